@@ -1,6 +1,6 @@
 import time
 import numpy as np
-from hcle_py.vector_env import HCLEVectorEnv
+from hcle_py.vector_env import NESVectorEnv
 
 def simulate_agent_work(delay_ms: int):
     """This function simulates the time an agent would spend 'thinking' (e.g., a GPU forward pass)."""
@@ -15,7 +15,7 @@ def run_performance_test():
     print("--- HCLE Performance Test ---")
     print(f"Envs: {num_envs}, Steps: {num_steps}, Agent Think Time: {agent_think_time_ms}ms")
 
-    envs = HCLEVectorEnv(game="smb1", num_envs=num_envs, render_mode="rgb_array", maxpool=False, grayscale=True, stack_num=1)
+    envs = NESVectorEnv(game="smb1", num_envs=num_envs, render_mode="rgb_array", maxpool=False, grayscale=True, stack_num=1)
     
     # --- 1. Synchronous Test (Your current method) ---
     print("\nRunning SYNCHRONOUS test...")
@@ -0,0 +1,798 @@
+// src/apps/behaviour_tests.cpp
+// Behaviour tests for the thread pool and its queue and latch, the frame codecs, trajectory
+// datasets, the replay buffer, the shared-memory vectorizer and the env server, e.g.
+//   hcle_behaviour_tests --test codecs
+// ctest runs one group per test; --test all runs them all. The shm group needs the
+// hcle_shm_worker binary passed as --shm-worker and runs one --autoreset mode per process.
+// Games load from HCLE_ROMS_DIR.
+// Exits with 0 if every check passes, 1 otherwise.
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <numeric>
+#include <random>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+#include "hcle/common/countdown_latch.hpp"
+#include "hcle/common/frame_codec.hpp"
+#include "hcle/common/thread_pool.hpp"
+#include "hcle/common/thread_safe_queue.hpp"
+#include "hcle/environment/async_vectorizer.hpp"
+#include "hcle/environment/env_client.hpp"
+#include "hcle/environment/env_server.hpp"
+#include "hcle/environment/hcle_vector_environment.hpp"
+#include "hcle/environment/replay_buffer.hpp"
+#include "hcle/environment/shm_vector_env.hpp"
+#include "hcle/environment/trajectory_dataset.hpp"
+
+namespace
+{
+    namespace common = hcle::common;
+    using namespace hcle::environment;
+
+    const std::map<std::string, std::string> kDefaults = {
+        {"test", "all"},
+        {"shm-worker", ""},
+        {"autoreset", "same_step"},
+        {"game", "smb1"},
+    };
+
+    void printUsage(const char *program)
+    {
+        std::cerr << "Usage: " << program << " [--option value]...\nOptions (defaults):\n";
+        for (const auto &[key, value] : kDefaults)
+            std::cerr << "  --" << key << " " << value << "\n";
+        std::cerr << "--test is all, pool, codecs, trajectory, replay_buffer, shm or server.\n";
+    }
+
+    int g_failures = 0;
+
+    void check(bool condition, const std::string &what)
+    {
+        if (condition)
+            return;
+        std::cerr << "FAIL: " << what << "\n";
+        g_failures++;
+    }
+
+    template <typename Exception, typename Fn>
+    void checkThrows(Fn &&fn, const std::string &what)
+    {
+        try
+        {
+            fn();
+        }
+        catch (const Exception &)
+        {
+            return;
+        }
+        catch (const std::exception &e)
+        {
+            check(false, what + " threw the wrong exception: " + e.what());
+            return;
+        }
+        check(false, what + " did not throw");
+    }
+
+    std::unique_ptr<PreprocessedEnv> makeEnv(const std::string &game)
+    {
+        return std::make_unique<PreprocessedEnv>("", game, 84, 84, 4, true, true, 4, false);
+    }
+
+    // Runs one env with random actions and returns its observations, back to back.
+    std::vector<uint8_t> collectObservations(const std::string &game, size_t num_steps, size_t &obs_size,
+                                             std::vector<size_t> &obs_shape)
+    {
+        auto env = makeEnv(game);
+        obs_size = env->getObservationSize();
+        obs_shape = env->getObservationShape();
+        std::mt19937 rng(3);
+        std::uniform_int_distribution<size_t> action_dist(0, env->getActionSet().size() - 1);
+        std::vector<uint8_t> obs(num_steps * obs_size);
+        env->reset(obs.data());
+        for (size_t i = 1; i < num_steps; ++i)
+        {
+            env->step(static_cast<uint8_t>(action_dist(rng)), obs.data() + i * obs_size);
+            if (env->isDone())
+                env->reset(obs.data() + i * obs_size);
+        }
+        return obs;
+    }
+
+    std::vector<uint8_t> randomActions(std::mt19937 &rng, size_t count, size_t num_actions)
+    {
+        std::vector<uint8_t> actions(count);
+        for (uint8_t &action : actions)
+            action = static_cast<uint8_t>(rng() % num_actions);
+        return actions;
+    }
+
+    void testPool()
+    {
+        common::ThreadPool pool(3);
+        common::ThreadPool::Client client(pool);
+
+        std::vector<std::atomic<int>> hits(1000);
+        client.parallelFor(static_cast<int>(hits.size()), [&](int i)
+                           { hits[i]++; });
+        check(std::all_of(hits.begin(), hits.end(), [](const std::atomic<int> &h)
+                          { return h.load() == 1; }),
+              "parallelFor runs every index exactly once");
+
+        client.submit([]
+                      { throw std::runtime_error("task failed"); });
+        checkThrows<std::runtime_error>([&]
+                                        { client.wait(); },
+                                        "Client::wait() after a failing task");
+        client.wait(); // The error was consumed
+
+        bool on_worker = false, resize_threw = false, respawn_threw = false;
+        client.submit([&]
+                      {
+                          on_worker = pool.isWorkerThread();
+                          try { pool.setNumThreads(2); } catch (const std::logic_error &) { resize_threw = true; }
+                          try { pool.respawnWorkers(); } catch (const std::logic_error &) { respawn_threw = true; } });
+        client.wait();
+        check(on_worker && !pool.isWorkerThread(), "isWorkerThread() is true only on the pool's workers");
+        check(resize_threw, "setNumThreads() from a task throws");
+        check(respawn_threw, "respawnWorkers() from a task throws");
+        checkThrows<std::invalid_argument>([&]
+                                           { pool.setNumThreads(0); },
+                                           "setNumThreads(0)");
+
+        // Queued tasks are kept across a resize and a respawn.
+        std::atomic<int> done{0};
+        for (int i = 0; i < 200; ++i)
+            client.submit([&]
+                          { done++; });
+        pool.setNumThreads(1);
+        pool.respawnWorkers();
+        client.wait();
+        check(done == 200 && pool.getNumThreads() == 1, "queued tasks survive setNumThreads() and respawnWorkers()");
+
+        // Never more than getNumThreads() tasks at once.
+        pool.setNumThreads(2);
+        std::atomic<int> running{0}, max_running{0};
+        client.parallelFor(32, [&](int)
+                           {
+                               const int now = ++running;
+                               int seen = max_running.load();
+                               while (now > seen && !max_running.compare_exchange_weak(seen, now))
+                               {
+                               }
+                               std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                               running--; });
+        check(max_running <= 2, "the pool runs at most getNumThreads() tasks at once");
+
+        common::ThreadSafeQueue<int> queue;
+        std::vector<int> items(10);
+        std::iota(items.begin(), items.end(), 0);
+        queue.push_bulk(std::span<const int>(items));
+        queue.push(10);
+        std::array<int, 4> head{};
+        check(queue.try_pop_bulk(std::span<int>(head)) == 4 && head == std::array<int, 4>{0, 1, 2, 3},
+              "try_pop_bulk() takes the oldest items in order");
+        check(queue.pop() == 4, "pop() continues after a bulk pop");
+        std::array<int, 16> rest{};
+        const size_t num_rest = queue.try_pop_bulk(std::span<int>(rest));
+        check(num_rest == 6 && rest[0] == 5 && rest[5] == 10, "try_pop_bulk() drains the rest");
+        check(queue.try_pop_bulk(std::span<int>(rest)) == 0, "try_pop_bulk() on an empty queue returns 0");
+        std::thread producer([&]
+                             {
+                                 std::this_thread::sleep_for(std::chrono::milliseconds(20));
+                                 queue.push(42); });
+        check(queue.pop() == 42, "pop() waits for a push from another thread");
+        producer.join();
+
+        common::CountdownLatch latch;
+        latch.reset(0);
+        latch.wait(); // Already released
+        for (int round = 0; round < 3; ++round)
+        {
+            std::atomic<int> counted{0};
+            latch.reset(10);
+            for (int i = 0; i < 8; ++i)
+                client.submit([&]
+                              {
+                                  counted++;
+                                  latch.count_down(); });
+            client.submit([&]
+                          {
+                              counted += 2;
+                              latch.count_down(2); });
+            latch.wait();
+            check(counted == 10, "CountdownLatch::wait() returns once the count reaches zero");
+            client.wait();
+        }
+        latch.reset(3);
+        latch.count_down(10);
+        latch.wait(); // Counting down past zero releases it once
+    }
+
+    void testCodecs(const std::string &game)
+    {
+        size_t obs_size = 0;
+        std::vector<size_t> shape;
+        const size_t num_frames = 200;
+        const std::vector<uint8_t> frames = collectObservations(game, num_frames, obs_size, shape);
+
+        const common::FrameCodec codecs[] = {common::FrameCodec::Raw, common::FrameCodec::DeltaRle,
+                                             common::FrameCodec::DeltaZlib};
+        for (const size_t stack_size : {size_t{1}, shape[0]})
+        {
+            for (const common::FrameCodec codec : codecs)
+            {
+                const std::string name = "codec " + std::to_string(static_cast<int>(codec)) + ", stack " +
+                                         std::to_string(stack_size);
+                // Stream 1 sees the frames in reverse, so streams must not share references.
+                common::FrameEncoder encoder(2, obs_size, stack_size);
+                common::FrameDecoder decoder(2, obs_size, stack_size);
+                std::vector<uint8_t> batch(2 * obs_size), encoded, decoded(2 * obs_size);
+                size_t raw_records = 0;
+                for (size_t i = 0; i < num_frames; ++i)
+                {
+                    std::memcpy(batch.data(), frames.data() + i * obs_size, obs_size);
+                    std::memcpy(batch.data() + obs_size, frames.data() + (num_frames - 1 - i) * obs_size, obs_size);
+                    if (i == num_frames / 2)
+                        encoder.resetStream(0);
+                    encoded.clear();
+                    encoder.encode(batch.data(), codec, encoded);
+                    const size_t consumed = decoder.decode(encoded.data(), encoded.size(), decoded.data());
+                    check(consumed == encoded.size(), name + ": decode() consumes the whole batch");
+                    check(decoded == batch, name + ": round trip of frame " + std::to_string(i));
+                    check(std::memcmp(decoder.getFrame(1), batch.data() + obs_size, obs_size) == 0,
+                          name + ": getFrame() returns the last decoded frame");
+                    const auto first = static_cast<common::FrameCodec>(encoded[0]);
+                    if (i == 0 || i == num_frames / 2)
+                        check(first == common::FrameCodec::Raw, name + ": first frame after a reset is Raw");
+                    raw_records += first == common::FrameCodec::Raw;
+                }
+                if (codec != common::FrameCodec::Raw)
+                    check(raw_records < num_frames / 2, name + ": most frames are delta-coded");
+            }
+        }
+
+        // Stacked deltas only carry the newest frame, so they must beat unshifted ones.
+        size_t sizes[2] = {};
+        for (int shifted = 0; shifted < 2; ++shifted)
+        {
+            common::FrameEncoder encoder(1, obs_size, shifted ? shape[0] : 1);
+            std::vector<uint8_t> encoded;
+            for (size_t i = 0; i < num_frames; ++i)
+                encoder.encode(frames.data() + i * obs_size, common::FrameCodec::DeltaRle, encoded);
+            sizes[shifted] = encoded.size();
+        }
+        check(sizes[1] < sizes[0], "shifted stack deltas are smaller than unshifted ones");
+
+        checkThrows<std::invalid_argument>([&]
+                                           { common::FrameEncoder(1, 10, 3); },
+                                           "a frame size that is not a multiple of the stack size");
+        common::FrameDecoder decoder(1, 16);
+        const uint8_t truncated[] = {0, 16, 0, 0, 0, 1, 2};
+        checkThrows<std::runtime_error>([&]
+                                        { decoder.decodeFrame(0, truncated, sizeof(truncated)); },
+                                        "decoding a truncated record");
+        const uint8_t wrong_size[] = {0, 2, 0, 0, 0, 1, 2};
+        checkThrows<std::runtime_error>([&]
+                                        { decoder.decodeFrame(0, wrong_size, sizeof(wrong_size)); },
+                                        "decoding a Raw record of the wrong size");
+        const uint8_t overrun[] = {1, 3, 0, 0, 0, 15, 4, 1};
+        checkThrows<std::runtime_error>([&]
+                                        { decoder.decodeFrame(0, overrun, sizeof(overrun)); },
+                                        "decoding a DeltaRle record that overruns the frame");
+        const uint8_t unknown[] = {9, 0, 0, 0, 0};
+        checkThrows<std::runtime_error>([&]
+                                        { decoder.decodeFrame(0, unknown, sizeof(unknown)); },
+                                        "decoding an unknown codec");
+    }
+
+    struct RecordedStep
+    {
+        std::vector<uint8_t> obs;
+        uint8_t action;
+        double reward;
+        bool done;
+        bool truncated;
+    };
+
+    // Checks every episode of a dataset against the steps each env produced, in order.
+    void checkDataset(const std::string &directory, const std::vector<std::vector<RecordedStep>> &expected,
+                      const std::string &name)
+    {
+        TrajectoryReader reader(directory);
+        const size_t obs_size = reader.getObservationSize();
+        std::vector<size_t> position(expected.size(), 0);
+        std::vector<uint8_t> obs(obs_size), episode_obs;
+        TrajectoryCursor cursor(reader);
+        for (size_t episode = 0; episode < reader.getNumEpisodes(); ++episode)
+        {
+            const uint32_t env = reader.getEpisodeEnv(episode);
+            const size_t length = reader.getEpisodeLength(episode);
+            episode_obs.resize(length * obs_size);
+            std::vector<uint8_t> actions(length), dones(length), truncateds(length);
+            std::vector<double> rewards(length);
+            reader.readEpisode(episode, episode_obs.data(), actions.data(), rewards.data(), dones.data(), truncateds.data());
+            check(actions[0] == kNoAction, name + ": episodes start with a reset observation");
+            cursor.seek(episode);
+            for (size_t k = 0; k < length; ++k)
+            {
+                const RecordedStep &step = expected[env].at(position[env]++);
+                const TrajectoryStep random_access = reader.getStep(episode, length - 1 - k, obs.data());
+                check(std::memcmp(obs.data(), episode_obs.data() + (length - 1 - k) * obs_size, obs_size) == 0 &&
+                          random_access.action == actions[length - 1 - k],
+                      name + ": getStep() agrees with readEpisode()");
+                cursor.next(obs.data());
+                check(std::memcmp(obs.data(), episode_obs.data() + k * obs_size, obs_size) == 0,
+                      name + ": TrajectoryCursor agrees with readEpisode()");
+                check(std::memcmp(episode_obs.data() + k * obs_size, step.obs.data(), obs_size) == 0 &&
+                          rewards[k] == step.reward && (dones[k] != 0) == step.done &&
+                          (truncateds[k] != 0) == step.truncated && (k == 0 || actions[k] == step.action),
+                      name + ": episode " + std::to_string(episode) + " step " + std::to_string(k));
+            }
+            check(cursor.atEnd(), name + ": the cursor ends with the episode");
+        }
+        for (size_t env = 0; env < expected.size(); ++env)
+            check(position[env] == expected[env].size(), name + ": every recorded step is read back");
+    }
+
+    void testTrajectory(const std::string &game)
+    {
+        const int num_envs = 3;
+        const std::string directory = (std::filesystem::temp_directory_path() /
+                                       ("hcle_behaviour_trajectory_" + std::to_string(getpid())))
+                                          .string();
+        for (const common::FrameCodec codec : {common::FrameCodec::DeltaRle, common::FrameCodec::DeltaZlib})
+        {
+            const std::string name = "trajectory codec " + std::to_string(static_cast<int>(codec));
+            std::filesystem::remove_all(directory);
+            AsyncVectorizer vectorizer(num_envs, [&](int)
+                                       { return makeEnv(game); }, 25, AutoResetMode::NextStep, 2);
+            const size_t obs_size = vectorizer.getObservationSize();
+            TrajectoryRecorderConfig config;
+            config.codec = codec;
+            config.chunk_size = 300 << 10; // Several chunks
+            config.keyframe_interval = 10;
+            vectorizer.startRecording(directory, config);
+
+            std::vector<std::vector<RecordedStep>> expected(num_envs);
+            std::vector<uint8_t> obs(num_envs * obs_size), dones(num_envs), truncateds(num_envs);
+            std::vector<double> rewards(num_envs);
+            vectorizer.reset(obs.data(), rewards.data(), dones.data(), truncateds.data());
+            for (int env = 0; env < num_envs; ++env)
+                expected[env].push_back({std::vector<uint8_t>(obs.begin() + env * obs_size, obs.begin() + (env + 1) * obs_size),
+                                         kNoAction, 0.0, false, false});
+            std::mt19937 rng(1);
+            for (int s = 0; s < 80; ++s)
+            {
+                const std::vector<uint8_t> actions = randomActions(rng, num_envs, vectorizer.getActionSet().size());
+                vectorizer.send(std::span<const uint8_t>(actions));
+                vectorizer.recv(obs.data(), rewards.data(), dones.data(), truncateds.data());
+                for (int env = 0; env < num_envs; ++env)
+                    expected[env].push_back({std::vector<uint8_t>(obs.begin() + env * obs_size, obs.begin() + (env + 1) * obs_size),
+                                             actions[env], rewards[env], dones[env] != 0, truncateds[env] != 0});
+            }
+            vectorizer.stopRecording();
+
+            TrajectoryReader reader(directory);
+            check(reader.getNumChunks() > 1, name + ": the dataset spans several chunks");
+            check(reader.getObservationShape() == vectorizer.getObservationShape(), name + ": observation shape");
+            checkDataset(directory, expected, name);
+        }
+
+        // stepMany() in SameStep mode returns the next episode's reset observation on terminal
+        // steps, so the recorder must get the terminal ones separately. Episodes are short
+        // enough that envs end several per block; the expected steps come from send()/recv().
+        {
+            const std::string name = "trajectory same-step stepMany";
+            std::filesystem::remove_all(directory);
+            auto make = [&](int)
+            { return makeEnv(game); };
+            AsyncVectorizer vectorizer(num_envs, make, 12, AutoResetMode::SameStep, 2);
+            AsyncVectorizer reference(num_envs, make, 12, AutoResetMode::SameStep, 2);
+            const size_t obs_size = vectorizer.getObservationSize();
+            vectorizer.startRecording(directory, TrajectoryRecorderConfig{});
+
+            std::vector<std::vector<RecordedStep>> expected(num_envs);
+            std::vector<uint8_t> obs(num_envs * obs_size), dones(num_envs), truncateds(num_envs);
+            std::vector<double> rewards(num_envs);
+            vectorizer.reset(nullptr, nullptr, nullptr);
+            reference.reset(obs.data(), rewards.data(), dones.data(), truncateds.data());
+            auto expect = [&](int env, const uint8_t *env_obs, uint8_t action, double reward, bool done, bool truncated)
+            { expected[env].push_back({std::vector<uint8_t>(env_obs, env_obs + obs_size), action, reward, done, truncated}); };
+            for (int env = 0; env < num_envs; ++env)
+                expect(env, obs.data() + env * obs_size, kNoAction, 0.0, false, false);
+
+            const int num_steps = 40;
+            std::mt19937 rng(2);
+            std::vector<uint8_t> block_obs(num_steps * num_envs * obs_size), block_dones(num_steps * num_envs),
+                block_truncateds(num_steps * num_envs);
+            std::vector<double> block_rewards(num_steps * num_envs);
+            for (int block = 0; block < 2; ++block)
+            {
+                const std::vector<uint8_t> actions = randomActions(rng, num_steps * num_envs, vectorizer.getActionSet().size());
+                vectorizer.stepMany(actions.data(), num_steps, block_obs.data(), block_rewards.data(), block_dones.data(),
+                                    block_truncateds.data());
+                for (int t = 0; t < num_steps; ++t)
+                {
+                    reference.send(std::span<const uint8_t>(actions.data() + t * num_envs, num_envs));
+                    reference.recv(obs.data(), rewards.data(), dones.data(), truncateds.data());
+                    check(std::memcmp(obs.data(), block_obs.data() + t * num_envs * obs_size, obs.size()) == 0,
+                          name + ": stepMany() matches send()/recv()");
+                    for (int env = 0; env < num_envs; ++env)
+                    {
+                        const uint8_t *env_obs = obs.data() + env * obs_size;
+                        if (!dones[env] && !truncateds[env])
+                        {
+                            expect(env, env_obs, actions[t * num_envs + env], rewards[env], false, false);
+                            continue;
+                        }
+                        expect(env, reference.getFinalObservations() + env * obs_size, actions[t * num_envs + env],
+                               rewards[env], dones[env] != 0, truncateds[env] != 0);
+                        expect(env, env_obs, kNoAction, 0.0, false, false);
+                    }
+                }
+            }
+            vectorizer.stopRecording();
+            check(reference.getEpisodeCounts()[0] >= 4, name + ": envs end several episodes per block");
+            checkDataset(directory, expected, name);
+        }
+
+        // A recorder that dies leaves its last chunk unsealed, possibly with a torn record
+        // past data_end. The reader must walk its complete records.
+        TrajectoryReader sealed(directory);
+        std::vector<std::filesystem::path> chunks;
+        for (const auto &entry : std::filesystem::directory_iterator(directory))
+            chunks.push_back(entry.path());
+        std::sort(chunks.begin(), chunks.end());
+        size_t sealed_records = 0;
+        for (size_t episode = 0; episode < sealed.getNumEpisodes(); ++episode)
+            sealed_records += sealed.getEpisodeLength(episode);
+        {
+            FILE *file = std::fopen(chunks.back().string().c_str(), "r+b");
+            TrajectoryChunkHeader header;
+            check(file && std::fread(&header, sizeof(header), 1, file) == 1, "read the last chunk header");
+            header.sealed = 0;
+            header.data_end -= 8; // Cut the last record short
+            std::fseek(file, 0, SEEK_SET);
+            std::fwrite(&header, sizeof(header), 1, file);
+            std::fclose(file);
+        }
+        TrajectoryReader unsealed(directory);
+        size_t unsealed_records = 0;
+        std::vector<uint8_t> expected_obs(sealed.getObservationSize()), obs(sealed.getObservationSize());
+        for (size_t episode = 0; episode < unsealed.getNumEpisodes(); ++episode)
+        {
+            unsealed_records += unsealed.getEpisodeLength(episode);
+            for (size_t k = 0; k < unsealed.getEpisodeLength(episode); ++k)
+            {
+                sealed.getStep(episode, k, expected_obs.data());
+                unsealed.getStep(episode, k, obs.data());
+                check(obs == expected_obs, "unsealed chunk: step decodes as before");
+            }
+        }
+        check(unsealed_records + 1 == sealed_records, "unsealed chunk: every complete record is read, the torn one is not");
+        std::filesystem::remove_all(directory);
+    }
+
+    // Samples must be transitions some env actually made, with stacks rebuilt across
+    // episode starts as the env built them.
+    void testReplayBuffer(const std::string &game)
+    {
+        using Transition = std::tuple<std::string, uint8_t, double, std::string, bool, bool>;
+        const int num_envs = 3;
+        for (const AutoResetMode mode : {AutoResetMode::NextStep, AutoResetMode::SameStep})
+        {
+            for (const size_t capacity : {size_t{90}, size_t{3000}})
+            {
+                const std::string name = std::string("replay buffer ") +
+                                         (mode == AutoResetMode::SameStep ? "same_step" : "next_step") +
+                                         ", capacity " + std::to_string(capacity);
+                const bool same_step = mode == AutoResetMode::SameStep;
+                AsyncVectorizer vectorizer(num_envs, [&](int)
+                                           { return makeEnv(game); }, 15, mode, 2);
+                const size_t obs_size = vectorizer.getObservationSize();
+                ReplayBuffer buffer(capacity, num_envs, vectorizer.getObservationShape(), 7);
+
+                std::set<Transition> made;
+                std::vector<std::string> previous(num_envs);
+                std::vector<bool> ended(num_envs, false);
+                vectorizer.reset(nullptr, nullptr, nullptr, nullptr);
+                int slot = vectorizer.getCurrentResultSlot();
+                buffer.add(vectorizer.getResultObservations(slot), vectorizer.getResultActions(),
+                           vectorizer.getResultRewards(slot), vectorizer.getResultDones(slot),
+                           vectorizer.getResultTruncateds(slot), nullptr);
+                for (int env = 0; env < num_envs; ++env)
+                    previous[env].assign(reinterpret_cast<const char *>(vectorizer.getResultObservations(slot)) + env * obs_size, obs_size);
+
+                std::mt19937 rng(1);
+                int episode_ends = 0;
+                for (int s = 0; s < 120; ++s)
+                {
+                    const std::vector<uint8_t> actions = randomActions(rng, num_envs, vectorizer.getActionSet().size());
+                    vectorizer.send(std::span<const uint8_t>(actions));
+                    vectorizer.recv(nullptr, nullptr, nullptr, nullptr);
+                    slot = vectorizer.getCurrentResultSlot();
+                    const auto *obs = reinterpret_cast<const char *>(vectorizer.getResultObservations(slot));
+                    const double *rewards = vectorizer.getResultRewards(slot);
+                    const uint8_t *dones = vectorizer.getResultDones(slot);
+                    const uint8_t *truncateds = vectorizer.getResultTruncateds(slot);
+                    const auto *final_obs = reinterpret_cast<const char *>(vectorizer.getFinalObservations());
+                    buffer.add(vectorizer.getResultObservations(slot), vectorizer.getResultActions(), rewards, dones,
+                               truncateds, same_step ? vectorizer.getFinalObservations() : nullptr);
+                    for (int env = 0; env < num_envs; ++env)
+                    {
+                        const bool terminal = dones[env] || truncateds[env];
+                        std::string current(obs + env * obs_size, obs_size);
+                        if (!ended[env])
+                        {
+                            std::string next = same_step && terminal ? std::string(final_obs + env * obs_size, obs_size) : current;
+                            made.insert({previous[env], actions[env], rewards[env], next, dones[env] != 0, truncateds[env] != 0});
+                        }
+                        ended[env] = !same_step && terminal;
+                        episode_ends += terminal;
+                        previous[env] = std::move(current);
+                    }
+                }
+                check(episode_ends > num_envs, name + ": the run crosses several episode boundaries");
+                check(buffer.getMemoryUsage() < buffer.getCapacity() * obs_size, name + ": frames are stored once");
+
+                const size_t batch = 256;
+                std::vector<uint8_t> obs(batch * obs_size), next_obs(batch * obs_size), actions(batch), dones(batch),
+                    truncateds(batch);
+                std::vector<double> rewards(batch);
+                size_t unknown = 0, terminals = 0;
+                for (int round = 0; round < 4; ++round)
+                {
+                    buffer.sample(batch, obs.data(), actions.data(), rewards.data(), next_obs.data(), dones.data(),
+                                  truncateds.data());
+                    for (size_t i = 0; i < batch; ++i)
+                    {
+                        const Transition sampled{std::string(reinterpret_cast<char *>(obs.data()) + i * obs_size, obs_size),
+                                                 actions[i], rewards[i],
+                                                 std::string(reinterpret_cast<char *>(next_obs.data()) + i * obs_size, obs_size),
+                                                 dones[i] != 0, truncateds[i] != 0};
+                        unknown += !made.count(sampled);
+                        terminals += dones[i] || truncateds[i];
+                    }
+                }
+                check(unknown == 0, name + ": " + std::to_string(unknown) + " sampled transitions were never made");
+                check(terminals > 0, name + ": samples include episode ends");
+            }
+        }
+    }
+
+    // Compares the workers with an in-process HCLEVectorEnvironment. Games share one reset
+    // snapshot per process (GameLogic's backup state), so the reference only matches fresh
+    // workers if it holds the first envs of this process: run it before any other group.
+    void testShm(const std::string &game, const std::string &worker_path, const std::string &autoreset)
+    {
+        if (worker_path.empty())
+            throw std::invalid_argument("The shm test needs --shm-worker.");
+        const int num_envs = 6;
+        const std::string name = "shm " + autoreset;
+        ShmVectorEnvironment shm(worker_path, num_envs, 3, game, 84, 84, 4, true, true, 4, false, 30, autoreset, 1);
+        HCLEVectorEnvironment reference(num_envs, "", game, "rgb_array", 84, 84, 4, true, true, 4, false, 30, autoreset, 1);
+        const size_t obs_size = shm.getObservationSize();
+        check(obs_size == reference.getObservationSize(), name + ": observation size");
+        std::vector<uint8_t> obs(num_envs * obs_size), dones(num_envs), truncateds(num_envs);
+        std::vector<double> rewards(num_envs);
+        shm.reset();
+        reference.reset(obs.data(), rewards.data(), dones.data(), truncateds.data());
+        check(std::memcmp(obs.data(), shm.getObservations(), obs.size()) == 0, name + ": reset observations");
+
+        int episode_ends = 0;
+        for (int s = 0; s < 100; ++s)
+        {
+            std::vector<int32_t> actions(num_envs);
+            for (int env = 0; env < num_envs; ++env)
+                actions[env] = (s / 10 + env) % 2;
+            shm.send(std::span<const int32_t>(actions));
+            reference.send(std::vector<int>(actions.begin(), actions.end()));
+            shm.recv();
+            reference.recv(obs.data(), rewards.data(), dones.data(), truncateds.data());
+            check(std::memcmp(obs.data(), shm.getObservations(), obs.size()) == 0 &&
+                      std::memcmp(rewards.data(), shm.getRewards(), num_envs * sizeof(double)) == 0 &&
+                      std::memcmp(dones.data(), shm.getDones(), num_envs) == 0 &&
+                      std::memcmp(truncateds.data(), shm.getTruncateds(), num_envs) == 0,
+                  name + ": step " + std::to_string(s) + " matches the in-process vectorizer");
+            for (int env = 0; env < num_envs; ++env)
+            {
+                if (!dones[env] && !truncateds[env])
+                    continue;
+                episode_ends++;
+                check(reference.getLastEpisodeReturns()[env] == shm.getLastEpisodeReturns()[env] &&
+                          reference.getLastEpisodeLengths()[env] == shm.getLastEpisodeLengths()[env],
+                      name + ": episode return and length");
+                if (shm.usesSameStepAutoreset())
+                    check(std::memcmp(reference.getFinalObservations() + env * obs_size,
+                                      shm.getFinalObservations() + env * obs_size, obs_size) == 0,
+                          name + ": final observation");
+            }
+        }
+        check(episode_ends > 0, name + ": episodes end during the run");
+
+        const std::vector<int32_t> actions(num_envs, 0);
+        shm.send(std::span<const int32_t>(actions));
+        checkThrows<std::logic_error>([&]
+                                      { shm.send(std::span<const int32_t>(actions)); },
+                                      name + ": a second send() before recv()");
+        checkThrows<std::logic_error>([&]
+                                      { shm.reset(); },
+                                      name + ": reset() with a step in flight");
+        shm.recv();
+        shm.send(std::span<const int32_t>(actions));
+        shm.recv();
+
+        checkThrows<std::runtime_error>([&]
+                                       { ShmVectorEnvironment(worker_path, 2, 2, "no_such_game"); },
+                                       "shm: a worker that fails to start");
+    }
+
+    void testServer(const std::string &game)
+    {
+        const int num_envs = 3;
+        const std::string address = "tcp:127.0.0.1:" + std::to_string(20000 + getpid() % 20000);
+        auto factory = [&](int)
+        { return makeEnv(game); };
+        EnvServer server(std::make_unique<AsyncVectorizer>(num_envs, factory, 50, AutoResetMode::NextStep, 2));
+        std::exception_ptr server_error;
+        std::thread serving([&]
+                            {
+                                try { server.serve(address, 2); }
+                                catch (...) { server_error = std::current_exception(); } });
+
+        // Follows the server's vectorizer, which carries its envs over between connections.
+        AsyncVectorizer reference(num_envs, factory, 50, AutoResetMode::NextStep, 2);
+        const size_t obs_size = reference.getObservationSize();
+        std::vector<uint8_t> obs(num_envs * obs_size), dones(num_envs), truncateds(num_envs);
+        std::vector<uint8_t> ref_obs(obs.size()), ref_dones(num_envs), ref_truncateds(num_envs);
+        std::vector<double> rewards(num_envs), ref_rewards(num_envs);
+        auto matches = [&]
+        {
+            return obs == ref_obs && rewards == ref_rewards && dones == ref_dones && truncateds == ref_truncateds;
+        };
+        auto referenceStep = [&](const std::vector<uint8_t> &actions)
+        {
+            reference.send(std::span<const uint8_t>(actions));
+            reference.recv(ref_obs.data(), ref_rewards.data(), ref_dones.data(), ref_truncateds.data());
+        };
+
+        for (const common::FrameCodec codec : {common::FrameCodec::Raw, common::FrameCodec::DeltaRle})
+        {
+            const std::string name = "server codec " + std::to_string(static_cast<int>(codec));
+            std::unique_ptr<EnvClient> client;
+            for (int attempt = 0; !client; ++attempt)
+            {
+                try
+                {
+                    client = std::make_unique<EnvClient>(address, codec);
+                }
+                catch (const std::exception &)
+                {
+                    if (attempt == 100)
+                        throw;
+                    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+                }
+            }
+            check(client->getObservationShape() == reference.getObservationShape(), name + ": observation shape");
+            check(client->getActionSet() == reference.getActionSet(), name + ": action set");
+
+            client->reset(obs.data(), rewards.data(), dones.data(), truncateds.data());
+            reference.reset(ref_obs.data(), ref_rewards.data(), ref_dones.data(), ref_truncateds.data());
+            check(obs == ref_obs, name + ": reset observations");
+
+            // Keep two steps in flight.
+            std::mt19937 rng(2);
+            std::vector<std::vector<uint8_t>> actions;
+            for (int s = 0; s < 60; ++s)
+                actions.push_back(randomActions(rng, num_envs, reference.getActionSet().size()));
+            client->send(actions[0]);
+            for (size_t s = 0; s < actions.size(); ++s)
+            {
+                if (s + 1 < actions.size())
+                    client->send(actions[s + 1]);
+                client->recv(obs.data(), rewards.data(), dones.data(), truncateds.data());
+                referenceStep(actions[s]);
+                check(matches(), name + ": pipelined step " + std::to_string(s));
+            }
+
+            // A bad request behind a good one fails alone; the connection stays usable.
+            client->send(actions[0]);
+            client->send(std::vector<uint8_t>(num_envs, 99));
+            client->recv(obs.data(), rewards.data(), dones.data(), truncateds.data());
+            referenceStep(actions[0]);
+            check(matches(), name + ": the step before a bad request");
+            checkThrows<std::runtime_error>([&]
+                                            { client->recv(nullptr, nullptr, nullptr); },
+                                            name + ": out-of-range actions");
+            client->send(actions[1]);
+            client->recv(obs.data(), rewards.data(), dones.data(), truncateds.data());
+            referenceStep(actions[1]);
+            check(matches(), name + ": the step after a bad request");
+
+            // Disconnect with a step in flight; the server finishes it and moves on.
+            client->send(actions[2]);
+            client.reset();
+            referenceStep(actions[2]);
+        }
+        serving.join();
+        if (server_error)
+            std::rethrow_exception(server_error);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    std::map<std::string, std::string> options = kDefaults;
+    for (int i = 1; i < argc; i += 2)
+    {
+        const std::string key = argv[i];
+        if (key.rfind("--", 0) != 0 || i + 1 >= argc || !options.count(key.substr(2)))
+        {
+            printUsage(argv[0]);
+            return 2;
+        }
+        options[key.substr(2)] = argv[i + 1];
+    }
+
+    const std::string game = options.at("game");
+    const std::vector<std::pair<std::string, std::function<void()>>> tests = {
+        {"shm", [&]
+         { testShm(game, options.at("shm-worker"), options.at("autoreset")); }},
+        {"pool", [&]
+         { testPool(); }},
+        {"codecs", [&]
+         { testCodecs(game); }},
+        {"trajectory", [&]
+         { testTrajectory(game); }},
+        {"replay_buffer", [&]
+         { testReplayBuffer(game); }},
+        {"server", [&]
+         { testServer(game); }},
+    };
+
+    const std::string selected = options.at("test");
+    bool found = false;
+    for (const auto &[name, run] : tests)
+    {
+        if (selected != "all" && selected != name)
+            continue;
+        if (selected == "all" && name == "shm" && options.at("shm-worker").empty())
+        {
+            std::cout << "skipping shm: no --shm-worker\n";
+            continue;
+        }
+        found = true;
+        const int failures_before = g_failures;
+        try
+        {
+            run();
+        }
+        catch (const std::exception &e)
+        {
+            check(false, name + " aborted: " + e.what());
+        }
+        std::cout << name << ": " << (g_failures == failures_before ? "ok" : "FAILED") << "\n";
+    }
+    if (!found)
+    {
+        printUsage(argv[0]);
+        return 2;
+    }
+    return g_failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,729 @@
+// src/apps/bench.cpp
+// Micro and macro benchmarks of the emulator and environment stack, e.g.
+//   hcle_bench --scenarios cpu,ppu,state,env --games smb1,tetris
+//   hcle_bench --scenarios vec --vec-envs 8,32 --vec-threads 1,4 --think-time 0,16 --output results.csv
+//   hcle_bench --scenarios scaling --scaling-envs 16,64 --scaling-report scaling.json
+//
+// Scenarios:
+//   cpu    CPU instructions/s (each instruction ticks the PPU, APU and mapper with it)
+//   ppu    emulated frames/s per output mode (rgb, grayscale, index, render_skip)
+//   state  NES::save() and NES::load() latency
+//   env    PreprocessedEnv::step() steps/s per game
+//   preprocess  FramePreprocessor::step() observations/s on a captured game frame
+//   vec    AsyncVectorizer steps/s per env count, thread count and think time, run both
+//          synchronously and pipelined like performance_test.py
+//   scaling  AsyncVectorizer throughput over a grid of thread and env counts, for sizing hosts
+//
+// Every result is one row with the columns below, written as CSV (the vec rows fill in the
+// think_time, sync_duration and async_duration columns of performance_results.csv) or JSON.
+//
+// --perf 1 also reads Linux hardware counters (perf_event_open) around each measured loop,
+// vectorizer workers included, and adds IPC plus cycles, instructions, branch misses and
+// L1D / last-level cache read misses per emulated frame (per iteration for the state and
+// preprocess scenarios). Where the counters can't be opened, e.g. perf_event_paranoid > 2
+// or no PMU in a VM, the bench warns once and leaves those columns empty.
+//
+// The scaling scenario runs --scaling-threads (auto: powers of two up to the hardware
+// concurrency, plus twice that, oversubscribed) against every --scaling-envs count, without
+// think time. Per env count it compares each throughput with ideal linear scaling from the
+// fewest threads (capped at the env count and the core count), and finds the knee: the last
+// thread count before efficiency falls below --scaling-knee. The point past the knee is
+// classified from the vectorizer's latency histograms: if the mean env step slowed down,
+// the workers contend for caches or memory bandwidth (memory_bandwidth); if steps kept their
+// speed but the workers spent less of their time stepping, dispatch, claiming and completion
+// dominate (queue_contention). The curves and knees are written as JSON to --scaling-report.
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <random>
+#include <span>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "hcle/common/perf_counters.hpp"
+#include "hcle/common/thread_pool.hpp"
+#include "hcle/environment/async_vectorizer.hpp"
+#include "hcle/environment/frame_preprocessor.hpp"
+#include "hcle/environment/hcle_environment.hpp"
+#include "hcle/environment/preprocessed_env.hpp"
+#include "hcle/games/roms.hpp"
+
+namespace
+{
+    const std::map<std::string, std::string> kDefaults = {
+        {"scenarios", "cpu,ppu,state,env,preprocess,vec"},
+        {"games", "smb1"},
+        {"frames", "600"},
+        {"state-iterations", "2000"},
+        {"steps", "1000"},
+        {"preprocess-iterations", "20000"},
+        {"obs-height", "84"},
+        {"obs-width", "84"},
+        {"frame-skip", "4"},
+        {"maxpool", "1"},
+        {"grayscale", "1"},
+        {"stack", "4"},
+        {"vec-game", "smb1"},
+        {"vec-steps", "200"},
+        {"vec-envs", "1,4,16,64"},
+        {"vec-threads", "1,2,4"},
+        {"think-time", "0"},
+        {"format", "csv"},
+        {"output", "-"},
+        {"seed", "0"},
+        {"perf", "0"},
+        {"scaling-threads", "auto"},
+        {"scaling-envs", "8,32,128"},
+        {"scaling-knee", "0.75"},
+        {"scaling-report", "scaling_report.json"},
+    };
+
+    void printUsage(const char *program)
+    {
+        std::cerr << "Usage: " << program << " [--option value]...\nOptions (defaults):\n";
+        for (const auto &[key, value] : kDefaults)
+            std::cerr << "  --" << key << " " << value << "\n";
+        std::cerr << "--games all runs every supported game. --format is csv or json; --output - writes to stdout.\n";
+    }
+
+    using clock_type = std::chrono::steady_clock;
+
+    double secondsSince(clock_type::time_point start)
+    {
+        return std::chrono::duration<double>(clock_type::now() - start).count();
+    }
+
+    std::vector<std::string> splitList(const std::string &list)
+    {
+        std::vector<std::string> items;
+        std::stringstream stream(list);
+        for (std::string item; std::getline(stream, item, ',');)
+            if (!item.empty())
+                items.push_back(item);
+        return items;
+    }
+
+    std::vector<int> splitInts(const std::string &list)
+    {
+        std::vector<int> values;
+        for (const std::string &item : splitList(list))
+            values.push_back(std::stoi(item));
+        return values;
+    }
+
+    struct Result
+    {
+        std::string scenario;
+        std::string game;
+        std::string variant;
+        int num_envs = 1;
+        int num_threads = 1;
+        int think_time = 0; // ms
+        uint64_t iterations = 0;
+        double seconds = 0.0;
+        std::string unit;
+        double sync_duration = -1.0; // vec only; -1 when not measured
+        double async_duration = -1.0;
+        uint64_t frames = 0; // Emulated frames in the measured loop, 0 if it emulates none
+        hcle::common::PerfCounters::Sample perf{};
+
+        double rate() const { return seconds > 0.0 ? iterations / seconds : 0.0; }
+        double latencyUs() const { return iterations ? seconds * 1e6 / iterations : 0.0; }
+    };
+
+    const char *kColumns[] = {"scenario", "game", "variant", "num_envs", "num_threads", "think_time", "iterations",
+                              "seconds", "rate", "unit", "latency_us", "sync_duration", "async_duration"};
+
+    // Derived hardware counter columns; -1 where a counter is missing.
+    const char *kPerfColumns[] = {"ipc", "cycles_per_frame", "instructions_per_frame", "branch_misses_per_frame",
+                                  "branch_miss_rate", "l1d_misses_per_frame", "llc_misses_per_frame"};
+
+    std::vector<double> perfColumns(const Result &r)
+    {
+        const auto &p = r.perf;
+        const double per = static_cast<double>(r.frames ? r.frames : r.iterations);
+        auto ratio = [](double a, double b)
+        { return a >= 0.0 && b > 0.0 ? a / b : -1.0; };
+        return {ratio(p.get(1), p.get(0)), ratio(p.get(0), per), ratio(p.get(1), per), ratio(p.get(3), per),
+                ratio(p.get(3), p.get(2)), ratio(p.get(4), per), ratio(p.get(5), per)};
+    }
+
+    // Hardware counters around one measured loop when --perf is on. Open them before
+    // spawning threads that should be counted.
+    class PerfSection
+    {
+    public:
+        explicit PerfSection(bool enabled)
+        {
+            if (!enabled)
+                return;
+            m_counters = std::make_unique<hcle::common::PerfCounters>();
+            if (m_counters->isAvailable())
+                return;
+            static bool warned = false;
+            if (!warned)
+                std::cerr << "hcle_bench: hardware counters unavailable (" << m_counters->getError()
+                          << "); continuing without them\n";
+            warned = true;
+            m_counters.reset();
+        }
+
+        void start()
+        {
+            if (m_counters)
+                m_counters->start();
+        }
+
+        hcle::common::PerfCounters::Sample stop() { return m_counters ? m_counters->stop() : hcle::common::PerfCounters::Sample{}; }
+
+    private:
+        std::unique_ptr<hcle::common::PerfCounters> m_counters;
+    };
+
+    void writeCsv(std::ostream &out, const std::vector<Result> &results)
+    {
+        for (size_t i = 0; i < std::size(kColumns); ++i)
+            out << (i ? "," : "") << kColumns[i];
+        for (const char *column : kPerfColumns)
+            out << "," << column;
+        out << "\n";
+        for (const Result &r : results)
+        {
+            out << r.scenario << "," << r.game << "," << r.variant << "," << r.num_envs << "," << r.num_threads << ","
+                << r.think_time << "," << r.iterations << "," << r.seconds << "," << r.rate() << "," << r.unit << ","
+                << r.latencyUs() << ",";
+            if (r.sync_duration >= 0.0)
+                out << r.sync_duration << "," << r.async_duration;
+            else
+                out << ",";
+            for (double value : perfColumns(r))
+            {
+                out << ",";
+                if (value >= 0.0)
+                    out << value;
+            }
+            out << "\n";
+        }
+    }
+
+    void writeJson(std::ostream &out, const std::vector<Result> &results)
+    {
+        out << "[\n";
+        for (size_t i = 0; i < results.size(); ++i)
+        {
+            const Result &r = results[i];
+            out << "  {\"scenario\": \"" << r.scenario << "\", \"game\": \"" << r.game << "\", \"variant\": \"" << r.variant
+                << "\", \"num_envs\": " << r.num_envs << ", \"num_threads\": " << r.num_threads
+                << ", \"think_time\": " << r.think_time << ", \"iterations\": " << r.iterations
+                << ", \"seconds\": " << r.seconds << ", \"rate\": " << r.rate() << ", \"unit\": \"" << r.unit
+                << "\", \"latency_us\": " << r.latencyUs();
+            if (r.sync_duration >= 0.0)
+                out << ", \"sync_duration\": " << r.sync_duration << ", \"async_duration\": " << r.async_duration;
+            const std::vector<double> perf = perfColumns(r);
+            for (size_t k = 0; k < perf.size(); ++k)
+                if (perf[k] >= 0.0)
+                    out << ", \"" << kPerfColumns[k] << "\": " << perf[k];
+            out << "}" << (i + 1 < results.size() ? "," : "") << "\n";
+        }
+        out << "]\n";
+    }
+
+    // An environment past its game's reset logic, so the emulator runs actual gameplay.
+    std::unique_ptr<hcle::environment::HCLEnvironment> loadGame(const std::string &game)
+    {
+        auto env = std::make_unique<hcle::environment::HCLEnvironment>();
+        env->loadROM(game);
+        return env;
+    }
+
+    Result benchCpu(const std::string &game, int frames, bool use_perf)
+    {
+        auto env = loadGame(game);
+        cynes::NES &nes = *env->emu;
+        uint64_t instructions = 0;
+        PerfSection perf(use_perf);
+        perf.start();
+        const auto start = clock_type::now();
+        int k = 0;
+        for (; k < frames && !nes.cpu.is_frozen(); ++k)
+        {
+            // Same loop as NES::step(), counting instructions.
+            while (!nes.ppu.is_frame_ready() && !nes.cpu.is_frozen())
+            {
+                nes.cpu.tick();
+                instructions++;
+            }
+        }
+        Result result{"cpu", game, "interpreter", 1, 1, 0, instructions, secondsSince(start), "instructions/s"};
+        result.perf = perf.stop();
+        result.frames = k;
+        return result;
+    }
+
+    std::vector<Result> benchPpu(const std::string &game, int frames, bool use_perf)
+    {
+        std::vector<Result> results;
+        for (const std::string mode : {"rgb", "grayscale", "index", "render_skip"})
+        {
+            auto env = loadGame(game);
+            if (mode == "grayscale" || mode == "index")
+                env->setOutputMode(mode);
+            env->setRenderSkip(mode == "render_skip");
+            PerfSection perf(use_perf);
+            perf.start();
+            const auto start = clock_type::now();
+            env->emu->step(0, frames);
+            Result result{"ppu", game, mode, 1, 1, 0, static_cast<uint64_t>(frames), secondsSince(start), "frames/s"};
+            result.perf = perf.stop();
+            result.frames = frames;
+            results.push_back(result);
+        }
+        return results;
+    }
+
+    std::vector<Result> benchState(const std::string &game, int iterations, bool use_perf)
+    {
+        auto env = loadGame(game);
+        cynes::NES &nes = *env->emu;
+        std::vector<uint8_t> state(nes.size());
+        nes.save(state.data());
+        PerfSection perf(use_perf);
+
+        perf.start();
+        auto start = clock_type::now();
+        for (int i = 0; i < iterations; ++i)
+            nes.save(state.data());
+        const double save_seconds = secondsSince(start);
+        const hcle::common::PerfCounters::Sample save_perf = perf.stop();
+
+        perf.start();
+        start = clock_type::now();
+        for (int i = 0; i < iterations; ++i)
+            nes.load(state.data());
+        const double load_seconds = secondsSince(start);
+        const hcle::common::PerfCounters::Sample load_perf = perf.stop();
+
+        const std::string bytes = std::to_string(state.size()) + "_bytes";
+        std::vector<Result> results = {
+            {"state", game, "save_" + bytes, 1, 1, 0, static_cast<uint64_t>(iterations), save_seconds, "saves/s"},
+            {"state", game, "load_" + bytes, 1, 1, 0, static_cast<uint64_t>(iterations), load_seconds, "loads/s"}};
+        results[0].perf = save_perf;
+        results[1].perf = load_perf;
+        return results;
+    }
+
+    using EnvFactory = std::function<std::unique_ptr<hcle::environment::PreprocessedEnv>(const std::string &)>;
+
+    Result benchEnv(const std::string &game, int steps, const EnvFactory &make_env, std::mt19937 &rng, bool use_perf)
+    {
+        auto env = make_env(game);
+        std::vector<uint8_t> obs(env->getObservationSize());
+        std::uniform_int_distribution<size_t> action_dist(0, env->getActionSet().size() - 1);
+        env->reset(obs.data());
+
+        PerfSection perf(use_perf);
+        perf.start();
+        const auto start = clock_type::now();
+        for (int i = 0; i < steps; ++i)
+        {
+            env->step(static_cast<uint8_t>(action_dist(rng)), obs.data());
+            if (env->isDone())
+                env->reset(obs.data());
+        }
+        Result result{"env", game, "preprocessed_step", 1, 1, 0, static_cast<uint64_t>(steps), secondsSince(start), "steps/s"};
+        result.perf = perf.stop();
+        result.frames = static_cast<uint64_t>(steps) * env->getFrameSkip();
+        return result;
+    }
+
+    // Preprocessing alone, on two consecutive frames of actual gameplay.
+    Result benchPreprocess(const std::string &game, int iterations, const EnvFactory &make_env, bool use_perf)
+    {
+        auto env = make_env(game);
+        std::vector<uint8_t> obs(env->getObservationSize());
+        env->reset(obs.data());
+        for (int i = 0; i < 60; ++i)
+            env->step(0, obs.data());
+        const size_t frame_size = env->getRawFrameSize();
+        std::vector<uint8_t> frame(env->getFramePointer(), env->getFramePointer() + frame_size);
+        std::vector<uint8_t> prev_frame = frame;
+        if (env->usesMaxpool())
+            prev_frame.assign(env->getPreviousFramePointer(), env->getPreviousFramePointer() + frame_size);
+
+        const std::vector<size_t> shape = env->getObservationShape();
+        const int channels = shape.size() > 3 ? static_cast<int>(shape[3]) : 1;
+        hcle::environment::FramePreprocessor preprocessor(static_cast<int>(shape[1]), static_cast<int>(shape[2]), channels,
+                                                          static_cast<int>(shape[0]), env->usesMaxpool());
+        preprocessor.reset(frame.data(), obs.data());
+
+        PerfSection perf(use_perf);
+        perf.start();
+        const auto start = clock_type::now();
+        for (int i = 0; i < iterations; ++i)
+            preprocessor.step(frame.data(), env->usesMaxpool() ? prev_frame.data() : nullptr, obs.data());
+        Result result{"preprocess", game, env->usesMaxpool() ? "maxpool_resize_stack" : "resize_stack", 1, 1, 0,
+                      static_cast<uint64_t>(iterations), secondsSince(start), "observations/s"};
+        result.perf = perf.stop();
+        return result;
+    }
+
+    Result benchVectorizer(const std::string &game, int num_envs, int num_threads, int think_time, int steps,
+                           const EnvFactory &make_env, std::mt19937 &rng, bool use_perf)
+    {
+        // Counters only follow threads spawned after they open, so respawn the pool workers.
+        PerfSection perf(use_perf);
+        hcle::common::ThreadPool::instance().setNumThreads(num_threads);
+        if (use_perf)
+            hcle::common::ThreadPool::instance().respawnWorkers();
+        int frame_skip = 1;
+        hcle::environment::AsyncVectorizer vectorizer(num_envs, [&](int)
+                                                      {
+                                                          auto env = make_env(game);
+                                                          frame_skip = env->getFrameSkip();
+                                                          return env; });
+        std::uniform_int_distribution<int> action_dist(0, static_cast<int>(vectorizer.getActionSet().size()) - 1);
+        std::vector<uint8_t> actions(num_envs);
+        auto sampleActions = [&]
+        {
+            for (auto &action : actions)
+                action = static_cast<uint8_t>(action_dist(rng));
+            return std::span<const uint8_t>(actions);
+        };
+        auto think = [think_time]
+        {
+            if (think_time > 0)
+                std::this_thread::sleep_for(std::chrono::milliseconds(think_time));
+        };
+
+        // Results are read in place, so no outputs are copied.
+        vectorizer.reset(nullptr, nullptr, nullptr);
+        auto start = clock_type::now();
+        for (int i = 0; i < steps; ++i)
+        {
+            vectorizer.send(sampleActions());
+            vectorizer.recv(nullptr, nullptr, nullptr);
+            think();
+        }
+        const double sync_duration = secondsSince(start);
+
+        // Pipelined: the next batch is emulated while the agent thinks.
+        vectorizer.reset(nullptr, nullptr, nullptr);
+        vectorizer.send(sampleActions());
+        perf.start();
+        start = clock_type::now();
+        for (int i = 0; i < steps; ++i)
+        {
+            think();
+            vectorizer.recv(nullptr, nullptr, nullptr);
+            vectorizer.send(sampleActions());
+        }
+        const double async_duration = secondsSince(start);
+        const hcle::common::PerfCounters::Sample async_perf = perf.stop();
+        vectorizer.recv(nullptr, nullptr, nullptr);
+
+        Result result{"vec", game, "async", num_envs, num_threads, think_time,
+                      static_cast<uint64_t>(steps) * num_envs, async_duration, "steps/s"};
+        result.sync_duration = sync_duration;
+        result.async_duration = async_duration;
+        result.perf = async_perf;
+        result.frames = static_cast<uint64_t>(steps) * num_envs * frame_skip;
+        return result;
+    }
+
+    struct ScalingPoint
+    {
+        Result result;
+        double step_mean_us = 0.0;       // One env step on a worker
+        double queue_wait_p50_us = 0.0;  // Dispatch to a worker starting the step
+        double utilisation = 0.0;        // Share of the busy workers' time spent stepping envs
+        double speedup = 0.0;            // Against the curve's first point
+        double ideal_speedup = 0.0;
+        double efficiency = 0.0;         // speedup / ideal_speedup
+    };
+
+    // 1, 2, 4, ... up to the core count, the core count itself, and twice it (oversubscribed).
+    std::vector<int> scalingThreads(const std::string &list, int num_cores)
+    {
+        if (list != "auto")
+            return splitInts(list);
+        std::vector<int> threads;
+        for (int t = 1; t < num_cores; t *= 2)
+            threads.push_back(t);
+        threads.push_back(num_cores);
+        threads.push_back(2 * num_cores);
+        return threads;
+    }
+
+    ScalingPoint benchScalingPoint(const std::string &game, int num_envs, int num_threads, int steps, int num_cores,
+                                   const EnvFactory &make_env, std::mt19937 &rng, bool use_perf)
+    {
+        PerfSection perf(use_perf);
+        hcle::common::ThreadPool::instance().setNumThreads(num_threads);
+        if (use_perf)
+            hcle::common::ThreadPool::instance().respawnWorkers();
+        int frame_skip = 1;
+        hcle::environment::AsyncVectorizer vectorizer(num_envs, [&](int)
+                                                      {
+                                                          auto env = make_env(game);
+                                                          frame_skip = env->getFrameSkip();
+                                                          return env; });
+        std::uniform_int_distribution<int> action_dist(0, static_cast<int>(vectorizer.getActionSet().size()) - 1);
+        std::vector<uint8_t> actions(num_envs);
+        // Synchronous steps: with no think time there is nothing for a pipelined batch to overlap.
+        auto step = [&]
+        {
+            for (auto &action : actions)
+                action = static_cast<uint8_t>(action_dist(rng));
+            vectorizer.send(actions);
+            vectorizer.recv(nullptr, nullptr, nullptr);
+        };
+
+        vectorizer.reset(nullptr, nullptr, nullptr);
+        for (int i = 0; i < std::max(1, steps / 10); ++i)
+            step();
+        vectorizer.resetLatencies();
+
+        perf.start();
+        const auto start = clock_type::now();
+        for (int i = 0; i < steps; ++i)
+            step();
+        const double seconds = secondsSince(start);
+
+        ScalingPoint point;
+        point.result = {"scaling", game, num_threads > num_cores ? "oversubscribed" : "sync", num_envs, num_threads, 0,
+                        static_cast<uint64_t>(steps) * num_envs, seconds, "steps/s"};
+        point.result.perf = perf.stop();
+        point.result.frames = static_cast<uint64_t>(steps) * num_envs * frame_skip;
+
+        const hcle::common::LatencyHistogram &step_latency = vectorizer.getStepLatency();
+        point.step_mean_us = step_latency.getMean() / 1e3;
+        point.queue_wait_p50_us = vectorizer.getQueueWaitLatency().getPercentile(50.0) / 1e3;
+        point.utilisation = step_latency.getCount() * step_latency.getMean() / 1e9 / (seconds * std::min(num_threads, num_envs));
+        return point;
+    }
+
+    struct ScalingCurve
+    {
+        int num_envs = 0;
+        std::vector<ScalingPoint> points; // By thread count
+        int knee = -1;                    // Index of the last point before efficiency drops, -1 if none drops
+        std::string cause = "none";
+    };
+
+    // Fills in speedup and efficiency against ideal linear scaling and locates the knee.
+    void analyseScaling(ScalingCurve &curve, int num_cores, double knee_efficiency)
+    {
+        auto &points = curve.points;
+        std::sort(points.begin(), points.end(), [](const ScalingPoint &a, const ScalingPoint &b)
+                  { return a.result.num_threads < b.result.num_threads; });
+        const ScalingPoint &base = points.front();
+        auto usable = [&](const ScalingPoint &p)
+        { return std::min({p.result.num_threads, curve.num_envs, num_cores}); };
+        for (ScalingPoint &p : points)
+        {
+            p.speedup = base.result.rate() > 0.0 ? p.result.rate() / base.result.rate() : 0.0;
+            p.ideal_speedup = static_cast<double>(usable(p)) / usable(base);
+            p.efficiency = p.speedup / p.ideal_speedup;
+        }
+
+        const auto drop = std::find_if(points.begin() + 1, points.end(), [&](const ScalingPoint &p)
+                                       { return p.efficiency < knee_efficiency; });
+        if (drop == points.end())
+            return;
+        curve.knee = static_cast<int>(drop - points.begin()) - 1;
+        if (drop->result.num_threads > num_cores)
+            curve.cause = "oversubscribed";
+        else if (drop->step_mean_us > 1.25 * base.step_mean_us)
+            curve.cause = "memory_bandwidth";
+        else if (drop->utilisation < 0.8 * base.utilisation)
+            curve.cause = "queue_contention";
+        else
+            curve.cause = "unknown";
+    }
+
+    void writeScalingReport(std::ostream &out, const std::string &game, int num_cores, int steps, double knee_efficiency,
+                            const std::vector<ScalingCurve> &curves)
+    {
+        out << "{\"game\": \"" << game << "\", \"hardware_concurrency\": " << num_cores << ", \"steps\": " << steps
+            << ", \"knee_efficiency\": " << knee_efficiency << ", \"curves\": [\n";
+        for (size_t c = 0; c < curves.size(); ++c)
+        {
+            const ScalingCurve &curve = curves[c];
+            const auto peak = std::max_element(curve.points.begin(), curve.points.end(),
+                                               [](const ScalingPoint &a, const ScalingPoint &b)
+                                               { return a.result.rate() < b.result.rate(); });
+            out << "  {\"num_envs\": " << curve.num_envs << ", \"knee_threads\": ";
+            if (curve.knee >= 0)
+                out << curve.points[curve.knee].result.num_threads;
+            else
+                out << "null";
+            out << ", \"knee_cause\": \"" << curve.cause << "\", \"peak_threads\": " << peak->result.num_threads
+                << ", \"peak_rate\": " << peak->result.rate() << ", \"points\": [\n";
+            for (size_t i = 0; i < curve.points.size(); ++i)
+            {
+                const ScalingPoint &p = curve.points[i];
+                out << "    {\"num_threads\": " << p.result.num_threads << ", \"rate\": " << p.result.rate()
+                    << ", \"speedup\": " << p.speedup << ", \"ideal_speedup\": " << p.ideal_speedup
+                    << ", \"efficiency\": " << p.efficiency << ", \"step_mean_us\": " << p.step_mean_us
+                    << ", \"queue_wait_p50_us\": " << p.queue_wait_p50_us << ", \"utilisation\": " << p.utilisation
+                    << ", \"oversubscribed\": " << (p.result.num_threads > num_cores ? "true" : "false");
+                const std::vector<double> perf = perfColumns(p.result);
+                for (size_t k = 0; k < perf.size(); ++k)
+                    if (perf[k] >= 0.0)
+                        out << ", \"" << kPerfColumns[k] << "\": " << perf[k];
+                out << "}" << (i + 1 < curve.points.size() ? "," : "") << "\n";
+            }
+            out << "  ]}" << (c + 1 < curves.size() ? "," : "") << "\n";
+        }
+        out << "]}\n";
+    }
+}
+
+int main(int argc, char **argv)
+{
+    std::map<std::string, std::string> options = kDefaults;
+    for (int i = 1; i < argc; i += 2)
+    {
+        const std::string key = argv[i];
+        if (key.rfind("--", 0) != 0 || i + 1 >= argc || !options.count(key.substr(2)))
+        {
+            printUsage(argv[0]);
+            return 2;
+        }
+        options[key.substr(2)] = argv[i + 1];
+    }
+
+    try
+    {
+        using namespace hcle;
+        auto opt = [&](const char *key)
+        { return std::stoi(options.at(key)); };
+
+        std::vector<std::string> games;
+        if (options.at("games") == "all")
+        {
+            for (const auto &[name, logic] : game_logic_map)
+                games.push_back(name);
+        }
+        else
+        {
+            games = splitList(options.at("games"));
+        }
+        const std::string format = options.at("format");
+        if (format != "csv" && format != "json")
+            throw std::invalid_argument("Unknown format '" + format + "'.");
+
+        EnvFactory make_env = [&](const std::string &game)
+        {
+            return std::make_unique<environment::PreprocessedEnv>("", game, opt("obs-height"), opt("obs-width"),
+                                                                  opt("frame-skip"), opt("maxpool") != 0,
+                                                                  opt("grayscale") != 0, opt("stack"));
+        };
+        std::mt19937 rng(opt("seed"));
+        const bool use_perf = opt("perf") != 0;
+
+        std::vector<Result> results;
+        for (const std::string &scenario : splitList(options.at("scenarios")))
+        {
+            std::cerr << "hcle_bench: running " << scenario << "\n";
+            if (scenario == "cpu")
+            {
+                for (const std::string &game : games)
+                    results.push_back(benchCpu(game, opt("frames"), use_perf));
+            }
+            else if (scenario == "ppu")
+            {
+                for (const std::string &game : games)
+                    for (Result &result : benchPpu(game, opt("frames"), use_perf))
+                        results.push_back(result);
+            }
+            else if (scenario == "state")
+            {
+                for (const std::string &game : games)
+                    for (Result &result : benchState(game, opt("state-iterations"), use_perf))
+                        results.push_back(result);
+            }
+            else if (scenario == "env")
+            {
+                for (const std::string &game : games)
+                    results.push_back(benchEnv(game, opt("steps"), make_env, rng, use_perf));
+            }
+            else if (scenario == "preprocess")
+            {
+                for (const std::string &game : games)
+                    results.push_back(benchPreprocess(game, opt("preprocess-iterations"), make_env, use_perf));
+            }
+            else if (scenario == "vec")
+            {
+                for (int num_threads : splitInts(options.at("vec-threads")))
+                    for (int num_envs : splitInts(options.at("vec-envs")))
+                        for (int think_time : splitInts(options.at("think-time")))
+                            results.push_back(benchVectorizer(options.at("vec-game"), num_envs, num_threads, think_time,
+                                                              opt("vec-steps"), make_env, rng, use_perf));
+            }
+            else if (scenario == "scaling")
+            {
+                const int num_cores = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+                const double knee_efficiency = std::stod(options.at("scaling-knee"));
+                std::vector<ScalingCurve> curves;
+                for (int num_envs : splitInts(options.at("scaling-envs")))
+                {
+                    ScalingCurve &curve = curves.emplace_back();
+                    curve.num_envs = num_envs;
+                    for (int num_threads : scalingThreads(options.at("scaling-threads"), num_cores))
+                        curve.points.push_back(benchScalingPoint(options.at("vec-game"), num_envs, num_threads,
+                                                                 opt("vec-steps"), num_cores, make_env, rng, use_perf));
+                    analyseScaling(curve, num_cores, knee_efficiency);
+                    for (const ScalingPoint &point : curve.points)
+                        results.push_back(point.result);
+                    std::cerr << "hcle_bench: " << num_envs << " envs: ";
+                    if (curve.knee < 0)
+                        std::cerr << "no knee up to " << curve.points.back().result.num_threads << " threads\n";
+                    else
+                        std::cerr << "knee at " << curve.points[curve.knee].result.num_threads << " threads ("
+                                  << curve.cause << ")\n";
+                }
+
+                std::ofstream report(options.at("scaling-report"));
+                report << std::setprecision(6);
+                writeScalingReport(report, options.at("vec-game"), num_cores, opt("vec-steps"), knee_efficiency, curves);
+                if (!report)
+                    throw std::runtime_error("Cannot write " + options.at("scaling-report") + ".");
+            }
+            else
+            {
+                throw std::invalid_argument("Unknown scenario '" + scenario + "'.");
+            }
+        }
+
+        std::ofstream file;
+        if (options.at("output") != "-")
+        {
+            file.open(options.at("output"));
+            if (!file)
+                throw std::runtime_error("Cannot open " + options.at("output") + ".");
+        }
+        std::ostream &out = file.is_open() ? file : std::cout;
+        out << std::setprecision(6);
+        if (format == "csv")
+            writeCsv(out, results);
+        else
+            writeJson(out, results);
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "hcle_bench: " << e.what() << "\n";
+        return 1;
+    }
+    return 0;
+}
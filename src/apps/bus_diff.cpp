@@ -0,0 +1,221 @@
+// src/apps/bus_diff.cpp
+// Aligns two binary CPU bus traces (see hcle/common/bus_trace.hpp) and reports the first
+// access where they differ, with the accesses leading up to it, e.g.
+//   hcle_bus_diff --left reference.bin --right fast_path.bin --context 16
+// Traces need a build with HCLE_ENABLE_BUS_TRACE; hcle_golden --trace-dir writes a pair for
+// every exact configuration that fails.
+//
+// --align cycle pairs the accesses on the same emulator cycle, which works for runs that
+// count cycles from the same power-on. --align content looks for the offset, up to --window
+// accesses, at which the first --match accesses agree, for traces started at different
+// points. auto uses cycles when the two traces overlap in time and content otherwise.
+// Exits with 0 if the aligned traces agree, 1 if they differ.
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "hcle/common/bus_trace.hpp"
+
+namespace
+{
+    using hcle::common::BusAccess;
+    using hcle::common::BusTraceEntry;
+
+    const std::map<std::string, std::string> kDefaults = {
+        {"left", ""},
+        {"right", ""},
+        {"align", "auto"},
+        {"context", "8"},
+        {"window", "100000"},
+        {"match", "32"},
+    };
+
+    void printUsage(const char *program)
+    {
+        std::cerr << "Usage: " << program << " --left a.bin --right b.bin [--option value]...\nOptions (defaults):\n";
+        for (const auto &[key, value] : kDefaults)
+            std::cerr << "  --" << key << " " << value << "\n";
+        std::cerr << "--align is auto, cycle or content.\n";
+    }
+
+    const char *accessName(BusAccess access)
+    {
+        switch (access)
+        {
+        case BusAccess::FETCH:
+            return "fetch";
+        case BusAccess::READ:
+            return "read";
+        case BusAccess::WRITE:
+            return "write";
+        default:
+            return "dummy";
+        }
+    }
+
+    // Every field but the cycle, which differs between runs that started apart.
+    bool sameAccess(const BusTraceEntry &a, const BusTraceEntry &b)
+    {
+        return a.pc == b.pc && a.opcode == b.opcode && a.access == b.access && a.address == b.address &&
+               a.value == b.value && a.ppu_x == b.ppu_x && a.ppu_y == b.ppu_y;
+    }
+
+    std::string differingFields(const BusTraceEntry &a, const BusTraceEntry &b)
+    {
+        std::string fields;
+        auto add = [&](bool differs, const char *name)
+        {
+            if (differs)
+                fields += fields.empty() ? name : std::string(", ") + name;
+        };
+        add(a.pc != b.pc, "pc");
+        add(a.opcode != b.opcode, "opcode");
+        add(a.access != b.access, "access");
+        add(a.address != b.address, "address");
+        add(a.value != b.value, "value");
+        add(a.ppu_x != b.ppu_x || a.ppu_y != b.ppu_y, "ppu position");
+        return fields;
+    }
+
+    void printEntry(const char *prefix, const BusTraceEntry &e)
+    {
+        std::printf("%s %12llu  pc=%04x op=%02x  %-5s %04x = %02x  ppu %3d,%3d\n", prefix,
+                    static_cast<unsigned long long>(e.cycle), e.pc, e.opcode, accessName(e.access), e.address, e.value,
+                    static_cast<int16_t>(e.ppu_x), static_cast<int16_t>(e.ppu_y));
+    }
+
+    struct Alignment
+    {
+        size_t left = 0;
+        size_t right = 0;
+        bool found = false;
+    };
+
+    Alignment alignByCycle(const std::vector<BusTraceEntry> &left, const std::vector<BusTraceEntry> &right)
+    {
+        const uint64_t cycle = std::max(left.front().cycle, right.front().cycle);
+        auto find = [cycle](const std::vector<BusTraceEntry> &entries)
+        {
+            return static_cast<size_t>(std::lower_bound(entries.begin(), entries.end(), cycle,
+                                                        [](const BusTraceEntry &e, uint64_t c)
+                                                        { return e.cycle < c; }) -
+                                       entries.begin());
+        };
+        Alignment alignment{find(left), find(right), false};
+        alignment.found = alignment.left < left.size() && alignment.right < right.size() &&
+                          left[alignment.left].cycle == right[alignment.right].cycle;
+        return alignment;
+    }
+
+    // Smallest offset into either trace at which the next match accesses agree.
+    Alignment alignByContent(const std::vector<BusTraceEntry> &left, const std::vector<BusTraceEntry> &right,
+                             size_t window, size_t match)
+    {
+        auto agrees = [&](size_t l, size_t r)
+        {
+            const size_t n = std::min({match, left.size() - l, right.size() - r});
+            for (size_t k = 0; k < n; ++k)
+                if (!sameAccess(left[l + k], right[r + k]))
+                    return false;
+            return n > 0;
+        };
+        for (size_t offset = 0; offset <= window; ++offset)
+        {
+            if (offset < left.size() && agrees(offset, 0))
+                return {offset, 0, true};
+            if (offset < right.size() && agrees(0, offset))
+                return {0, offset, true};
+        }
+        return {};
+    }
+}
+
+int main(int argc, char **argv)
+{
+    std::map<std::string, std::string> options = kDefaults;
+    for (int i = 1; i < argc; i += 2)
+    {
+        const std::string key = argv[i];
+        if (key.rfind("--", 0) != 0 || i + 1 >= argc || !options.count(key.substr(2)))
+        {
+            printUsage(argv[0]);
+            return 2;
+        }
+        options[key.substr(2)] = argv[i + 1];
+    }
+    if (options.at("left").empty() || options.at("right").empty())
+    {
+        printUsage(argv[0]);
+        return 2;
+    }
+
+    try
+    {
+        const std::string align = options.at("align");
+        if (align != "auto" && align != "cycle" && align != "content")
+            throw std::invalid_argument("Unknown alignment '" + align + "'.");
+        const size_t context = std::stoul(options.at("context"));
+        const size_t window = std::stoul(options.at("window"));
+        const size_t match = std::max<size_t>(1, std::stoul(options.at("match")));
+
+        const hcle::common::BusTraceFile left_file = hcle::common::BusTrace::readBinary(options.at("left"));
+        const hcle::common::BusTraceFile right_file = hcle::common::BusTrace::readBinary(options.at("right"));
+        const auto &left = left_file.entries;
+        const auto &right = right_file.entries;
+        std::printf("left:  %zu accesses, cycles %llu-%llu (%llu dropped)\n", left.size(),
+                    left.empty() ? 0ULL : static_cast<unsigned long long>(left.front().cycle),
+                    left.empty() ? 0ULL : static_cast<unsigned long long>(left.back().cycle),
+                    static_cast<unsigned long long>(left_file.num_dropped));
+        std::printf("right: %zu accesses, cycles %llu-%llu (%llu dropped)\n", right.size(),
+                    right.empty() ? 0ULL : static_cast<unsigned long long>(right.front().cycle),
+                    right.empty() ? 0ULL : static_cast<unsigned long long>(right.back().cycle),
+                    static_cast<unsigned long long>(right_file.num_dropped));
+        if (left.empty() || right.empty())
+            throw std::runtime_error("Cannot align an empty trace.");
+
+        Alignment alignment;
+        const bool overlap = left.front().cycle <= right.back().cycle && right.front().cycle <= left.back().cycle;
+        if (align == "cycle" || (align == "auto" && overlap))
+        {
+            alignment = alignByCycle(left, right);
+            if (alignment.found)
+                std::printf("aligned on cycle %llu\n", static_cast<unsigned long long>(left[alignment.left].cycle));
+        }
+        else
+        {
+            alignment = alignByContent(left, right, window, match);
+            if (alignment.found)
+                std::printf("aligned on content at left #%zu, right #%zu\n", alignment.left, alignment.right);
+        }
+        if (!alignment.found)
+            throw std::runtime_error("Could not align the traces; try another --align or a larger --window.");
+
+        const size_t length = std::min(left.size() - alignment.left, right.size() - alignment.right);
+        for (size_t k = 0; k < length; ++k)
+        {
+            const BusTraceEntry &l = left[alignment.left + k];
+            const BusTraceEntry &r = right[alignment.right + k];
+            if (sameAccess(l, r))
+                continue;
+
+            std::printf("first difference after %zu matching accesses (%s):\n", k, differingFields(l, r).c_str());
+            for (size_t c = std::min(k, context); c > 0; --c)
+                printEntry(" ", left[alignment.left + k - c]);
+            printEntry("<", l);
+            printEntry(">", r);
+            return 1;
+        }
+        std::printf("no difference over %zu aligned accesses\n", length);
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "hcle_bus_diff: " << e.what() << "\n";
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,143 @@
+// src/apps/codec_bench.cpp
+// Compression ratio and throughput of each frame codec on real processed frames, e.g.
+//   hcle_codec_bench --games smb1,tetris --steps 2000 --grayscale 1 --color-index-grayscale 1
+#include <chrono>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "hcle/common/frame_codec.hpp"
+#include "hcle/environment/preprocessed_env.hpp"
+#include "hcle/games/roms.hpp"
+
+namespace
+{
+    const std::map<std::string, std::string> kDefaults = {
+        {"games", "all"},
+        {"steps", "1000"},
+        {"obs-height", "84"},
+        {"obs-width", "84"},
+        {"frame-skip", "4"},
+        {"maxpool", "1"},
+        {"grayscale", "1"},
+        {"stack", "1"},
+        {"color-index-grayscale", "0"},
+        {"zlib-level", "1"},
+        {"seed", "0"},
+    };
+
+    void printUsage(const char *program)
+    {
+        std::cerr << "Usage: " << program << " [--option value]...\nOptions (defaults):\n";
+        for (const auto &[key, value] : kDefaults)
+            std::cerr << "  --" << key << " " << value << "\n";
+    }
+
+    using clock_type = std::chrono::steady_clock;
+
+    double secondsSince(clock_type::time_point start)
+    {
+        return std::chrono::duration<double>(clock_type::now() - start).count();
+    }
+}
+
+int main(int argc, char **argv)
+{
+    std::map<std::string, std::string> options = kDefaults;
+    for (int i = 1; i < argc; i += 2)
+    {
+        const std::string key = argv[i];
+        if (key.rfind("--", 0) != 0 || i + 1 >= argc || !options.count(key.substr(2)))
+        {
+            printUsage(argv[0]);
+            return 2;
+        }
+        options[key.substr(2)] = argv[i + 1];
+    }
+
+    try
+    {
+        using namespace hcle;
+        auto opt = [&](const char *key)
+        { return std::stoi(options.at(key)); };
+
+        std::vector<std::string> games;
+        if (options.at("games") == "all")
+        {
+            for (const auto &[name, logic] : game_logic_map)
+                games.push_back(name);
+        }
+        else
+        {
+            std::stringstream list(options.at("games"));
+            for (std::string name; std::getline(list, name, ',');)
+                games.push_back(name);
+        }
+
+        const common::FrameCodec codecs[] = {common::FrameCodec::DeltaRle, common::FrameCodec::DeltaZlib};
+        const char *codec_names[] = {"delta_rle", "delta_zlib"};
+        std::mt19937 rng(opt("seed"));
+
+        std::cout << std::left << std::setw(12) << "game" << std::setw(12) << "codec" << std::right
+                  << std::setw(10) << "ratio" << std::setw(14) << "encode MB/s" << std::setw(14) << "decode MB/s" << "\n";
+        for (const std::string &game : games)
+        {
+            environment::PreprocessedEnv env("", game, opt("obs-height"), opt("obs-width"), opt("frame-skip"), opt("maxpool") != 0,
+                                             opt("grayscale") != 0, opt("stack"), opt("color-index-grayscale") != 0);
+            const size_t frame_size = env.getObservationSize();
+            const size_t stack_size = env.getObservationShape().front();
+            const size_t num_frames = static_cast<size_t>(opt("steps"));
+            std::uniform_int_distribution<size_t> action_dist(0, env.getActionSet().size() - 1);
+
+            std::vector<uint8_t> frames(num_frames * frame_size);
+            env.reset(frames.data());
+            for (size_t i = 1; i < num_frames; ++i)
+            {
+                env.step(static_cast<uint8_t>(action_dist(rng)), frames.data() + i * frame_size);
+                if (env.isDone())
+                    env.reset(frames.data() + i * frame_size);
+            }
+            const double raw_mb = static_cast<double>(frames.size()) / 1e6;
+
+            for (size_t c = 0; c < std::size(codecs); ++c)
+            {
+                common::FrameEncoder encoder(1, frame_size, stack_size, opt("zlib-level"));
+                std::vector<uint8_t> encoded;
+                encoded.reserve(frames.size() + num_frames * common::kFrameRecordHeaderSize);
+                auto start = clock_type::now();
+                for (size_t i = 0; i < num_frames; ++i)
+                    encoder.encode(frames.data() + i * frame_size, codecs[c], encoded);
+                const double encode_seconds = secondsSince(start);
+
+                common::FrameDecoder decoder(1, frame_size, stack_size);
+                std::vector<uint8_t> decoded(frames.size());
+                start = clock_type::now();
+                size_t offset = 0;
+                for (size_t i = 0; i < num_frames; ++i)
+                    offset += decoder.decode(encoded.data() + offset, encoded.size() - offset, decoded.data() + i * frame_size);
+                const double decode_seconds = secondsSince(start);
+                if (offset != encoded.size() || decoded != frames)
+                    throw std::runtime_error(std::string(codec_names[c]) + " round trip failed for " + game + ".");
+
+                std::cout << std::left << std::setw(12) << game << std::setw(12) << codec_names[c] << std::right << std::fixed
+                          << std::setprecision(1) << std::setw(10) << static_cast<double>(frames.size()) / encoded.size()
+                          << std::setprecision(0) << std::setw(14) << raw_mb / encode_seconds
+                          << std::setw(14) << raw_mb / decode_seconds << "\n";
+            }
+        }
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "hcle_codec_bench: " << e.what() << "\n";
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,479 @@
+// src/apps/golden.cpp
+// Golden hash regression suite guarding the emulator's accelerated and alternative paths, e.g.
+//   hcle_golden                        check every game against the golden file
+//   hcle_golden --games smb1,tetris --verbose 1
+//   hcle_golden --update 1             re-record the golden file from the reference path
+//
+// Every game runs a fixed, seeded action script from power-on: a random action from the
+// game's action set, held for 1-8 frames. Game logic is not involved, so games whose reset
+// logic is randomised still run deterministically. The reference path steps one frame
+// at a time with RGB output and full rendering, and hashes the frame buffer and
+// NES::hash_state() (RAM, OAM, palette, PPU state) after every frame. Then
+//  - a running digest of the reference hashes is checked against the golden file every
+//    --checkpoint frames, which catches changes to the reference path itself;
+//  - every exact configuration must reproduce the reference hashes on every frame it can
+//    observe, and fails at the first frame that differs;
+//  - approximate configurations (render_skip) only report where they first diverge.
+// A new accelerated mode belongs in kConfigs, as exact unless it is approximate by design.
+// Exits with 1 on any golden or exact mismatch, or if a game's ROM can't be found.
+//
+// In a build with HCLE_ENABLE_BUS_TRACE, --trace-dir DIR reruns every failing exact
+// configuration and the reference with the CPU bus traced over the frame before the
+// divergence and the diverging frame, and writes the pair as DIR/<game>_<config>.bin and
+// DIR/<game>_<config>_reference.bin for hcle_bus_diff.
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "hcle/emucore/nes.hpp"
+#include "hcle/emucore/utils.hpp"
+#include "hcle/games/roms.hpp"
+
+#ifndef HCLE_GOLDEN_FILE
+#define HCLE_GOLDEN_FILE "golden_hashes.txt"
+#endif
+
+namespace
+{
+    const std::map<std::string, std::string> kDefaults = {
+        {"games", "all"},
+        {"frames", "1200"},
+        {"checkpoint", "30"},
+        {"seed", "1"},
+        {"golden", HCLE_GOLDEN_FILE},
+        {"update", "0"},
+        {"verbose", "0"},
+        {"trace-dir", ""},
+    };
+
+    void printUsage(const char *program)
+    {
+        std::cerr << "Usage: " << program << " [--option value]...\nOptions (defaults):\n";
+        for (const auto &[key, value] : kDefaults)
+            std::cerr << "  --" << key << " " << value << "\n";
+        std::cerr << "--update 1 rewrites the golden file from the reference path instead of checking it.\n";
+    }
+
+    constexpr size_t kRgbFrameSize = 256 * 240 * 3;
+
+    struct Hold
+    {
+        uint8_t input;
+        unsigned int frames;
+    };
+
+    std::vector<Hold> makeScript(const std::string &game, int frames, int seed)
+    {
+        const std::vector<uint8_t> actions = hcle::get_game_logic(game)->getActionSet();
+        std::seed_seq seq{static_cast<uint32_t>(seed),
+                          static_cast<uint32_t>(cynes::hash_bytes(cynes::HASH_SEED, game.data(), game.size()))};
+        std::mt19937 rng(seq);
+        std::uniform_int_distribution<size_t> pick(0, actions.size() - 1);
+        std::uniform_int_distribution<unsigned int> length(1, 8);
+
+        std::vector<Hold> script;
+        for (int total = 0; total < frames;)
+        {
+            Hold hold{actions[pick(rng)], length(rng)};
+            hold.frames = std::min<unsigned int>(hold.frames, frames - total);
+            total += hold.frames;
+            script.push_back(hold);
+        }
+        return script;
+    }
+
+    struct RunOptions
+    {
+        std::string output_mode = "rgb"; // rgb, grayscale or index
+        bool render_skip = false;
+        bool batched = false;        // One NES::step() call per hold, observed at its end
+        int reload_interval = 0;     // Save, rebuild the NES and load every N frames
+        bool compare_frames = true;  // Frame buffers are comparable to the reference (RGB)
+        bool exact = true;
+        int trace_from = -1;         // Trace the bus from this frame through trace_until,
+        int trace_until = -1;        // write it to trace_path and stop there
+        std::string trace_path;
+    };
+
+    struct FrameHash
+    {
+        uint64_t state = 0;
+        uint64_t frame = 0;
+        bool observed = false;
+    };
+
+    std::unique_ptr<cynes::NES> makeNes(const std::string &rom_path, const RunOptions &options)
+    {
+        auto nes = std::make_unique<cynes::NES>(rom_path.c_str());
+        if (options.output_mode == "grayscale")
+            nes->setOutputModeGrayscale();
+        else if (options.output_mode == "index")
+            nes->setOutputModeColorIndex();
+        nes->ppu.set_render_skip(options.render_skip);
+        return nes;
+    }
+
+    // Per-frame hashes of one run; frames the configuration can't observe stay unobserved.
+    // Stops early if the CPU jams, or once the traced frames are written.
+    std::vector<FrameHash> run(const std::string &rom_path, const std::vector<Hold> &script, int frames,
+                               const RunOptions &options)
+    {
+        auto nes = makeNes(rom_path, options);
+        std::vector<FrameHash> hashes(frames);
+        auto observe = [&](int frame)
+        {
+            hashes[frame] = {nes->hash_state(),
+                             options.compare_frames ? cynes::hash_bytes(cynes::HASH_SEED, nes->get_frame_buffer(), kRgbFrameSize) : 0,
+                             true};
+        };
+        // Called before emulating frames [first, first + count); true once tracing is done.
+        auto trace = [&](int first, int count)
+        {
+            if (options.trace_path.empty())
+                return false;
+            if (first > options.trace_until)
+            {
+                nes->bus_trace.writeBinary(options.trace_path);
+                return true;
+            }
+            if (!nes->bus_trace.isEnabled() && first + count > options.trace_from)
+                nes->bus_trace.start();
+            return false;
+        };
+
+        int frame = 0;
+        for (const Hold &hold : script)
+        {
+            if (options.batched)
+            {
+                if (trace(frame, hold.frames))
+                    return hashes;
+                const bool frozen = nes->step(hold.input, hold.frames);
+                frame += hold.frames;
+                observe(frame - 1);
+                if (frozen)
+                    break;
+                continue;
+            }
+            for (unsigned int k = 0; k < hold.frames; ++k)
+            {
+                if (trace(frame, 1) || nes->step(hold.input, 1))
+                    return hashes;
+                observe(frame++);
+                if (options.reload_interval && frame % options.reload_interval == 0)
+                {
+                    std::vector<uint8_t> state(nes->size());
+                    nes->save(state.data());
+                    // The trace, cycle count included, continues across the reload.
+                    hcle::common::BusTrace bus_trace = std::move(nes->bus_trace);
+                    nes = makeNes(rom_path, options);
+                    nes->load(state.data());
+                    nes->bus_trace = std::move(bus_trace);
+                }
+            }
+        }
+        trace(frames, 0);
+        return hashes;
+    }
+
+    struct Config
+    {
+        const char *name;
+        RunOptions options;
+    };
+
+    std::vector<Config> makeConfigs()
+    {
+        std::vector<Config> configs(5);
+        configs[0].name = "batched_step";
+        configs[0].options.batched = true;
+        configs[1].name = "save_load";
+        configs[1].options.reload_interval = 97; // Lands mid-hold
+        configs[2].name = "grayscale";
+        configs[2].options.output_mode = "grayscale";
+        configs[2].options.compare_frames = false;
+        configs[3].name = "index";
+        configs[3].options.output_mode = "index";
+        configs[3].options.compare_frames = false;
+        configs[4].name = "render_skip";
+        configs[4].options.render_skip = true;
+        configs[4].options.compare_frames = false;
+        configs[4].options.exact = false;
+        return configs;
+    }
+    const std::vector<Config> kConfigs = makeConfigs();
+
+    // Running digest of the reference hashes, sampled every checkpoint frames and at the end.
+    std::vector<std::pair<int, uint64_t>> digests(const std::vector<FrameHash> &hashes, int checkpoint)
+    {
+        std::vector<std::pair<int, uint64_t>> result;
+        uint64_t digest = cynes::HASH_SEED;
+        for (size_t i = 0; i < hashes.size() && hashes[i].observed; ++i)
+        {
+            const uint64_t pair[2] = {hashes[i].state, hashes[i].frame};
+            digest = cynes::hash_bytes(digest, pair, sizeof(pair));
+            const int frame = static_cast<int>(i) + 1;
+            if (frame % checkpoint == 0 || i + 1 == hashes.size() || !hashes[i + 1].observed)
+                result.push_back({frame, digest});
+        }
+        return result;
+    }
+
+    // Frame index of the first mismatch against the reference, or -1.
+    int firstDivergence(const std::vector<FrameHash> &reference, const std::vector<FrameHash> &hashes, bool compare_frames)
+    {
+        for (size_t i = 0; i < reference.size(); ++i)
+        {
+            if (reference[i].observed != hashes[i].observed && hashes[i].observed)
+                return static_cast<int>(i);
+            if (!hashes[i].observed)
+                continue;
+            if (hashes[i].state != reference[i].state || (compare_frames && hashes[i].frame != reference[i].frame))
+                return static_cast<int>(i);
+        }
+        return -1;
+    }
+
+    std::string paramsLine(int frames, int checkpoint, int seed)
+    {
+        return "params frames=" + std::to_string(frames) + " checkpoint=" + std::to_string(checkpoint) +
+               " seed=" + std::to_string(seed);
+    }
+
+    // game -> [(frame, digest)]
+    using GoldenTable = std::map<std::string, std::vector<std::pair<int, uint64_t>>>;
+
+    GoldenTable readGolden(const std::string &path, const std::string &params)
+    {
+        std::ifstream file(path);
+        if (!file)
+            throw std::runtime_error("Cannot open golden file " + path + "; record it with --update 1.");
+        GoldenTable table;
+        bool params_match = false;
+        for (std::string line; std::getline(file, line);)
+        {
+            if (line.empty() || line[0] == '#')
+                continue;
+            if (line.rfind("params ", 0) == 0)
+            {
+                params_match = line == params;
+                continue;
+            }
+            std::istringstream fields(line);
+            std::string game, digest;
+            int frame;
+            if (!(fields >> game >> frame >> digest))
+                throw std::runtime_error("Malformed line in " + path + ": " + line);
+            table[game].push_back({frame, std::stoull(digest, nullptr, 16)});
+        }
+        if (!params_match)
+            throw std::runtime_error(path + " was recorded with different options than '" + params +
+                                     "'; use matching options or --update 1.");
+        return table;
+    }
+
+    std::vector<std::string> splitList(const std::string &list)
+    {
+        std::vector<std::string> items;
+        std::stringstream stream(list);
+        for (std::string item; std::getline(stream, item, ',');)
+            if (!item.empty())
+                items.push_back(item);
+        return items;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    std::map<std::string, std::string> options = kDefaults;
+    for (int i = 1; i < argc; i += 2)
+    {
+        const std::string key = argv[i];
+        if (key.rfind("--", 0) != 0 || i + 1 >= argc || !options.count(key.substr(2)))
+        {
+            printUsage(argv[0]);
+            return 2;
+        }
+        options[key.substr(2)] = argv[i + 1];
+    }
+
+    try
+    {
+        auto opt = [&](const char *key)
+        { return std::stoi(options.at(key)); };
+        const int frames = opt("frames");
+        const int checkpoint = opt("checkpoint");
+        const int seed = opt("seed");
+        const bool update = opt("update") != 0;
+        const bool verbose = opt("verbose") != 0;
+        const std::string trace_dir = options.at("trace-dir");
+        if (frames <= 0 || checkpoint <= 0)
+            throw std::invalid_argument("--frames and --checkpoint must be positive.");
+        if (!trace_dir.empty())
+        {
+            if (!hcle::common::kBusTraceEnabled)
+                throw std::invalid_argument("--trace-dir needs a build with HCLE_ENABLE_BUS_TRACE.");
+            std::filesystem::create_directories(trace_dir);
+        }
+
+        std::vector<std::string> games;
+        if (options.at("games") == "all")
+        {
+            for (const auto &[name, logic] : hcle::game_logic_map)
+                games.push_back(name);
+        }
+        else
+        {
+            games = splitList(options.at("games"));
+        }
+
+        const std::string params = paramsLine(frames, checkpoint, seed);
+        const std::string golden_path = options.at("golden");
+        GoldenTable golden;
+        if (!update)
+            golden = readGolden(golden_path, params);
+
+        // Updating a subset of games keeps the other games' digests.
+        GoldenTable recorded;
+        if (update && std::ifstream(golden_path))
+        {
+            try
+            {
+                recorded = readGolden(golden_path, params);
+            }
+            catch (const std::runtime_error &)
+            {
+            }
+        }
+        int failures = 0;
+        for (const std::string &game : games)
+        {
+            if (!hcle::get_game_logic(game))
+                throw std::invalid_argument("Unknown game '" + game + "'.");
+            std::string rom_path;
+            try
+            {
+                rom_path = hcle::get_rom_path(game);
+            }
+            catch (const std::runtime_error &)
+            {
+            }
+            if (rom_path.empty())
+            {
+                // An unchecked game must not pass, e.g. when HCLE_ROMS_DIR is unset.
+                std::cout << game << ": FAIL (ROM unavailable)\n";
+                failures++;
+                continue;
+            }
+            const std::vector<Hold> script = makeScript(game, frames, seed);
+            const std::vector<FrameHash> reference = run(rom_path, script, frames, RunOptions{});
+            recorded[game] = digests(reference, checkpoint);
+
+            std::cout << game << ":";
+            if (update)
+                std::cout << " recorded";
+            else
+            {
+                const auto it = golden.find(game);
+                if (it == golden.end())
+                {
+                    std::cout << " golden MISSING";
+                    failures++;
+                }
+                else
+                {
+                    int mismatch = -1;
+                    const auto &expected = it->second;
+                    const auto &actual = recorded[game];
+                    for (size_t k = 0; k < std::max(expected.size(), actual.size()) && mismatch < 0; ++k)
+                        if (k >= expected.size() || k >= actual.size() || expected[k] != actual[k])
+                            mismatch = k < expected.size() ? expected[k].first : actual[k].first;
+                    if (mismatch >= 0)
+                    {
+                        std::cout << " golden FAIL (by frame " << mismatch << ")";
+                        failures++;
+                    }
+                    else
+                    {
+                        std::cout << " golden ok";
+                    }
+                }
+            }
+
+            for (const Config &config : kConfigs)
+            {
+                const int divergence = firstDivergence(reference, run(rom_path, script, frames, config.options),
+                                                       config.options.compare_frames);
+                std::cout << " | " << config.name;
+                if (divergence < 0)
+                    std::cout << " ok";
+                else if (config.options.exact)
+                    std::cout << " FAIL (frame " << divergence << ")";
+                else
+                    std::cout << " diverges at frame " << divergence << " (approximate)";
+                failures += config.options.exact && divergence >= 0;
+
+                if (config.options.exact && divergence >= 0 && !trace_dir.empty())
+                {
+                    const std::string stem = (std::filesystem::path(trace_dir) / (game + "_" + config.name)).string();
+                    auto traceRun = [&](RunOptions run_options, const std::string &path)
+                    {
+                        run_options.trace_from = std::max(0, divergence - 1);
+                        run_options.trace_until = divergence;
+                        run_options.trace_path = path;
+                        run(rom_path, script, frames, run_options);
+                    };
+                    traceRun(RunOptions{}, stem + "_reference.bin");
+                    traceRun(config.options, stem + ".bin");
+                    std::cout << " [bus traces: " << stem << "_reference.bin " << stem << ".bin]";
+                }
+            }
+            std::cout << "\n";
+
+            if (verbose)
+                for (const auto &[frame, digest] : recorded[game])
+                    std::printf("  %6d %016llx\n", frame, static_cast<unsigned long long>(digest));
+        }
+
+        if (update)
+        {
+            std::ofstream file(golden_path);
+            file << "# hcle_golden reference digests: <game> <frame> <running digest of per-frame state and frame hashes>\n"
+                 << params << "\n";
+            for (const auto &[game, entries] : recorded)
+                for (const auto &[frame, digest] : entries)
+                {
+                    char line[64];
+                    std::snprintf(line, sizeof(line), "%s %d %016llx\n", game.c_str(), frame,
+                                  static_cast<unsigned long long>(digest));
+                    file << line;
+                }
+            if (!file)
+                throw std::runtime_error("Failed to write " + golden_path + ".");
+            std::cout << "Recorded " << golden_path << "\n";
+        }
+
+        if (failures)
+        {
+            std::cout << failures << " check(s) failed.\n";
+            return 1;
+        }
+        std::cout << "All checks passed.\n";
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "hcle_golden: " << e.what() << "\n";
+        return 1;
+    }
+    return 0;
+}
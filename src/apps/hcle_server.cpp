@@ -0,0 +1,87 @@
+// src/apps/hcle_server.cpp
+// Serves a vector of environments over a Unix or TCP socket, e.g.
+//   hcle_server --address tcp:0.0.0.0:5555 --game smb1 --num-envs 64
+//   hcle_server --address unix:/tmp/hcle.sock --game tetris --num-envs 8 --grayscale 0
+#include <csignal>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <string>
+
+#include "hcle/environment/env_server.hpp"
+
+namespace
+{
+    const std::map<std::string, std::string> kDefaults = {
+        {"address", "tcp:127.0.0.1:5555"},
+        {"game", "smb1"},
+        {"num-envs", "8"},
+        {"obs-height", "84"},
+        {"obs-width", "84"},
+        {"frame-skip", "4"},
+        {"maxpool", "1"},
+        {"grayscale", "1"},
+        {"stack", "4"},
+        {"color-index-grayscale", "0"},
+        {"max-episode-steps", "0"},
+        {"autoreset", "next_step"},
+        {"threads", "0"},
+        {"max-connections", "0"},
+    };
+
+    void printUsage(const char *program)
+    {
+        std::cerr << "Usage: " << program << " [--option value]...\nOptions (defaults):\n";
+        for (const auto &[key, value] : kDefaults)
+            std::cerr << "  --" << key << " " << value << "\n";
+    }
+}
+
+int main(int argc, char **argv)
+{
+    std::map<std::string, std::string> options = kDefaults;
+    for (int i = 1; i < argc; i += 2)
+    {
+        const std::string key = argv[i];
+        if (key.rfind("--", 0) != 0 || i + 1 >= argc || !options.count(key.substr(2)))
+        {
+            printUsage(argv[0]);
+            return 2;
+        }
+        options[key.substr(2)] = argv[i + 1];
+    }
+
+    // A client vanishing mid-send must not take the server down.
+    std::signal(SIGPIPE, SIG_IGN);
+
+    try
+    {
+        using namespace hcle::environment;
+        auto opt = [&](const char *key)
+        { return std::stoi(options.at(key)); };
+
+        if (opt("threads") > 0)
+            hcle::common::ThreadPool::instance().setNumThreads(opt("threads"));
+
+        const std::string game = options.at("game");
+        auto env_factory = [&]([[maybe_unused]] int env_id)
+        {
+            return std::make_unique<PreprocessedEnv>(
+                "", game, opt("obs-height"), opt("obs-width"), opt("frame-skip"), opt("maxpool") != 0,
+                opt("grayscale") != 0, opt("stack"), opt("color-index-grayscale") != 0);
+        };
+        auto vectorizer = std::make_unique<AsyncVectorizer>(
+            opt("num-envs"), env_factory, opt("max-episode-steps"), parseAutoResetMode(options.at("autoreset")), 2);
+
+        EnvServer server(std::move(vectorizer));
+        std::cout << "hcle_server: serving " << opt("num-envs") << " x " << game << " on " << options.at("address") << std::endl;
+        server.serve(options.at("address"), opt("max-connections"));
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "hcle_server: " << e.what() << "\n";
+        return 1;
+    }
+    return 0;
+}
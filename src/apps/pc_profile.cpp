@@ -0,0 +1,222 @@
+// src/apps/pc_profile.cpp
+// Plays each game with random actions and reports where its 6502 code spends its
+// instructions: the hottest program counter ranges (with the mapper page they run from)
+// and the most executed opcodes, e.g.
+//   hcle_pc_profile --games smb1,tetris --steps 5000 --top 20
+// Requires a build with HCLE_ENABLE_PC_PROFILING. PC samples are merged into one range
+// while they are on the same page and at most --gap bytes apart, so a tight loop such as
+// a wait-for-NMI spin shows up as a single hot range.
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "hcle/common/profiling.hpp"
+#include "hcle/environment/hcle_environment.hpp"
+#include "hcle/games/roms.hpp"
+
+namespace
+{
+    const std::map<std::string, std::string> kDefaults = {
+        {"games", "smb1"},
+        {"steps", "3000"},
+        {"frame-skip", "4"},
+        {"top", "20"},
+        {"gap", "16"},
+        {"opcodes", "16"},
+        {"seed", "0"},
+    };
+
+    void printUsage(const char *program)
+    {
+        std::cerr << "Usage: " << program << " [--option value]...\nOptions (defaults):\n";
+        for (const auto &[key, value] : kDefaults)
+            std::cerr << "  --" << key << " " << value << "\n";
+        std::cerr << "--games all profiles every supported game.\n";
+    }
+
+    // Standard mnemonics of the opcodes, unofficial ones included.
+    const char *kMnemonics[256] = {
+        "brk", "ora", "jam", "slo", "nop", "ora", "asl", "slo", "php", "ora", "asl", "anc", "nop", "ora", "asl", "slo",
+        "bpl", "ora", "jam", "slo", "nop", "ora", "asl", "slo", "clc", "ora", "nop", "slo", "nop", "ora", "asl", "slo",
+        "jsr", "and", "jam", "rla", "bit", "and", "rol", "rla", "plp", "and", "rol", "anc", "bit", "and", "rol", "rla",
+        "bmi", "and", "jam", "rla", "nop", "and", "rol", "rla", "sec", "and", "nop", "rla", "nop", "and", "rol", "rla",
+        "rti", "eor", "jam", "sre", "nop", "eor", "lsr", "sre", "pha", "eor", "lsr", "alr", "jmp", "eor", "lsr", "sre",
+        "bvc", "eor", "jam", "sre", "nop", "eor", "lsr", "sre", "cli", "eor", "nop", "sre", "nop", "eor", "lsr", "sre",
+        "rts", "adc", "jam", "rra", "nop", "adc", "ror", "rra", "pla", "adc", "ror", "arr", "jmp", "adc", "ror", "rra",
+        "bvs", "adc", "jam", "rra", "nop", "adc", "ror", "rra", "sei", "adc", "nop", "rra", "nop", "adc", "ror", "rra",
+        "nop", "sta", "nop", "sax", "sty", "sta", "stx", "sax", "dey", "nop", "txa", "ane", "sty", "sta", "stx", "sax",
+        "bcc", "sta", "jam", "sha", "sty", "sta", "stx", "sax", "tya", "sta", "txs", "tas", "shy", "sta", "shx", "sha",
+        "ldy", "lda", "ldx", "lax", "ldy", "lda", "ldx", "lax", "tay", "lda", "tax", "lxa", "ldy", "lda", "ldx", "lax",
+        "bcs", "lda", "jam", "lax", "ldy", "lda", "ldx", "lax", "clv", "lda", "tsx", "las", "ldy", "lda", "ldx", "lax",
+        "cpy", "cmp", "nop", "dcp", "cpy", "cmp", "dec", "dcp", "iny", "cmp", "dex", "sbx", "cpy", "cmp", "dec", "dcp",
+        "bne", "cmp", "jam", "dcp", "nop", "cmp", "dec", "dcp", "cld", "cmp", "nop", "dcp", "nop", "cmp", "dec", "dcp",
+        "cpx", "sbc", "nop", "isc", "cpx", "sbc", "inc", "isc", "inx", "sbc", "nop", "usb", "cpx", "sbc", "inc", "isc",
+        "beq", "sbc", "jam", "isc", "nop", "sbc", "inc", "isc", "sed", "sbc", "nop", "isc", "nop", "sbc", "inc", "isc",
+    };
+
+    struct HotRange
+    {
+        uint16_t page;
+        uint16_t first_pc;
+        uint16_t last_pc;
+        uint64_t samples = 0;
+        uint16_t hottest_pc = 0;
+        uint64_t hottest_samples = 0;
+    };
+
+    std::vector<HotRange> mergeRanges(const hcle::common::PcProfile &profile, int gap)
+    {
+        using hcle::common::PcProfile;
+        std::vector<std::pair<uint32_t, uint64_t>> samples(profile.samples.begin(), profile.samples.end());
+        std::sort(samples.begin(), samples.end());
+
+        std::vector<HotRange> ranges;
+        for (const auto &[key, count] : samples)
+        {
+            const uint16_t page = PcProfile::samplePage(key);
+            const uint16_t pc = PcProfile::samplePc(key);
+            if (ranges.empty() || ranges.back().page != page || pc - ranges.back().last_pc > gap)
+                ranges.push_back({page, pc, pc});
+            HotRange &range = ranges.back();
+            range.last_pc = pc;
+            range.samples += count;
+            if (count > range.hottest_samples)
+            {
+                range.hottest_pc = pc;
+                range.hottest_samples = count;
+            }
+        }
+        std::sort(ranges.begin(), ranges.end(), [](const HotRange &a, const HotRange &b)
+                  { return a.samples > b.samples; });
+        return ranges;
+    }
+
+    void report(const std::string &game, const hcle::common::PcProfile &profile, uint16_t prg_pages, int top,
+                int gap, int num_opcodes)
+    {
+        uint64_t instructions = 0;
+        for (uint64_t count : profile.opcodes)
+            instructions += count;
+
+        std::printf("== %s: %llu instructions, %llu PC samples\n", game.c_str(),
+                    static_cast<unsigned long long>(instructions), static_cast<unsigned long long>(profile.num_samples));
+        std::printf("%4s %9s %7s  %-11s %6s  %-15s  %s\n", "rank", "samples", "share", "cpu range", "page",
+                    "prg offset", "hottest pc");
+
+        const std::vector<HotRange> ranges = mergeRanges(profile, gap);
+        const double total = static_cast<double>(std::max<uint64_t>(profile.num_samples, 1));
+        for (size_t i = 0; i < ranges.size() && static_cast<int>(i) < top; ++i)
+        {
+            const HotRange &r = ranges[i];
+            char page[8] = "-";
+            char prg_offset[24] = "-";
+            if (r.page != hcle::common::PcProfile::kNoPage)
+                std::snprintf(page, sizeof(page), "0x%03X", r.page);
+            // PRG ROM pages start the mapper memory; offsets are into the ROM's PRG data.
+            if (r.page < prg_pages)
+                std::snprintf(prg_offset, sizeof(prg_offset), "0x%05X-0x%05X", (r.page << 10) | (r.first_pc & 0x3FF),
+                              (r.page << 10) | (r.last_pc & 0x3FF));
+            std::printf("%4zu %9llu %6.2f%%  $%04X-$%04X %6s  %-15s  $%04X (%.0f%% of range)\n", i + 1,
+                        static_cast<unsigned long long>(r.samples), 100.0 * r.samples / total, r.first_pc, r.last_pc,
+                        page, prg_offset, r.hottest_pc, 100.0 * r.hottest_samples / r.samples);
+        }
+
+        std::vector<int> opcodes(256);
+        for (int i = 0; i < 256; ++i)
+            opcodes[i] = i;
+        std::sort(opcodes.begin(), opcodes.end(), [&](int a, int b)
+                  { return profile.opcodes[a] > profile.opcodes[b]; });
+        std::printf("-- top opcodes\n");
+        for (int i = 0; i < num_opcodes && profile.opcodes[opcodes[i]]; ++i)
+        {
+            const int opcode = opcodes[i];
+            std::printf("  %02X %s %12llu %6.2f%%\n", opcode, kMnemonics[opcode],
+                        static_cast<unsigned long long>(profile.opcodes[opcode]),
+                        100.0 * profile.opcodes[opcode] / std::max<uint64_t>(instructions, 1));
+        }
+        std::printf("\n");
+    }
+
+    std::vector<std::string> splitList(const std::string &list)
+    {
+        std::vector<std::string> items;
+        std::stringstream stream(list);
+        for (std::string item; std::getline(stream, item, ',');)
+            if (!item.empty())
+                items.push_back(item);
+        return items;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    std::map<std::string, std::string> options = kDefaults;
+    for (int i = 1; i < argc; i += 2)
+    {
+        const std::string key = argv[i];
+        if (key.rfind("--", 0) != 0 || i + 1 >= argc || !options.count(key.substr(2)))
+        {
+            printUsage(argv[0]);
+            return 2;
+        }
+        options[key.substr(2)] = argv[i + 1];
+    }
+
+    if (!hcle::common::kPcProfilingEnabled)
+    {
+        std::cerr << "hcle_pc_profile: built without PC profiling; reconfigure with -DHCLE_ENABLE_PC_PROFILING=ON.\n";
+        return 1;
+    }
+
+    try
+    {
+        auto opt = [&](const char *key)
+        { return std::stoi(options.at(key)); };
+
+        std::vector<std::string> games;
+        if (options.at("games") == "all")
+        {
+            for (const auto &[name, logic] : hcle::game_logic_map)
+                games.push_back(name);
+        }
+        else
+        {
+            games = splitList(options.at("games"));
+        }
+
+        std::mt19937 rng(opt("seed"));
+        for (const std::string &game : games)
+        {
+            auto env = std::make_unique<hcle::environment::HCLEnvironment>();
+            env->loadROM(game);
+            const std::vector<uint8_t> actions = env->getActionSet();
+            std::uniform_int_distribution<size_t> pick(0, actions.size() - 1);
+
+            // Profile gameplay only, not the power-on and menu logic run by loadROM().
+            env->emu->pc_profile.clear();
+            for (int step = 0; step < opt("steps"); ++step)
+            {
+                env->act(actions[pick(rng)], opt("frame-skip"));
+                if (env->isDone())
+                    env->reset();
+            }
+            report(game, env->emu->pc_profile, env->emu->get_mapper().get_prg_pages(), opt("top"), opt("gap"),
+                   opt("opcodes"));
+        }
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "hcle_pc_profile: " << e.what() << "\n";
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,116 @@
+// src/apps/replay.cpp
+// Replays the action logs written by AsyncVectorizer::startActionLogs() and reports the
+// first state-hash divergence of each, e.g.
+//   hcle_replay --logs action_logs --verbose 1
+// --render-skip 1 replays in the PPU's render-skip mode to check it against the recording. That
+// mode is approximate: it diverges within a few steps, and games whose logic waits for a screen
+// to change (tetris between rounds) may not get past it.
+// Exits with 1 if any log diverged.
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "hcle/environment/action_log.hpp"
+
+namespace
+{
+    const std::map<std::string, std::string> kDefaults = {
+        {"logs", "action_logs"},
+        {"render-skip", "0"},
+        {"verbose", "0"},
+    };
+
+    void printUsage(const char *program)
+    {
+        std::cerr << "Usage: " << program << " [--option value]...\nOptions (defaults):\n";
+        for (const auto &[key, value] : kDefaults)
+            std::cerr << "  --" << key << " " << value << "\n";
+        std::cerr << "--logs takes a .hcla file or a directory of them.\n";
+    }
+
+    using clock_type = std::chrono::steady_clock;
+
+    double secondsSince(clock_type::time_point start)
+    {
+        return std::chrono::duration<double>(clock_type::now() - start).count();
+    }
+}
+
+int main(int argc, char **argv)
+{
+    std::map<std::string, std::string> options = kDefaults;
+    for (int i = 1; i < argc; i += 2)
+    {
+        const std::string key = argv[i];
+        if (key.rfind("--", 0) != 0 || i + 1 >= argc || !options.count(key.substr(2)))
+        {
+            printUsage(argv[0]);
+            return 2;
+        }
+        options[key.substr(2)] = argv[i + 1];
+    }
+
+    try
+    {
+        using namespace hcle;
+        namespace fs = std::filesystem;
+        const bool render_skip = std::stoi(options.at("render-skip")) != 0;
+        const bool verbose = std::stoi(options.at("verbose")) != 0;
+
+        std::vector<std::string> paths;
+        const fs::path logs = options.at("logs");
+        if (fs::is_directory(logs))
+        {
+            for (const auto &entry : fs::directory_iterator(logs))
+                if (entry.is_regular_file() && entry.path().extension() == ".hcla")
+                    paths.push_back(entry.path().string());
+            std::sort(paths.begin(), paths.end());
+        }
+        else
+        {
+            paths.push_back(logs.string());
+        }
+        if (paths.empty())
+            throw std::runtime_error("No action logs found in " + logs.string() + ".");
+
+        size_t total_steps = 0, total_frames = 0, diverged = 0;
+        const auto start = clock_type::now();
+        for (const std::string &path : paths)
+        {
+            const environment::ActionLog log = environment::ActionLog::read(path);
+            const environment::ActionLogReplayResult result = environment::replayActionLog(log, render_skip);
+            total_steps += result.steps;
+            total_frames += static_cast<size_t>(result.steps) * log.header.frame_skip;
+            if (!result.matches())
+            {
+                diverged++;
+                std::cout << path << ": DIVERGED at step " << result.divergence_step << std::hex
+                          << " (expected " << std::setw(16) << std::setfill('0') << result.expected_hash
+                          << ", got " << std::setw(16) << result.actual_hash << ")" << std::dec << std::setfill(' ') << "\n";
+            }
+            else if (verbose)
+            {
+                std::cout << path << ": ok, " << log.getGameName() << ", " << result.steps << " steps, "
+                          << result.hashes_checked << " hashes\n";
+            }
+        }
+        const double seconds = secondsSince(start);
+
+        std::cout << paths.size() - diverged << "/" << paths.size() << " logs matched, " << total_steps << " steps in "
+                  << std::fixed << std::setprecision(2) << seconds << " s (" << std::setprecision(0)
+                  << total_steps / seconds << " steps/s, " << total_frames / seconds << " frames/s, render skip "
+                  << (render_skip ? "on" : "off") << ")\n";
+        return diverged ? 1 : 0;
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "hcle_replay: " << e.what() << "\n";
+        return 1;
+    }
+}
@@ -0,0 +1,27 @@
+// src/apps/shm_worker.cpp
+// Env worker process for ShmVectorEnvironment. Started by the client as
+//   hcle_shm_worker <shm_name> <worker_id>
+#include <iostream>
+#include <string>
+#include <stdexcept>
+
+#include "hcle/environment/shm_vector_env.hpp"
+
+int main(int argc, char **argv)
+{
+    if (argc != 3)
+    {
+        std::cerr << "Usage: " << argv[0] << " <shm_name> <worker_id>\n";
+        return 2;
+    }
+
+    try
+    {
+        return hcle::environment::runShmWorker(argv[1], std::stoi(argv[2]));
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "hcle_shm_worker: " << e.what() << "\n";
+        return 1;
+    }
+}
@@ -54,7 +54,7 @@ int main(int argc, char **argv)
         // --- Pre-allocate memory buffers for results ---
         const size_t single_obs_size = env.getObservationSize();
         std::vector<uint8_t> obs_buffer(num_envs * single_obs_size);
-        std::vector<float> reward_buffer(num_envs);
+        std::vector<double> reward_buffer(num_envs);
         std::vector<uint8_t> done_buffer(num_envs);
 
         // --- Reset environments to get initial state ---
@@ -0,0 +1,189 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Binary trace of the CPU bus, for finding the first access where two runs of the emulator
+// part ways. Build with HCLE_ENABLE_BUS_TRACE (CMake option of the same name) to compile the
+// HCLE_TRACE_* macros in; otherwise they expand to nothing.
+//
+// Every CPU bus cycle (opcode fetch, read, write or dummy read) is one BusTraceEntry with the
+// instruction it belongs to and the PPU dot it happened on. Entries go to a fixed in-memory
+// ring that keeps the latest ones, and writeBinary() dumps it as
+//
+//   BusTraceHeader
+//   BusTraceEntry[num_entries], oldest first
+//
+// for hcle_bus_diff to align and compare. While not recording, a trace point only bumps the
+// cycle counter.
+
+#ifdef HCLE_ENABLE_BUS_TRACE
+#define HCLE_TRACE_INSTRUCTION(trace, pc) (trace).beginInstruction(pc)
+#define HCLE_TRACE_BUS(trace, kind, address, value, ppu_x, ppu_y) (trace).access(kind, address, value, ppu_x, ppu_y)
+#else
+#define HCLE_TRACE_INSTRUCTION(trace, pc) ((void)0)
+#define HCLE_TRACE_BUS(trace, kind, address, value, ppu_x, ppu_y) ((void)0)
+#endif
+
+namespace hcle
+{
+    namespace common
+    {
+#ifdef HCLE_ENABLE_BUS_TRACE
+        inline constexpr bool kBusTraceEnabled = true;
+#else
+        inline constexpr bool kBusTraceEnabled = false;
+#endif
+
+        inline constexpr char kBusTraceMagic[8] = {'H', 'C', 'L', 'E', 'B', 'U', 'S', '\0'};
+        inline constexpr uint32_t kBusTraceVersion = 1;
+
+        enum class BusAccess : uint8_t
+        {
+            FETCH, // Opcode fetch; starts an instruction
+            READ,
+            WRITE,
+            DUMMY // Dummy read cycle, no address on the bus
+        };
+
+        struct BusTraceEntry
+        {
+            uint64_t cycle;   // CPU cycles since the emulator was created
+            uint16_t pc;      // Address of the current instruction
+            uint16_t address; // 0 for dummy reads
+            uint16_t ppu_x;   // PPU dot and scanline during the access
+            uint16_t ppu_y;
+            uint8_t opcode; // Current instruction
+            uint8_t value;  // Value read or written, the open bus for dummy reads
+            BusAccess access;
+            uint8_t reserved[5];
+        };
+        static_assert(sizeof(BusTraceEntry) == 24);
+
+        struct BusTraceHeader
+        {
+            char magic[8];
+            uint32_t version;
+            uint32_t entry_size;
+            uint64_t num_entries;
+            uint64_t num_dropped; // Entries overwritten in the ring before the dump
+        };
+        static_assert(sizeof(BusTraceHeader) == 32);
+
+        struct BusTraceFile
+        {
+            std::vector<BusTraceEntry> entries;
+            uint64_t num_dropped = 0;
+        };
+
+        // The bus trace of one emulator. Not thread-safe; it lives with its NES.
+        class BusTrace
+        {
+        public:
+            // Clears the ring and starts recording, keeping the latest capacity entries.
+            void start(size_t capacity = size_t{1} << 20)
+            {
+                if (capacity == 0)
+                    throw std::invalid_argument("Bus trace capacity must be positive.");
+                m_entries.assign(capacity, BusTraceEntry{});
+                m_written = 0;
+                m_fetch_pending = false;
+                m_enabled = true;
+            }
+
+            // Stops recording; the recorded entries stay available to writeBinary().
+            void stop() { m_enabled = false; }
+
+            bool isEnabled() const { return m_enabled; }
+            uint64_t getCycle() const { return m_cycle; }
+
+            // Called before the opcode fetch: the next read is that fetch.
+            void beginInstruction(uint16_t pc)
+            {
+                m_pc = pc;
+                m_fetch_pending = true;
+            }
+
+            void access(BusAccess access, uint16_t address, uint8_t value, uint16_t ppu_x, uint16_t ppu_y)
+            {
+                const uint64_t cycle = m_cycle++;
+                if (m_fetch_pending && access == BusAccess::READ)
+                {
+                    access = BusAccess::FETCH;
+                    m_opcode = value;
+                    m_fetch_pending = false;
+                }
+                if (!m_enabled)
+                    return;
+                BusTraceEntry &entry = m_entries[m_written++ % m_entries.size()];
+                entry = {cycle, m_pc, address, ppu_x, ppu_y, m_opcode, value, access, {}};
+            }
+
+            // The retained entries, oldest first.
+            std::vector<BusTraceEntry> getEntries() const
+            {
+                std::vector<BusTraceEntry> entries;
+                const uint64_t first = m_written > m_entries.size() ? m_written - m_entries.size() : 0;
+                entries.reserve(static_cast<size_t>(m_written - first));
+                for (uint64_t i = first; i < m_written; ++i)
+                    entries.push_back(m_entries[i % m_entries.size()]);
+                return entries;
+            }
+
+            void writeBinary(const std::string &path) const
+            {
+                const std::vector<BusTraceEntry> entries = getEntries();
+                BusTraceHeader header;
+                std::memset(&header, 0, sizeof(header));
+                std::memcpy(header.magic, kBusTraceMagic, sizeof(kBusTraceMagic));
+                header.version = kBusTraceVersion;
+                header.entry_size = sizeof(BusTraceEntry);
+                header.num_entries = entries.size();
+                header.num_dropped = m_written - entries.size();
+
+                std::ofstream file(path, std::ios::binary);
+                if (!file)
+                    throw std::runtime_error("Cannot open " + path + " for writing.");
+                file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+                file.write(reinterpret_cast<const char *>(entries.data()),
+                           static_cast<std::streamsize>(entries.size() * sizeof(BusTraceEntry)));
+                if (!file)
+                    throw std::runtime_error("Failed to write " + path + ".");
+            }
+
+            static BusTraceFile readBinary(const std::string &path)
+            {
+                std::ifstream file(path, std::ios::binary);
+                if (!file)
+                    throw std::runtime_error("Cannot open bus trace " + path + ".");
+                BusTraceHeader header;
+                if (!file.read(reinterpret_cast<char *>(&header), sizeof(header)) ||
+                    std::memcmp(header.magic, kBusTraceMagic, sizeof(kBusTraceMagic)) != 0)
+                    throw std::runtime_error(path + " is not a bus trace.");
+                if (header.version != kBusTraceVersion || header.entry_size != sizeof(BusTraceEntry))
+                    throw std::runtime_error(path + " has unsupported version " + std::to_string(header.version) + ".");
+
+                BusTraceFile trace;
+                trace.num_dropped = header.num_dropped;
+                trace.entries.resize(static_cast<size_t>(header.num_entries));
+                if (!file.read(reinterpret_cast<char *>(trace.entries.data()),
+                               static_cast<std::streamsize>(trace.entries.size() * sizeof(BusTraceEntry))))
+                    throw std::runtime_error(path + " is truncated.");
+                return trace;
+            }
+
+        private:
+            std::vector<BusTraceEntry> m_entries;
+            uint64_t m_written = 0;
+            uint64_t m_cycle = 0;
+            uint16_t m_pc = 0;
+            uint8_t m_opcode = 0;
+            bool m_fetch_pending = false;
+            bool m_enabled = false;
+        };
+    }
+}
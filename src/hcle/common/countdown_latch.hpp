@@ -0,0 +1,50 @@
+#pragma once
+
+#include <mutex>
+#include <condition_variable>
+#include <algorithm>
+#include <cstddef>
+
+namespace hcle
+{
+    namespace common
+    {
+
+        // A reusable std::latch: reset() arms it for the next batch, count_down() is
+        // called as work completes and wait() returns once the count reaches zero.
+        class CountdownLatch
+        {
+        public:
+            void reset(size_t count)
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_count = count;
+            }
+
+            void count_down(size_t n = 1)
+            {
+                bool released;
+                {
+                    std::unique_lock<std::mutex> lock(m_mutex);
+                    m_count -= std::min(n, m_count);
+                    released = m_count == 0;
+                }
+                if (released)
+                    m_cond.notify_all();
+            }
+
+            void wait()
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_cond.wait(lock, [this]
+                            { return m_count == 0; });
+            }
+
+        private:
+            size_t m_count = 0;
+            std::mutex m_mutex;
+            std::condition_variable m_cond;
+        };
+
+    } // namespace common
+} // namespace hcle
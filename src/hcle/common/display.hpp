@@ -26,7 +26,7 @@ namespace hcle
                 display->update(frame_ptr, grayscale);
                 if (display->processEvents())
                 {
-                    throw WindowClosedException::WindowClosedException();
+                    throw WindowClosedException();
                 }
             }
 
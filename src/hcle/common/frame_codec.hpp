@@ -0,0 +1,374 @@
+#pragma once
+
+// Frame codecs for shipping or storing observations. Consecutive NES frames differ in a
+// small fraction of pixels, so each frame is encoded as the XOR with the previous frame
+// of the same stream (one stream per env), then either run-length coded or deflated.
+//
+// Stacked observations ([stack_size, ...], oldest first) advance by one sub-frame per
+// step, so with stack_size > 1 the reference is the previous observation shifted by one
+// sub-frame, with its newest sub-frame repeated in the last slot. Only the newest
+// sub-frame then carries a real delta.
+//
+// An encoded frame is a record:  u8 codec, u32 payload_size, payload
+//   Raw        the frame itself (keyframe)
+//   DeltaRle   segments of (varint zero_run, varint literal_len, literal_len XOR bytes);
+//              bytes past the last segment are unchanged
+//   DeltaZlib  zlib stream of the full XOR delta
+// The first frame of a stream, and the first after resetStream(), is always Raw, as is
+// any frame whose delta would not be smaller.
+
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <zlib.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#endif
+
+namespace hcle
+{
+    namespace common
+    {
+
+        enum class FrameCodec : uint8_t
+        {
+            Raw = 0,
+            DeltaRle = 1,
+            DeltaZlib = 2
+        };
+
+        inline FrameCodec parseFrameCodec(const std::string &name)
+        {
+            if (name == "raw")
+                return FrameCodec::Raw;
+            if (name == "delta_rle")
+                return FrameCodec::DeltaRle;
+            if (name == "delta_zlib")
+                return FrameCodec::DeltaZlib;
+            throw std::invalid_argument("Unknown frame codec '" + name + "'. Expected raw, delta_rle or delta_zlib.");
+        }
+
+        // Size of the u8 codec + u32 payload_size record header.
+        inline constexpr size_t kFrameRecordHeaderSize = 5;
+
+        // Index of the first byte in [pos, size) where a and b differ, or size.
+        inline size_t findMismatch(const uint8_t *a, const uint8_t *b, size_t pos, size_t size)
+        {
+#if defined(__AVX2__)
+            for (; pos + 32 <= size; pos += 32)
+            {
+                const __m256i eq = _mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(a + pos)),
+                                                     _mm256_loadu_si256(reinterpret_cast<const __m256i *>(b + pos)));
+                const uint32_t diff = ~static_cast<uint32_t>(_mm256_movemask_epi8(eq));
+                if (diff)
+                    return pos + std::countr_zero(diff);
+            }
+#endif
+#if defined(__AVX2__) || defined(__SSE2__) || defined(_M_X64)
+            for (; pos + 16 <= size; pos += 16)
+            {
+                const __m128i eq = _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(a + pos)),
+                                                  _mm_loadu_si128(reinterpret_cast<const __m128i *>(b + pos)));
+                const uint32_t diff = ~static_cast<uint32_t>(_mm_movemask_epi8(eq)) & 0xFFFFu;
+                if (diff)
+                    return pos + std::countr_zero(diff);
+            }
+#endif
+            if constexpr (std::endian::native == std::endian::little)
+            {
+                for (; pos + 8 <= size; pos += 8)
+                {
+                    uint64_t x, y;
+                    std::memcpy(&x, a + pos, 8);
+                    std::memcpy(&y, b + pos, 8);
+                    if (x != y)
+                        return pos + std::countr_zero(x ^ y) / 8;
+                }
+            }
+            while (pos < size && a[pos] == b[pos])
+                pos++;
+            return pos;
+        }
+
+        // Index of the first byte in [pos, size) where a and b are equal, or size.
+        inline size_t findMatch(const uint8_t *a, const uint8_t *b, size_t pos, size_t size)
+        {
+#if defined(__AVX2__)
+            for (; pos + 32 <= size; pos += 32)
+            {
+                const __m256i eq = _mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(a + pos)),
+                                                     _mm256_loadu_si256(reinterpret_cast<const __m256i *>(b + pos)));
+                const uint32_t same = static_cast<uint32_t>(_mm256_movemask_epi8(eq));
+                if (same)
+                    return pos + std::countr_zero(same);
+            }
+#endif
+#if defined(__AVX2__) || defined(__SSE2__) || defined(_M_X64)
+            for (; pos + 16 <= size; pos += 16)
+            {
+                const __m128i eq = _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(a + pos)),
+                                                  _mm_loadu_si128(reinterpret_cast<const __m128i *>(b + pos)));
+                const uint32_t same = static_cast<uint32_t>(_mm_movemask_epi8(eq));
+                if (same)
+                    return pos + std::countr_zero(same);
+            }
+#endif
+            while (pos < size && a[pos] != b[pos])
+                pos++;
+            return pos;
+        }
+
+        inline void putVarint(std::vector<uint8_t> &out, uint64_t value)
+        {
+            while (value >= 0x80)
+            {
+                out.push_back(static_cast<uint8_t>(value) | 0x80);
+                value >>= 7;
+            }
+            out.push_back(static_cast<uint8_t>(value));
+        }
+
+        inline uint64_t getVarint(const uint8_t *data, size_t size, size_t &offset)
+        {
+            uint64_t value = 0;
+            for (int shift = 0; shift < 64; shift += 7)
+            {
+                if (offset >= size)
+                    throw std::runtime_error("Truncated varint in encoded frame.");
+                const uint8_t byte = data[offset++];
+                value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+                if (!(byte & 0x80))
+                    return value;
+            }
+            throw std::runtime_error("Malformed varint in encoded frame.");
+        }
+
+        // Appends the DeltaRle payload of current against previous (both size bytes).
+        // Unchanged runs shorter than kMinZeroRun are folded into the surrounding literal,
+        // since a segment header costs about as much as the bytes it would skip.
+        inline void appendDeltaRle(const uint8_t *current, const uint8_t *previous, size_t size, std::vector<uint8_t> &out)
+        {
+            constexpr size_t kMinZeroRun = 4;
+            size_t pos = 0;
+            while (true)
+            {
+                const size_t literal_start = findMismatch(current, previous, pos, size);
+                if (literal_start == size)
+                    return;
+
+                size_t literal_end = literal_start;
+                while (true)
+                {
+                    literal_end = findMatch(current, previous, literal_end, size);
+                    const size_t run_end = findMismatch(current, previous, literal_end, size);
+                    if (run_end == size || run_end - literal_end >= kMinZeroRun)
+                        break;
+                    literal_end = run_end;
+                }
+
+                putVarint(out, literal_start - pos);
+                putVarint(out, literal_end - literal_start);
+                const size_t offset = out.size();
+                out.resize(offset + literal_end - literal_start);
+                uint8_t *dst = out.data() + offset;
+                for (size_t i = literal_start; i < literal_end; ++i)
+                    *dst++ = current[i] ^ previous[i];
+                pos = literal_end;
+            }
+        }
+
+        // Applies a DeltaRle payload to frame (size bytes) in place.
+        inline void applyDeltaRle(const uint8_t *data, size_t data_size, uint8_t *frame, size_t size)
+        {
+            size_t offset = 0;
+            size_t pos = 0;
+            while (offset < data_size)
+            {
+                pos += getVarint(data, data_size, offset);
+                const uint64_t literal = getVarint(data, data_size, offset);
+                if (pos > size || literal > size - pos || literal > data_size - offset)
+                    throw std::runtime_error("DeltaRle payload overruns the frame.");
+                const uint8_t *src = data + offset;
+                for (uint64_t i = 0; i < literal; ++i)
+                    frame[pos + i] ^= src[i];
+                pos += literal;
+                offset += literal;
+            }
+        }
+
+        // Bytes per sub-frame of a stacked frame.
+        inline size_t stackShift(size_t frame_size, size_t stack_size)
+        {
+            if (stack_size == 0 || frame_size % stack_size != 0)
+                throw std::invalid_argument("Frame size " + std::to_string(frame_size) + " is not a multiple of stack size " +
+                                            std::to_string(stack_size) + ".");
+            return frame_size / stack_size;
+        }
+
+        // Encodes batches of frames, one stream per env, against each stream's previous frame.
+        class FrameEncoder
+        {
+        public:
+            FrameEncoder(size_t num_streams, size_t frame_size, size_t stack_size = 1, int zlib_level = Z_BEST_SPEED)
+                : m_num_streams(num_streams), m_frame_size(frame_size), m_shift(stackShift(frame_size, stack_size)),
+                  m_zlib_level(zlib_level), m_prev(num_streams * frame_size), m_has_prev(num_streams, 0)
+            {
+            }
+
+            // Appends one record per stream for num_streams contiguous frames.
+            void encode(const uint8_t *frames, FrameCodec codec, std::vector<uint8_t> &out)
+            {
+                for (size_t i = 0; i < m_num_streams; ++i)
+                    encodeFrame(i, frames + i * m_frame_size, codec, out);
+            }
+
+            void encodeFrame(size_t stream, const uint8_t *frame, FrameCodec codec, std::vector<uint8_t> &out)
+            {
+                uint8_t *prev = m_prev.data() + stream * m_frame_size;
+                if (!m_has_prev[stream])
+                    codec = FrameCodec::Raw;
+
+                const size_t header = out.size();
+                out.resize(header + kFrameRecordHeaderSize);
+                if (codec == FrameCodec::DeltaRle)
+                    appendDeltaRle(frame, prev, m_frame_size, out);
+                else if (codec == FrameCodec::DeltaZlib)
+                    appendDeltaZlib(frame, prev, out);
+
+                size_t payload = out.size() - header - kFrameRecordHeaderSize;
+                if (codec == FrameCodec::Raw || payload >= m_frame_size)
+                {
+                    codec = FrameCodec::Raw;
+                    payload = m_frame_size;
+                    out.resize(header + kFrameRecordHeaderSize + payload);
+                    std::memcpy(out.data() + header + kFrameRecordHeaderSize, frame, payload);
+                }
+                out[header] = static_cast<uint8_t>(codec);
+                const uint32_t payload_size = static_cast<uint32_t>(payload);
+                std::memcpy(out.data() + header + 1, &payload_size, sizeof(payload_size));
+
+                // The next reference: this frame shifted by one sub-frame (see the top of the file).
+                std::memcpy(prev, frame + m_shift, m_frame_size - m_shift);
+                std::memcpy(prev + m_frame_size - m_shift, frame + m_frame_size - m_shift, m_shift);
+                m_has_prev[stream] = 1;
+            }
+
+            // Makes the next frame of a stream a keyframe (e.g. a new client or file chunk).
+            void resetStream(size_t stream) { m_has_prev[stream] = 0; }
+            void resetAll() { std::fill(m_has_prev.begin(), m_has_prev.end(), 0); }
+
+            size_t getNumStreams() const { return m_num_streams; }
+            size_t getFrameSize() const { return m_frame_size; }
+
+        private:
+            void appendDeltaZlib(const uint8_t *frame, const uint8_t *prev, std::vector<uint8_t> &out)
+            {
+                m_scratch.resize(m_frame_size);
+                for (size_t i = 0; i < m_frame_size; ++i)
+                    m_scratch[i] = frame[i] ^ prev[i];
+
+                const size_t offset = out.size();
+                uLongf compressed = compressBound(static_cast<uLong>(m_frame_size));
+                out.resize(offset + compressed);
+                if (compress2(out.data() + offset, &compressed, m_scratch.data(), static_cast<uLong>(m_frame_size), m_zlib_level) != Z_OK)
+                    throw std::runtime_error("zlib compression failed.");
+                out.resize(offset + compressed);
+            }
+
+            size_t m_num_streams;
+            size_t m_frame_size;
+            size_t m_shift;
+            int m_zlib_level;
+            std::vector<uint8_t> m_prev;
+            std::vector<uint8_t> m_has_prev;
+            std::vector<uint8_t> m_scratch;
+        };
+
+        // Reverses a FrameEncoder with the same frame and stack size. Keeps the latest frame of
+        // every stream to derive the delta reference from.
+        class FrameDecoder
+        {
+        public:
+            FrameDecoder(size_t num_streams, size_t frame_size, size_t stack_size = 1)
+                : m_num_streams(num_streams), m_frame_size(frame_size), m_shift(stackShift(frame_size, stack_size)),
+                  m_frames(num_streams * frame_size)
+            {
+            }
+
+            // Decodes one record per stream from data and returns the bytes consumed. frames,
+            // if not null, receives the num_streams decoded frames contiguously.
+            size_t decode(const uint8_t *data, size_t size, uint8_t *frames = nullptr)
+            {
+                size_t offset = 0;
+                for (size_t i = 0; i < m_num_streams; ++i)
+                    offset += decodeFrame(i, data + offset, size - offset, frames ? frames + i * m_frame_size : nullptr);
+                return offset;
+            }
+
+            size_t decodeFrame(size_t stream, const uint8_t *data, size_t size, uint8_t *frame_out = nullptr)
+            {
+                if (size < kFrameRecordHeaderSize)
+                    throw std::runtime_error("Truncated frame record.");
+                const auto codec = static_cast<FrameCodec>(data[0]);
+                uint32_t payload_size;
+                std::memcpy(&payload_size, data + 1, sizeof(payload_size));
+                if (payload_size > size - kFrameRecordHeaderSize)
+                    throw std::runtime_error("Truncated frame record.");
+                const uint8_t *payload = data + kFrameRecordHeaderSize;
+                uint8_t *frame = m_frames.data() + stream * m_frame_size;
+                // Turn the previous frame into the encoder's reference; its newest sub-frame
+                // is already in the last slot.
+                if (codec != FrameCodec::Raw && m_shift < m_frame_size)
+                    std::memmove(frame, frame + m_shift, m_frame_size - m_shift);
+
+                switch (codec)
+                {
+                case FrameCodec::Raw:
+                    if (payload_size != m_frame_size)
+                        throw std::runtime_error("Raw frame record has the wrong size.");
+                    std::memcpy(frame, payload, m_frame_size);
+                    break;
+                case FrameCodec::DeltaRle:
+                    applyDeltaRle(payload, payload_size, frame, m_frame_size);
+                    break;
+                case FrameCodec::DeltaZlib:
+                {
+                    m_scratch.resize(m_frame_size);
+                    uLongf inflated = static_cast<uLongf>(m_frame_size);
+                    if (uncompress(m_scratch.data(), &inflated, payload, payload_size) != Z_OK || inflated != m_frame_size)
+                        throw std::runtime_error("Corrupt DeltaZlib frame record.");
+                    for (size_t i = 0; i < m_frame_size; ++i)
+                        frame[i] ^= m_scratch[i];
+                    break;
+                }
+                default:
+                    throw std::runtime_error("Unknown frame codec " + std::to_string(data[0]) + ".");
+                }
+
+                if (frame_out)
+                    std::memcpy(frame_out, frame, m_frame_size);
+                return kFrameRecordHeaderSize + payload_size;
+            }
+
+            const uint8_t *getFrame(size_t stream) const { return m_frames.data() + stream * m_frame_size; }
+            size_t getNumStreams() const { return m_num_streams; }
+            size_t getFrameSize() const { return m_frame_size; }
+
+        private:
+            size_t m_num_streams;
+            size_t m_frame_size;
+            size_t m_shift;
+            std::vector<uint8_t> m_frames;
+            std::vector<uint8_t> m_scratch;
+        };
+
+    } // namespace common
+} // namespace hcle
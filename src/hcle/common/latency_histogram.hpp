@@ -0,0 +1,141 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace hcle
+{
+    namespace common
+    {
+
+        // HDR-style histogram of nanosecond latencies that any number of threads can record
+        // into without locking.
+        //
+        // Buckets are log-linear: values below kSubBuckets get a bucket each, and every
+        // power of two above that is split into kSubBuckets equal buckets, so any recorded
+        // value is known to within 1 / kSubBuckets (~3%). Values from kMaxValue up land in
+        // the last bucket; the exact maximum is tracked separately.
+        class LatencyHistogram
+        {
+        public:
+            static constexpr int kSubBucketBits = 5;
+            static constexpr uint64_t kSubBuckets = uint64_t{1} << kSubBucketBits;
+            static constexpr int kMaxValueBits = 40; // ~18 minutes
+            static constexpr uint64_t kMaxValue = (uint64_t{1} << kMaxValueBits) - 1;
+            static constexpr size_t kNumBuckets = kSubBuckets * (kMaxValueBits - kSubBucketBits + 1);
+
+            static uint64_t now()
+            {
+                return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                                 std::chrono::steady_clock::now().time_since_epoch())
+                                                 .count());
+            }
+
+            static size_t bucketIndex(uint64_t value)
+            {
+                value = std::min(value, kMaxValue);
+                if (value < kSubBuckets)
+                    return static_cast<size_t>(value);
+                const int shift = std::bit_width(value) - 1 - kSubBucketBits;
+                return static_cast<size_t>(kSubBuckets * (shift + 1) + ((value >> shift) - kSubBuckets));
+            }
+
+            static uint64_t bucketLowerBound(size_t index)
+            {
+                if (index < kSubBuckets)
+                    return index;
+                const int shift = static_cast<int>(index / kSubBuckets) - 1;
+                return (kSubBuckets + index % kSubBuckets) << shift;
+            }
+
+            // Largest value that falls in the bucket.
+            static uint64_t bucketUpperBound(size_t index)
+            {
+                return index + 1 < kNumBuckets ? bucketLowerBound(index + 1) - 1 : kMaxValue;
+            }
+
+            void record(uint64_t nanoseconds)
+            {
+                m_counts[bucketIndex(nanoseconds)].fetch_add(1, std::memory_order_relaxed);
+                m_count.fetch_add(1, std::memory_order_relaxed);
+                m_sum.fetch_add(nanoseconds, std::memory_order_relaxed);
+                uint64_t max = m_max.load(std::memory_order_relaxed);
+                while (nanoseconds > max && !m_max.compare_exchange_weak(max, nanoseconds, std::memory_order_relaxed))
+                {
+                }
+            }
+
+            // Records the time elapsed since start, a value of now().
+            void recordSince(uint64_t start) { record(now() - start); }
+
+            // Not atomic with respect to concurrent record() calls; reset between batches.
+            void reset()
+            {
+                for (auto &count : m_counts)
+                    count.store(0, std::memory_order_relaxed);
+                m_count.store(0, std::memory_order_relaxed);
+                m_sum.store(0, std::memory_order_relaxed);
+                m_max.store(0, std::memory_order_relaxed);
+            }
+
+            uint64_t getCount() const { return m_count.load(std::memory_order_relaxed); }
+            uint64_t getMax() const { return m_max.load(std::memory_order_relaxed); }
+            double getMean() const
+            {
+                const uint64_t count = getCount();
+                return count ? static_cast<double>(m_sum.load(std::memory_order_relaxed)) / count : 0.0;
+            }
+
+            // Per-bucket counts, kNumBuckets long.
+            std::vector<uint64_t> getCounts() const
+            {
+                std::vector<uint64_t> counts(kNumBuckets);
+                for (size_t i = 0; i < kNumBuckets; ++i)
+                    counts[i] = m_counts[i].load(std::memory_order_relaxed);
+                return counts;
+            }
+
+            static std::vector<uint64_t> getBucketUpperBounds()
+            {
+                std::vector<uint64_t> bounds(kNumBuckets);
+                for (size_t i = 0; i < kNumBuckets; ++i)
+                    bounds[i] = bucketUpperBound(i);
+                return bounds;
+            }
+
+            // Upper bound of the bucket holding the given percentile (0-100), capped at the
+            // recorded maximum. 0 if nothing was recorded.
+            uint64_t getPercentile(double percentile) const
+            {
+                const std::vector<uint64_t> counts = getCounts();
+                uint64_t total = 0;
+                for (uint64_t count : counts)
+                    total += count;
+                if (total == 0)
+                    return 0;
+
+                const double clamped = std::clamp(percentile, 0.0, 100.0);
+                const uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(clamped / 100.0 * total + 0.5));
+                uint64_t seen = 0;
+                for (size_t i = 0; i < kNumBuckets; ++i)
+                {
+                    seen += counts[i];
+                    if (seen >= rank)
+                        return std::min(bucketUpperBound(i), getMax());
+                }
+                return getMax();
+            }
+
+        private:
+            std::atomic<uint64_t> m_counts[kNumBuckets];
+            std::atomic<uint64_t> m_count{0};
+            std::atomic<uint64_t> m_sum{0};
+            std::atomic<uint64_t> m_max{0};
+        };
+    }
+}
@@ -0,0 +1,195 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace hcle
+{
+    namespace common
+    {
+
+        // A file mapped into memory, either created read-write at a fixed capacity or
+        // opened read-only at its current size. Move-only; unmaps on destruction.
+        class MappedFile
+        {
+        public:
+            MappedFile() = default;
+
+            // Creates (or truncates) path and maps capacity bytes of it read-write.
+            static MappedFile create(const std::string &path, size_t capacity)
+            {
+                MappedFile file;
+                file.m_path = path;
+                file.m_size = capacity;
+                file.m_writable = true;
+#if defined(_WIN32)
+                file.m_file = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr,
+                                          CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+                if (file.m_file == INVALID_HANDLE_VALUE)
+                    throw std::runtime_error("CreateFile(" + path + ") failed: error " + std::to_string(GetLastError()));
+                file.mapWindows(PAGE_READWRITE, FILE_MAP_WRITE);
+#else
+                file.m_fd = ::open(path.c_str(), O_CREAT | O_TRUNC | O_RDWR, 0644);
+                if (file.m_fd < 0)
+                    throw std::runtime_error("open(" + path + ") failed: " + std::strerror(errno));
+                if (ftruncate(file.m_fd, static_cast<off_t>(capacity)) != 0)
+                    throw std::runtime_error("ftruncate(" + path + ") failed: " + std::strerror(errno));
+                file.mapPosix(PROT_READ | PROT_WRITE);
+#endif
+                return file;
+            }
+
+            // Maps an existing file read-only.
+            static MappedFile openReadOnly(const std::string &path)
+            {
+                MappedFile file;
+                file.m_path = path;
+#if defined(_WIN32)
+                file.m_file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr,
+                                          OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+                if (file.m_file == INVALID_HANDLE_VALUE)
+                    throw std::runtime_error("CreateFile(" + path + ") failed: error " + std::to_string(GetLastError()));
+                LARGE_INTEGER size;
+                GetFileSizeEx(file.m_file, &size);
+                file.m_size = static_cast<size_t>(size.QuadPart);
+                if (file.m_size > 0)
+                    file.mapWindows(PAGE_READONLY, FILE_MAP_READ);
+#else
+                file.m_fd = ::open(path.c_str(), O_RDONLY);
+                if (file.m_fd < 0)
+                    throw std::runtime_error("open(" + path + ") failed: " + std::strerror(errno));
+                struct stat st;
+                if (fstat(file.m_fd, &st) != 0)
+                    throw std::runtime_error("fstat(" + path + ") failed: " + std::strerror(errno));
+                file.m_size = static_cast<size_t>(st.st_size);
+                if (file.m_size > 0)
+                    file.mapPosix(PROT_READ);
+#endif
+                return file;
+            }
+
+            ~MappedFile() { close(); }
+
+            MappedFile(MappedFile &&other) noexcept { *this = std::move(other); }
+            MappedFile &operator=(MappedFile &&other) noexcept
+            {
+                if (this != &other)
+                {
+                    close();
+                    m_path = std::move(other.m_path);
+                    m_data = std::exchange(other.m_data, nullptr);
+                    m_size = std::exchange(other.m_size, 0);
+                    m_writable = std::exchange(other.m_writable, false);
+#if defined(_WIN32)
+                    m_file = std::exchange(other.m_file, INVALID_HANDLE_VALUE);
+                    m_mapping = std::exchange(other.m_mapping, nullptr);
+#else
+                    m_fd = std::exchange(other.m_fd, -1);
+#endif
+                }
+                return *this;
+            }
+
+            MappedFile(const MappedFile &) = delete;
+            MappedFile &operator=(const MappedFile &) = delete;
+
+            // Unmaps the file and, for writable files, trims it to final_size bytes.
+            void close(size_t final_size = SIZE_MAX)
+            {
+#if defined(_WIN32)
+                if (m_data)
+                {
+                    if (m_writable)
+                        FlushViewOfFile(m_data, 0);
+                    UnmapViewOfFile(m_data);
+                }
+                if (m_mapping)
+                    CloseHandle(m_mapping);
+                if (m_file != INVALID_HANDLE_VALUE)
+                {
+                    if (m_writable && final_size != SIZE_MAX)
+                    {
+                        LARGE_INTEGER size;
+                        size.QuadPart = static_cast<LONGLONG>(final_size);
+                        SetFilePointerEx(m_file, size, nullptr, FILE_BEGIN);
+                        SetEndOfFile(m_file);
+                    }
+                    CloseHandle(m_file);
+                }
+                m_file = INVALID_HANDLE_VALUE;
+                m_mapping = nullptr;
+#else
+                if (m_data)
+                    munmap(m_data, m_size);
+                if (m_fd >= 0)
+                {
+                    if (m_writable && final_size != SIZE_MAX)
+                    {
+                        // Best effort: an untrimmed file is still valid, just larger.
+                        [[maybe_unused]] const int result = ftruncate(m_fd, static_cast<off_t>(final_size));
+                    }
+                    ::close(m_fd);
+                }
+                m_fd = -1;
+#endif
+                m_data = nullptr;
+                m_size = 0;
+            }
+
+            uint8_t *data() { return static_cast<uint8_t *>(m_data); }
+            const uint8_t *data() const { return static_cast<const uint8_t *>(m_data); }
+            size_t size() const { return m_size; }
+            const std::string &path() const { return m_path; }
+            bool isOpen() const { return m_data != nullptr; }
+
+        private:
+#if defined(_WIN32)
+            void mapWindows(DWORD protect, DWORD access)
+            {
+                const uint64_t size = m_size;
+                m_mapping = CreateFileMappingA(m_file, nullptr, protect, static_cast<DWORD>(size >> 32),
+                                               static_cast<DWORD>(size & 0xFFFFFFFFu), nullptr);
+                if (!m_mapping)
+                    throw std::runtime_error("CreateFileMapping(" + m_path + ") failed: error " + std::to_string(GetLastError()));
+                m_data = MapViewOfFile(m_mapping, access, 0, 0, m_size);
+                if (!m_data)
+                    throw std::runtime_error("MapViewOfFile(" + m_path + ") failed: error " + std::to_string(GetLastError()));
+            }
+
+            HANDLE m_file = INVALID_HANDLE_VALUE;
+            HANDLE m_mapping = nullptr;
+#else
+            void mapPosix(int protection)
+            {
+                void *ptr = mmap(nullptr, m_size, protection, MAP_SHARED, m_fd, 0);
+                if (ptr == MAP_FAILED)
+                    throw std::runtime_error("mmap(" + m_path + ") failed: " + std::strerror(errno));
+                m_data = ptr;
+            }
+
+            int m_fd = -1;
+#endif
+            std::string m_path;
+            void *m_data = nullptr;
+            size_t m_size = 0;
+            bool m_writable = false;
+        };
+
+    } // namespace common
+} // namespace hcle
@@ -0,0 +1,145 @@
+#pragma once
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace hcle
+{
+    namespace common
+    {
+
+        // Hardware performance counters of the calling thread and every thread it spawns
+        // after construction, via Linux perf_event_open. Counters the kernel or PMU refuses
+        // (permissions, virtual machines without a PMU, other platforms) are skipped, and if
+        // none open isAvailable() is false with the reason in getError(); reads then return
+        // nothing instead of failing.
+        class PerfCounters
+        {
+        public:
+            // Names of the counters, in the order getValues() reports them.
+            static const std::vector<std::string> &names()
+            {
+                static const std::vector<std::string> kNames = {"cycles", "instructions", "branches", "branch_misses",
+                                                                "l1d_read_misses", "llc_read_misses"};
+                return kNames;
+            }
+
+            struct Sample
+            {
+                // Per names(), scaled up if the kernel multiplexed the counter; -1 if the
+                // counter did not open.
+                std::vector<double> values;
+
+                bool empty() const { return values.empty(); }
+                double get(size_t index) const { return index < values.size() ? values[index] : -1.0; }
+            };
+
+            PerfCounters()
+            {
+#if defined(__linux__)
+                const uint64_t cache_read_miss = (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+                const std::pair<uint32_t, uint64_t> events[] = {
+                    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+                    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+                    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_INSTRUCTIONS},
+                    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+                    {PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | cache_read_miss},
+                    {PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_LL | cache_read_miss},
+                };
+                bool any_open = false;
+                for (const auto &[type, config] : events)
+                {
+                    perf_event_attr attr;
+                    std::memset(&attr, 0, sizeof(attr));
+                    attr.size = sizeof(attr);
+                    attr.type = type;
+                    attr.config = config;
+                    attr.disabled = 1;
+                    attr.inherit = 1;
+                    attr.exclude_kernel = 1; // Allowed at perf_event_paranoid 2
+                    attr.exclude_hv = 1;
+                    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+                    const int fd = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+                    if (fd < 0 && m_error.empty())
+                        m_error = std::string("perf_event_open failed: ") + std::strerror(errno);
+                    any_open |= fd >= 0;
+                    m_fds.push_back(fd);
+                }
+                if (any_open)
+                    m_error.clear();
+                else
+                    closeAll();
+#else
+                m_error = "hardware counters need Linux perf_event_open";
+#endif
+            }
+
+            ~PerfCounters() { closeAll(); }
+
+            PerfCounters(const PerfCounters &) = delete;
+            PerfCounters &operator=(const PerfCounters &) = delete;
+
+            bool isAvailable() const { return !m_fds.empty(); }
+            const std::string &getError() const { return m_error; }
+
+            // Zeroes and starts the counters.
+            void start()
+            {
+#if defined(__linux__)
+                for (int fd : m_fds)
+                    if (fd >= 0)
+                    {
+                        ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+                        ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+                    }
+#endif
+            }
+
+            // Stops the counters and returns their values since start().
+            Sample stop()
+            {
+                Sample sample;
+#if defined(__linux__)
+                for (int fd : m_fds)
+                    if (fd >= 0)
+                        ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+                for (int fd : m_fds)
+                {
+                    uint64_t data[3] = {}; // value, time enabled, time running
+                    if (fd < 0 || read(fd, data, sizeof(data)) != static_cast<ssize_t>(sizeof(data)) || !data[2])
+                    {
+                        sample.values.push_back(-1.0);
+                        continue;
+                    }
+                    sample.values.push_back(static_cast<double>(data[0]) * data[1] / data[2]);
+                }
+#endif
+                return sample;
+            }
+
+        private:
+            void closeAll()
+            {
+#if defined(__linux__)
+                for (int fd : m_fds)
+                    if (fd >= 0)
+                        close(fd);
+#endif
+                m_fds.clear();
+            }
+
+            std::vector<int> m_fds; // -1 for counters that did not open
+            std::string m_error;
+        };
+    }
+}
@@ -0,0 +1,244 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define HCLE_PROFILING_RDTSC 1
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+#endif
+
+// Per-component time accounting for the emulator and environments. Build with
+// HCLE_ENABLE_PROFILING (CMake option of the same name) to compile the HCLE_PROFILE_*
+// macros in; otherwise they expand to nothing and every counter stays zero.
+//
+// Hot paths (PPU/APU/mapper ticks) only time one call in kProfileSampleInterval and
+// extrapolate from the call count; coarser phases time every call.
+
+#ifdef HCLE_ENABLE_PROFILING
+#define HCLE_PROFILE_CONCAT_(a, b) a##b
+#define HCLE_PROFILE_CONCAT(a, b) HCLE_PROFILE_CONCAT_(a, b)
+#define HCLE_PROFILE_SAMPLED(counter) \
+    ::hcle::common::ProfileScope HCLE_PROFILE_CONCAT(hcle_profile_scope_, __LINE__)(counter, ::hcle::common::kProfileSampleInterval)
+#define HCLE_PROFILE_SAMPLED_NESTED(counter) \
+    ::hcle::common::ProfileScope HCLE_PROFILE_CONCAT(hcle_profile_scope_, __LINE__)(counter, ::hcle::common::kProfileSampleInterval, ::hcle::common::kProfileSampleInterval / 2)
+#define HCLE_PROFILE_SCOPE(counter) \
+    ::hcle::common::ProfileScope HCLE_PROFILE_CONCAT(hcle_profile_scope_, __LINE__)(counter, 1)
+#define HCLE_PROFILE_COUNT(counter) (++(counter).calls)
+#else
+#define HCLE_PROFILE_SAMPLED(counter) ((void)0)
+#define HCLE_PROFILE_SAMPLED_NESTED(counter) ((void)0)
+#define HCLE_PROFILE_SCOPE(counter) ((void)0)
+#define HCLE_PROFILE_COUNT(counter) ((void)0)
+#endif
+
+// 6502 hot-spot profiling, compiled in separately with HCLE_ENABLE_PC_PROFILING since it
+// touches every instruction: counts each executed opcode and samples the program counter
+// (with the mapper page it runs from) about once per kPcSampleInterval instructions.
+#ifdef HCLE_ENABLE_PC_PROFILING
+#define HCLE_PROFILE_PC(profile, pc, opcode, page)               \
+    do                                                           \
+    {                                                            \
+        ::hcle::common::PcProfile &hcle_pc_profile_ = (profile); \
+        hcle_pc_profile_.opcodes[opcode]++;                      \
+        if (hcle_pc_profile_.sampleDue())                        \
+            hcle_pc_profile_.addSample(pc, page);                \
+    } while (0)
+#else
+#define HCLE_PROFILE_PC(profile, pc, opcode, page) ((void)0)
+#endif
+
+namespace hcle
+{
+    namespace common
+    {
+#ifdef HCLE_ENABLE_PROFILING
+        inline constexpr bool kProfilingEnabled = true;
+#else
+        inline constexpr bool kProfilingEnabled = false;
+#endif
+        inline constexpr uint32_t kProfileSampleInterval = 64;
+#ifdef HCLE_ENABLE_PC_PROFILING
+        inline constexpr bool kPcProfilingEnabled = true;
+#else
+        inline constexpr bool kPcProfilingEnabled = false;
+#endif
+        inline constexpr uint32_t kPcSampleInterval = 16;
+
+        // rdtsc where available, steady_clock nanoseconds elsewhere.
+        inline uint64_t readTimestamp()
+        {
+#ifdef HCLE_PROFILING_RDTSC
+            return __rdtsc();
+#else
+            return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                             std::chrono::steady_clock::now().time_since_epoch())
+                                             .count());
+#endif
+        }
+
+        // Timestamp ticks per second, calibrated against steady_clock on first use.
+        inline double timestampsPerSecond()
+        {
+#ifdef HCLE_PROFILING_RDTSC
+            static const double rate = []
+            {
+                using clock = std::chrono::steady_clock;
+                const auto start = clock::now();
+                const uint64_t start_ticks = readTimestamp();
+                while (clock::now() - start < std::chrono::milliseconds(20))
+                {
+                }
+                const double seconds = std::chrono::duration<double>(clock::now() - start).count();
+                return static_cast<double>(readTimestamp() - start_ticks) / seconds;
+            }();
+            return rate;
+#else
+            return 1e9;
+#endif
+        }
+
+        inline double timestampOverhead();
+
+        struct ProfileCounter
+        {
+            uint64_t calls = 0;
+            uint64_t timed_calls = 0;
+            uint64_t timed_ticks = 0;
+
+            // Time spent in all calls, extrapolated from the timed ones.
+            double estimatedTicks() const
+            {
+                if (!timed_calls)
+                    return 0.0;
+                const double ticks = static_cast<double>(timed_ticks) - timed_calls * timestampOverhead();
+                return ticks > 0.0 ? ticks * calls / timed_calls : 0.0;
+            }
+
+            double estimatedSeconds() const { return estimatedTicks() / timestampsPerSecond(); }
+
+            ProfileCounter &operator+=(const ProfileCounter &other)
+            {
+                calls += other.calls;
+                timed_calls += other.timed_calls;
+                timed_ticks += other.timed_ticks;
+                return *this;
+            }
+        };
+
+        // Counts a call and times one of every sample_interval calls, at offset phase. Scopes
+        // nested in another sampled scope with the same call rate take a different phase, so
+        // the outer samples don't include the inner ones' timestamp reads.
+        class ProfileScope
+        {
+        public:
+            ProfileScope(ProfileCounter &counter, uint32_t sample_interval, uint32_t phase = 0)
+                : m_counter(counter), m_timed(counter.calls++ % sample_interval == phase)
+            {
+                if (m_timed)
+                    m_start = readTimestamp();
+            }
+
+            ~ProfileScope()
+            {
+                if (m_timed)
+                {
+                    m_counter.timed_ticks += readTimestamp() - m_start;
+                    m_counter.timed_calls++;
+                }
+            }
+
+            ProfileScope(const ProfileScope &) = delete;
+            ProfileScope &operator=(const ProfileScope &) = delete;
+
+        private:
+            ProfileCounter &m_counter;
+            bool m_timed;
+            uint64_t m_start = 0;
+        };
+
+        // What a sampled scope around nothing reads, subtracted from every timed call: the hot
+        // paths are only a few times slower than the timestamp reads and branches themselves.
+        inline double timestampOverhead()
+        {
+            static const double overhead = []
+            {
+                ProfileCounter empty;
+                for (uint32_t i = 0; i < kProfileSampleInterval * 4096; ++i)
+                    ProfileScope scope(empty, kProfileSampleInterval);
+                return static_cast<double>(empty.timed_ticks) / empty.timed_calls;
+            }();
+            return overhead;
+        }
+
+        // Counters owned by each cynes::NES. Time is inclusive: step contains everything,
+        // and the PPU's time contains the mapper ticks it drives.
+        struct EmulatorProfile
+        {
+            ProfileCounter step;         // NES::step, every call timed
+            ProfileCounter instructions; // CPU::tick, counted only
+            ProfileCounter ppu;
+            ProfileCounter apu;
+            ProfileCounter mapper;
+        };
+
+        // Executed opcodes and program counter samples of one cynes::NES.
+        struct PcProfile
+        {
+            static constexpr uint16_t kNoPage = 0xFFFF; // PC outside the mapper (RAM, registers)
+
+            std::array<uint64_t, 256> opcodes{};
+            std::unordered_map<uint32_t, uint64_t> samples; // sampleKey(pc, page) -> samples
+            uint64_t num_samples = 0;
+
+            static uint32_t sampleKey(uint16_t pc, uint16_t page) { return static_cast<uint32_t>(page) << 16 | pc; }
+            static uint16_t samplePc(uint32_t key) { return static_cast<uint16_t>(key); }
+            static uint16_t samplePage(uint32_t key) { return static_cast<uint16_t>(key >> 16); }
+
+            // Sample intervals are drawn uniformly from [1, 2 * kPcSampleInterval) so short
+            // loops don't alias with a fixed stride.
+            bool sampleDue()
+            {
+                if (--m_countdown)
+                    return false;
+                m_rng ^= m_rng << 13;
+                m_rng ^= m_rng >> 17;
+                m_rng ^= m_rng << 5;
+                m_countdown = 1 + m_rng % (2 * kPcSampleInterval - 1);
+                return true;
+            }
+
+            void addSample(uint16_t pc, uint16_t page)
+            {
+                samples[sampleKey(pc, page)]++;
+                num_samples++;
+            }
+
+            void clear()
+            {
+                opcodes.fill(0);
+                samples.clear();
+                num_samples = 0;
+            }
+
+        private:
+            uint32_t m_countdown = kPcSampleInterval;
+            uint32_t m_rng = 0x9E3779B9;
+        };
+
+        // One line of a profile report.
+        struct ProfileEntry
+        {
+            std::string name;
+            uint64_t calls = 0;
+            double seconds = 0.0;
+        };
+    }
+}
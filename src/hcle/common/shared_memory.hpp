@@ -0,0 +1,146 @@
+#pragma once
+
+#if defined(_WIN32)
+#error "hcle/common/shared_memory.hpp requires a POSIX system."
+#endif
+
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <thread>
+#include <chrono>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if defined(__linux__)
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <ctime>
+#endif
+
+namespace hcle
+{
+    namespace common
+    {
+
+        // A named POSIX shared memory object mapped into this process. The creating side
+        // owns the name and unlinks it on destruction; other processes open it by name.
+        class SharedMemoryRegion
+        {
+        public:
+            // Creates a new region of the given size. Fails if the name is already in use.
+            SharedMemoryRegion(const std::string &name, size_t size)
+                : m_name(name), m_size(size), m_owner(true)
+            {
+                int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+                if (fd < 0)
+                    throw std::runtime_error("shm_open(" + name + ") failed: " + std::strerror(errno));
+                if (ftruncate(fd, static_cast<off_t>(size)) != 0)
+                {
+                    const int err = errno;
+                    close(fd);
+                    shm_unlink(name.c_str());
+                    throw std::runtime_error("ftruncate(" + name + ") failed: " + std::strerror(err));
+                }
+                map(fd);
+            }
+
+            // Opens an existing region created by another process.
+            explicit SharedMemoryRegion(const std::string &name)
+                : m_name(name), m_owner(false)
+            {
+                int fd = shm_open(name.c_str(), O_RDWR, 0600);
+                if (fd < 0)
+                    throw std::runtime_error("shm_open(" + name + ") failed: " + std::strerror(errno));
+                struct stat st;
+                if (fstat(fd, &st) != 0)
+                {
+                    const int err = errno;
+                    close(fd);
+                    throw std::runtime_error("fstat(" + name + ") failed: " + std::strerror(err));
+                }
+                m_size = static_cast<size_t>(st.st_size);
+                map(fd);
+            }
+
+            ~SharedMemoryRegion()
+            {
+                if (m_data)
+                    munmap(m_data, m_size);
+                if (m_owner)
+                    shm_unlink(m_name.c_str());
+            }
+
+            SharedMemoryRegion(const SharedMemoryRegion &) = delete;
+            SharedMemoryRegion &operator=(const SharedMemoryRegion &) = delete;
+
+            SharedMemoryRegion(SharedMemoryRegion &&other) noexcept
+                : m_name(std::move(other.m_name)),
+                  m_size(other.m_size),
+                  m_owner(std::exchange(other.m_owner, false)),
+                  m_data(std::exchange(other.m_data, nullptr)) {}
+
+            void *data() const { return m_data; }
+            size_t size() const { return m_size; }
+            const std::string &name() const { return m_name; }
+
+        private:
+            void map(int fd)
+            {
+                void *data = mmap(nullptr, m_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+                const int err = errno;
+                close(fd);
+                if (data == MAP_FAILED)
+                {
+                    if (m_owner)
+                        shm_unlink(m_name.c_str());
+                    throw std::runtime_error("mmap(" + m_name + ") failed: " + std::strerror(err));
+                }
+                m_data = data;
+            }
+
+            std::string m_name;
+            size_t m_size = 0;
+            bool m_owner;
+            void *m_data = nullptr;
+        };
+
+        static_assert(std::atomic<uint32_t>::is_always_lock_free,
+                      "Cross-process synchronisation needs lock-free 32-bit atomics.");
+
+        // Blocks while *word == expected, for at most timeout_ms. Like any futex wait it can
+        // return early, so callers re-check their condition in a loop. Uses a futex on Linux
+        // and falls back to a short sleep elsewhere.
+        inline void futexWait(std::atomic<uint32_t> *word, uint32_t expected, int timeout_ms)
+        {
+#if defined(__linux__)
+            struct timespec timeout;
+            timeout.tv_sec = timeout_ms / 1000;
+            timeout.tv_nsec = static_cast<long>(timeout_ms % 1000) * 1000000L;
+            syscall(SYS_futex, reinterpret_cast<uint32_t *>(word), FUTEX_WAIT, expected, &timeout, nullptr, 0);
+#else
+            if (word->load(std::memory_order_acquire) == expected)
+                std::this_thread::sleep_for(std::chrono::microseconds(50));
+            (void)timeout_ms;
+#endif
+        }
+
+        // Wakes every process blocked in futexWait() on word.
+        inline void futexWakeAll(std::atomic<uint32_t> *word)
+        {
+#if defined(__linux__)
+            syscall(SYS_futex, reinterpret_cast<uint32_t *>(word), FUTEX_WAKE, INT32_MAX, nullptr, nullptr, 0);
+#else
+            (void)word;
+#endif
+        }
+
+    } // namespace common
+} // namespace hcle
@@ -0,0 +1,255 @@
+#pragma once
+
+#if defined(_WIN32)
+#error "hcle/common/socket.hpp requires a POSIX system."
+#endif
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0 // macOS: rely on SO_NOSIGPIPE / ignoring SIGPIPE instead.
+#endif
+
+namespace hcle
+{
+    namespace common
+    {
+
+        // A connected or listening stream socket. Addresses are "unix:/path/to.sock" or
+        // "tcp:host:port" (the "tcp:" prefix is optional).
+        class Socket
+        {
+        public:
+            Socket() = default;
+            explicit Socket(int fd) : m_fd(fd) {}
+            ~Socket() { close(); }
+
+            Socket(const Socket &) = delete;
+            Socket &operator=(const Socket &) = delete;
+            Socket(Socket &&other) noexcept : m_fd(std::exchange(other.m_fd, -1)) {}
+            Socket &operator=(Socket &&other) noexcept
+            {
+                if (this != &other)
+                {
+                    close();
+                    m_fd = std::exchange(other.m_fd, -1);
+                }
+                return *this;
+            }
+
+            static Socket listen(const std::string &address, int backlog = 4)
+            {
+                std::string unix_path;
+                if (parseUnix(address, unix_path))
+                {
+                    Socket socket(::socket(AF_UNIX, SOCK_STREAM, 0));
+                    socket.check("socket");
+                    ::unlink(unix_path.c_str());
+                    sockaddr_un addr = unixAddress(unix_path);
+                    if (::bind(socket.m_fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0)
+                        throw error("bind(" + address + ")");
+                    if (::listen(socket.m_fd, backlog) != 0)
+                        throw error("listen(" + address + ")");
+                    return socket;
+                }
+
+                addrinfo *info = resolve(address, true);
+                Socket socket(::socket(info->ai_family, info->ai_socktype, info->ai_protocol));
+                const int one = 1;
+                if (socket.m_fd >= 0)
+                    ::setsockopt(socket.m_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+                const bool ok = socket.m_fd >= 0 && ::bind(socket.m_fd, info->ai_addr, info->ai_addrlen) == 0 &&
+                                ::listen(socket.m_fd, backlog) == 0;
+                const int err = errno;
+                freeaddrinfo(info);
+                if (!ok)
+                {
+                    errno = err;
+                    throw error("listen(" + address + ")");
+                }
+                return socket;
+            }
+
+            static Socket connect(const std::string &address)
+            {
+                std::string unix_path;
+                if (parseUnix(address, unix_path))
+                {
+                    Socket socket(::socket(AF_UNIX, SOCK_STREAM, 0));
+                    socket.check("socket");
+                    sockaddr_un addr = unixAddress(unix_path);
+                    if (::connect(socket.m_fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0)
+                        throw error("connect(" + address + ")");
+                    return socket;
+                }
+
+                addrinfo *info = resolve(address, false);
+                Socket socket(::socket(info->ai_family, info->ai_socktype, info->ai_protocol));
+                const bool ok = socket.m_fd >= 0 && ::connect(socket.m_fd, info->ai_addr, info->ai_addrlen) == 0;
+                const int err = errno;
+                freeaddrinfo(info);
+                if (!ok)
+                {
+                    errno = err;
+                    throw error("connect(" + address + ")");
+                }
+                socket.setNoDelay();
+                return socket;
+            }
+
+            Socket accept()
+            {
+                int fd;
+                do
+                {
+                    fd = ::accept(m_fd, nullptr, nullptr);
+                } while (fd < 0 && errno == EINTR);
+                Socket socket(fd);
+                socket.check("accept");
+                socket.setNoDelay();
+                return socket;
+            }
+
+            void sendAll(const void *data, size_t size)
+            {
+                const auto *bytes = static_cast<const uint8_t *>(data);
+                while (size > 0)
+                {
+                    const ssize_t sent = ::send(m_fd, bytes, size, MSG_NOSIGNAL);
+                    if (sent < 0)
+                    {
+                        if (errno == EINTR)
+                            continue;
+                        throw error("send");
+                    }
+                    bytes += sent;
+                    size -= static_cast<size_t>(sent);
+                }
+            }
+
+            // Reads exactly size bytes. Returns false if the peer closed the connection before
+            // the first byte; a close part-way through is an error.
+            bool recvAll(void *data, size_t size)
+            {
+                auto *bytes = static_cast<uint8_t *>(data);
+                size_t received = 0;
+                while (received < size)
+                {
+                    const ssize_t n = ::recv(m_fd, bytes + received, size - received, 0);
+                    if (n < 0)
+                    {
+                        if (errno == EINTR)
+                            continue;
+                        throw error("recv");
+                    }
+                    if (n == 0)
+                    {
+                        if (received == 0)
+                            return false;
+                        throw std::runtime_error("Connection closed mid-message.");
+                    }
+                    received += static_cast<size_t>(n);
+                }
+                return true;
+            }
+
+            // True if a recv() would not block: data has arrived or the peer has closed.
+            bool isReadable() const
+            {
+                pollfd entry{m_fd, POLLIN, 0};
+                int ready;
+                do
+                {
+                    ready = ::poll(&entry, 1, 0);
+                } while (ready < 0 && errno == EINTR);
+                if (ready < 0)
+                    throw error("poll");
+                return ready > 0;
+            }
+
+            void close()
+            {
+                if (m_fd >= 0)
+                {
+                    ::close(m_fd);
+                    m_fd = -1;
+                }
+            }
+
+            bool isOpen() const { return m_fd >= 0; }
+
+        private:
+            static bool parseUnix(const std::string &address, std::string &path)
+            {
+                if (address.rfind("unix:", 0) != 0)
+                    return false;
+                path = address.substr(5);
+                return true;
+            }
+
+            static sockaddr_un unixAddress(const std::string &path)
+            {
+                sockaddr_un addr{};
+                addr.sun_family = AF_UNIX;
+                if (path.size() >= sizeof(addr.sun_path))
+                    throw std::invalid_argument("Unix socket path is too long: " + path);
+                std::strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+                return addr;
+            }
+
+            static addrinfo *resolve(std::string address, bool passive)
+            {
+                if (address.rfind("tcp:", 0) == 0)
+                    address = address.substr(4);
+                const size_t colon = address.rfind(':');
+                if (colon == std::string::npos)
+                    throw std::invalid_argument("Expected host:port, got '" + address + "'.");
+                const std::string host = address.substr(0, colon);
+                const std::string port = address.substr(colon + 1);
+
+                addrinfo hints{};
+                hints.ai_family = AF_UNSPEC;
+                hints.ai_socktype = SOCK_STREAM;
+                hints.ai_flags = passive ? AI_PASSIVE : 0;
+                addrinfo *info = nullptr;
+                const int rc = getaddrinfo(host.empty() ? nullptr : host.c_str(), port.c_str(), &hints, &info);
+                if (rc != 0)
+                    throw std::runtime_error("Could not resolve '" + address + "': " + gai_strerror(rc));
+                return info;
+            }
+
+            static std::runtime_error error(const std::string &what)
+            {
+                return std::runtime_error(what + " failed: " + std::strerror(errno));
+            }
+
+            void check(const char *what) const
+            {
+                if (m_fd < 0)
+                    throw error(what);
+            }
+
+            void setNoDelay()
+            {
+                const int one = 1;
+                ::setsockopt(m_fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one)); // Fails harmlessly on Unix sockets.
+            }
+
+            int m_fd = -1;
+        };
+
+    } // namespace common
+} // namespace hcle
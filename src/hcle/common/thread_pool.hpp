@@ -0,0 +1,272 @@
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <exception>
+#include <algorithm>
+#include <cstdlib>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+#include "hcle/common/trace.hpp"
+
+namespace hcle
+{
+    namespace common
+    {
+
+        // Process-wide worker pool shared by every vectorizer and parallel state operation.
+        // Work is submitted through a Client; the pool round-robins between clients that
+        // have pending work, so one busy vectorizer can't starve another, and never runs
+        // more than getNumThreads() tasks at once.
+        class ThreadPool
+        {
+            struct ClientQueue
+            {
+                std::deque<std::function<void()>> tasks;
+                size_t in_flight = 0;
+                bool scheduled = false;
+                std::exception_ptr error;
+                std::condition_variable idle;
+            };
+
+        public:
+            class Client
+            {
+            public:
+                explicit Client(ThreadPool &pool = ThreadPool::instance())
+                    : m_pool(pool), m_queue(std::make_unique<ClientQueue>()) {}
+
+                ~Client()
+                {
+                    std::unique_lock<std::mutex> lock(m_pool.m_mutex);
+                    m_queue->idle.wait(lock, [this]
+                                       { return isIdle(); });
+                }
+
+                Client(const Client &) = delete;
+                Client &operator=(const Client &) = delete;
+
+                void submit(std::function<void()> task)
+                {
+                    std::unique_lock<std::mutex> lock(m_pool.m_mutex);
+                    m_queue->tasks.push_back(std::move(task));
+                    m_pool.schedule(m_queue.get());
+                    m_pool.m_cond.notify_one();
+                }
+
+                // Blocks until every task submitted by this client has finished, then
+                // rethrows the first exception raised by any of them.
+                void wait()
+                {
+                    std::unique_lock<std::mutex> lock(m_pool.m_mutex);
+                    m_queue->idle.wait(lock, [this]
+                                       { return isIdle(); });
+                    if (m_queue->error)
+                    {
+                        std::exception_ptr error = std::exchange(m_queue->error, nullptr);
+                        std::rethrow_exception(error);
+                    }
+                }
+
+                // Runs fn(0) ... fn(count - 1) on the pool and waits for all of them.
+                void parallelFor(int count, const std::function<void(int)> &fn)
+                {
+                    for (int i = 0; i < count; ++i)
+                    {
+                        submit([&fn, i]
+                               { fn(i); });
+                    }
+                    wait();
+                }
+
+            private:
+                bool isIdle() const { return m_queue->tasks.empty() && m_queue->in_flight == 0; }
+
+                ThreadPool &m_pool;
+                std::unique_ptr<ClientQueue> m_queue;
+            };
+
+            // The shared instance. Its size defaults to the HCLE_NUM_THREADS environment
+            // variable, falling back to std::thread::hardware_concurrency().
+            static ThreadPool &instance()
+            {
+                static ThreadPool pool(defaultNumThreads());
+                return pool;
+            }
+
+            explicit ThreadPool(int num_threads) { start(num_threads); }
+
+            ~ThreadPool() { stop(); }
+
+            ThreadPool(const ThreadPool &) = delete;
+            ThreadPool &operator=(const ThreadPool &) = delete;
+
+            // Changes the hard cap on worker threads. Running tasks finish first; queued
+            // tasks are kept and picked up by the new workers. Must not be called from a
+            // task, which would wait for its own worker to exit.
+            void setNumThreads(int num_threads)
+            {
+                if (num_threads <= 0)
+                    throw std::invalid_argument("Number of threads must be positive.");
+                if (isWorkerThread())
+                    throw std::logic_error("setNumThreads() cannot be called from a pool task.");
+
+                std::unique_lock<std::mutex> resize_lock(m_resize_mutex);
+                if (num_threads == getNumThreads())
+                    return;
+                stop();
+                start(num_threads);
+            }
+
+            // Joins every worker and spawns the same number of new threads, for tools whose
+            // per-thread state is only inherited at thread creation (hcle_bench's perf counters).
+            // The pool is shared by every vectorizer in the process, so all of them stall while
+            // running tasks finish; queued tasks wait for the new workers. Must not be called
+            // from a task.
+            void respawnWorkers()
+            {
+                if (isWorkerThread())
+                    throw std::logic_error("respawnWorkers() cannot be called from a pool task.");
+
+                std::unique_lock<std::mutex> resize_lock(m_resize_mutex);
+                const int num_threads = getNumThreads();
+                stop();
+                start(num_threads);
+            }
+
+            // True on the pool's own worker threads.
+            bool isWorkerThread() const { return t_worker_pool == this; }
+
+            int getNumThreads() const
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                return m_num_threads;
+            }
+
+            static int defaultNumThreads()
+            {
+                if (const char *env_threads = std::getenv("HCLE_NUM_THREADS"))
+                {
+                    try
+                    {
+                        int num_threads = std::stoi(env_threads);
+                        if (num_threads > 0)
+                            return num_threads;
+                    }
+                    catch (const std::exception &)
+                    {
+                    }
+                }
+                return std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+            }
+
+        private:
+            void start(int num_threads)
+            {
+                {
+                    std::unique_lock<std::mutex> lock(m_mutex);
+                    m_stop = false;
+                    m_num_threads = num_threads;
+                }
+                m_workers.reserve(num_threads);
+                for (int i = 0; i < num_threads; ++i)
+                {
+                    m_workers.emplace_back([this, i]
+                                           {
+                                               t_worker_pool = this;
+                                               Tracer::instance().setThreadName("pool worker " + std::to_string(i));
+                                               workerFunction(); });
+                }
+            }
+
+            void stop()
+            {
+                {
+                    std::unique_lock<std::mutex> lock(m_mutex);
+                    m_stop = true;
+                }
+                m_cond.notify_all();
+                for (auto &worker : m_workers)
+                {
+                    if (worker.joinable())
+                    {
+                        worker.join();
+                    }
+                }
+                m_workers.clear();
+            }
+
+            // Must be called with m_mutex held.
+            void schedule(ClientQueue *queue)
+            {
+                if (!queue->scheduled)
+                {
+                    queue->scheduled = true;
+                    m_ready.push_back(queue);
+                }
+            }
+
+            void workerFunction()
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                while (true)
+                {
+                    m_cond.wait(lock, [this]
+                                { return m_stop || !m_ready.empty(); });
+                    if (m_stop)
+                        break;
+
+                    // Take one task from the client at the front, then rotate it to the
+                    // back so every client with pending work gets a turn.
+                    ClientQueue *queue = m_ready.front();
+                    m_ready.pop_front();
+                    std::function<void()> task = std::move(queue->tasks.front());
+                    queue->tasks.pop_front();
+                    queue->scheduled = false;
+                    if (!queue->tasks.empty())
+                    {
+                        schedule(queue);
+                        m_cond.notify_one();
+                    }
+                    queue->in_flight++;
+
+                    lock.unlock();
+                    std::exception_ptr error;
+                    try
+                    {
+                        task();
+                    }
+                    catch (...)
+                    {
+                        error = std::current_exception();
+                    }
+                    lock.lock();
+
+                    if (error && !queue->error)
+                        queue->error = error;
+                    queue->in_flight--;
+                    if (queue->tasks.empty() && queue->in_flight == 0)
+                        queue->idle.notify_all();
+                }
+            }
+
+            static inline thread_local const ThreadPool *t_worker_pool = nullptr;
+
+            mutable std::mutex m_mutex;
+            std::mutex m_resize_mutex;
+            std::condition_variable m_cond;
+            std::deque<ClientQueue *> m_ready;
+            std::vector<std::thread> m_workers;
+            int m_num_threads = 0;
+            bool m_stop = false;
+        };
+
+    } // namespace common
+} // namespace hcle
@@ -3,6 +3,8 @@
 #include <queue>
 #include <mutex>
 #include <condition_variable>
+#include <span>
+#include <cstddef>
 
 namespace hcle
 {
@@ -20,6 +22,17 @@ namespace hcle
                 m_cond.notify_one();
             }
 
+            // Enqueues every item under a single lock. Doesn't wake pop(): bulk consumers
+            // poll with try_pop_bulk().
+            void push_bulk(std::span<const T> items)
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                for (const T &item : items)
+                {
+                    m_queue.push(item);
+                }
+            }
+
             T pop()
             {
                 std::unique_lock<std::mutex> lock(m_mutex);
@@ -30,6 +43,20 @@ namespace hcle
                 return item;
             }
 
+            // Moves up to out.size() items into out without blocking. Returns the number
+            // of items taken, 0 if the queue is empty.
+            size_t try_pop_bulk(std::span<T> out)
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                size_t count = 0;
+                while (count < out.size() && !m_queue.empty())
+                {
+                    out[count++] = std::move(m_queue.front());
+                    m_queue.pop();
+                }
+                return count;
+            }
+
         private:
             std::queue<T> m_queue;
             std::mutex m_mutex;
@@ -0,0 +1,253 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace hcle
+{
+    namespace common
+    {
+
+        // Process-wide event timeline of the vectorizers and their pool workers, written as
+        // Chrome trace JSON (chrome://tracing or ui.perfetto.dev).
+        //
+        // Every thread records into its own fixed-size ring without locking; a full ring
+        // overwrites its oldest events. A thread's ring is released when it exits: its events
+        // stay until the next start(), and a new thread with the same name (e.g. the same pool
+        // worker slot after a restart) continues it. While tracing is off a trace point costs
+        // one relaxed atomic load. start(), stop() and writeChromeTrace() should be called
+        // between batches, when no worker is recording.
+        class Tracer
+        {
+        public:
+            struct Event
+            {
+                const char *name;     // String literal
+                uint64_t start_ns;    // steady_clock
+                uint64_t duration_ns; // 0 for instant events
+                int32_t env_id;       // -1 if not about one env
+                int32_t vectorizer_id;
+                int32_t value; // Event-specific count, -1 if unused
+            };
+
+            static Tracer &instance()
+            {
+                static Tracer tracer;
+                return tracer;
+            }
+
+            static uint64_t now()
+            {
+                return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                                 std::chrono::steady_clock::now().time_since_epoch())
+                                                 .count());
+            }
+
+            // Clears the rings of live threads, frees those of exited ones and starts recording
+            // with room for events_per_thread each.
+            void start(size_t events_per_thread = size_t{1} << 16)
+            {
+                if (events_per_thread == 0)
+                    throw std::invalid_argument("events_per_thread must be positive.");
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_capacity = events_per_thread;
+                std::erase_if(m_rings, [](const std::unique_ptr<Ring> &ring)
+                              { return !ring->live; });
+                for (auto &ring : m_rings)
+                {
+                    ring->events.assign(m_capacity, Event{});
+                    ring->written.store(0, std::memory_order_relaxed);
+                }
+                m_start_ns = now();
+                m_enabled.store(true, std::memory_order_release);
+            }
+
+            // Stops recording; the recorded events stay available to writeChromeTrace().
+            void stop() { m_enabled.store(false, std::memory_order_release); }
+
+            bool isEnabled() const { return m_enabled.load(std::memory_order_relaxed); }
+
+            void record(const char *name, uint64_t start_ns, uint64_t duration_ns, int env_id = -1,
+                        int vectorizer_id = -1, int value = -1)
+            {
+                if (!isEnabled())
+                    return;
+                Ring &ring = threadRing();
+                if (ring.events.empty())
+                    return;
+                const uint64_t index = ring.written.load(std::memory_order_relaxed);
+                ring.events[index % ring.events.size()] = {name, start_ns, duration_ns, env_id, vectorizer_id, value};
+                ring.written.store(index + 1, std::memory_order_release);
+            }
+
+            void instant(const char *name, int env_id = -1, int vectorizer_id = -1, int value = -1)
+            {
+                if (isEnabled())
+                    record(name, now(), 0, env_id, vectorizer_id, value);
+            }
+
+            // Names the calling thread's track in the trace. Call it before the thread records
+            // anything to continue the released ring of an exited thread of the same name.
+            void setThreadName(const std::string &name)
+            {
+                Ring &ring = threadRing(&name);
+                std::unique_lock<std::mutex> lock(m_mutex);
+                ring.name = name;
+            }
+
+            // Writes the retained events of every thread; returns how many were written.
+            size_t writeChromeTrace(const std::string &path)
+            {
+                std::ofstream out(path);
+                if (!out)
+                    throw std::runtime_error("Cannot open " + path + " for writing.");
+
+                std::unique_lock<std::mutex> lock(m_mutex);
+                size_t num_events = 0;
+                char line[256];
+                out << "{\"displayTimeUnit\": \"ns\", \"traceEvents\": [\n";
+                for (size_t t = 0; t < m_rings.size(); ++t)
+                {
+                    const Ring &ring = *m_rings[t];
+                    std::snprintf(line, sizeof(line),
+                                  "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": %zu, \"args\": {\"name\": \"%s\"}}",
+                                  t, ring.name.c_str());
+                    out << (t ? ",\n" : "") << line;
+
+                    const uint64_t written = ring.written.load(std::memory_order_acquire);
+                    const uint64_t first = written > ring.events.size() ? written - ring.events.size() : 0;
+                    for (uint64_t i = first; i < written; ++i)
+                    {
+                        const Event &event = ring.events[i % ring.events.size()];
+                        if (event.start_ns < m_start_ns)
+                            continue;
+                        const double ts = (event.start_ns - m_start_ns) / 1e3;
+                        int length = event.duration_ns
+                                         ? std::snprintf(line, sizeof(line),
+                                                         ",\n{\"name\": \"%s\", \"ph\": \"X\", \"ts\": %.3f, \"dur\": %.3f, \"pid\": 1, \"tid\": %zu",
+                                                         event.name, ts, event.duration_ns / 1e3, t)
+                                         : std::snprintf(line, sizeof(line),
+                                                         ",\n{\"name\": \"%s\", \"ph\": \"i\", \"s\": \"t\", \"ts\": %.3f, \"pid\": 1, \"tid\": %zu",
+                                                         event.name, ts, t);
+                        out.write(line, length);
+                        length = std::snprintf(line, sizeof(line), ", \"args\": {\"vectorizer\": %d, \"env\": %d, \"value\": %d}}",
+                                               event.vectorizer_id, event.env_id, event.value);
+                        out.write(line, length);
+                        num_events++;
+                    }
+                }
+                out << "\n]}\n";
+                if (!out)
+                    throw std::runtime_error("Failed to write " + path + ".");
+                return num_events;
+            }
+
+        private:
+            struct Ring
+            {
+                std::vector<Event> events;
+                std::atomic<uint64_t> written{0};
+                std::string name;
+                bool live = true; // Owned by a running thread
+            };
+
+            // The calling thread's ring, handed back to the tracer when the thread exits.
+            struct RingLease
+            {
+                Ring *ring = nullptr;
+
+                ~RingLease()
+                {
+                    if (ring)
+                        Tracer::instance().releaseRing(*ring);
+                }
+            };
+
+            Tracer() = default;
+
+            // Takes a released ring of the same name, else one that holds no events, else a new one.
+            Ring &threadRing(const std::string *name = nullptr)
+            {
+                thread_local RingLease lease;
+                if (!lease.ring)
+                {
+                    std::unique_lock<std::mutex> lock(m_mutex);
+                    size_t index = m_rings.size();
+                    for (size_t i = 0; i < m_rings.size(); ++i)
+                    {
+                        const Ring &ring = *m_rings[i];
+                        if (ring.live)
+                            continue;
+                        if (name && ring.name == *name)
+                        {
+                            index = i;
+                            break;
+                        }
+                        if (index == m_rings.size() && ring.written.load(std::memory_order_relaxed) == 0)
+                            index = i;
+                    }
+                    if (index == m_rings.size())
+                    {
+                        m_rings.push_back(std::make_unique<Ring>());
+                        m_rings.back()->events.resize(m_capacity);
+                    }
+                    Ring &ring = *m_rings[index];
+                    if (!name || ring.name != *name)
+                        ring.name = "thread " + std::to_string(index);
+                    ring.live = true;
+                    lease.ring = &ring;
+                }
+                return *lease.ring;
+            }
+
+            void releaseRing(Ring &ring)
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                ring.live = false;
+            }
+
+            std::atomic<bool> m_enabled{false};
+            std::mutex m_mutex;
+            std::vector<std::unique_ptr<Ring>> m_rings; // Only start() drops rings, and only released ones
+            size_t m_capacity = 0;
+            uint64_t m_start_ns = 0;
+        };
+
+        // Records the enclosing scope as one complete event, if tracing is on when it starts.
+        class TraceScope
+        {
+        public:
+            TraceScope(const char *name, int env_id = -1, int vectorizer_id = -1, int value = -1)
+                : m_name(name), m_env_id(env_id), m_vectorizer_id(vectorizer_id), m_value(value),
+                  m_start(Tracer::instance().isEnabled() ? Tracer::now() : 0)
+            {
+            }
+
+            ~TraceScope()
+            {
+                if (m_start)
+                    Tracer::instance().record(m_name, m_start, std::max<uint64_t>(Tracer::now() - m_start, 1),
+                                              m_env_id, m_vectorizer_id, m_value);
+            }
+
+            TraceScope(const TraceScope &) = delete;
+            TraceScope &operator=(const TraceScope &) = delete;
+
+        private:
+            const char *m_name;
+            int m_env_id;
+            int m_vectorizer_id;
+            int m_value;
+            uint64_t m_start;
+        };
+    }
+}
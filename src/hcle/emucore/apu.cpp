@@ -104,6 +104,9 @@ void cynes::APU::tick(bool reading, bool prevent_load) {
         perform_pending_dma();
     }
 
+    // After the DMA, whose bus cycles are accounted to the components they tick.
+    HCLE_PROFILE_SAMPLED(_nes.profile.apu);
+
     _latch_cycle = !_latch_cycle;
 
     if (_step_mode) {
@@ -115,8 +115,14 @@ void cynes::CPU::tick()
         return;
     }
 
+    HCLE_PROFILE_COUNT(_nes.profile.instructions);
+    HCLE_TRACE_INSTRUCTION(_nes.bus_trace, _program_counter);
+
     uint8_t instruction = fetch_next();
 
+    HCLE_PROFILE_PC(_nes.pc_profile, static_cast<uint16_t>(_program_counter - 1), instruction,
+                    _nes.get_cpu_page(static_cast<uint16_t>(_program_counter - 1)));
+
     (this->*ADDRESSING_MODES[instruction])();
     (this->*INSTRUCTIONS[instruction])();
 
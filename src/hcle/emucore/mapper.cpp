@@ -135,7 +135,7 @@ std::unique_ptr<cynes::Mapper> cynes::Mapper::load_mapper(
     } else {
         metadata.size_chr = 8;
         metadata.read_only_chr = false;
-        metadata.memory_chr.reset(new uint8_t[0x2000]);
+        metadata.memory_chr.reset(new uint8_t[0x2000]{});
     }
 
     stream.close();
@@ -208,6 +208,16 @@ uint8_t cynes::Mapper::read_ppu(uint16_t address) {
     return _memory[bank.offset + (address & 0x3FF)];
 }
 
+uint16_t cynes::Mapper::get_cpu_page(uint16_t address) const {
+    const auto& bank = _banks_cpu[address >> 10];
+
+    if (!bank.mapped) {
+        return 0xFFFF;
+    }
+
+    return static_cast<uint16_t>(bank.offset >> 10);
+}
+
 void cynes::Mapper::map_bank_prg(uint8_t page, uint16_t address) {
     _banks_cpu[page] = {
         static_cast<size_t>(address << 10),
@@ -90,6 +90,21 @@ public:
     /// @return The value stored at the given address.
     virtual uint8_t read_ppu(uint16_t address);
 
+    /// Get the mapper memory page a CPU address is currently mapped to.
+    /// @param address Memory address within the console memory address space.
+    /// @return Index of the 1 KiB page within the mapper memory (PRG ROM pages come
+    /// first), or 0xFFFF if the address is unmapped.
+    uint16_t get_cpu_page(uint16_t address) const;
+
+    /// Get the number of 1 KiB PRG ROM pages.
+    inline uint16_t get_prg_pages() const { return _banks_prg; }
+
+    /// Size, save or load the state of the actual mapper, registers of the derived
+    /// mapper included. dump() is not virtual, so the emulator goes through these.
+    virtual void dump_size(unsigned int& buffer) { dump<DumpOperation::SIZE>(buffer); }
+    virtual void dump_save(uint8_t*& buffer) { dump<DumpOperation::DUMP>(buffer); }
+    virtual void dump_load(uint8_t*& buffer) { dump<DumpOperation::LOAD>(buffer); }
+
 protected:
     /// A memory bank provides a view within the mapper memory.
     // Each bank is exactly 0x400 bytes large.
@@ -232,6 +247,10 @@ public:
         cynes::dump<operation>(buffer, _register);
         cynes::dump<operation>(buffer, _counter);
     }
+
+    virtual void dump_size(unsigned int& buffer) { dump<DumpOperation::SIZE>(buffer); }
+    virtual void dump_save(uint8_t*& buffer) { dump<DumpOperation::DUMP>(buffer); }
+    virtual void dump_load(uint8_t*& buffer) { dump<DumpOperation::LOAD>(buffer); }
 };
 
 
@@ -341,6 +360,10 @@ public:
         cynes::dump<operation>(buffer, _enable_interrupt);
         cynes::dump<operation>(buffer, _should_reload_interrupt);
     }
+
+    virtual void dump_size(unsigned int& buffer) { dump<DumpOperation::SIZE>(buffer); }
+    virtual void dump_save(uint8_t*& buffer) { dump<DumpOperation::DUMP>(buffer); }
+    virtual void dump_load(uint8_t*& buffer) { dump<DumpOperation::LOAD>(buffer); }
 };
 
 
@@ -455,6 +478,10 @@ public:
         cynes::dump<operation>(buffer, _latches);
         cynes::dump<operation>(buffer, _selected_banks);
     }
+
+    virtual void dump_size(unsigned int& buffer) { dump<DumpOperation::SIZE>(buffer); }
+    virtual void dump_save(uint8_t*& buffer) { dump<DumpOperation::DUMP>(buffer); }
+    virtual void dump_load(uint8_t*& buffer) { dump<DumpOperation::LOAD>(buffer); }
 };
 
 using MMC2 = MMC<0x08>;
@@ -57,6 +57,7 @@ void cynes::NES::dummy_read()
     apu.tick(true);
     ppu.tick();
     ppu.tick();
+    HCLE_TRACE_BUS(bus_trace, hcle::common::BusAccess::DUMMY, 0, _open_bus, ppu.get_current_x(), ppu.get_current_y());
     ppu.tick();
     cpu.poll();
 }
@@ -67,6 +68,7 @@ void cynes::NES::write(uint16_t address, uint8_t value)
     ppu.tick();
     ppu.tick();
 
+    HCLE_TRACE_BUS(bus_trace, hcle::common::BusAccess::WRITE, address, value, ppu.get_current_x(), ppu.get_current_y());
     write_cpu(address, value);
 
     ppu.tick();
@@ -145,6 +147,7 @@ uint8_t cynes::NES::read(uint16_t address)
     ppu.tick();
 
     _open_bus = read_cpu(address);
+    HCLE_TRACE_BUS(bus_trace, hcle::common::BusAccess::READ, address, _open_bus, ppu.get_current_x(), ppu.get_current_y());
 
     ppu.tick();
     cpu.poll();
@@ -218,6 +221,8 @@ uint8_t cynes::NES::get_open_bus() const
 
 bool cynes::NES::step(uint16_t controllers, unsigned int frames)
 {
+    HCLE_PROFILE_SCOPE(profile.step);
+
     _controller_status[0x0] = controllers & 0xFF;
     _controller_status[0x1] = controllers >> 8;
 
@@ -238,6 +243,14 @@ bool cynes::NES::step(uint16_t controllers, unsigned int frames)
     return false;
 }
 
+uint64_t cynes::NES::hash_state() const
+{
+    uint64_t hash = hash_bytes(HASH_SEED, _memory_cpu.get(), 0x800);
+    hash = hash_bytes(hash, _memory_oam.get(), 0x100);
+    hash = hash_bytes(hash, _memory_palette.get(), 0x20);
+    return ppu.hash_state(hash);
+}
+
 unsigned int cynes::NES::size()
 {
     unsigned int buffer_size = 0;
@@ -256,6 +269,15 @@ void cynes::NES::load(uint8_t *buffer)
     dump<DumpOperation::LOAD>(buffer);
 }
 
+uint16_t cynes::NES::get_cpu_page(uint16_t address) const
+{
+    if (address < 0x4018)
+    {
+        return hcle::common::PcProfile::kNoPage;
+    }
+    return _mapper->get_cpu_page(address);
+}
+
 cynes::Mapper &cynes::NES::get_mapper()
 {
     return static_cast<Mapper &>(*_mapper.get());
@@ -285,7 +307,18 @@ void cynes::NES::dump(T &buffer)
     ppu.dump<operation>(buffer);
     apu.dump<operation>(buffer);
 
-    _mapper->dump<operation>(buffer);
+    if constexpr (operation == DumpOperation::SIZE)
+    {
+        _mapper->dump_size(buffer);
+    }
+    else if constexpr (operation == DumpOperation::DUMP)
+    {
+        _mapper->dump_save(buffer);
+    }
+    else
+    {
+        _mapper->dump_load(buffer);
+    }
 
     cynes::dump<operation>(buffer, _memory_cpu.get(), 0x800);
     cynes::dump<operation>(buffer, _memory_oam.get(), 0x100);
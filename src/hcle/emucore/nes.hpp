@@ -4,7 +4,9 @@
 #include <cstdint>
 #include <memory>
 
+#include "hcle/common/bus_trace.hpp"
 #include "hcle/common/display.hpp"
+#include "hcle/common/profiling.hpp"
 
 #include "apu.hpp"
 #include "cpu.hpp"
@@ -121,6 +123,11 @@ namespace cynes
         /// @param buffer Save state buffer.
         void load(uint8_t *buffer);
 
+        /// Hash the CPU RAM, OAM, palette memory and key PPU state, to check that two
+        /// runs of the emulator stayed in sync. The frame buffer is not included.
+        /// @return 64-bit FNV-1a hash of the state.
+        uint64_t hash_state() const;
+
         /// Get a pointer to the internal frame buffer.
         inline const uint8_t *get_frame_buffer() const
         {
@@ -132,6 +139,21 @@ namespace cynes
         PPU ppu;
         APU apu;
 
+        /// Per-component call counts and time, only updated in HCLE_ENABLE_PROFILING builds.
+        hcle::common::EmulatorProfile profile;
+
+        /// Opcode counts and program counter samples, only updated in HCLE_ENABLE_PC_PROFILING builds.
+        hcle::common::PcProfile pc_profile;
+
+        /// Ring of CPU bus accesses, only recorded in HCLE_ENABLE_BUS_TRACE builds.
+        hcle::common::BusTrace bus_trace;
+
+        /// Get the 1 KiB mapper memory page a CPU address currently reads from.
+        /// @param address Memory address within the console memory map.
+        /// @return Page index within the mapper memory, or `PcProfile::kNoPage` if the
+        /// address is not served by the mapper.
+        uint16_t get_cpu_page(uint16_t address) const;
+
         Mapper &get_mapper();
 
     private:
@@ -62,7 +62,7 @@ static constexpr uint8_t REVERSE_BYTE_LOOKUP[256] = {
 static constexpr uint8_t DECAY_MASKS[] = {0x3F, 0xDF, 0xE0};
 
 cynes::PPU::PPU(NES &nes)
-    : _nes{nes}, _frame_buffer{new uint8_t[0x2D000]}, _current_x{0x0000}, _current_y{0x0000}, _rendering_enabled{false}, _rendering_enabled_delayed{false}, _prevent_vertical_blank{false}, _control_increment_mode{false}, _control_foreground_table{false}, _control_background_table{false}, _control_foreground_large{false}, _control_interrupt_on_vertical_blank{false}, _mask_grayscale_mode{false}, _mask_render_background_left{false}, _mask_render_foreground_left{false}, _mask_render_background{false}, _mask_render_foreground{false}, _mask_color_emphasize{0x00}, _status_sprite_overflow{false}, _status_sprite_zero_hit{false}, _status_vertical_blank{false}, _clock_decays{}, _register_decay{0x00}, _latch_cycle{false}, _latch_address{false}, _register_t{0x0000}, _register_v{0x0000}, _delayed_register_v{0x0000}, _scroll_x{0x00}, _delay_data_read_counter{0x00}, _delay_data_write_counter{0x00}, _buffer_data{0x00}, _background_data{}, _background_shifter{}, _foreground_data{}, _foreground_shifter{}, _foreground_attributes{}, _foreground_positions{}, _foreground_data_pointer{0x00}, _foreground_sprite_count{0x00}, _foreground_sprite_count_next{0x00}, _foreground_sprite_pointer{0x00}, _foreground_read_delay_counter{0x00}, _foreground_sprite_address{0x0000}, _foreground_sprite_zero_line{false}, _foreground_sprite_zero_should{false}, _foreground_sprite_zero_hit{false}, _foreground_evaluation_step{SpriteEvaluationStep::LOAD_SECONDARY_OAM}
+    : _nes{nes}, _frame_buffer{new uint8_t[0x2D000]}, _current_x{0x0000}, _current_y{0x0000}, _frame_ready{false}, _rendering_enabled{false}, _rendering_enabled_delayed{false}, _prevent_vertical_blank{false}, _control_increment_mode{false}, _control_foreground_table{false}, _control_background_table{false}, _control_foreground_large{false}, _control_interrupt_on_vertical_blank{false}, _mask_grayscale_mode{false}, _mask_render_background_left{false}, _mask_render_foreground_left{false}, _mask_render_background{false}, _mask_render_foreground{false}, _mask_color_emphasize{0x00}, _status_sprite_overflow{false}, _status_sprite_zero_hit{false}, _status_vertical_blank{false}, _clock_decays{}, _register_decay{0x00}, _latch_cycle{false}, _latch_address{false}, _register_t{0x0000}, _register_v{0x0000}, _delayed_register_v{0x0000}, _scroll_x{0x00}, _delay_data_read_counter{0x00}, _delay_data_write_counter{0x00}, _buffer_data{0x00}, _background_data{}, _background_shifter{}, _foreground_data{}, _foreground_shifter{}, _foreground_attributes{}, _foreground_positions{}, _foreground_data_pointer{0x00}, _foreground_sprite_count{0x00}, _foreground_sprite_count_next{0x00}, _foreground_sprite_pointer{0x00}, _foreground_read_delay_counter{0x00}, _foreground_sprite_address{0x0000}, _foreground_sprite_zero_line{false}, _foreground_sprite_zero_should{false}, _foreground_sprite_zero_hit{false}, _foreground_evaluation_step{SpriteEvaluationStep::LOAD_SECONDARY_OAM}
 {
     std::memset(_clock_decays, 0x00, 0x3);
     std::memset(_background_data, 0x00, 0x4);
@@ -296,7 +296,10 @@ void cynes::PPU::tick_no_draw()
         _register_t = _register_v;
     }
 
-    _nes.get_mapper().tick();
+    {
+        HCLE_PROFILE_SAMPLED_NESTED(_nes.profile.mapper);
+        _nes.get_mapper().tick();
+    }
 }
 
 void cynes::PPU::set_render_skip(bool skip)
@@ -304,8 +307,30 @@ void cynes::PPU::set_render_skip(bool skip)
     _render_skip = skip;
 }
 
+uint64_t cynes::PPU::hash_state(uint64_t hash) const
+{
+    const uint16_t position[2] = {_current_x, _current_y};
+    const uint16_t registers[3] = {_register_t, _register_v, _delayed_register_v};
+    const bool flags[] = {
+        _rendering_enabled, _rendering_enabled_delayed, _prevent_vertical_blank,
+        _control_increment_mode, _control_foreground_table, _control_background_table,
+        _control_foreground_large, _control_interrupt_on_vertical_blank,
+        _mask_grayscale_mode, _mask_render_background_left, _mask_render_foreground_left,
+        _mask_render_background, _mask_render_foreground,
+        _status_sprite_overflow, _status_sprite_zero_hit, _status_vertical_blank,
+        _latch_cycle, _latch_address};
+    const uint8_t bytes[4] = {_mask_color_emphasize, _scroll_x, _buffer_data, _register_decay};
+
+    hash = hash_bytes(hash, position, sizeof(position));
+    hash = hash_bytes(hash, registers, sizeof(registers));
+    hash = hash_bytes(hash, flags, sizeof(flags));
+    return hash_bytes(hash, bytes, sizeof(bytes));
+}
+
 void cynes::PPU::tick()
 {
+    HCLE_PROFILE_SAMPLED(_nes.profile.ppu);
+
     if (_render_skip)
         return tick_no_draw();
 
@@ -493,7 +518,10 @@ void cynes::PPU::tick()
         _delay_data_read_counter--;
     }
 
-    _nes.get_mapper().tick();
+    {
+        HCLE_PROFILE_SAMPLED_NESTED(_nes.profile.mapper);
+        _nes.get_mapper().tick();
+    }
 }
 
 void cynes::PPU::write(uint8_t address, uint8_t value)
@@ -49,6 +49,12 @@ namespace cynes
         /// Get a pointer to the internal frame buffer.
         const uint8_t *get_frame_buffer() const;
 
+        /// Get the current dot within the scanline.
+        inline uint16_t get_current_x() const { return _current_x; }
+
+        /// Get the current scanline.
+        inline uint16_t get_current_y() const { return _current_y; }
+
         /// Check whether or not the frame is ready.
         /// @note Calling this function will reset the flag.
         /// @return True if the frame is ready, false otherwise.
@@ -60,6 +66,11 @@ namespace cynes
         void set_frame_ready(bool ready);
         void set_render_skip(bool skip);
 
+        /// Fold the PPU's scroll, register and status state into a hash (see NES::hash_state).
+        /// @param hash Hash to fold the state into.
+        /// @return The updated hash.
+        uint64_t hash_state(uint64_t hash) const;
+
     private:
         NES &_nes;
         bool _render_skip = false;
@@ -243,6 +254,8 @@ namespace cynes
             cynes::dump<operation>(buffer, _foreground_sprite_zero_should);
             cynes::dump<operation>(buffer, _foreground_sprite_zero_hit);
             cynes::dump<operation>(buffer, _foreground_evaluation_step);
+
+            cynes::dump<operation>(buffer, _palette_cache);
         }
     };
 }
@@ -1,6 +1,7 @@
 #ifndef __CYNES_UTILS__
 #define __CYNES_UTILS__
 
+#include <cstddef>
 #include <cstdint>
 #include <cstring>
 
@@ -13,6 +14,20 @@ namespace cynes
         LOAD
     };
 
+    /// 64-bit FNV-1a offset basis, the starting value for hash_bytes.
+    constexpr uint64_t HASH_SEED = 0xCBF29CE484222325ULL;
+
+    /// Fold bytes into a 64-bit FNV-1a hash.
+    inline uint64_t hash_bytes(uint64_t hash, const void *data, size_t size)
+    {
+        const uint8_t *bytes = static_cast<const uint8_t *>(data);
+        for (size_t k = 0; k < size; k++)
+        {
+            hash = (hash ^ bytes[k]) * 0x100000001B3ULL;
+        }
+        return hash;
+    }
+
     template <DumpOperation operation, typename T>
     constexpr void dump(uint8_t *&buffer, T &value)
     {
@@ -0,0 +1,266 @@
+#pragma once
+
+// Compact, replayable logs of single episodes, written by AsyncVectorizer::startActionLogs()
+// and checked by replayActionLog() / hcle_replay.
+//
+// A log directory holds one file per episode, env%03d_ep%06u.hcla:
+//
+//   ActionLogHeader
+//   actions: uint8_t[num_steps], the action index of every step, padded to 8 bytes
+//   hashes:  ActionLogHash[num_hashes], NES::hash_state() after every hash_interval-th
+//            step and after the last one
+//
+// plus the emulator snapshots the episodes start from, snapshots/<snapshot_id>.state.
+// Snapshots are stored once per distinct state (snapshot_id is the hash of the snapshot
+// bytes), so episodes starting from the same state share one. The snapshot is taken after
+// the game's reset logic has run, which makes games that randomise their reset replayable.
+// Snapshots are HCLEnvironment::saveState() blobs; version 1 logs hold headerless ones
+// from before the save-state layout change and are rejected.
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include "hcle/emucore/utils.hpp"
+#include "hcle/environment/preprocessed_env.hpp"
+
+namespace hcle::environment
+{
+    inline constexpr char kActionLogMagic[8] = {'H', 'C', 'L', 'E', 'A', 'L', 'G', '\0'};
+    inline constexpr uint32_t kActionLogVersion = 2;
+
+    struct ActionLogHeader
+    {
+        char magic[8];
+        uint32_t version;
+        uint32_t header_size;
+        char game_name[32];
+        uint64_t snapshot_id;
+        uint32_t frame_skip;
+        uint8_t maxpool;
+        uint8_t reserved[3];
+        uint32_t hash_interval;
+        uint32_t num_steps;
+        uint32_t num_hashes;
+        uint32_t reserved2;
+    };
+    static_assert(sizeof(ActionLogHeader) == 80);
+
+    struct ActionLogHash
+    {
+        uint32_t step; // Number of steps taken when the hash was computed
+        uint32_t reserved;
+        uint64_t hash;
+    };
+    static_assert(sizeof(ActionLogHash) == 16);
+
+    inline std::string actionLogSnapshotPath(const std::string &directory, uint64_t snapshot_id)
+    {
+        char name[40];
+        std::snprintf(name, sizeof(name), "%016llx.state", static_cast<unsigned long long>(snapshot_id));
+        return (std::filesystem::path(directory) / "snapshots" / name).string();
+    }
+
+    // Builds the log of one env's episodes. Not thread-safe; each env owns its writer.
+    class ActionLogWriter
+    {
+    public:
+        ActionLogWriter(const std::string &directory, int env_id, const std::string &game_name, int frame_skip,
+                        bool maxpool, int hash_interval)
+            : m_directory(directory), m_env_id(env_id)
+        {
+            if (hash_interval <= 0)
+                throw std::invalid_argument("hash_interval must be positive.");
+            if (game_name.size() >= sizeof(m_header.game_name))
+                throw std::invalid_argument("Game name '" + game_name + "' is too long for an action log.");
+            std::memset(&m_header, 0, sizeof(m_header));
+            std::memcpy(m_header.magic, kActionLogMagic, sizeof(kActionLogMagic));
+            m_header.version = kActionLogVersion;
+            m_header.header_size = sizeof(ActionLogHeader);
+            std::memcpy(m_header.game_name, game_name.data(), game_name.size());
+            m_header.frame_skip = static_cast<uint32_t>(frame_skip);
+            m_header.maxpool = maxpool;
+            m_header.hash_interval = static_cast<uint32_t>(hash_interval);
+            std::filesystem::create_directories(std::filesystem::path(directory) / "snapshots");
+        }
+
+        // Starts an episode from snapshot, writing out the previous one if still open.
+        void begin(const std::vector<uint8_t> &snapshot)
+        {
+            end();
+            m_header.snapshot_id = cynes::hash_bytes(cynes::HASH_SEED, snapshot.data(), snapshot.size());
+            writeSnapshot(snapshot);
+            m_actions.clear();
+            m_hashes.clear();
+            m_open = true;
+        }
+
+        // Logs one step. Returns true if the state hash after it is due; pass it to addHash().
+        bool append(uint8_t action)
+        {
+            if (!m_open)
+                return false;
+            m_actions.push_back(action);
+            return m_actions.size() % m_header.hash_interval == 0;
+        }
+
+        void addHash(uint64_t hash)
+        {
+            if (!m_open || (!m_hashes.empty() && m_hashes.back().step == m_actions.size()))
+                return;
+            m_hashes.push_back({static_cast<uint32_t>(m_actions.size()), 0, hash});
+        }
+
+        // Writes the open episode, if any.
+        void end()
+        {
+            if (!m_open)
+                return;
+            m_open = false;
+            m_header.num_steps = static_cast<uint32_t>(m_actions.size());
+            m_header.num_hashes = static_cast<uint32_t>(m_hashes.size());
+
+            char name[40];
+            std::snprintf(name, sizeof(name), "env%03d_ep%06u.hcla", m_env_id, m_num_episodes++);
+            std::ofstream file(std::filesystem::path(m_directory) / name, std::ios::binary);
+            const size_t padding = (8 - m_actions.size() % 8) % 8;
+            const char zeros[8] = {};
+            file.write(reinterpret_cast<const char *>(&m_header), sizeof(m_header));
+            file.write(reinterpret_cast<const char *>(m_actions.data()), m_actions.size());
+            file.write(zeros, padding);
+            file.write(reinterpret_cast<const char *>(m_hashes.data()), m_hashes.size() * sizeof(ActionLogHash));
+            if (!file)
+                throw std::runtime_error("Failed to write action log " + std::string(name) + ".");
+        }
+
+        bool isOpen() const { return m_open; }
+
+    private:
+        void writeSnapshot(const std::vector<uint8_t> &snapshot)
+        {
+            const std::filesystem::path path = actionLogSnapshotPath(m_directory, m_header.snapshot_id);
+            if (std::filesystem::exists(path))
+                return;
+            // Other envs may write the same snapshot concurrently; publish it with a rename.
+            std::filesystem::path temp = path;
+            temp += ".tmp" + std::to_string(m_env_id);
+            {
+                std::ofstream file(temp, std::ios::binary);
+                file.write(reinterpret_cast<const char *>(snapshot.data()), snapshot.size());
+                if (!file)
+                    throw std::runtime_error("Failed to write snapshot " + path.string() + ".");
+            }
+            std::error_code error;
+            std::filesystem::rename(temp, path, error);
+            if (error)
+                std::filesystem::remove(temp, error);
+        }
+
+        std::string m_directory;
+        int m_env_id;
+        uint32_t m_num_episodes = 0;
+        ActionLogHeader m_header;
+        std::vector<uint8_t> m_actions;
+        std::vector<ActionLogHash> m_hashes;
+        bool m_open = false;
+    };
+
+    struct ActionLog
+    {
+        ActionLogHeader header;
+        std::vector<uint8_t> actions;
+        std::vector<ActionLogHash> hashes;
+        std::vector<uint8_t> snapshot;
+
+        std::string getGameName() const
+        {
+            return std::string(header.game_name, std::find(std::begin(header.game_name), std::end(header.game_name), '\0'));
+        }
+
+        // Reads a log and its snapshot from the snapshots/ directory next to it.
+        static ActionLog read(const std::string &path)
+        {
+            std::ifstream file(path, std::ios::binary);
+            ActionLog log;
+            if (!file.read(reinterpret_cast<char *>(&log.header), sizeof(log.header)) ||
+                std::memcmp(log.header.magic, kActionLogMagic, sizeof(kActionLogMagic)) != 0 ||
+                log.header.header_size != sizeof(ActionLogHeader))
+                throw std::runtime_error(path + " is not an action log.");
+            if (log.header.version == 1)
+                throw std::runtime_error(path + " was recorded with an older save-state format and cannot be replayed.");
+            if (log.header.version != kActionLogVersion)
+                throw std::runtime_error(path + " has unsupported version " + std::to_string(log.header.version) + ".");
+
+            log.actions.resize(log.header.num_steps);
+            log.hashes.resize(log.header.num_hashes);
+            file.read(reinterpret_cast<char *>(log.actions.data()), log.actions.size());
+            file.ignore((8 - log.actions.size() % 8) % 8);
+            file.read(reinterpret_cast<char *>(log.hashes.data()), log.hashes.size() * sizeof(ActionLogHash));
+            if (!file)
+                throw std::runtime_error(path + " is truncated.");
+
+            const std::string directory = std::filesystem::path(path).parent_path().string();
+            const std::string snapshot_path = actionLogSnapshotPath(directory, log.header.snapshot_id);
+            std::ifstream snapshot(snapshot_path, std::ios::binary);
+            if (!snapshot)
+                throw std::runtime_error("Missing snapshot " + snapshot_path + ".");
+            log.snapshot.assign(std::istreambuf_iterator<char>(snapshot), std::istreambuf_iterator<char>());
+            if (cynes::hash_bytes(cynes::HASH_SEED, log.snapshot.data(), log.snapshot.size()) != log.header.snapshot_id)
+                throw std::runtime_error("Snapshot " + snapshot_path + " does not match its ID.");
+            return log;
+        }
+    };
+
+    struct ActionLogReplayResult
+    {
+        uint32_t steps = 0;            // Steps replayed
+        uint32_t hashes_checked = 0;
+        int64_t divergence_step = -1;  // Step count at the first mismatching hash, or -1
+        uint64_t expected_hash = 0;
+        uint64_t actual_hash = 0;
+
+        bool matches() const { return divergence_step < 0; }
+    };
+
+    // Re-runs a log headlessly from its snapshot and stops at the first hash mismatch.
+    // render_skip replays in the PPU's render-skip mode instead, to check whether that mode
+    // stays bit-exact with the full emulation the log was recorded with.
+    inline ActionLogReplayResult replayActionLog(const ActionLog &log, bool render_skip = false)
+    {
+        // Observation settings don't affect emulation, so use the cheapest ones.
+        PreprocessedEnv env("", log.getGameName(), FramePreprocessor::kRawFrameHeight, FramePreprocessor::kRawFrameWidth,
+                            static_cast<int>(log.header.frame_skip), log.header.maxpool != 0, true, 1);
+        env.loadState(log.snapshot);
+        env.setRenderSkip(render_skip);
+
+        ActionLogReplayResult result;
+        size_t next_hash = 0;
+        for (uint8_t action : log.actions)
+        {
+            env.advance(action);
+            result.steps++;
+            if (next_hash < log.hashes.size() && log.hashes[next_hash].step == result.steps)
+            {
+                const uint64_t hash = env.getStateHash();
+                result.hashes_checked++;
+                if (hash != log.hashes[next_hash].hash)
+                {
+                    result.divergence_step = result.steps;
+                    result.expected_hash = log.hashes[next_hash].hash;
+                    result.actual_hash = hash;
+                    break;
+                }
+                next_hash++;
+            }
+        }
+        return result;
+    }
+}
@@ -2,28 +2,69 @@
 
 #include <vector>
 #include <memory>
-#include <thread>
-#include <atomic>
+#include <mutex>
 #include <functional>
 #include <string>
 #include <algorithm>
+#include <atomic>
 #include <stdexcept>
-#include <execution>
+#include <exception>
+#include <utility>
+#include <cstring>
+#include <cstdint>
+#include <span>
 
+#include "hcle/common/countdown_latch.hpp"
+#include "hcle/common/latency_histogram.hpp"
+#include "hcle/common/thread_pool.hpp"
 #include "hcle/common/thread_safe_queue.hpp"
+#include "hcle/common/trace.hpp"
+#include "hcle/environment/action_log.hpp"
 #include "hcle/environment/preprocessed_env.hpp"
+#include "hcle/environment/trajectory_dataset.hpp"
 
 namespace hcle::environment
 {
+    // When an env that has just finished an episode is reset.
+    //  NextStep: the step after the episode ends performs the reset and returns the
+    //            first observation of the new episode (reward 0, not done).
+    //  SameStep: the env is reset in the step that ended the episode; the returned
+    //            observation is the new episode's first one and the terminal observation
+    //            is written to the final observation buffer.
+    enum class AutoResetMode
+    {
+        NextStep,
+        SameStep
+    };
+
+    inline AutoResetMode parseAutoResetMode(const std::string &mode)
+    {
+        if (mode == "next_step")
+            return AutoResetMode::NextStep;
+        if (mode == "same_step")
+            return AutoResetMode::SameStep;
+        throw std::invalid_argument("Unknown autoreset mode '" + mode + "'. Expected 'next_step' or 'same_step'.");
+    }
+
     class AsyncVectorizer
     {
     public:
         AsyncVectorizer(
             const int num_envs,
-            const std::function<std::unique_ptr<PreprocessedEnv>(int)> &env_factory) : m_num_envs(num_envs), m_stop(false)
+            const std::function<std::unique_ptr<PreprocessedEnv>(int)> &env_factory,
+            const int max_episode_steps = 0,
+            const AutoResetMode autoreset_mode = AutoResetMode::NextStep,
+            const int num_result_buffers = 2)
+            : m_num_envs(num_envs),
+              m_max_episode_steps(max_episode_steps),
+              m_autoreset_mode(autoreset_mode)
         {
             if (num_envs <= 0)
                 throw std::invalid_argument("Number of environments must be positive.");
+            if (max_episode_steps < 0)
+                throw std::invalid_argument("Max episode steps must be non-negative (0 disables truncation).");
+            if (num_result_buffers <= 0)
+                throw std::invalid_argument("Number of result buffers must be positive.");
 
             m_envs.reserve(m_num_envs);
             for (int i = 0; i < m_num_envs; ++i)
@@ -35,72 +76,151 @@ namespace hcle::environment
                 throw std::runtime_error("Environment creation failed.");
 
             m_action_set_cache = m_envs[0]->getActionSet();
+            m_info_names = m_envs[0]->getInfoNames();
+            m_info_size = m_info_names.size();
 
             // Pre-allocate internal buffers to avoid allocations in main loop
             const size_t single_obs_size = getObservationSize();
-            m_internal_obs_buffers.resize(m_num_envs);
-            for (int i = 0; i < m_num_envs; ++i)
+            m_result_slots.resize(num_result_buffers);
+            for (auto &slot : m_result_slots)
             {
-                m_internal_obs_buffers[i].resize(single_obs_size);
+                slot.obs_storage.resize(m_num_envs * single_obs_size + kBufferAlignment);
+                void *ptr = slot.obs_storage.data();
+                size_t space = slot.obs_storage.size();
+                slot.obs = static_cast<uint8_t *>(std::align(kBufferAlignment, m_num_envs * single_obs_size, ptr, space));
+                slot.reward_storage.resize(m_num_envs);
+                slot.flag_storage.resize(2 * m_num_envs);
+                slot.rewards = slot.reward_storage.data();
+                slot.dones = slot.flag_storage.data();
+                slot.truncateds = slot.flag_storage.data() + m_num_envs;
             }
-            m_internal_reward_buffers.resize(m_num_envs);
-            m_internal_done_buffers.resize(m_num_envs);
-
-            const std::size_t processor_count = std::thread::hardware_concurrency();
-            m_num_threads = std::min<int>(m_num_envs, static_cast<int>(processor_count));
+            m_task_scratch.resize(m_num_envs);
+            m_last_actions.resize(m_num_envs);
 
-            // Start worker threads
-            m_workers.reserve(m_num_threads);
-            for (int i = 0; i < m_num_threads; ++i)
-            {
-                m_workers.emplace_back([this]
-                                       { workerFunction(); });
-            }
+            m_final_obs_buffer.resize(m_num_envs * single_obs_size);
+            m_needs_reset.resize(m_num_envs, 0);
+            m_elapsed_steps.resize(m_num_envs, 0);
+            m_episode_counts.resize(m_num_envs, 0);
+            m_episode_returns.resize(m_num_envs, 0.0);
+            m_last_episode_returns.resize(m_num_envs, 0.0);
+            m_last_episode_lengths.resize(m_num_envs, 0);
+            m_game_info.resize(m_num_envs * m_info_size, 0);
         }
 
         ~AsyncVectorizer()
         {
-            m_stop = true;
-            // Push dummy actions to wake up workers
-            for (int i = 0; i < m_num_threads; ++i)
-            {
-                m_action_queue.push({-1, 0, false});
-            }
-            // Wait for all worker threads to terminate
-            for (auto &worker : m_workers)
-            {
-                if (worker.joinable())
-                {
-                    worker.join();
-                }
-            }
+            // Let any in-flight work finish before the environments are destroyed.
+            m_pool_client.wait();
         }
 
-        void reset(uint8_t *obs_buffer, double *reward_buffer, uint8_t *done_buffer)
+        void reset(uint8_t *obs_buffer, double *reward_buffer, uint8_t *done_buffer, uint8_t *truncated_buffer = nullptr)
         {
+            checkNotInFlight("reset()");
             for (int i = 0; i < m_num_envs; ++i)
             {
-                m_action_queue.push({i, 0, true});
+                m_task_scratch[i] = {i, 0, true};
             }
-            collectResults(obs_buffer, reward_buffer, done_buffer);
+            m_write_slot = (m_read_slot + 1) % m_result_slots.size();
+            m_batch_is_reset = true;
+            dispatchTasks();
+            collectResults(obs_buffer, reward_buffer, done_buffer, truncated_buffer);
         }
 
-        void send(const std::vector<int> &action_ids)
+        // Actions are borrowed for the duration of the call only. Every send() must be
+        // followed by a recv() before the next send(), reset() or stepMany().
+        void send(std::span<const uint8_t> action_ids) { queueActions(action_ids); }
+        void send(std::span<const int32_t> action_ids) { queueActions(action_ids); }
+        void send(const std::vector<int> &action_ids) { queueActions(std::span<const int>(action_ids)); }
+
+        // Runs num_steps consecutive steps for every env with no round-trips to the caller.
+        // actions is laid out [num_steps, num_envs] and the outputs [num_steps, num_envs, ...].
+        // Auto-reset follows the vectorizer's mode. In SameStep mode final_obs_buffer, if given,
+        // receives [num_steps, num_envs, ...] terminal observations; only the entries of steps
+        // that ended an episode are written.
+        void stepMany(const uint8_t *actions, int num_steps, uint8_t *obs_buffer, double *reward_buffer,
+                      uint8_t *done_buffer, uint8_t *truncated_buffer = nullptr, uint8_t *final_obs_buffer = nullptr)
         {
-            if (static_cast<int>(action_ids.size()) != m_num_envs)
+            if (num_steps <= 0)
             {
-                throw std::runtime_error("Number of actions must equal number of environments.");
+                throw std::invalid_argument("Number of steps must be positive.");
             }
-            // Queue a step command for every environment.
+            checkNotInFlight("stepMany()");
+            if (m_recorder && m_record_raw)
+            {
+                throw std::runtime_error("stepMany() cannot record raw frames; use send()/recv().");
+            }
+            // Check the whole block up front so a bad action can't fail a batch half-way.
+            const size_t num_actions = static_cast<size_t>(num_steps) * m_num_envs;
+            for (size_t i = 0; i < num_actions; ++i)
+            {
+                if (actions[i] >= m_action_set_cache.size())
+                    throw std::invalid_argument("Action " + std::to_string(actions[i]) + " at step " +
+                                                std::to_string(i / m_num_envs) + " for env " +
+                                                std::to_string(i % m_num_envs) + " is out of range.");
+            }
+            // The recorder needs the terminal observations too, so keep them even if the caller doesn't.
+            if (m_recorder && m_autoreset_mode == AutoResetMode::SameStep && !final_obs_buffer)
+            {
+                m_multi_step_final_obs.resize(num_actions * getObservationSize());
+                final_obs_buffer = m_multi_step_final_obs.data();
+            }
+            m_multi_step = {actions, num_steps, obs_buffer, reward_buffer, done_buffer, truncated_buffer, final_obs_buffer};
             for (int i = 0; i < m_num_envs; ++i)
             {
-                m_action_queue.push({i, static_cast<uint8_t>(action_ids[i]), false});
+                m_task_scratch[i] = {i, 0, false, true};
+            }
+            dispatchTasks();
+            m_done_latch.wait();
+            rethrowWorkerError();
+
+            for (int t = 0; m_recorder && t < num_steps; ++t)
+            {
+                const size_t offset = static_cast<size_t>(t) * m_num_envs;
+                m_recorder->record(obs_buffer + offset * getObservationSize(), actions + offset, reward_buffer + offset,
+                                   done_buffer + offset, truncated_buffer ? truncated_buffer + offset : nullptr,
+                                   m_autoreset_mode == AutoResetMode::SameStep
+                                       ? final_obs_buffer + offset * getObservationSize()
+                                       : nullptr);
             }
         }
 
         const uint8_t *getRawFramePointer(int index) { return m_envs[index]->getFramePointer(); }
 
-        void recv(uint8_t *obs_buffer, double *reward_buffer, uint8_t *done_buffer) { collectResults(obs_buffer, reward_buffer, done_buffer); }
+        // Results can also be read in place: pass nullptr output buffers to reset()/recv()
+        // and read the slot returned by getCurrentResultSlot(). Slots are reused round-robin,
+        // so a slot's contents stay valid for getNumResultBuffers() - 1 further resets/steps.
+        void recv(uint8_t *obs_buffer, double *reward_buffer, uint8_t *done_buffer, uint8_t *truncated_buffer = nullptr)
+        {
+            collectResults(obs_buffer, reward_buffer, done_buffer, truncated_buffer);
+        }
+
+        int getNumResultBuffers() const { return static_cast<int>(m_result_slots.size()); }
+        int getCurrentResultSlot() const { return static_cast<int>(m_read_slot); }
+        const uint8_t *getResultObservations(int slot) const { return m_result_slots.at(slot).obs; }
+        const double *getResultRewards(int slot) const { return m_result_slots.at(slot).rewards; }
+        const uint8_t *getResultDones(int slot) const { return m_result_slots.at(slot).dones; }
+        const uint8_t *getResultTruncateds(int slot) const { return m_result_slots.at(slot).truncateds; }
+
+        // Moves the result slot into caller-owned arrays, e.g. a shared memory region, so the
+        // workers write every result there directly. Needs a single result buffer; the arrays
+        // must outlive the vectorizer. Pass nullptr outputs to reset()/recv() afterwards.
+        void attachResultStorage(uint8_t *obs, double *rewards, uint8_t *dones, uint8_t *truncateds)
+        {
+            if (m_result_slots.size() != 1)
+                throw std::logic_error("External result storage needs exactly one result buffer.");
+            if (!obs || !rewards || !dones || !truncateds)
+                throw std::invalid_argument("External result storage needs every array.");
+            ResultSlot &slot = m_result_slots[0];
+            slot.obs_storage = {};
+            slot.reward_storage = {};
+            slot.flag_storage = {};
+            slot.obs = obs;
+            slot.rewards = rewards;
+            slot.dones = dones;
+            slot.truncateds = truncateds;
+        }
+        // Actions that produced the current result slot, or null if it holds reset() results.
+        const uint8_t *getResultActions() const { return m_batch_is_reset ? nullptr : m_last_actions.data(); }
 
         const std::vector<uint8_t> &getActionSet() const { return m_action_set_cache; }
 
@@ -111,92 +231,487 @@ namespace hcle::environment
             return m_envs[0]->getObservationSize();
         }
 
+        std::vector<size_t> getObservationShape() const { return m_envs[0]->getObservationShape(); }
+
         int getNumEnvs() const { return m_num_envs; }
+        int getMaxEpisodeSteps() const { return m_max_episode_steps; }
+        AutoResetMode getAutoResetMode() const { return m_autoreset_mode; }
+
+        // Per-env arrays owned by the vectorizer. They are updated by the workers and are
+        // valid from the end of recv()/reset() until the next send().
+        const uint8_t *getFinalObservations() const { return m_final_obs_buffer.data(); }
+        const int32_t *getElapsedSteps() const { return m_elapsed_steps.data(); }
+        const int64_t *getEpisodeCounts() const { return m_episode_counts.data(); }
+        const double *getEpisodeReturns() const { return m_episode_returns.data(); }
+        const double *getLastEpisodeReturns() const { return m_last_episode_returns.data(); }
+        const int32_t *getLastEpisodeLengths() const { return m_last_episode_lengths.data(); }
+
+        // Game info values laid out [num_envs, getInfoNames().size()]. For an env whose
+        // episode just ended they describe the terminal state, even in SameStep mode.
+        const std::vector<std::string> &getInfoNames() const { return m_info_names; }
+        const int32_t *getGameInfo() const { return m_game_info.data(); }
 
         void loadFromState(int state_num)
         {
-            std::for_each(
-                std::execution::par,
-                m_envs.begin(),
-                m_envs.end(),
-                [](auto &env)
+            m_pool_client.parallelFor(m_num_envs, [this, state_num](int env_id)
+                                      { m_envs[env_id]->loadFromState(state_num); });
+        }
+
+        // Every env's profile (see PreprocessedEnv::getProfile()) summed, so seconds are
+        // worker-thread seconds. Call between batches.
+        std::vector<common::ProfileEntry> getProfile() const
+        {
+            std::vector<common::ProfileEntry> total = m_envs[0]->getProfile();
+            for (int i = 1; i < m_num_envs; ++i)
+            {
+                const std::vector<common::ProfileEntry> entries = m_envs[i]->getProfile();
+                for (size_t k = 0; k < total.size(); ++k)
                 {
-                    env->loadFromState(0);
-                });
+                    total[k].calls += entries[k].calls;
+                    total[k].seconds += entries[k].seconds;
+                }
+            }
+            return total;
+        }
+
+        void resetProfile()
+        {
+            for (auto &env : m_envs)
+                env->resetProfile();
+        }
+
+        // Latency distributions in nanoseconds, recorded continuously:
+        //  step:       one env step inside a send()/recv() or stepMany() batch, including any
+        //              autoreset it performs
+        //  batch:      send() to the end of the matching recv()
+        //  queue_wait: a task's dispatch to a worker starting on it
+        const common::LatencyHistogram &getStepLatency() const { return m_step_latency; }
+        const common::LatencyHistogram &getBatchLatency() const { return m_batch_latency; }
+        const common::LatencyHistogram &getQueueWaitLatency() const { return m_queue_wait_latency; }
+
+        // Call between batches.
+        void resetLatencies()
+        {
+            m_step_latency.reset();
+            m_batch_latency.reset();
+            m_queue_wait_latency.reset();
+        }
+
+        // Streams every subsequent reset/step result into a trajectory dataset in directory
+        // (see trajectory_dataset.hpp). Start before reset() so every episode is complete.
+        // With TrajectoryContent::RawFrames the raw emulator frames are recorded instead of
+        // the observations, [2 with maxpool else 1, 240, 256(, 3)] per record.
+        void startRecording(const std::string &directory, const TrajectoryRecorderConfig &config = {})
+        {
+            if (m_recorder)
+                throw std::runtime_error("Already recording to " + m_recorder->getDirectory() + ".");
+
+            const bool raw = config.content == TrajectoryContent::RawFrames;
+            size_t record_size = getObservationSize();
+            std::vector<size_t> record_shape = getObservationShape();
+            if (raw)
+            {
+                const PreprocessedEnv &env = *m_envs[0];
+                const size_t frames = env.usesMaxpool() ? 2 : 1;
+                const size_t pixels = FramePreprocessor::kRawFrameHeight * FramePreprocessor::kRawFrameWidth;
+                record_size = frames * env.getRawFrameSize();
+                record_shape = {frames, FramePreprocessor::kRawFrameHeight, FramePreprocessor::kRawFrameWidth};
+                if (env.getRawFrameSize() != pixels)
+                    record_shape.push_back(env.getRawFrameSize() / pixels);
+            }
+            m_recorder = std::make_unique<TrajectoryRecorder>(directory, m_num_envs, record_size, record_shape, config);
+
+            m_record_raw = raw;
+            m_raw_record_size = raw ? record_size : 0;
+            m_raw_frames.assign(m_num_envs * m_raw_record_size, 0);
+            m_final_raw_frames.assign(m_num_envs * m_raw_record_size, 0);
+        }
+
+        // Flushes and seals the dataset.
+        void stopRecording()
+        {
+            m_record_raw = false;
+            if (auto recorder = std::move(m_recorder))
+                recorder->close();
+        }
+
+        bool isRecording() const { return m_recorder != nullptr; }
+
+        // Logs every episode that starts from now on as a replayable action log in directory
+        // (see action_log.hpp), with a state hash every hash_interval steps. Call between
+        // batches, before reset() to cover the first episodes.
+        void startActionLogs(const std::string &directory, int hash_interval = 64)
+        {
+            if (!m_action_logs.empty())
+                throw std::runtime_error("Action logs are already being written.");
+            std::vector<ActionLogWriter> logs;
+            logs.reserve(m_num_envs);
+            for (int i = 0; i < m_num_envs; ++i)
+                logs.emplace_back(directory, i, m_envs[i]->getGameName(), m_envs[i]->getFrameSkip(),
+                                  m_envs[i]->usesMaxpool(), hash_interval);
+            m_action_logs = std::move(logs);
         }
 
+        // Writes out the episodes still in progress and stops logging.
+        void stopActionLogs()
+        {
+            auto logs = std::move(m_action_logs);
+            m_action_logs.clear();
+            for (auto &log : logs)
+                log.end();
+        }
+
+        bool isLoggingActions() const { return !m_action_logs.empty(); }
+
     private:
         struct ActionTask
         {
             int env_id;
             uint8_t action_value;
             bool force_reset;
+            bool multi_step = false;
+        };
+
+        struct MultiStepBatch
+        {
+            const uint8_t *actions = nullptr;
+            int num_steps = 0;
+            uint8_t *obs = nullptr;
+            double *rewards = nullptr;
+            uint8_t *dones = nullptr;
+            uint8_t *truncateds = nullptr;
+            uint8_t *final_obs = nullptr;
+        };
+
+        // One batch of step results, in the slot's own storage unless attachResultStorage()
+        // pointed it elsewhere. The observation block is aligned to kBufferAlignment.
+        struct ResultSlot
+        {
+            std::vector<uint8_t> obs_storage;
+            std::vector<double> reward_storage;
+            std::vector<uint8_t> flag_storage; // Dones, then truncateds
+            uint8_t *obs = nullptr;
+            double *rewards = nullptr;
+            uint8_t *dones = nullptr;
+            uint8_t *truncateds = nullptr;
+        };
+
+        struct EnvResult
+        {
+            double reward;
+            bool terminated;
+            bool truncated;
         };
 
         std::vector<uint8_t> m_action_set_cache;
+        std::vector<std::string> m_info_names;
+        size_t m_info_size;
         int m_num_envs;
-        int m_num_threads;
+        int m_max_episode_steps;
+        AutoResetMode m_autoreset_mode;
         common::ThreadSafeQueue<ActionTask> m_action_queue;
-        common::ThreadSafeQueue<int> m_result_queue; // Queue for "work complete" notifications.
-        std::vector<std::thread> m_workers;
-        std::atomic<bool> m_stop;
+        common::CountdownLatch m_done_latch; // Released once every queued task has run.
+        std::vector<ActionTask> m_task_scratch;
         std::vector<std::unique_ptr<PreprocessedEnv>> m_envs;
+        common::ThreadPool::Client m_pool_client;
+
+        // Tells this vectorizer's events apart in a trace (see common::Tracer).
+        static inline std::atomic<int> s_next_trace_id{0};
+        int m_trace_id = s_next_trace_id.fetch_add(1);
+
+        common::LatencyHistogram m_step_latency;
+        common::LatencyHistogram m_batch_latency;
+        common::LatencyHistogram m_queue_wait_latency;
+        uint64_t m_dispatch_ns = 0;
+        uint64_t m_send_ns = 0;
+
+        // Ring of result buffers the workers write into; m_write_slot is being filled by
+        // the batch in flight and m_read_slot holds the most recently collected results.
+        static constexpr size_t kBufferAlignment = 64;
+        std::vector<ResultSlot> m_result_slots;
+        size_t m_write_slot = 0;
+        size_t m_read_slot = 0;
+
+        // Per-env episode bookkeeping, each element only touched by the worker running that env.
+        std::vector<uint8_t> m_final_obs_buffer;
+        std::vector<uint8_t> m_needs_reset;
+        std::vector<int32_t> m_elapsed_steps;
+        std::vector<int64_t> m_episode_counts;
+        std::vector<double> m_episode_returns;
+        std::vector<double> m_last_episode_returns;
+        std::vector<int32_t> m_last_episode_lengths;
+        std::vector<int32_t> m_game_info;
+
+        MultiStepBatch m_multi_step;
+        std::vector<uint8_t> m_multi_step_final_obs; // Terminal observations to record, if the caller wants none
+
+        // The actions and kind of the batch in flight, and the recorder if active. With raw
+        // recording the workers also capture each env's raw frames, [num_envs, record size].
+        std::vector<uint8_t> m_last_actions;
+        bool m_batch_is_reset = false;
+        bool m_batch_in_flight = false; // Between a send() and its recv()
+        std::unique_ptr<TrajectoryRecorder> m_recorder;
+        bool m_record_raw = false;
+        size_t m_raw_record_size = 0;
+        std::vector<uint8_t> m_raw_frames;
+        std::vector<uint8_t> m_final_raw_frames;
+
+        // One action log writer per env while action logging is on.
+        std::vector<ActionLogWriter> m_action_logs;
+
+        std::mutex m_error_mutex;
+        std::exception_ptr m_worker_error;
+
+        static constexpr size_t kMaxClaimSize = 16;
+
+        template <typename ActionT>
+        void queueActions(std::span<const ActionT> action_ids)
+        {
+            if (static_cast<int>(action_ids.size()) != m_num_envs)
+            {
+                throw std::runtime_error("Number of actions must equal number of environments.");
+            }
+            checkNotInFlight("send()");
+            // Queue a step command for every environment.
+            for (int i = 0; i < m_num_envs; ++i)
+            {
+                const ActionT action = action_ids[i];
+                if (std::cmp_less(action, 0) || std::cmp_greater_equal(action, m_action_set_cache.size()))
+                    throw std::invalid_argument("Action " + std::to_string(action) + " for env " +
+                                                std::to_string(i) + " is out of range.");
+                m_task_scratch[i] = {i, static_cast<uint8_t>(action), false};
+                m_last_actions[i] = static_cast<uint8_t>(action);
+            }
+            m_send_ns = common::LatencyHistogram::now();
+            m_write_slot = (m_read_slot + 1) % m_result_slots.size();
+            m_batch_is_reset = false;
+            dispatchTasks();
+            m_batch_in_flight = true;
+        }
 
-        // Internal buffers for thread-safe data transfer.
-        std::vector<std::vector<uint8_t>> m_internal_obs_buffers;
-        std::vector<double> m_internal_reward_buffers;
-        std::vector<bool> m_internal_done_buffers;
+        void checkNotInFlight(const char *call) const
+        {
+            if (m_batch_in_flight)
+                throw std::logic_error(std::string(call) + " called while a step is in flight; recv() it first.");
+        }
+
+        // Queues the tasks in m_task_scratch under one lock, arms the completion latch and
+        // submits enough drain jobs to the shared pool to work through them.
+        void dispatchTasks()
+        {
+            const int num_jobs = std::min(m_num_envs, common::ThreadPool::instance().getNumThreads());
+            // Claim several tasks per lock, but leave enough chunks to balance the load.
+            const size_t claim_size = std::clamp<size_t>(m_num_envs / (4 * num_jobs), 1, kMaxClaimSize);
+
+            common::Tracer::instance().instant("dispatch", -1, m_trace_id, m_num_envs);
+            m_done_latch.reset(m_num_envs);
+            m_dispatch_ns = common::LatencyHistogram::now();
+            m_action_queue.push_bulk(std::span<const ActionTask>(m_task_scratch));
+            for (int i = 0; i < num_jobs; ++i)
+            {
+                m_pool_client.submit([this, claim_size]
+                                     { workerFunction(claim_size); });
+            }
+        }
 
-        void workerFunction()
+        // Runs one claim of up to claim_size tasks. A full claim may have left tasks behind,
+        // so the job then requeues itself behind the pool's other clients rather than
+        // holding the worker until this vectorizer's queue is empty.
+        void workerFunction(size_t claim_size)
         {
-            while (!m_stop)
+            ActionTask claimed[kMaxClaimSize];
+            const size_t count = m_action_queue.try_pop_bulk(std::span<ActionTask>(claimed, claim_size));
+            if (count == 0)
+                return;
+            common::Tracer::instance().instant("claim", -1, m_trace_id, static_cast<int>(count));
+            for (size_t i = 0; i < count; ++i)
             {
-                ActionTask work = m_action_queue.pop();
-                if (m_stop || work.env_id < 0)
+                const ActionTask &work = claimed[i];
+                const uint64_t start_ns = common::LatencyHistogram::now();
+                m_queue_wait_latency.record(start_ns - m_dispatch_ns);
+                try
                 {
-                    break;
+                    if (work.multi_step)
+                    {
+                        common::TraceScope trace("step_many", work.env_id, m_trace_id);
+                        runMultiStep(work.env_id);
+                    }
+                    else
+                    {
+                        const bool resetting = work.force_reset || m_needs_reset[work.env_id];
+                        common::TraceScope trace(resetting ? "reset" : "step", work.env_id, m_trace_id);
+                        ResultSlot &slot = m_result_slots[m_write_slot];
+                        EnvResult result = runEnv(work.env_id, work.action_value, work.force_reset,
+                                                  slot.obs + work.env_id * getObservationSize());
+
+                        slot.rewards[work.env_id] = result.reward;
+                        slot.dones[work.env_id] = result.terminated;
+                        slot.truncateds[work.env_id] = result.truncated;
+                        if (!work.force_reset)
+                            m_step_latency.recordSince(start_ns);
+                    }
+                }
+                catch (...)
+                {
+                    // Still count the env as complete so the caller doesn't wait forever.
+                    std::unique_lock<std::mutex> lock(m_error_mutex);
+                    if (!m_worker_error)
+                        m_worker_error = std::current_exception();
                 }
+            }
+            common::Tracer::instance().instant("push", -1, m_trace_id, static_cast<int>(count));
+            // Requeue before counting down: once the latch opens the caller may destroy us.
+            if (count == claim_size)
+            {
+                m_pool_client.submit([this, claim_size]
+                                     { workerFunction(claim_size); });
+            }
+            m_done_latch.count_down(count);
+        }
+
+        EnvResult runEnv(int env_id, uint8_t action_value, bool force_reset, uint8_t *obs_buffer)
+        {
+            auto &env = m_envs[env_id];
+            if (force_reset || m_needs_reset[env_id])
+            {
+                env->reset(obs_buffer);
+                env->getInfo(m_game_info.data() + env_id * m_info_size);
+                if (m_record_raw)
+                    captureRawFrames(env_id, true);
+                if (!m_action_logs.empty())
+                    m_action_logs[env_id].begin(env->saveState());
+                m_needs_reset[env_id] = false;
+                m_elapsed_steps[env_id] = 0;
+                m_episode_returns[env_id] = 0.0;
+                return {0.0, false, false};
+            }
+
+            env->step(action_value, obs_buffer);
+            env->getInfo(m_game_info.data() + env_id * m_info_size);
+            if (m_record_raw)
+                captureRawFrames(env_id, false);
+            m_elapsed_steps[env_id]++;
 
-                auto &env = m_envs[work.env_id];
+            EnvResult result{env->getReward(), env->isDone(), false};
+            result.truncated = !result.terminated && m_max_episode_steps > 0 &&
+                               m_elapsed_steps[env_id] >= m_max_episode_steps;
+            m_episode_returns[env_id] += result.reward;
 
-                uint8_t *current_obs_buffer = m_internal_obs_buffers[work.env_id].data();
+            if (!m_action_logs.empty())
+            {
+                ActionLogWriter &log = m_action_logs[env_id];
+                if (log.append(action_value) || result.terminated || result.truncated)
+                    log.addHash(env->getStateHash());
+                if (result.terminated || result.truncated)
+                    log.end();
+            }
 
-                if (work.force_reset || env->isDone())
+            if (result.terminated || result.truncated)
+            {
+                m_episode_counts[env_id]++;
+                m_last_episode_returns[env_id] = m_episode_returns[env_id];
+                m_last_episode_lengths[env_id] = m_elapsed_steps[env_id];
+                if (m_autoreset_mode == AutoResetMode::SameStep)
                 {
-                    env->reset(current_obs_buffer);
+                    const size_t single_obs_size = getObservationSize();
+                    std::memcpy(m_final_obs_buffer.data() + env_id * single_obs_size, obs_buffer, single_obs_size);
+                    env->reset(obs_buffer);
+                    if (m_record_raw)
+                    {
+                        const size_t offset = env_id * m_raw_record_size;
+                        std::memcpy(m_final_raw_frames.data() + offset, m_raw_frames.data() + offset, m_raw_record_size);
+                        captureRawFrames(env_id, true);
+                    }
+                    if (!m_action_logs.empty())
+                        m_action_logs[env_id].begin(env->saveState());
+                    m_elapsed_steps[env_id] = 0;
+                    m_episode_returns[env_id] = 0.0;
                 }
                 else
                 {
-                    env->step(work.action_value, current_obs_buffer);
+                    m_needs_reset[env_id] = true;
                 }
+            }
+            return result;
+        }
 
-                // Store results in internal buffers
-                m_internal_reward_buffers[work.env_id] = env->getReward();
-                m_internal_done_buffers[work.env_id] = env->isDone();
+        // Copies the raw frames env_id's last reset/step ended on into m_raw_frames. A reset
+        // has no earlier frame to max-pool with, so its frame is stored twice.
+        void captureRawFrames(int env_id, bool after_reset)
+        {
+            const PreprocessedEnv &env = *m_envs[env_id];
+            const size_t frame_size = env.getRawFrameSize();
+            uint8_t *dst = m_raw_frames.data() + env_id * m_raw_record_size;
+            if (env.usesMaxpool())
+            {
+                std::memcpy(dst, after_reset ? env.getFramePointer() : env.getPreviousFramePointer(), frame_size);
+                dst += frame_size;
+            }
+            std::memcpy(dst, env.getFramePointer(), frame_size);
+        }
 
-                m_result_queue.push(work.env_id);
+        void runMultiStep(int env_id)
+        {
+            const size_t single_obs_size = getObservationSize();
+            for (int t = 0; t < m_multi_step.num_steps; ++t)
+            {
+                const size_t index = static_cast<size_t>(t) * m_num_envs + env_id;
+                const uint64_t start_ns = common::LatencyHistogram::now();
+                EnvResult result = runEnv(env_id, m_multi_step.actions[index], false,
+                                          m_multi_step.obs + index * single_obs_size);
+                m_multi_step.rewards[index] = result.reward;
+                m_multi_step.dones[index] = result.terminated;
+                if (m_multi_step.truncateds)
+                    m_multi_step.truncateds[index] = result.truncated;
+                if (m_multi_step.final_obs && m_autoreset_mode == AutoResetMode::SameStep &&
+                    (result.terminated || result.truncated))
+                    std::memcpy(m_multi_step.final_obs + index * single_obs_size,
+                                m_final_obs_buffer.data() + env_id * single_obs_size, single_obs_size);
+                m_step_latency.recordSince(start_ns);
             }
         }
 
-        void collectResults(uint8_t *obs_buffer, double *reward_buffer, uint8_t *done_buffer)
+        void collectResults(uint8_t *obs_buffer, double *reward_buffer, uint8_t *done_buffer, uint8_t *truncated_buffer)
         {
             const size_t single_obs_size = getObservationSize();
 
-            for (int i = 0; i < m_num_envs; ++i)
             {
-                int completed_env_id = m_result_queue.pop();
+                common::TraceScope trace("recv_wait", -1, m_trace_id);
+                m_done_latch.wait();
+            }
+            m_batch_in_flight = false;
+            m_read_slot = m_write_slot;
 
-                if (completed_env_id >= 0 && completed_env_id < m_num_envs)
-                {
-                    // Copy data from internal buffers to python buffers
-                    reward_buffer[completed_env_id] = m_internal_reward_buffers[completed_env_id];
-                    done_buffer[completed_env_id] = m_internal_done_buffers[completed_env_id];
-
-                    // Copy observation data from internal buffer to the pthon buffer
-                    std::memcpy(obs_buffer + (completed_env_id * single_obs_size),
-                                m_internal_obs_buffers[completed_env_id].data(),
-                                single_obs_size);
-                }
+            // Copy out of the result slot into the caller's buffers, if any were given.
+            const ResultSlot &slot = m_result_slots[m_read_slot];
+            if (obs_buffer)
+                std::memcpy(obs_buffer, slot.obs, m_num_envs * single_obs_size);
+            if (reward_buffer)
+                std::copy_n(slot.rewards, m_num_envs, reward_buffer);
+            if (done_buffer)
+                std::copy_n(slot.dones, m_num_envs, done_buffer);
+            if (truncated_buffer)
+                std::copy_n(slot.truncateds, m_num_envs, truncated_buffer);
+            if (!m_batch_is_reset)
+                m_batch_latency.recordSince(m_send_ns);
+            rethrowWorkerError();
+
+            if (m_recorder)
+            {
+                const uint8_t *final_obs = m_record_raw ? m_final_raw_frames.data() : m_final_obs_buffer.data();
+                m_recorder->record(m_record_raw ? m_raw_frames.data() : slot.obs,
+                                   m_batch_is_reset ? nullptr : m_last_actions.data(), slot.rewards,
+                                   slot.dones, slot.truncateds,
+                                   m_autoreset_mode == AutoResetMode::SameStep ? final_obs : nullptr);
+            }
+        }
+
+        void rethrowWorkerError()
+        {
+            std::unique_lock<std::mutex> lock(m_error_mutex);
+            if (m_worker_error)
+            {
+                std::rethrow_exception(std::exchange(m_worker_error, nullptr));
             }
         }
     };
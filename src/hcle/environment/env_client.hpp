@@ -0,0 +1,138 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "hcle/common/socket.hpp"
+#include "hcle/environment/env_protocol.hpp"
+
+namespace hcle::environment
+{
+    // C++ client for hcle_server. send() only writes the request, so several steps can be
+    // in flight at once; recv() returns their results in order.
+    class EnvClient
+    {
+    public:
+        explicit EnvClient(const std::string &address, common::FrameCodec codec = common::FrameCodec::Raw)
+            : m_socket(common::Socket::connect(address)), m_codec(codec)
+        {
+            MessageWriter writer(m_request);
+            writer.put(MessageType::Info);
+            writer.send(m_socket);
+
+            MessageReader reader = readReply(MessageType::InfoReply);
+            m_num_envs = reader.get<uint32_t>();
+            m_obs_size = reader.get<uint64_t>();
+            const uint8_t ndim = reader.get<uint8_t>();
+            for (uint8_t i = 0; i < ndim; ++i)
+                m_obs_shape.push_back(reader.get<uint32_t>());
+            const uint32_t num_actions = reader.get<uint32_t>();
+            const uint8_t *actions = reader.take(num_actions);
+            m_action_set.assign(actions, actions + num_actions);
+            m_decoder = std::make_unique<common::FrameDecoder>(m_num_envs, m_obs_size, m_obs_shape.empty() ? 1 : m_obs_shape[0]);
+        }
+
+        ~EnvClient()
+        {
+            try
+            {
+                MessageWriter writer(m_request);
+                writer.put(MessageType::Close);
+                writer.send(m_socket);
+            }
+            catch (const std::exception &)
+            {
+            }
+        }
+
+        EnvClient(const EnvClient &) = delete;
+        EnvClient &operator=(const EnvClient &) = delete;
+
+        void reset(uint8_t *obs_buffer, double *reward_buffer, uint8_t *done_buffer, uint8_t *truncated_buffer = nullptr)
+        {
+            MessageWriter writer(m_request);
+            writer.put(MessageType::Reset);
+            writer.put(m_codec);
+            writer.send(m_socket);
+            m_in_flight++;
+            recv(obs_buffer, reward_buffer, done_buffer, truncated_buffer);
+        }
+
+        void send(std::span<const uint8_t> action_ids)
+        {
+            if (action_ids.size() != m_num_envs)
+                throw std::runtime_error("Number of actions must equal number of environments.");
+            MessageWriter writer(m_request);
+            writer.put(MessageType::Step);
+            writer.put(m_codec);
+            writer.putBytes(action_ids.data(), action_ids.size());
+            writer.send(m_socket);
+            m_in_flight++;
+        }
+
+        // Reads the result of the oldest outstanding request. Any buffer may be null.
+        void recv(uint8_t *obs_buffer, double *reward_buffer, uint8_t *done_buffer, uint8_t *truncated_buffer = nullptr)
+        {
+            if (m_in_flight == 0)
+                throw std::runtime_error("recv() called with no request in flight.");
+            m_in_flight--;
+
+            MessageReader reader = readReply(MessageType::Result);
+            if (reader.get<uint32_t>() != m_num_envs)
+                throw std::runtime_error("Result has the wrong number of envs.");
+            copyOut(reader, reward_buffer, m_num_envs * sizeof(double));
+            copyOut(reader, done_buffer, m_num_envs);
+            copyOut(reader, truncated_buffer, m_num_envs);
+
+            const auto obs_bytes = reader.get<uint64_t>();
+            if (m_decoder->decode(reader.take(obs_bytes), obs_bytes, obs_buffer) != obs_bytes)
+                throw std::runtime_error("Result has the wrong observation size.");
+        }
+
+        size_t getNumEnvs() const { return m_num_envs; }
+        size_t getObservationSize() const { return m_obs_size; }
+        const std::vector<size_t> &getObservationShape() const { return m_obs_shape; }
+        const std::vector<uint8_t> &getActionSet() const { return m_action_set; }
+        int getInFlight() const { return m_in_flight; }
+
+    private:
+        MessageReader readReply(MessageType expected)
+        {
+            if (!readMessage(m_socket, m_response))
+                throw std::runtime_error("hcle_server closed the connection.");
+            MessageReader reader(m_response);
+            const auto type = static_cast<MessageType>(reader.get<uint8_t>());
+            if (type == MessageType::Error)
+            {
+                const size_t size = reader.remaining();
+                throw std::runtime_error("hcle_server: " + std::string(reinterpret_cast<const char *>(reader.take(size)), size));
+            }
+            if (type != expected)
+                throw std::runtime_error("Unexpected reply from hcle_server.");
+            return reader;
+        }
+
+        static void copyOut(MessageReader &reader, void *destination, size_t size)
+        {
+            const uint8_t *data = reader.take(size);
+            if (destination)
+                std::memcpy(destination, data, size);
+        }
+
+        common::Socket m_socket;
+        common::FrameCodec m_codec;
+        size_t m_num_envs = 0;
+        size_t m_obs_size = 0;
+        std::vector<size_t> m_obs_shape;
+        std::vector<uint8_t> m_action_set;
+        std::unique_ptr<common::FrameDecoder> m_decoder;
+        std::vector<uint8_t> m_request;
+        std::vector<uint8_t> m_response;
+        int m_in_flight = 0;
+    };
+}
@@ -0,0 +1,124 @@
+#pragma once
+
+// Wire format shared by hcle_server and its clients (EnvClient here, RemoteVectorEnv in
+// Python). Every message is a little-endian uint32 payload length followed by the payload,
+// whose first byte is a MessageType. Requests are answered strictly in order, so a client
+// may pipeline several Step requests before reading their results.
+//
+//   Info     -> InfoReply: u32 num_envs, u64 obs_size, u8 ndim, u32 shape[ndim],
+//                          u32 num_actions, u8 actions[num_actions]
+//   Reset    u8 codec                -> Result
+//   Step     u8 codec, u8 actions[N] -> Result
+//   Close    (no reply)
+//   Result:  u32 num_envs, f64 rewards[N], u8 dones[N], u8 truncateds[N],
+//            u64 obs_bytes, N frame records (see hcle/common/frame_codec.hpp)
+//   Error:   utf-8 message (the request is dropped; the connection stays usable)
+//
+// codec is a common::FrameCodec. Delta codecs are relative to the previous observation
+// of the same env sent on this connection, shifted by one frame of the stack (shape[0]);
+// the first result on a connection is Raw.
+
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "hcle/common/frame_codec.hpp"
+#include "hcle/common/socket.hpp"
+
+namespace hcle::environment
+{
+    enum class MessageType : uint8_t
+    {
+        Info = 1,
+        Reset = 2,
+        Step = 3,
+        Close = 4,
+        Error = 0x7F,
+        InfoReply = 0x81,
+        Result = 0x82
+    };
+
+    // Upper bound on a single message, to catch corrupt length prefixes.
+    inline constexpr uint32_t kMaxMessageSize = 1u << 30;
+
+    // Builds one length-prefixed message in a reusable buffer.
+    class MessageWriter
+    {
+    public:
+        explicit MessageWriter(std::vector<uint8_t> &buffer) : m_buffer(buffer)
+        {
+            m_buffer.resize(sizeof(uint32_t));
+        }
+
+        template <typename T>
+        void put(const T &value) { putBytes(&value, sizeof(T)); }
+
+        void putBytes(const void *data, size_t size)
+        {
+            const size_t offset = m_buffer.size();
+            m_buffer.resize(offset + size);
+            std::memcpy(m_buffer.data() + offset, data, size);
+        }
+
+        size_t size() const { return m_buffer.size(); }
+        // The underlying buffer, for encoders that append to it directly.
+        std::vector<uint8_t> &buffer() { return m_buffer; }
+
+        void send(common::Socket &socket)
+        {
+            const uint32_t length = static_cast<uint32_t>(m_buffer.size() - sizeof(uint32_t));
+            std::memcpy(m_buffer.data(), &length, sizeof(length));
+            socket.sendAll(m_buffer.data(), m_buffer.size());
+        }
+
+    private:
+        std::vector<uint8_t> &m_buffer;
+    };
+
+    // Bounds-checked reads from a received payload.
+    class MessageReader
+    {
+    public:
+        explicit MessageReader(std::span<const uint8_t> payload) : m_payload(payload) {}
+
+        template <typename T>
+        T get()
+        {
+            T value;
+            std::memcpy(&value, take(sizeof(T)), sizeof(T));
+            return value;
+        }
+
+        const uint8_t *take(size_t size)
+        {
+            if (size > m_payload.size() - m_offset)
+                throw std::runtime_error("Truncated message.");
+            const uint8_t *data = m_payload.data() + m_offset;
+            m_offset += size;
+            return data;
+        }
+
+        size_t remaining() const { return m_payload.size() - m_offset; }
+
+    private:
+        std::span<const uint8_t> m_payload;
+        size_t m_offset = 0;
+    };
+
+    // Reads one message payload into buffer. Returns false on a clean close.
+    inline bool readMessage(common::Socket &socket, std::vector<uint8_t> &buffer)
+    {
+        uint32_t length;
+        if (!socket.recvAll(&length, sizeof(length)))
+            return false;
+        if (length == 0 || length > kMaxMessageSize)
+            throw std::runtime_error("Invalid message length " + std::to_string(length) + ".");
+        buffer.resize(length);
+        if (!socket.recvAll(buffer.data(), length))
+            throw std::runtime_error("Connection closed mid-message.");
+        return true;
+    }
+}
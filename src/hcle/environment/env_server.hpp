@@ -0,0 +1,236 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <iostream>
+#include <memory>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "hcle/common/socket.hpp"
+#include "hcle/environment/async_vectorizer.hpp"
+#include "hcle/environment/env_protocol.hpp"
+
+namespace hcle::environment
+{
+    // Hosts one AsyncVectorizer and serves it over the protocol in env_protocol.hpp. The
+    // envs are a single shared resource, so clients are served one connection at a time.
+    //
+    // Steps are pipelined: when the next Step request has already arrived, its actions are
+    // handed to the vectorizer before the previous result is encoded and written, so the
+    // envs step while the server is busy with the socket. Results stay in the vectorizer's
+    // result slots, which needs at least two of them.
+    class EnvServer
+    {
+    public:
+        explicit EnvServer(std::unique_ptr<AsyncVectorizer> vectorizer)
+            : m_vectorizer(std::move(vectorizer)),
+              m_encoder(m_vectorizer->getNumEnvs(), m_vectorizer->getObservationSize(),
+                        m_vectorizer->getObservationShape().front())
+        {
+            if (m_vectorizer->getNumResultBuffers() < 2)
+                throw std::invalid_argument("EnvServer needs a vectorizer with at least two result buffers.");
+            m_obs_size = m_vectorizer->getObservationSize();
+        }
+
+        // Accepts and serves connections until max_connections have been handled
+        // (0 = forever).
+        void serve(const std::string &address, int max_connections = 0)
+        {
+            common::Socket listener = common::Socket::listen(address);
+            for (int handled = 0; max_connections == 0 || handled < max_connections; ++handled)
+            {
+                common::Socket connection = listener.accept();
+                try
+                {
+                    serveConnection(connection);
+                }
+                catch (const std::exception &e)
+                {
+                    std::cerr << "hcle_server: connection dropped: " << e.what() << "\n";
+                }
+            }
+        }
+
+        // Handles requests on one connection until the client closes it.
+        void serveConnection(common::Socket &connection)
+        {
+            // A connection dropped mid-step leaves its step in flight.
+            if (m_step_in_flight)
+            {
+                m_step_in_flight = false;
+                m_vectorizer->recv(nullptr, nullptr, nullptr);
+            }
+            m_encoder.resetAll();
+            while (true)
+            {
+                // Nothing to overlap the step in flight with: finish it now.
+                if (m_step_in_flight && !connection.isReadable())
+                    finishStep(connection);
+                if (!readMessage(connection, m_request))
+                    break;
+
+                MessageReader reader(m_request);
+                const auto type = static_cast<MessageType>(reader.get<uint8_t>());
+                if (type == MessageType::Close)
+                    break;
+
+                try
+                {
+                    handle(type, reader, connection);
+                }
+                catch (const std::invalid_argument &e)
+                {
+                    // Bad request (e.g. an out-of-range action): report it and carry on.
+                    MessageWriter writer(m_response);
+                    writer.put(MessageType::Error);
+                    writer.putBytes(e.what(), std::strlen(e.what()));
+                    writer.send(connection);
+                }
+            }
+            // The client is gone; collect its last step without replying.
+            if (m_step_in_flight)
+            {
+                m_step_in_flight = false;
+                m_vectorizer->recv(nullptr, nullptr, nullptr);
+            }
+        }
+
+    private:
+        void handle(MessageType type, MessageReader &reader, common::Socket &connection)
+        {
+            switch (type)
+            {
+            case MessageType::Info:
+                finishStep(connection);
+                sendInfo(connection);
+                break;
+            case MessageType::Reset:
+            {
+                finishStep(connection);
+                const auto codec = readCodec(reader);
+                m_vectorizer->reset(nullptr, nullptr, nullptr);
+                sendResult(connection, codec);
+                break;
+            }
+            case MessageType::Step:
+            {
+                // A bad request is only reported after the previous step's reply, so replies
+                // stay in request order.
+                std::exception_ptr bad_request;
+                common::FrameCodec codec{};
+                const uint8_t *actions = nullptr;
+                const size_t num_envs = m_vectorizer->getNumEnvs();
+                try
+                {
+                    codec = readCodec(reader);
+                    if (reader.remaining() != num_envs)
+                        throw std::invalid_argument("Step request must carry one action per env.");
+                    actions = reader.take(num_envs);
+                }
+                catch (const std::invalid_argument &)
+                {
+                    bad_request = std::current_exception();
+                }
+
+                // Collect the previous step and start this one, then reply to the previous
+                // step from its result slot while the envs run.
+                const bool previous = m_step_in_flight;
+                const common::FrameCodec previous_codec = m_step_codec;
+                if (previous)
+                {
+                    m_step_in_flight = false;
+                    m_vectorizer->recv(nullptr, nullptr, nullptr);
+                }
+                if (!bad_request)
+                {
+                    try
+                    {
+                        m_vectorizer->send(std::span<const uint8_t>(actions, num_envs));
+                        m_step_in_flight = true;
+                        m_step_codec = codec;
+                    }
+                    catch (const std::invalid_argument &)
+                    {
+                        bad_request = std::current_exception();
+                    }
+                }
+                if (previous)
+                    sendResult(connection, previous_codec);
+                if (bad_request)
+                    std::rethrow_exception(bad_request);
+                break;
+            }
+            default:
+                finishStep(connection);
+                throw std::invalid_argument("Unknown message type " + std::to_string(static_cast<int>(type)) + ".");
+            }
+        }
+
+        // Waits for the step in flight, if any, and replies with its result.
+        void finishStep(common::Socket &connection)
+        {
+            if (!m_step_in_flight)
+                return;
+            m_step_in_flight = false;
+            m_vectorizer->recv(nullptr, nullptr, nullptr);
+            sendResult(connection, m_step_codec);
+        }
+
+        void sendInfo(common::Socket &connection)
+        {
+            MessageWriter writer(m_response);
+            writer.put(MessageType::InfoReply);
+            writer.put(static_cast<uint32_t>(m_vectorizer->getNumEnvs()));
+            writer.put(static_cast<uint64_t>(m_obs_size));
+            const auto shape = m_vectorizer->getObservationShape();
+            writer.put(static_cast<uint8_t>(shape.size()));
+            for (size_t dim : shape)
+                writer.put(static_cast<uint32_t>(dim));
+            const auto &action_set = m_vectorizer->getActionSet();
+            writer.put(static_cast<uint32_t>(action_set.size()));
+            writer.putBytes(action_set.data(), action_set.size());
+            writer.send(connection);
+        }
+
+        static common::FrameCodec readCodec(MessageReader &reader)
+        {
+            const uint8_t codec = reader.get<uint8_t>();
+            if (codec > static_cast<uint8_t>(common::FrameCodec::DeltaZlib))
+                throw std::invalid_argument("Unknown frame codec " + std::to_string(codec) + ".");
+            return static_cast<common::FrameCodec>(codec);
+        }
+
+        // Replies with the most recently collected results. A step started since writes to
+        // the next result slot, so they stay intact.
+        void sendResult(common::Socket &connection, common::FrameCodec codec)
+        {
+            const int slot = m_vectorizer->getCurrentResultSlot();
+            const size_t num_envs = m_vectorizer->getNumEnvs();
+            MessageWriter writer(m_response);
+            writer.put(MessageType::Result);
+            writer.put(static_cast<uint32_t>(num_envs));
+            writer.putBytes(m_vectorizer->getResultRewards(slot), num_envs * sizeof(double));
+            writer.putBytes(m_vectorizer->getResultDones(slot), num_envs);
+            writer.putBytes(m_vectorizer->getResultTruncateds(slot), num_envs);
+
+            const size_t length_offset = writer.size();
+            writer.put(uint64_t{0});
+            m_encoder.encode(m_vectorizer->getResultObservations(slot), codec, writer.buffer());
+            const uint64_t obs_bytes = writer.size() - length_offset - sizeof(uint64_t);
+            std::memcpy(m_response.data() + length_offset, &obs_bytes, sizeof(obs_bytes));
+            writer.send(connection);
+        }
+
+        std::unique_ptr<AsyncVectorizer> m_vectorizer;
+        size_t m_obs_size;
+        common::FrameEncoder m_encoder;
+        bool m_step_in_flight = false;
+        common::FrameCodec m_step_codec{};
+        std::vector<uint8_t> m_request;
+        std::vector<uint8_t> m_response;
+    };
+}
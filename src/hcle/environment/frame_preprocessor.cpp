@@ -0,0 +1,101 @@
+#include <cstring>
+#include <stdexcept>
+#include <opencv2/opencv.hpp>
+#include "hcle/environment/frame_preprocessor.hpp"
+
+namespace hcle::environment
+{
+    FramePreprocessor::FramePreprocessor(int obs_height, int obs_width, int channels, int stack_num, bool maxpool)
+        : m_obs_height(obs_height),
+          m_obs_width(obs_width),
+          m_channels(channels),
+          m_stack_num(stack_num),
+          m_maxpool(maxpool)
+    {
+        if (obs_height <= 0 || obs_width <= 0 || stack_num <= 0)
+            throw std::invalid_argument("Observation height, width and stack size must be positive.");
+        if (channels != 1 && channels != 3)
+            throw std::invalid_argument("Frames must have 1 or 3 channels.");
+
+        m_raw_size = kRawFrameHeight * kRawFrameWidth * m_channels;
+        m_obs_size = m_obs_height * m_obs_width * m_channels;
+        m_stacked_obs_size = m_stack_num * m_obs_size;
+
+        if (m_maxpool)
+            m_pooled_frame.resize(m_raw_size, 0);
+        m_frame_stack.resize(m_stacked_obs_size, 0);
+
+        m_requires_resize = (m_obs_height != kRawFrameHeight) || (m_obs_width != kRawFrameWidth);
+    }
+
+    void FramePreprocessor::reset(const uint8_t *frame, uint8_t *obs_output_buffer)
+    {
+        m_frame_stack_idx = 0;
+        processFrame(frame);
+
+        for (int i = 1; i < m_stack_num; ++i)
+        {
+            std::memcpy(m_frame_stack.data() + (i * m_obs_size),
+                        m_frame_stack.data(),
+                        m_obs_size);
+        }
+        writeObservation(obs_output_buffer);
+    }
+
+    void FramePreprocessor::step(const uint8_t *frame, const uint8_t *prev_frame, uint8_t *obs_output_buffer)
+    {
+        if (m_maxpool && prev_frame)
+        {
+            auto cv2_format = m_channels == 1 ? CV_8UC1 : CV_8UC3;
+            cv::Mat current(kRawFrameHeight, kRawFrameWidth, cv2_format, const_cast<uint8_t *>(frame));
+            cv::Mat previous(kRawFrameHeight, kRawFrameWidth, cv2_format, const_cast<uint8_t *>(prev_frame));
+            cv::Mat pooled(kRawFrameHeight, kRawFrameWidth, cv2_format, m_pooled_frame.data());
+            cv::max(current, previous, pooled);
+            frame = m_pooled_frame.data();
+        }
+        processFrame(frame);
+        writeObservation(obs_output_buffer);
+    }
+
+    void FramePreprocessor::processFrame(const uint8_t *frame)
+    {
+        auto cv2_format = m_channels == 1 ? CV_8UC1 : CV_8UC3;
+        cv::Mat source_mat = cv::Mat(kRawFrameHeight, kRawFrameWidth, cv2_format, const_cast<uint8_t *>(frame));
+
+        // Get pointer to current position in circular buffer
+        uint8_t *dest_ptr = m_frame_stack.data() + (m_frame_stack_idx * m_obs_size);
+
+        if (m_requires_resize)
+        {
+            cv::Mat dest_mat(m_obs_height, m_obs_width, cv2_format, dest_ptr);
+            cv::resize(source_mat, dest_mat, dest_mat.size(), 0, 0, cv::INTER_AREA);
+        }
+        else
+        {
+            std::memcpy(dest_ptr, source_mat.data, m_obs_size);
+        }
+
+        // Move to next position in circular buffer
+        m_frame_stack_idx = (m_frame_stack_idx + 1) % m_stack_num;
+    }
+
+    void FramePreprocessor::writeObservation(uint8_t *obs_output_buffer)
+    {
+        if (m_frame_stack_idx == 0)
+        {
+            std::memcpy(obs_output_buffer, m_frame_stack.data(), m_stacked_obs_size);
+        }
+        else
+        {
+            size_t older_part_size = (m_stack_num - m_frame_stack_idx) * m_obs_size;
+            std::memcpy(obs_output_buffer,
+                        m_frame_stack.data() + (m_frame_stack_idx * m_obs_size),
+                        older_part_size);
+
+            size_t newer_part_size = m_frame_stack_idx * m_obs_size;
+            std::memcpy(obs_output_buffer + older_part_size,
+                        m_frame_stack.data(),
+                        newer_part_size);
+        }
+    }
+} // namespace environment
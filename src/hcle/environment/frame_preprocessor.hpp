@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+namespace hcle::environment
+{
+    // The observation pipeline shared by PreprocessedEnv and OfflineVectorEnv: optional
+    // max-pooling of the last two raw frames of a step, resizing to obs_height x obs_width
+    // and stacking the last stack_num processed frames (oldest first).
+    class FramePreprocessor
+    {
+    public:
+        static constexpr int kRawFrameHeight = 240;
+        static constexpr int kRawFrameWidth = 256;
+
+        FramePreprocessor(int obs_height, int obs_width, int channels, int stack_num, bool maxpool);
+
+        // Starts a new stack filled with the processed frame.
+        void reset(const uint8_t *frame, uint8_t *obs_output_buffer);
+
+        // Pushes the frame a step ended on. With maxpool, prev_frame is the frame before
+        // it and the two are max-pooled pixel-wise; otherwise prev_frame is ignored.
+        void step(const uint8_t *frame, const uint8_t *prev_frame, uint8_t *obs_output_buffer);
+
+        bool usesMaxpool() const { return m_maxpool; }
+        int getChannels() const { return m_channels; }
+        size_t getRawFrameSize() const { return m_raw_size; }
+        size_t getFrameSize() const { return m_obs_size; }
+        size_t getObservationSize() const { return m_stacked_obs_size; }
+        // [stack, height, width] for one channel, [stack, height, width, channels] otherwise.
+        std::vector<size_t> getObservationShape() const
+        {
+            std::vector<size_t> shape = {static_cast<size_t>(m_stack_num), static_cast<size_t>(m_obs_height),
+                                         static_cast<size_t>(m_obs_width)};
+            if (m_channels != 1)
+                shape.push_back(m_channels);
+            return shape;
+        }
+
+    private:
+        void processFrame(const uint8_t *frame);
+        void writeObservation(uint8_t *obs_output_buffer);
+
+        int m_obs_height;
+        int m_obs_width;
+        int m_channels;
+        int m_stack_num;
+        bool m_maxpool;
+        bool m_requires_resize;
+
+        size_t m_raw_size; // Size of a single raw frame from the emulator
+        size_t m_obs_size; // Size of a single processed (resized) observation frame
+        size_t m_stacked_obs_size;
+
+        std::vector<uint8_t> m_pooled_frame; // Max of the last two raw frames
+        std::vector<uint8_t> m_frame_stack;  // Circular buffer for stacked processed frames
+        int m_frame_stack_idx = 0;
+    };
+}
@@ -1,6 +1,9 @@
+#include <algorithm>
+#include <cstring>
 #include <stdexcept>
 #include <iostream>
 #include <chrono>
+#include <thread>
 
 #include "hcle/environment/hcle_environment.hpp"
 #include "hcle/games/roms.hpp"
@@ -105,6 +108,7 @@ namespace hcle
             {
                 throw std::runtime_error("Environment must be loaded with a ROM before reset.");
             }
+            HCLE_PROFILE_SCOPE(m_reset_profile);
             game_logic->reset();
             this->m_current_step = 0;
             game_logic->updateRAM();
@@ -117,19 +121,23 @@ namespace hcle
                 throw std::runtime_error("Environment must be loaded with a ROM before calling step.");
             }
             game_logic->updateRAM();
-            if (m_display)
             {
-                for (unsigned int k = 0; k < frames; k++)
+                HCLE_PROFILE_SCOPE(m_emulate_profile);
+                if (m_display)
                 {
-                    emu->step(controller_input, 1);
-                    this->updateWindow();
+                    for (unsigned int k = 0; k < frames; k++)
+                    {
+                        emu->step(controller_input, 1);
+                        this->updateWindow();
+                    }
+                }
+                else
+                {
+                    emu->step(controller_input, frames);
                 }
-            }
-            else
-            {
-                emu->step(controller_input, frames);
             }
             this->m_current_step++;
+            HCLE_PROFILE_SCOPE(m_game_logic_profile);
             game_logic->onStep();
 
             return game_logic->getReward();
@@ -149,6 +157,83 @@ namespace hcle
             game_logic->loadFromState(state_num);
         }
 
+        std::vector<uint8_t> HCLEnvironment::saveState()
+        {
+            if (!emu)
+                throw std::runtime_error("Environment must be loaded with a ROM before saving state.");
+            SaveStateHeader header;
+            std::memset(&header, 0, sizeof(header));
+            std::memcpy(header.magic, kSaveStateMagic, sizeof(kSaveStateMagic));
+            header.version = kSaveStateVersion;
+            header.size = emu->size();
+
+            std::vector<uint8_t> state(sizeof(header) + header.size);
+            std::memcpy(state.data(), &header, sizeof(header));
+            emu->save(state.data() + sizeof(header));
+            return state;
+        }
+
+        void HCLEnvironment::loadState(const std::vector<uint8_t> &state)
+        {
+            if (!emu)
+                throw std::runtime_error("Environment must be loaded with a ROM before loading state.");
+            SaveStateHeader header;
+            if (state.size() < sizeof(header))
+                throw std::invalid_argument("Not an emulator state.");
+            std::memcpy(&header, state.data(), sizeof(header));
+            if (std::memcmp(header.magic, kSaveStateMagic, sizeof(kSaveStateMagic)) != 0)
+                throw std::invalid_argument("Not an emulator state, or one saved by an older version without a header.");
+            if (header.version != kSaveStateVersion)
+                throw std::invalid_argument("Emulator state has unsupported version " + std::to_string(header.version) + ".");
+            if (header.size != emu->size() || state.size() != sizeof(header) + header.size)
+                throw std::invalid_argument("State size does not match this emulator.");
+            emu->load(const_cast<uint8_t *>(state.data()) + sizeof(header));
+        }
+
+        uint64_t HCLEnvironment::getStateHash() const
+        {
+            if (!emu)
+                throw std::runtime_error("Environment must be loaded with a ROM before hashing state.");
+            return emu->hash_state();
+        }
+
+        void HCLEnvironment::setRenderSkip(bool skip)
+        {
+            if (!emu)
+                throw std::runtime_error("Environment must be loaded with a ROM before setting render skip.");
+            emu->ppu.set_render_skip(skip);
+        }
+
+        std::vector<hcle::common::ProfileEntry> HCLEnvironment::getProfile() const
+        {
+            if (!emu)
+                throw std::runtime_error("Environment must be loaded with a ROM before getting the profile.");
+            const hcle::common::EmulatorProfile &profile = emu->profile;
+            const double ppu_seconds = profile.ppu.estimatedSeconds();
+            const double apu_seconds = profile.apu.estimatedSeconds();
+            const double mapper_seconds = profile.mapper.estimatedSeconds();
+            // The CPU ticks every other component, so it gets what they don't account for.
+            const double cpu_seconds = profile.step.estimatedSeconds() - ppu_seconds - apu_seconds;
+            return {
+                {"cpu", profile.instructions.calls, std::max(0.0, cpu_seconds)},
+                {"ppu", profile.ppu.calls, std::max(0.0, ppu_seconds - mapper_seconds)},
+                {"apu", profile.apu.calls, apu_seconds},
+                {"mapper", profile.mapper.calls, mapper_seconds},
+                {"emulate", m_emulate_profile.calls, m_emulate_profile.estimatedSeconds()},
+                {"game_logic", m_game_logic_profile.calls, m_game_logic_profile.estimatedSeconds()},
+                {"reset", m_reset_profile.calls, m_reset_profile.estimatedSeconds()},
+            };
+        }
+
+        void HCLEnvironment::resetProfile()
+        {
+            if (emu)
+                emu->profile = {};
+            m_emulate_profile = {};
+            m_game_logic_profile = {};
+            m_reset_profile = {};
+        }
+
         double HCLEnvironment::getReward() const
         {
             if (!game_logic)
@@ -156,6 +241,20 @@ namespace hcle
             return game_logic->getReward();
         }
 
+        std::vector<std::string> HCLEnvironment::getInfoNames() const
+        {
+            if (!game_logic)
+                throw std::runtime_error("Environment must be loaded with a ROM before getting info names.");
+            return game_logic->getInfoNames();
+        }
+
+        void HCLEnvironment::getInfo(int32_t *values) const
+        {
+            if (!game_logic)
+                throw std::runtime_error("Environment must be loaded with a ROM before getting info.");
+            game_logic->getInfo(values);
+        }
+
         bool HCLEnvironment::isDone()
         {
             return game_logic->isDone();
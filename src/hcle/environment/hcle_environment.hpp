@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstdint>
 #include <string>
 #include <vector>
 #include <memory>
@@ -8,6 +9,7 @@
 #include "hcle/games/game_logic.hpp"
 #include "hcle/common/exceptions.hpp"
 #include "hcle/common/display.hpp"
+#include "hcle/common/profiling.hpp"
 #include "hcle/games/smb1.hpp"
 #include "hcle/games/kungfu.hpp"
 #include "hcle/version.hpp"
@@ -31,6 +33,21 @@ namespace hcle
     using tp = std::chrono::steady_clock::time_point;
     using namespace std::chrono;
 
+    // Header of the snapshots saveState() returns. Bump kSaveStateVersion whenever the
+    // emulator's dump layout changes, so that older snapshots are rejected instead of being
+    // loaded into the wrong fields. Version 1 is the headerless layout before the mapper
+    // registers and palette cache were saved.
+    inline constexpr char kSaveStateMagic[8] = {'H', 'C', 'L', 'E', 'S', 'T', 'A', '\0'};
+    inline constexpr uint32_t kSaveStateVersion = 2;
+
+    struct SaveStateHeader
+    {
+      char magic[8];
+      uint32_t version;
+      uint32_t size; // Bytes of emulator state that follow
+    };
+    static_assert(sizeof(SaveStateHeader) == 16);
+
     class HCLEnvironment
     {
     public:
@@ -49,12 +66,31 @@ namespace hcle
       const std::vector<uint8_t> getActionSet() const;
       double getReward() const;
 
+      std::vector<std::string> getInfoNames() const;
+      void getInfo(int32_t *values) const;
+
       bool isDone();
       void reset();
 
       void saveToState(int state_num);
       void loadFromState(int state_num);
 
+      // Full emulator snapshots (SaveStateHeader + state), independent of the shared
+      // numbered save slots.
+      std::vector<uint8_t> saveState();
+      void loadState(const std::vector<uint8_t> &state);
+      // Hash of RAM and key PPU state (see cynes::NES::hash_state).
+      uint64_t getStateHash() const;
+      // Uses the PPU's approximate render-skip path, which is faster but not bit-exact.
+      void setRenderSkip(bool skip);
+
+      // Time per emulator component (cpu, ppu, apu, mapper; exclusive, adding up to the
+      // emulation time) and per phase (emulate, game_logic, reset; the game logic phase also
+      // holds any frames a game advances by itself). All zero unless built with
+      // HCLE_ENABLE_PROFILING.
+      std::vector<hcle::common::ProfileEntry> getProfile() const;
+      void resetProfile();
+
       const uint8_t *frame_ptr;
 
       std::unique_ptr<cynes::NES> emu;
@@ -79,6 +115,10 @@ namespace hcle
       uint8_t m_fps_limit = 0;
       milliseconds m_fps_sleep_ms;
       tp m_last_update;
+
+      hcle::common::ProfileCounter m_emulate_profile;
+      hcle::common::ProfileCounter m_game_logic_profile;
+      hcle::common::ProfileCounter m_reset_profile;
     };
 
   } // namespace environment
@@ -4,6 +4,7 @@
 #include <memory>
 #include <string>
 #include <functional>
+#include <span>
 
 #include "hcle/common/display.hpp"
 #include "hcle/environment/async_vectorizer.hpp"
@@ -14,6 +15,16 @@ namespace hcle::environment
     class HCLEVectorEnvironment
     {
     public:
+        // Caller-owned output arrays, registered once and reused by every reset()/recv()
+        // that doesn't pass buffers of its own. truncateds may be null.
+        struct OutputBuffers
+        {
+            uint8_t *obs = nullptr;
+            double *rewards = nullptr;
+            uint8_t *dones = nullptr;
+            uint8_t *truncateds = nullptr;
+        };
+
         HCLEVectorEnvironment(
             const int num_envs,
             const std::string &rom_path,
@@ -25,7 +36,10 @@ namespace hcle::environment
             const bool maxpool = false,
             const bool grayscale = true,
             const int stack_num = 4,
-            const bool color_index_grayscale = false)
+            const bool color_index_grayscale = false,
+            const int max_episode_steps = 0,
+            const std::string &autoreset_mode = "next_step",
+            const int num_result_buffers = 2)
             : m_render_mode(render_mode),
               m_grayscale(grayscale)
         {
@@ -38,7 +52,8 @@ namespace hcle::environment
             };
 
             // Create and own the vectorizer engine.
-            m_vectorizer = std::make_unique<AsyncVectorizer>(num_envs, env_factory);
+            m_vectorizer = std::make_unique<AsyncVectorizer>(num_envs, env_factory, max_episode_steps,
+                                                             parseAutoResetMode(autoreset_mode), num_result_buffers);
 
             // Only create a display window if in "human" mode.
             if (m_render_mode == "human")
@@ -48,12 +63,15 @@ namespace hcle::environment
             }
         }
 
-        void reset(uint8_t *obs_buffer, double *reward_buffer, uint8_t *done_buffer)
+        void reset(uint8_t *obs_buffer, double *reward_buffer, uint8_t *done_buffer, uint8_t *truncated_buffer = nullptr)
         {
-            m_vectorizer->reset(obs_buffer, reward_buffer, done_buffer);
+            m_vectorizer->reset(obs_buffer, reward_buffer, done_buffer, truncated_buffer);
         }
 
-        void send(const std::vector<int> &action_ids)
+        void send(const std::vector<int> &action_ids) { send(std::span<const int>(action_ids)); }
+
+        template <typename ActionT>
+        void send(std::span<const ActionT> action_ids)
         {
             if (m_render_mode == "human" && m_display && m_frame_ptr)
             {
@@ -62,9 +80,19 @@ namespace hcle::environment
             m_vectorizer->send(action_ids);
         }
 
-        void recv(uint8_t *obs_buffer, double *reward_buffer, uint8_t *done_buffer)
+        void recv(uint8_t *obs_buffer, double *reward_buffer, uint8_t *done_buffer, uint8_t *truncated_buffer = nullptr)
         {
-            m_vectorizer->recv(obs_buffer, reward_buffer, done_buffer);
+            m_vectorizer->recv(obs_buffer, reward_buffer, done_buffer, truncated_buffer);
+        }
+
+        void setOutputBuffers(const OutputBuffers &buffers) { m_output_buffers = buffers; }
+        const OutputBuffers &getOutputBuffers() const { return m_output_buffers; }
+
+        void stepMany(const uint8_t *actions, int num_steps, uint8_t *obs_buffer, double *reward_buffer,
+                      uint8_t *done_buffer, uint8_t *truncated_buffer = nullptr, uint8_t *final_obs_buffer = nullptr)
+        {
+            m_vectorizer->stepMany(actions, num_steps, obs_buffer, reward_buffer, done_buffer, truncated_buffer,
+                                   final_obs_buffer);
         }
 
         const std::vector<uint8_t> &getActionSet() const
@@ -77,18 +105,62 @@ namespace hcle::environment
             return m_vectorizer->getObservationSize();
         }
 
+        std::vector<size_t> getObservationShape() const { return m_vectorizer->getObservationShape(); }
+
         int getNumEnvs() const { return m_vectorizer->getNumEnvs(); }
+        int getMaxEpisodeSteps() const { return m_vectorizer->getMaxEpisodeSteps(); }
+        AutoResetMode getAutoResetMode() const { return m_vectorizer->getAutoResetMode(); }
+
+        int getNumResultBuffers() const { return m_vectorizer->getNumResultBuffers(); }
+        int getCurrentResultSlot() const { return m_vectorizer->getCurrentResultSlot(); }
+        const uint8_t *getResultObservations(int slot) const { return m_vectorizer->getResultObservations(slot); }
+        const double *getResultRewards(int slot) const { return m_vectorizer->getResultRewards(slot); }
+        const uint8_t *getResultDones(int slot) const { return m_vectorizer->getResultDones(slot); }
+        const uint8_t *getResultTruncateds(int slot) const { return m_vectorizer->getResultTruncateds(slot); }
+        const uint8_t *getResultActions() const { return m_vectorizer->getResultActions(); }
+
+        const uint8_t *getFinalObservations() const { return m_vectorizer->getFinalObservations(); }
+        const int32_t *getElapsedSteps() const { return m_vectorizer->getElapsedSteps(); }
+        const int64_t *getEpisodeCounts() const { return m_vectorizer->getEpisodeCounts(); }
+        const double *getEpisodeReturns() const { return m_vectorizer->getEpisodeReturns(); }
+        const double *getLastEpisodeReturns() const { return m_vectorizer->getLastEpisodeReturns(); }
+        const int32_t *getLastEpisodeLengths() const { return m_vectorizer->getLastEpisodeLengths(); }
+        const std::vector<std::string> &getInfoNames() const { return m_vectorizer->getInfoNames(); }
+        const int32_t *getGameInfo() const { return m_vectorizer->getGameInfo(); }
 
         void loadFromState(int state_num)
         {
             m_vectorizer->loadFromState(state_num);
         }
 
+        std::vector<common::ProfileEntry> getProfile() const { return m_vectorizer->getProfile(); }
+        void resetProfile() { m_vectorizer->resetProfile(); }
+
+        const common::LatencyHistogram &getStepLatency() const { return m_vectorizer->getStepLatency(); }
+        const common::LatencyHistogram &getBatchLatency() const { return m_vectorizer->getBatchLatency(); }
+        const common::LatencyHistogram &getQueueWaitLatency() const { return m_vectorizer->getQueueWaitLatency(); }
+        void resetLatencies() { m_vectorizer->resetLatencies(); }
+
+        void startRecording(const std::string &directory, const TrajectoryRecorderConfig &config = {})
+        {
+            m_vectorizer->startRecording(directory, config);
+        }
+        void stopRecording() { m_vectorizer->stopRecording(); }
+        bool isRecording() const { return m_vectorizer->isRecording(); }
+
+        void startActionLogs(const std::string &directory, int hash_interval = 64)
+        {
+            m_vectorizer->startActionLogs(directory, hash_interval);
+        }
+        void stopActionLogs() { m_vectorizer->stopActionLogs(); }
+        bool isLoggingActions() const { return m_vectorizer->isLoggingActions(); }
+
     private:
         std::unique_ptr<AsyncVectorizer> m_vectorizer;
         std::unique_ptr<hcle::common::Display> m_display;
         std::string m_render_mode;
         const uint8_t *m_frame_ptr = nullptr;
+        OutputBuffers m_output_buffers;
 
         bool m_grayscale;
     };
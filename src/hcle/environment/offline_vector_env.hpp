@@ -0,0 +1,182 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "hcle/common/thread_pool.hpp"
+#include "hcle/environment/frame_preprocessor.hpp"
+#include "hcle/environment/trajectory_dataset.hpp"
+
+namespace hcle::environment
+{
+    // Replays a RawFrames trajectory dataset through the FramePreprocessor pipeline behind
+    // AsyncVectorizer's reset/send/recv contract, so preprocessing settings can be evaluated
+    // and benchmarked without emulation.
+    //
+    // Env i plays episodes i, i + num_envs, ... of the dataset, wrapping around at the end.
+    // The recorded actions drive the replay: send() only checks the number of actions, and
+    // getResultActions() returns the recorded ones. Autoreset follows NextStep. An episode
+    // cut short by the end of the recording ends truncated.
+    class OfflineVectorEnv
+    {
+    public:
+        OfflineVectorEnv(const std::string &directory, const int num_envs, const int obs_height = 84,
+                         const int obs_width = 84, const int stack_num = 4, const bool maxpool = true)
+            : m_reader(directory), m_num_envs(num_envs)
+        {
+            if (num_envs <= 0)
+                throw std::invalid_argument("Number of environments must be positive.");
+            if (m_reader.getContent() != TrajectoryContent::RawFrames)
+                throw std::invalid_argument("'" + directory + "' does not hold raw frames; record it with the raw frames content.");
+            const auto &shape = m_reader.getObservationShape();
+            if (shape.size() < 3 || shape[0] < 1 || shape[0] > 2 ||
+                shape[1] != FramePreprocessor::kRawFrameHeight || shape[2] != FramePreprocessor::kRawFrameWidth)
+                throw std::runtime_error("'" + directory + "' has an unexpected raw frame shape.");
+            if (maxpool && shape[0] < 2)
+                throw std::invalid_argument("'" + directory + "' was recorded without maxpool, so its frames cannot be max-pooled.");
+            if (m_reader.getNumEpisodes() == 0)
+                throw std::runtime_error("'" + directory + "' contains no episodes.");
+
+            m_frames_per_record = shape[0];
+            const int channels = shape.size() == 4 ? static_cast<int>(shape[3]) : 1;
+            m_envs.reserve(num_envs);
+            for (int i = 0; i < num_envs; ++i)
+            {
+                m_envs.push_back({TrajectoryCursor(m_reader),
+                                  FramePreprocessor(obs_height, obs_width, channels, stack_num, maxpool),
+                                  std::vector<uint8_t>(m_reader.getObservationSize())});
+            }
+
+            m_obs.resize(num_envs * getObservationSize());
+            m_rewards.resize(num_envs);
+            m_dones.resize(num_envs);
+            m_truncateds.resize(num_envs);
+            m_actions.resize(num_envs);
+        }
+
+        ~OfflineVectorEnv()
+        {
+            // Let any in-flight work finish before the cursors are destroyed.
+            m_pool_client.wait();
+        }
+
+        // The cursors point into m_reader.
+        OfflineVectorEnv(const OfflineVectorEnv &) = delete;
+        OfflineVectorEnv &operator=(const OfflineVectorEnv &) = delete;
+
+        void reset(uint8_t *obs_buffer, double *reward_buffer, uint8_t *done_buffer, uint8_t *truncated_buffer = nullptr)
+        {
+            dispatch(true);
+            recv(obs_buffer, reward_buffer, done_buffer, truncated_buffer);
+        }
+
+        void send(std::span<const uint8_t> action_ids) { checkedDispatch(action_ids.size()); }
+        void send(std::span<const int32_t> action_ids) { checkedDispatch(action_ids.size()); }
+        void send(const std::vector<int> &action_ids) { checkedDispatch(action_ids.size()); }
+
+        // Any output may be null; the results can also be read in place with the getters
+        // below until the next send().
+        void recv(uint8_t *obs_buffer, double *reward_buffer, uint8_t *done_buffer, uint8_t *truncated_buffer = nullptr)
+        {
+            m_pool_client.wait();
+            if (obs_buffer)
+                std::memcpy(obs_buffer, m_obs.data(), m_obs.size());
+            if (reward_buffer)
+                std::copy(m_rewards.begin(), m_rewards.end(), reward_buffer);
+            if (done_buffer)
+                std::copy(m_dones.begin(), m_dones.end(), done_buffer);
+            if (truncated_buffer)
+                std::copy(m_truncateds.begin(), m_truncateds.end(), truncated_buffer);
+        }
+
+        const uint8_t *getObservations() const { return m_obs.data(); }
+        const double *getRewards() const { return m_rewards.data(); }
+        const uint8_t *getDones() const { return m_dones.data(); }
+        const uint8_t *getTruncateds() const { return m_truncateds.data(); }
+        // The recorded actions that produced the current results; kNoAction for resets.
+        const uint8_t *getResultActions() const { return m_actions.data(); }
+
+        int getNumEnvs() const { return m_num_envs; }
+        size_t getNumEpisodes() const { return m_reader.getNumEpisodes(); }
+        size_t getObservationSize() const { return m_envs[0].preprocessor.getObservationSize(); }
+        std::vector<size_t> getObservationShape() const { return m_envs[0].preprocessor.getObservationShape(); }
+
+    private:
+        struct EnvState
+        {
+            TrajectoryCursor cursor;
+            FramePreprocessor preprocessor;
+            std::vector<uint8_t> raw_frames; // One record: [frames_per_record, 240, 256(, 3)]
+            uint64_t episodes_started = 0;
+            bool needs_reset = true;
+        };
+
+        void checkedDispatch(size_t num_actions)
+        {
+            if (num_actions != static_cast<size_t>(m_num_envs))
+                throw std::runtime_error("Number of actions must equal number of environments.");
+            dispatch(false);
+        }
+
+        // Splits the envs over the shared pool; recv() waits for them.
+        void dispatch(bool force_reset)
+        {
+            const int num_jobs = std::min(m_num_envs, common::ThreadPool::instance().getNumThreads());
+            for (int job = 0; job < num_jobs; ++job)
+            {
+                m_pool_client.submit([this, job, num_jobs, force_reset]
+                                     {
+                                         for (int env_id = job; env_id < m_num_envs; env_id += num_jobs)
+                                             runEnv(env_id, force_reset); });
+            }
+        }
+
+        void runEnv(int env_id, bool force_reset)
+        {
+            EnvState &env = m_envs[env_id];
+            uint8_t *obs = m_obs.data() + env_id * getObservationSize();
+            const size_t frame_size = env.raw_frames.size() / m_frames_per_record;
+            const uint8_t *last_frame = env.raw_frames.data() + (m_frames_per_record - 1) * frame_size;
+
+            if (force_reset || env.needs_reset)
+            {
+                const uint64_t episode = (env_id + env.episodes_started++ * m_num_envs) % m_reader.getNumEpisodes();
+                env.cursor.seek(episode);
+                env.cursor.next(env.raw_frames.data());
+                env.preprocessor.reset(last_frame, obs);
+                env.needs_reset = env.cursor.atEnd();
+                m_rewards[env_id] = 0.0;
+                m_dones[env_id] = false;
+                m_truncateds[env_id] = false;
+                m_actions[env_id] = kNoAction;
+                return;
+            }
+
+            const TrajectoryStep step = env.cursor.next(env.raw_frames.data());
+            env.preprocessor.step(last_frame, m_frames_per_record > 1 ? env.raw_frames.data() : nullptr, obs);
+            env.needs_reset = env.cursor.atEnd();
+            m_rewards[env_id] = step.reward;
+            m_dones[env_id] = step.done;
+            m_truncateds[env_id] = step.truncated || (env.needs_reset && !step.done);
+            m_actions[env_id] = step.action;
+        }
+
+        TrajectoryReader m_reader;
+        int m_num_envs;
+        size_t m_frames_per_record = 1;
+        std::vector<EnvState> m_envs;
+
+        std::vector<uint8_t> m_obs;
+        std::vector<double> m_rewards;
+        std::vector<uint8_t> m_dones;
+        std::vector<uint8_t> m_truncateds;
+        std::vector<uint8_t> m_actions;
+
+        common::ThreadPool::Client m_pool_client;
+    };
+}
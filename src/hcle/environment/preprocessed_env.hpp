@@ -5,6 +5,7 @@
 #include <memory>
 #include <cstdint>
 
+#include "hcle/environment/frame_preprocessor.hpp"
 #include "hcle/environment/hcle_environment.hpp"
 
 namespace hcle::environment
@@ -27,48 +28,54 @@ namespace hcle::environment
 
     void step(uint8_t action_index, uint8_t *obs_output_buffer);
 
+    // Runs a step's frames without producing an observation.
+    void advance(uint8_t action_index);
+
     bool isDone() const { return m_done; }
     double getReward() const { return m_reward; }
     std::vector<uint8_t> getActionSet() const { return m_action_set; }
-    size_t getObservationSize() const { return m_stacked_obs_size; }
+    size_t getObservationSize() const { return m_preprocessor.getObservationSize(); }
+    // [stack, height, width] for grayscale, [stack, height, width, 3] for RGB.
+    std::vector<size_t> getObservationShape() const { return m_preprocessor.getObservationShape(); }
     const uint8_t *getFramePointer() const { return m_env->frame_ptr; }
+    // The raw frame before the last one of the latest step; only kept with maxpool.
+    const uint8_t *getPreviousFramePointer() const { return m_maxpool ? m_prev_frame.data() : nullptr; }
+    size_t getRawFrameSize() const { return m_preprocessor.getRawFrameSize(); }
+    bool usesMaxpool() const { return m_maxpool; }
+    std::vector<std::string> getInfoNames() const { return m_env->getInfoNames(); }
+    void getInfo(int32_t *values) const { m_env->getInfo(values); }
 
     void saveToState(int state_num);
     void loadFromState(int state_num);
 
+    std::vector<uint8_t> saveState() { return m_env->saveState(); }
+    void loadState(const std::vector<uint8_t> &state) { m_env->loadState(state); }
+    uint64_t getStateHash() const { return m_env->getStateHash(); }
+    void setRenderSkip(bool skip) { m_env->setRenderSkip(skip); }
+    const std::string &getGameName() const { return m_game_name; }
+    int getFrameSkip() const { return m_frame_skip; }
+
+    // HCLEnvironment::getProfile() plus the preprocess phase of reset() and step().
+    std::vector<hcle::common::ProfileEntry> getProfile() const;
+    void resetProfile();
+
     void createWindow(uint8_t fps_limit = 0);
     void updateWindow();
 
   private:
-    void processScreen();
-
-    void writeObservation(uint8_t *obs_output_buffer);
-
-    int m_obs_height;
-    int m_obs_width;
+    std::string m_game_name;
     int m_frame_skip;
     bool m_maxpool;
-    bool m_grayscale;
-    int m_stack_num;
-
-    bool m_requires_resize;
 
     std::unique_ptr<HCLEnvironment> m_env;
     std::vector<uint8_t> m_action_set;
+    FramePreprocessor m_preprocessor;
 
     double m_reward;
     bool m_done;
 
-    // Buffers and dimensions
-    const int m_raw_frame_height = 240;
-    const int m_raw_frame_width = 256;
-    int m_channels_per_frame;
-    size_t m_raw_size; // Size of a single raw RGB frame from the emulator
-    size_t m_obs_size; // Size of a single processed (resized, grayscale) observation frame
-    size_t m_stacked_obs_size;
-
-    std::vector<uint8_t> m_prev_frame;  // Previous frame for max-pooling
-    std::vector<uint8_t> m_frame_stack; // Circular buffer for stacked processed frames
-    int m_frame_stack_idx;
+    std::vector<uint8_t> m_prev_frame; // Previous frame for max-pooling
+
+    hcle::common::ProfileCounter m_preprocess_profile;
   };
 }
@@ -0,0 +1,278 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "hcle/common/thread_pool.hpp"
+
+namespace hcle::environment
+{
+    // Replay buffer for frame-stacked observations that stores each env's newest frame
+    // once and rebuilds the [stack_num, ...] observations at sample time, so it needs
+    // about 1/stack_num of the memory of storing (obs, next_obs) pairs.
+    //
+    // Each env has its own ring of rows. A row holds one frame plus how the env arrived at
+    // it: the action taken from the previous row, the reward and the terminated/truncated
+    // flags, or an episode-start marker for reset observations. Frames before the start of
+    // an episode are filled with its first frame, as PreprocessedEnv does on reset.
+    //
+    // add() and sample() must not run concurrently; sample() spreads the stack rebuilding
+    // over the shared thread pool.
+    class ReplayBuffer
+    {
+    public:
+        ReplayBuffer(size_t capacity, int num_envs, const std::vector<size_t> &obs_shape, uint64_t seed = 0)
+            : m_num_envs(num_envs), m_obs_shape(obs_shape), m_rng(seed)
+        {
+            if (num_envs <= 0)
+                throw std::invalid_argument("Number of environments must be positive.");
+            if (obs_shape.size() < 2 || obs_shape[0] == 0)
+                throw std::invalid_argument("obs_shape must be [stack_num, ...].");
+            if (capacity < static_cast<size_t>(num_envs) * (obs_shape[0] + 1))
+                throw std::invalid_argument("Capacity must hold at least stack_num + 1 frames per environment.");
+
+            m_stack_num = obs_shape[0];
+            m_frame_size = 1;
+            for (size_t i = 1; i < obs_shape.size(); ++i)
+                m_frame_size *= obs_shape[i];
+            m_env_capacity = (capacity + num_envs - 1) / num_envs;
+
+            const size_t rows = m_env_capacity * num_envs;
+            m_frames.resize(rows * m_frame_size);
+            m_actions.resize(rows);
+            m_rewards.resize(rows);
+            m_flags.resize(rows);
+            m_counts.resize(num_envs, 0);
+            m_started.resize(num_envs, 0);
+            m_episode_over.resize(num_envs, 0);
+        }
+
+        // Adds one batch of vectorizer results. actions is null for the results of reset();
+        // truncateds may be null; final_obs holds terminal observations under SameStep
+        // autoreset. Observations are [num_envs, stack_num, ...]; only the newest frame of
+        // each is stored.
+        void add(const uint8_t *obs, const uint8_t *actions, const double *rewards, const uint8_t *dones,
+                 const uint8_t *truncateds = nullptr, const uint8_t *final_obs = nullptr)
+        {
+            if (actions && std::find(m_started.begin(), m_started.end(), 0) != m_started.end())
+                throw std::runtime_error("Add the results of reset() before adding steps.");
+
+            const size_t obs_size = getObservationSize();
+            const size_t newest = (m_stack_num - 1) * m_frame_size;
+            for (int env = 0; env < m_num_envs; ++env)
+            {
+                const uint8_t *frame = obs + env * obs_size + newest;
+                if (!actions || m_episode_over[env])
+                {
+                    // A reset, or the NextStep autoreset after an episode ended.
+                    pushRow(env, frame, 0, 0.0, kEpisodeStart);
+                    m_started[env] = 1;
+                    m_episode_over[env] = 0;
+                    continue;
+                }
+
+                const bool truncated = truncateds && truncateds[env];
+                const uint8_t flags = (dones[env] ? kTerminated : 0) | (truncated ? kTruncated : 0);
+                if (flags && final_obs)
+                {
+                    // SameStep autoreset: obs already starts the next episode.
+                    pushRow(env, final_obs + env * obs_size + newest, actions[env], rewards[env], flags);
+                    pushRow(env, frame, 0, 0.0, kEpisodeStart);
+                }
+                else
+                {
+                    pushRow(env, frame, actions[env], rewards[env], flags);
+                    m_episode_over[env] = flags != 0;
+                }
+            }
+        }
+
+        // Samples batch_size transitions uniformly into caller buffers: obs and next_obs are
+        // [batch_size, stack_num, ...], the rest [batch_size]. Any output may be null.
+        void sample(size_t batch_size, uint8_t *obs, uint8_t *actions, double *rewards, uint8_t *next_obs,
+                    uint8_t *terminateds, uint8_t *truncateds)
+        {
+            drawSamples(batch_size);
+
+            const size_t obs_size = getObservationSize();
+            auto fill = [&](size_t begin, size_t end)
+            {
+                for (size_t i = begin; i < end; ++i)
+                {
+                    const auto [env, row] = m_samples[i];
+                    const size_t next = slot(env, row + 1);
+                    if (obs)
+                        buildStack(env, row, obs + i * obs_size);
+                    if (next_obs)
+                        buildStack(env, row + 1, next_obs + i * obs_size);
+                    if (actions)
+                        actions[i] = m_actions[next];
+                    if (rewards)
+                        rewards[i] = m_rewards[next];
+                    if (terminateds)
+                        terminateds[i] = (m_flags[next] & kTerminated) != 0;
+                    if (truncateds)
+                        truncateds[i] = (m_flags[next] & kTruncated) != 0;
+                }
+            };
+
+            // Chunks of at least kMinSamplesPerTask keep small batches on one thread.
+            const size_t num_tasks = std::min<size_t>(common::ThreadPool::instance().getNumThreads(),
+                                                      (batch_size + kMinSamplesPerTask - 1) / kMinSamplesPerTask);
+            if (num_tasks <= 1)
+            {
+                fill(0, batch_size);
+                return;
+            }
+            const size_t per_task = (batch_size + num_tasks - 1) / num_tasks;
+            m_pool_client.parallelFor(static_cast<int>(num_tasks), [&](int task)
+                                      { fill(task * per_task, std::min(batch_size, (task + 1) * per_task)); });
+        }
+
+        void clear()
+        {
+            std::fill(m_counts.begin(), m_counts.end(), 0);
+            std::fill(m_started.begin(), m_started.end(), 0);
+            std::fill(m_episode_over.begin(), m_episode_over.end(), 0);
+        }
+
+        // Number of frames currently stored, over all envs.
+        size_t size() const
+        {
+            size_t total = 0;
+            for (uint64_t count : m_counts)
+                total += std::min<uint64_t>(count, m_env_capacity);
+            return total;
+        }
+
+        size_t getCapacity() const { return m_env_capacity * m_num_envs; }
+        int getNumEnvs() const { return m_num_envs; }
+        size_t getStackNum() const { return m_stack_num; }
+        size_t getFrameSize() const { return m_frame_size; }
+        size_t getObservationSize() const { return m_stack_num * m_frame_size; }
+        const std::vector<size_t> &getObservationShape() const { return m_obs_shape; }
+        size_t getMemoryUsage() const
+        {
+            return m_frames.size() + m_actions.size() + m_rewards.size() * sizeof(double) + m_flags.size();
+        }
+
+    private:
+        static constexpr uint8_t kEpisodeStart = 1;
+        static constexpr uint8_t kTerminated = 2;
+        static constexpr uint8_t kTruncated = 4;
+        static constexpr size_t kMinSamplesPerTask = 32;
+        static constexpr int kMaxDrawAttempts = 1000;
+
+        struct Sample
+        {
+            int env;
+            uint64_t row; // Absolute row index for the env
+        };
+
+        size_t slot(int env, uint64_t row) const
+        {
+            return static_cast<size_t>(env) * m_env_capacity + static_cast<size_t>(row % m_env_capacity);
+        }
+
+        uint64_t oldestRow(int env) const
+        {
+            return m_counts[env] - std::min<uint64_t>(m_counts[env], m_env_capacity);
+        }
+
+        void pushRow(int env, const uint8_t *frame, uint8_t action, double reward, uint8_t flags)
+        {
+            const size_t index = slot(env, m_counts[env]++);
+            std::memcpy(m_frames.data() + index * m_frame_size, frame, m_frame_size);
+            m_actions[index] = action;
+            m_rewards[index] = reward;
+            m_flags[index] = flags;
+        }
+
+        // A row can start a transition if its successor continues the same episode and
+        // every frame of its stack is still stored.
+        bool isSampleable(int env, uint64_t row) const
+        {
+            if (row + 1 >= m_counts[env] || (m_flags[slot(env, row + 1)] & kEpisodeStart))
+                return false;
+            const uint64_t oldest = oldestRow(env);
+            for (size_t k = 0; k + 1 < m_stack_num; ++k)
+            {
+                if (m_flags[slot(env, row - k)] & kEpisodeStart)
+                    return true;
+                if (row - k == oldest)
+                    return false;
+            }
+            return true;
+        }
+
+        void buildStack(int env, uint64_t row, uint8_t *out) const
+        {
+            // first: the earliest frame of this episode within reach of the stack.
+            uint64_t first = row;
+            while (row - first + 1 < m_stack_num && !(m_flags[slot(env, first)] & kEpisodeStart))
+                first--;
+            for (size_t j = 0; j < m_stack_num; ++j)
+            {
+                const uint64_t back = m_stack_num - 1 - j;
+                const uint64_t source = row - first >= back ? row - back : first;
+                std::memcpy(out + j * m_frame_size, m_frames.data() + slot(env, source) * m_frame_size, m_frame_size);
+            }
+        }
+
+        void drawSamples(size_t batch_size)
+        {
+            const size_t total = size();
+            if (total == 0)
+                throw std::runtime_error("Cannot sample from an empty replay buffer.");
+
+            std::uniform_int_distribution<size_t> pick(0, total - 1);
+            m_samples.resize(batch_size);
+            for (auto &sample : m_samples)
+            {
+                int attempts = 0;
+                while (true)
+                {
+                    // Map a uniform draw over all stored rows to (env, row).
+                    size_t offset = pick(m_rng);
+                    int env = 0;
+                    while (offset >= std::min<uint64_t>(m_counts[env], m_env_capacity))
+                        offset -= std::min<uint64_t>(m_counts[env++], m_env_capacity);
+                    const uint64_t row = oldestRow(env) + offset;
+                    if (isSampleable(env, row))
+                    {
+                        sample = {env, row};
+                        break;
+                    }
+                    if (++attempts == kMaxDrawAttempts)
+                        throw std::runtime_error("The replay buffer does not hold enough complete transitions to sample from.");
+                }
+            }
+        }
+
+        int m_num_envs;
+        std::vector<size_t> m_obs_shape;
+        size_t m_stack_num;
+        size_t m_frame_size;
+        size_t m_env_capacity;
+
+        // Rows laid out [num_envs, env_capacity]; m_counts[env] is the number of rows ever
+        // written for env, so its live rows are [count - min(count, capacity), count).
+        std::vector<uint8_t> m_frames;
+        std::vector<uint8_t> m_actions;
+        std::vector<double> m_rewards;
+        std::vector<uint8_t> m_flags;
+        std::vector<uint64_t> m_counts;
+        std::vector<uint8_t> m_started;
+        std::vector<uint8_t> m_episode_over;
+
+        std::mt19937_64 m_rng;
+        std::vector<Sample> m_samples;
+        common::ThreadPool::Client m_pool_client;
+    };
+}
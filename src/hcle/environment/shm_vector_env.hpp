@@ -0,0 +1,511 @@
+#pragma once
+
+// Multi-process vectorizer: a ShmVectorEnvironment spawns hcle_shm_worker processes, each
+// of which hosts an AsyncVectorizer over a contiguous slice of the envs. Actions, observations,
+// rewards and dones live in one POSIX shared memory region. The workers' vectorizers use the
+// region as their result storage, so results are written straight into the memory the client
+// (and NumPy, through the bindings) reads. Workers also publish the terminal observation (in
+// same_step autoreset mode) and the return and length of every episode that ends.
+//
+// A step is one round trip on two futex words in the region header: the client writes the
+// actions and bumps command_seq; each worker runs its slice and bumps completed; the worker
+// that brings completed to command_seq * num_workers wakes the client.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <signal.h>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "hcle/common/shared_memory.hpp"
+#include "hcle/environment/async_vectorizer.hpp"
+
+extern char **environ;
+
+namespace hcle::environment
+{
+    enum class ShmCommand : uint32_t
+    {
+        Reset = 0,
+        Step = 1,
+        Shutdown = 2
+    };
+
+    struct ShmEnvConfig
+    {
+        char game_name[64];
+        int32_t obs_height;
+        int32_t obs_width;
+        int32_t frame_skip;
+        int32_t stack_num;
+        int32_t max_episode_steps;
+        int32_t threads_per_worker;
+        uint8_t maxpool;
+        uint8_t grayscale;
+        uint8_t color_index_grayscale;
+        uint8_t same_step_autoreset;
+    };
+
+    struct ShmHeader
+    {
+        static constexpr uint32_t kMagic = 0x48434C45; // "HCLE"
+        static constexpr uint32_t kVersion = 2;
+
+        uint32_t magic;
+        uint32_t version;
+        int32_t num_envs;
+        int32_t num_workers;
+        uint64_t obs_size;
+        uint64_t actions_offset;
+        uint64_t obs_offset;
+        uint64_t rewards_offset;
+        uint64_t dones_offset;
+        uint64_t truncateds_offset;
+        uint64_t final_obs_offset;       // Terminal observations of same_step autoresets
+        uint64_t episode_returns_offset; // Return and length of each env's last finished episode
+        uint64_t episode_lengths_offset;
+        ShmEnvConfig config;
+
+        // Published by worker 0 once its envs are built.
+        int32_t num_actions;
+        uint8_t action_set[256];
+
+        // Client -> workers. command is written before command_seq is released.
+        alignas(64) std::atomic<uint32_t> command_seq;
+        uint32_t command;
+
+        // Workers -> client. failed is kShmErrorWriting while a worker fills in error, then
+        // kShmErrorSet.
+        alignas(64) std::atomic<uint32_t> completed;
+        std::atomic<uint32_t> ready_workers;
+        std::atomic<uint32_t> failed;
+        char error[256];
+    };
+
+    inline constexpr size_t kShmAlignment = 64;
+    inline constexpr uint32_t kShmErrorWriting = 1;
+    inline constexpr uint32_t kShmErrorSet = 2;
+
+    inline size_t alignShmOffset(size_t offset)
+    {
+        return (offset + kShmAlignment - 1) / kShmAlignment * kShmAlignment;
+    }
+
+    // Fills in the header's array offsets and returns the total region size.
+    inline size_t layoutShmRegion(ShmHeader &header)
+    {
+        const size_t num_envs = static_cast<size_t>(header.num_envs);
+        size_t offset = alignShmOffset(sizeof(ShmHeader));
+        header.actions_offset = offset;
+        offset = alignShmOffset(offset + num_envs);
+        header.obs_offset = offset;
+        offset = alignShmOffset(offset + num_envs * header.obs_size);
+        header.rewards_offset = offset;
+        offset = alignShmOffset(offset + num_envs * sizeof(double));
+        header.dones_offset = offset;
+        offset = alignShmOffset(offset + num_envs);
+        header.truncateds_offset = offset;
+        offset = alignShmOffset(offset + num_envs);
+        header.final_obs_offset = offset;
+        offset = alignShmOffset(offset + num_envs * header.obs_size);
+        header.episode_returns_offset = offset;
+        offset = alignShmOffset(offset + num_envs * sizeof(double));
+        header.episode_lengths_offset = offset;
+        return alignShmOffset(offset + num_envs * sizeof(int32_t));
+    }
+
+    // Keeps the first error. The text is complete before the client can see kShmErrorSet.
+    inline void reportShmError(ShmHeader *header, const char *message)
+    {
+        uint32_t expected = 0;
+        if (header->failed.compare_exchange_strong(expected, kShmErrorWriting, std::memory_order_acquire))
+        {
+            std::strncpy(header->error, message, sizeof(header->error) - 1);
+            header->error[sizeof(header->error) - 1] = '\0';
+            header->failed.store(kShmErrorSet, std::memory_order_release);
+        }
+    }
+
+    // Body of the hcle_shm_worker executable: serves envs [begin, end) of the region until
+    // told to shut down or the parent process goes away.
+    inline int runShmWorker(const std::string &shm_name, int worker_id)
+    {
+        common::SharedMemoryRegion region(shm_name);
+        auto *base = static_cast<uint8_t *>(region.data());
+        auto *header = reinterpret_cast<ShmHeader *>(base);
+        if (header->magic != ShmHeader::kMagic || header->version != ShmHeader::kVersion)
+            throw std::runtime_error("Shared memory region " + shm_name + " has an unexpected layout.");
+
+        const ShmEnvConfig config = header->config;
+        const int num_envs = header->num_envs;
+        const int num_workers = header->num_workers;
+        const int begin = static_cast<int>(static_cast<int64_t>(worker_id) * num_envs / num_workers);
+        const int end = static_cast<int>(static_cast<int64_t>(worker_id + 1) * num_envs / num_workers);
+        const pid_t parent = getppid();
+
+        std::unique_ptr<AsyncVectorizer> vectorizer;
+        try
+        {
+            if (config.threads_per_worker > 0)
+                common::ThreadPool::instance().setNumThreads(config.threads_per_worker);
+
+            const std::string game_name(config.game_name);
+            auto env_factory = [&]([[maybe_unused]] int env_id)
+            {
+                return std::make_unique<PreprocessedEnv>(
+                    "", game_name, config.obs_height, config.obs_width, config.frame_skip,
+                    config.maxpool, config.grayscale, config.stack_num, config.color_index_grayscale);
+            };
+            vectorizer = std::make_unique<AsyncVectorizer>(
+                end - begin, env_factory, config.max_episode_steps,
+                config.same_step_autoreset ? AutoResetMode::SameStep : AutoResetMode::NextStep, 1);
+
+            if (worker_id == 0)
+            {
+                const auto &action_set = vectorizer->getActionSet();
+                std::copy(action_set.begin(), action_set.end(), header->action_set);
+                header->num_actions = static_cast<int32_t>(action_set.size());
+            }
+        }
+        catch (const std::exception &e)
+        {
+            reportShmError(header, e.what());
+        }
+        header->ready_workers.fetch_add(1, std::memory_order_acq_rel);
+        common::futexWakeAll(&header->ready_workers);
+        if (!vectorizer)
+            return 1;
+
+        const size_t obs_size = header->obs_size;
+        const uint8_t *actions = base + header->actions_offset + begin;
+        const uint8_t *dones = base + header->dones_offset + begin;
+        const uint8_t *truncateds = base + header->truncateds_offset + begin;
+        uint8_t *final_obs = base + header->final_obs_offset + begin * obs_size;
+        double *episode_returns = reinterpret_cast<double *>(base + header->episode_returns_offset) + begin;
+        int32_t *episode_lengths = reinterpret_cast<int32_t *>(base + header->episode_lengths_offset) + begin;
+        vectorizer->attachResultStorage(base + header->obs_offset + begin * obs_size,
+                                        reinterpret_cast<double *>(base + header->rewards_offset) + begin,
+                                        base + header->dones_offset + begin, base + header->truncateds_offset + begin);
+
+        uint32_t seen = 0;
+        while (true)
+        {
+            uint32_t seq;
+            while ((seq = header->command_seq.load(std::memory_order_acquire)) == seen)
+            {
+                common::futexWait(&header->command_seq, seen, 1000);
+                if (getppid() != parent)
+                    return 0;
+            }
+            seen = seq;
+
+            const auto command = static_cast<ShmCommand>(header->command);
+            if (command == ShmCommand::Shutdown)
+                return 0;
+
+            try
+            {
+                if (command == ShmCommand::Reset)
+                {
+                    vectorizer->reset(nullptr, nullptr, nullptr);
+                }
+                else
+                {
+                    vectorizer->send(std::span<const uint8_t>(actions, end - begin));
+                    vectorizer->recv(nullptr, nullptr, nullptr);
+
+                    // Only the envs whose episode just ended have anything new to publish.
+                    for (int i = 0; i < end - begin; ++i)
+                    {
+                        if (!dones[i] && !truncateds[i])
+                            continue;
+                        episode_returns[i] = vectorizer->getLastEpisodeReturns()[i];
+                        episode_lengths[i] = vectorizer->getLastEpisodeLengths()[i];
+                        if (config.same_step_autoreset)
+                            std::memcpy(final_obs + i * obs_size, vectorizer->getFinalObservations() + i * obs_size,
+                                        obs_size);
+                    }
+                }
+            }
+            catch (const std::exception &e)
+            {
+                reportShmError(header, e.what());
+            }
+
+            const uint32_t target = seen * static_cast<uint32_t>(num_workers);
+            if (header->completed.fetch_add(1, std::memory_order_acq_rel) + 1 == target)
+                common::futexWakeAll(&header->completed);
+        }
+    }
+
+    class ShmVectorEnvironment
+    {
+    public:
+        ShmVectorEnvironment(
+            const std::string &worker_path,
+            const int num_envs,
+            const int num_workers,
+            const std::string &game_name,
+            const int obs_height = 84,
+            const int obs_width = 84,
+            const int frame_skip = 4,
+            const bool maxpool = false,
+            const bool grayscale = true,
+            const int stack_num = 4,
+            const bool color_index_grayscale = false,
+            const int max_episode_steps = 0,
+            const std::string &autoreset_mode = "next_step",
+            const int threads_per_worker = 0)
+            : m_num_envs(num_envs),
+              m_num_workers(num_workers)
+        {
+            if (num_envs <= 0)
+                throw std::invalid_argument("Number of environments must be positive.");
+            if (num_workers <= 0 || num_workers > num_envs)
+                throw std::invalid_argument("Number of workers must be between 1 and the number of environments.");
+            if (game_name.size() >= sizeof(ShmEnvConfig::game_name))
+                throw std::invalid_argument("Game name is too long.");
+
+            // Lay the region out in a scratch header first to learn its size.
+            auto layout = std::make_unique<ShmHeader>();
+            layout->num_envs = num_envs;
+            layout->obs_size = static_cast<uint64_t>(stack_num) * obs_height * obs_width * (grayscale ? 1 : 3);
+            const size_t region_size = layoutShmRegion(*layout);
+
+            static std::atomic<int> s_region_counter{0};
+            const std::string name = "/hcle_" + std::to_string(getpid()) + "_" + std::to_string(s_region_counter++);
+            m_region = std::make_unique<common::SharedMemoryRegion>(name, region_size);
+            m_base = static_cast<uint8_t *>(m_region->data());
+
+            // The new mapping is zero-filled, which is a valid state for every atomic.
+            m_header = new (m_base) ShmHeader();
+            m_same_step_autoreset = parseAutoResetMode(autoreset_mode) == AutoResetMode::SameStep;
+            m_header->magic = ShmHeader::kMagic;
+            m_header->version = ShmHeader::kVersion;
+            m_header->num_envs = num_envs;
+            m_header->num_workers = num_workers;
+            m_header->obs_size = layout->obs_size;
+            layoutShmRegion(*m_header);
+            ShmEnvConfig &config = m_header->config;
+            std::strncpy(config.game_name, game_name.c_str(), sizeof(config.game_name) - 1);
+            config.obs_height = obs_height;
+            config.obs_width = obs_width;
+            config.frame_skip = frame_skip;
+            config.stack_num = stack_num;
+            config.max_episode_steps = max_episode_steps;
+            config.threads_per_worker = threads_per_worker > 0
+                                            ? threads_per_worker
+                                            : std::max(1, common::ThreadPool::defaultNumThreads() / num_workers);
+            config.maxpool = maxpool;
+            config.grayscale = grayscale;
+            config.color_index_grayscale = color_index_grayscale;
+            config.same_step_autoreset = m_same_step_autoreset;
+
+            try
+            {
+                spawnWorkers(worker_path);
+            }
+            catch (...)
+            {
+                shutdownWorkers();
+                throw;
+            }
+        }
+
+        ~ShmVectorEnvironment() { shutdownWorkers(); }
+
+        ShmVectorEnvironment(const ShmVectorEnvironment &) = delete;
+        ShmVectorEnvironment &operator=(const ShmVectorEnvironment &) = delete;
+
+        // Results are written in place; read them through the get*() pointers, which stay
+        // valid for the lifetime of this object and are refreshed by every reset()/recv().
+        // Every send() must be followed by a recv() before the next send() or reset().
+        void reset()
+        {
+            issue(ShmCommand::Reset);
+            waitForWorkers();
+        }
+
+        void send(std::span<const uint8_t> action_ids) { queueActions(action_ids); }
+        void send(std::span<const int32_t> action_ids) { queueActions(action_ids); }
+
+        void recv() { waitForWorkers(); }
+
+        std::vector<uint8_t> getActionSet() const
+        {
+            return std::vector<uint8_t>(m_header->action_set, m_header->action_set + m_header->num_actions);
+        }
+
+        int getNumEnvs() const { return m_num_envs; }
+        int getNumWorkers() const { return m_num_workers; }
+        bool usesSameStepAutoreset() const { return m_same_step_autoreset; }
+        size_t getObservationSize() const { return m_header->obs_size; }
+        const std::string &getSharedMemoryName() const { return m_region->name(); }
+
+        const uint8_t *getObservations() const { return m_base + m_header->obs_offset; }
+        const double *getRewards() const { return reinterpret_cast<const double *>(m_base + m_header->rewards_offset); }
+        const uint8_t *getDones() const { return m_base + m_header->dones_offset; }
+        const uint8_t *getTruncateds() const { return m_base + m_header->truncateds_offset; }
+
+        // Only the entries of envs whose episode has ended are written; each keeps its value
+        // until that env's next episode ends. Final observations are only kept in same_step
+        // autoreset mode.
+        const uint8_t *getFinalObservations() const { return m_base + m_header->final_obs_offset; }
+        const double *getLastEpisodeReturns() const
+        {
+            return reinterpret_cast<const double *>(m_base + m_header->episode_returns_offset);
+        }
+        const int32_t *getLastEpisodeLengths() const
+        {
+            return reinterpret_cast<const int32_t *>(m_base + m_header->episode_lengths_offset);
+        }
+
+    private:
+        template <typename ActionT>
+        void queueActions(std::span<const ActionT> action_ids)
+        {
+            if (static_cast<int>(action_ids.size()) != m_num_envs)
+                throw std::runtime_error("Number of actions must equal number of environments.");
+            // The workers may still be reading the actions of the step in flight.
+            checkNotInFlight();
+
+            uint8_t *actions = m_base + m_header->actions_offset;
+            for (int i = 0; i < m_num_envs; ++i)
+            {
+                const ActionT action = action_ids[i];
+                if (std::cmp_less(action, 0) || std::cmp_greater_equal(action, m_header->num_actions))
+                    throw std::invalid_argument("Action " + std::to_string(action) + " for env " +
+                                                std::to_string(i) + " is out of range.");
+                actions[i] = static_cast<uint8_t>(action);
+            }
+            issue(ShmCommand::Step);
+        }
+
+        void issue(ShmCommand command)
+        {
+            if (command != ShmCommand::Shutdown)
+            {
+                checkNotInFlight();
+                m_in_flight = true;
+            }
+            m_header->command = static_cast<uint32_t>(command);
+            m_seq++;
+            m_header->command_seq.store(m_seq, std::memory_order_release);
+            common::futexWakeAll(&m_header->command_seq);
+        }
+
+        // Workers only ever run the latest command, so a second one would never complete.
+        void checkNotInFlight() const
+        {
+            if (m_in_flight)
+                throw std::logic_error("send() or reset() called while a step is in flight; recv() it first.");
+        }
+
+        void waitForWorkers()
+        {
+            const uint32_t target = m_seq * static_cast<uint32_t>(m_num_workers);
+            uint32_t completed;
+            while ((completed = m_header->completed.load(std::memory_order_acquire)) != target)
+            {
+                common::futexWait(&m_header->completed, completed, 100);
+                checkWorkersAlive();
+            }
+            m_in_flight = false;
+            rethrowWorkerError();
+        }
+
+        void spawnWorkers(const std::string &worker_path)
+        {
+            const std::string &name = m_region->name();
+            for (int worker_id = 0; worker_id < m_num_workers; ++worker_id)
+            {
+                std::string id = std::to_string(worker_id);
+                char *argv[] = {const_cast<char *>(worker_path.c_str()), const_cast<char *>(name.c_str()),
+                                const_cast<char *>(id.c_str()), nullptr};
+                pid_t pid;
+                const int err = posix_spawnp(&pid, worker_path.c_str(), nullptr, nullptr, argv, environ);
+                if (err != 0)
+                {
+                    throw std::runtime_error("Could not start shm worker '" + worker_path + "': " + std::strerror(err));
+                }
+                m_workers.push_back(pid);
+            }
+
+            uint32_t ready;
+            while ((ready = m_header->ready_workers.load(std::memory_order_acquire)) != static_cast<uint32_t>(m_num_workers))
+            {
+                common::futexWait(&m_header->ready_workers, ready, 100);
+                checkWorkersAlive();
+            }
+            rethrowWorkerError();
+        }
+
+        void shutdownWorkers()
+        {
+            issue(ShmCommand::Shutdown);
+            for (pid_t pid : m_workers)
+            {
+                if (pid <= 0)
+                    continue;
+                // Give workers a moment to exit cleanly, then make sure they're gone.
+                int status;
+                for (int i = 0; i < 200 && waitpid(pid, &status, WNOHANG) == 0; ++i)
+                    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+                if (waitpid(pid, &status, WNOHANG) == 0)
+                {
+                    kill(pid, SIGKILL);
+                    waitpid(pid, &status, 0);
+                }
+            }
+            m_workers.clear();
+        }
+
+        void checkWorkersAlive()
+        {
+            for (size_t i = 0; i < m_workers.size(); ++i)
+            {
+                int status;
+                if (m_workers[i] > 0 && waitpid(m_workers[i], &status, WNOHANG) == m_workers[i])
+                {
+                    m_workers[i] = -1;
+                    rethrowWorkerError();
+                    throw std::runtime_error("shm worker " + std::to_string(i) + " exited unexpectedly.");
+                }
+            }
+        }
+
+        void rethrowWorkerError()
+        {
+            if (m_header->failed.load(std::memory_order_acquire) == kShmErrorSet)
+            {
+                std::string message(m_header->error);
+                m_header->error[0] = '\0';
+                m_header->failed.store(0, std::memory_order_release);
+                throw std::runtime_error("shm worker failed: " + message);
+            }
+        }
+
+        int m_num_envs;
+        int m_num_workers;
+        std::unique_ptr<common::SharedMemoryRegion> m_region;
+        uint8_t *m_base = nullptr;
+        ShmHeader *m_header = nullptr;
+        std::vector<pid_t> m_workers;
+        uint32_t m_seq = 0;
+        bool m_in_flight = false;
+        bool m_same_step_autoreset = false;
+    };
+}
@@ -0,0 +1,714 @@
+#pragma once
+
+// On-disk trajectory dataset written by TrajectoryRecorder and read by TrajectoryReader.
+//
+// A dataset is a directory of chunk files chunk_000000.hclt, chunk_000001.hclt, ... Each
+// chunk is created at a fixed capacity, memory-mapped, filled front to back and trimmed
+// to its used length when sealed:
+//
+//   TrajectoryChunkHeader
+//   records: TrajectoryRecordHeader, frame record (see common/frame_codec.hpp), padding
+//            to 8 bytes
+//   index:   TrajectoryIndexEntry[num_records] (sealed chunks only)
+//
+// A record is one env's observation after one step, with the action that produced it and
+// the resulting reward/done/truncated. In RawFrames datasets the "observation" is instead
+// the emulator frames the step ended on, [1 or 2, 240, 256(, 3)], for re-preprocessing
+// with OfflineVectorEnv. Every episode starts at step 0 with action kNoAction (the reset
+// observation). Frames are delta-coded against the same env's previous record, which for
+// stacked observations is first shifted by one frame of the stack (version 2; version 1
+// datasets are read without the shift). An env's first record in each chunk, the first of
+// each episode and every keyframe_interval-th step are keyframes, so any step decodes from
+// within its own chunk. A chunk left unsealed by a crash is still readable: its records
+// are found by walking them up to data_end.
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "hcle/common/frame_codec.hpp"
+#include "hcle/common/mapped_file.hpp"
+#include "hcle/common/thread_safe_queue.hpp"
+
+namespace hcle::environment
+{
+    inline constexpr char kTrajectoryMagic[8] = {'H', 'C', 'L', 'E', 'T', 'R', 'J', '\0'};
+    inline constexpr uint32_t kTrajectoryVersion = 2;
+    // Action stored for reset observations, which no action produced.
+    inline constexpr uint8_t kNoAction = 0xFF;
+
+    // What the records of a dataset hold.
+    //  Observations: the vectorizer's preprocessed observations.
+    //  RawFrames:    raw emulator frames; with maxpool, the last two frames of each step.
+    enum class TrajectoryContent : uint8_t
+    {
+        Observations = 0,
+        RawFrames = 1
+    };
+
+    struct TrajectoryChunkHeader
+    {
+        char magic[8];
+        uint32_t version;
+        uint32_t header_size;
+        uint64_t obs_size;
+        uint32_t obs_ndim;
+        uint32_t obs_shape[4];
+        uint32_t chunk_index;
+        uint8_t codec;
+        uint8_t sealed;
+        uint8_t content; // TrajectoryContent
+        uint8_t reserved;
+        uint32_t keyframe_interval;
+        uint64_t data_end;     // End of the last complete record
+        uint64_t index_offset; // Valid once sealed
+        uint64_t num_records;  // Valid once sealed
+    };
+    static_assert(sizeof(TrajectoryChunkHeader) == 80);
+
+    struct TrajectoryRecordHeader
+    {
+        uint64_t episode_id;
+        uint32_t step;
+        uint32_t env_id;
+        double reward;
+        uint32_t frame_size; // Bytes of the frame record that follows
+        uint8_t action;
+        uint8_t done;
+        uint8_t truncated;
+        uint8_t reserved;
+    };
+    static_assert(sizeof(TrajectoryRecordHeader) == 32);
+
+    struct TrajectoryIndexEntry
+    {
+        uint64_t offset;
+        uint64_t episode_id;
+        uint32_t step;
+        uint32_t env_id;
+    };
+    static_assert(sizeof(TrajectoryIndexEntry) == 24);
+
+    inline std::string trajectoryChunkName(uint32_t index)
+    {
+        char name[32];
+        std::snprintf(name, sizeof(name), "chunk_%06u.hclt", index);
+        return name;
+    }
+
+    // Frames per observation that deltas shift by (see the top of the file). Raw emulator
+    // frames are not a stack, and version 1 did not shift.
+    inline size_t trajectoryStackSize(const std::vector<size_t> &obs_shape, TrajectoryContent content, uint32_t version)
+    {
+        if (version < 2 || content != TrajectoryContent::Observations || obs_shape.empty())
+            return 1;
+        return obs_shape[0];
+    }
+
+    inline size_t trajectoryRecordSize(size_t frame_size)
+    {
+        return (sizeof(TrajectoryRecordHeader) + frame_size + 7) & ~size_t{7};
+    }
+
+    struct TrajectoryRecorderConfig
+    {
+        common::FrameCodec codec = common::FrameCodec::DeltaRle;
+        size_t chunk_size = size_t{64} << 20;
+        int keyframe_interval = 64;
+        int queue_depth = 8; // Batches that may wait for the I/O thread before record() blocks
+        int zlib_level = 1;
+        TrajectoryContent content = TrajectoryContent::Observations;
+    };
+
+    // Streams vectorizer results into a trajectory dataset. record() copies a batch into a
+    // staging buffer and returns; encoding and writing happen on a background I/O thread.
+    class TrajectoryRecorder
+    {
+    public:
+        TrajectoryRecorder(const std::string &directory, size_t num_envs, size_t obs_size,
+                           const std::vector<size_t> &obs_shape, const TrajectoryRecorderConfig &config = {})
+            : m_directory(directory), m_num_envs(num_envs), m_obs_size(obs_size), m_obs_shape(obs_shape),
+              m_config(config),
+              m_encoder(num_envs, obs_size, trajectoryStackSize(obs_shape, config.content, kTrajectoryVersion),
+                        config.zlib_level),
+              m_env_state(num_envs)
+        {
+            if (config.keyframe_interval <= 0 || config.queue_depth <= 0)
+                throw std::invalid_argument("keyframe_interval and queue_depth must be positive.");
+            if (obs_shape.size() > 4)
+                throw std::invalid_argument("Observations may have at most 4 dimensions.");
+            const size_t max_record = trajectoryRecordSize(common::kFrameRecordHeaderSize + obs_size);
+            if (config.chunk_size < sizeof(TrajectoryChunkHeader) + max_record + sizeof(TrajectoryIndexEntry))
+                throw std::invalid_argument("chunk_size is too small to hold a single observation.");
+
+            std::filesystem::create_directories(m_directory);
+            if (std::filesystem::exists(std::filesystem::path(m_directory) / trajectoryChunkName(0)))
+                throw std::runtime_error("'" + directory + "' already contains a trajectory dataset.");
+
+            m_batches.resize(config.queue_depth);
+            for (auto &batch : m_batches)
+            {
+                batch.obs.resize(num_envs * obs_size);
+                batch.final_obs.resize(num_envs * obs_size);
+                batch.actions.resize(num_envs);
+                batch.rewards.resize(num_envs);
+                batch.dones.resize(num_envs);
+                batch.truncateds.resize(num_envs);
+                m_free.push(&batch);
+            }
+            m_thread = std::thread([this]
+                                   { writerLoop(); });
+        }
+
+        ~TrajectoryRecorder()
+        {
+            try
+            {
+                close();
+            }
+            catch (const std::exception &)
+            {
+            }
+        }
+
+        TrajectoryRecorder(const TrajectoryRecorder &) = delete;
+        TrajectoryRecorder &operator=(const TrajectoryRecorder &) = delete;
+
+        // Queues one step of results for every env. actions is null for a reset, truncateds
+        // may be null, and final_obs (SameStep autoreset) holds terminal observations.
+        // Blocks only if queue_depth batches are already waiting to be written.
+        void record(const uint8_t *obs, const uint8_t *actions, const double *rewards, const uint8_t *dones,
+                    const uint8_t *truncateds, const uint8_t *final_obs = nullptr)
+        {
+            rethrowWriterError();
+            if (!m_thread.joinable())
+                throw std::runtime_error("Recorder is closed.");
+
+            Batch *batch = m_free.pop();
+            std::memcpy(batch->obs.data(), obs, m_num_envs * m_obs_size);
+            batch->has_actions = actions != nullptr;
+            if (actions)
+                std::memcpy(batch->actions.data(), actions, m_num_envs);
+            std::copy(rewards, rewards + m_num_envs, batch->rewards.begin());
+            std::memcpy(batch->dones.data(), dones, m_num_envs);
+            if (truncateds)
+                std::memcpy(batch->truncateds.data(), truncateds, m_num_envs);
+            else
+                std::fill(batch->truncateds.begin(), batch->truncateds.end(), 0);
+
+            batch->has_final_obs = final_obs != nullptr;
+            if (final_obs)
+            {
+                for (size_t env = 0; env < m_num_envs; ++env)
+                    if (batch->dones[env] || batch->truncateds[env])
+                        std::memcpy(batch->final_obs.data() + env * m_obs_size, final_obs + env * m_obs_size, m_obs_size);
+            }
+
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_pending++;
+            }
+            m_full.push(batch);
+        }
+
+        // Waits until every queued batch has been written.
+        void flush()
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_idle.wait(lock, [this]
+                        { return m_pending == 0; });
+            lock.unlock();
+            rethrowWriterError();
+        }
+
+        // Writes everything queued, seals the current chunk and stops the I/O thread.
+        void close()
+        {
+            if (!m_thread.joinable())
+                return;
+            m_full.push(nullptr);
+            m_thread.join();
+            rethrowWriterError();
+        }
+
+        const std::string &getDirectory() const { return m_directory; }
+        uint64_t getNumEpisodes() const { return m_next_episode_id; }
+
+    private:
+        struct Batch
+        {
+            std::vector<uint8_t> obs;
+            std::vector<uint8_t> final_obs;
+            std::vector<uint8_t> actions;
+            std::vector<double> rewards;
+            std::vector<uint8_t> dones;
+            std::vector<uint8_t> truncateds;
+            bool has_actions = false;
+            bool has_final_obs = false;
+        };
+
+        struct EnvState
+        {
+            uint64_t episode_id = 0;
+            uint32_t step = 0;
+            bool started = false;
+            bool episode_over = false;
+        };
+
+        void writerLoop()
+        {
+            while (Batch *batch = m_full.pop())
+            {
+                try
+                {
+                    if (!m_writer_error)
+                        writeBatch(*batch);
+                }
+                catch (...)
+                {
+                    std::unique_lock<std::mutex> lock(m_mutex);
+                    m_writer_error = std::current_exception();
+                }
+                m_free.push(batch);
+                {
+                    std::unique_lock<std::mutex> lock(m_mutex);
+                    m_pending--;
+                }
+                m_idle.notify_all();
+            }
+
+            try
+            {
+                sealChunk();
+            }
+            catch (...)
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                if (!m_writer_error)
+                    m_writer_error = std::current_exception();
+            }
+        }
+
+        void writeBatch(const Batch &batch)
+        {
+            for (size_t env = 0; env < m_num_envs; ++env)
+            {
+                EnvState &state = m_env_state[env];
+                const bool terminal = batch.dones[env] || batch.truncateds[env];
+                uint8_t action = batch.has_actions ? batch.actions[env] : kNoAction;
+
+                if (!state.started || state.episode_over || !batch.has_actions)
+                {
+                    // A reset, or the NextStep autoreset after an episode ended.
+                    if (state.episode_over)
+                        action = kNoAction;
+                    beginEpisode(state);
+                }
+                else
+                {
+                    state.step++;
+                }
+
+                const uint8_t *obs = batch.obs.data() + env * m_obs_size;
+                if (terminal && batch.has_final_obs)
+                {
+                    // SameStep autoreset: obs is already the next episode's first observation.
+                    writeRecord(env, state, action, batch.rewards[env], batch.dones[env], batch.truncateds[env],
+                                batch.final_obs.data() + env * m_obs_size);
+                    beginEpisode(state);
+                    writeRecord(env, state, kNoAction, 0.0, false, false, obs);
+                    state.episode_over = false;
+                }
+                else
+                {
+                    writeRecord(env, state, action, batch.rewards[env], batch.dones[env], batch.truncateds[env], obs);
+                    state.episode_over = terminal;
+                }
+            }
+        }
+
+        void beginEpisode(EnvState &state)
+        {
+            state.episode_id = m_next_episode_id++;
+            state.step = 0;
+            state.started = true;
+        }
+
+        void writeRecord(size_t env, const EnvState &state, uint8_t action, double reward, bool done, bool truncated,
+                         const uint8_t *frame)
+        {
+            if (state.step % static_cast<uint32_t>(m_config.keyframe_interval) == 0)
+                m_encoder.resetStream(env);
+            m_frame.clear();
+            m_encoder.encodeFrame(env, frame, m_config.codec, m_frame);
+
+            if (!fits(trajectoryRecordSize(m_frame.size())))
+            {
+                sealChunk();
+                openChunk();
+                m_frame.clear();
+                m_encoder.encodeFrame(env, frame, m_config.codec, m_frame);
+            }
+            const size_t record_size = trajectoryRecordSize(m_frame.size());
+
+            TrajectoryRecordHeader header{};
+            header.episode_id = state.episode_id;
+            header.step = state.step;
+            header.env_id = static_cast<uint32_t>(env);
+            header.reward = reward;
+            header.frame_size = static_cast<uint32_t>(m_frame.size());
+            header.action = action;
+            header.done = done;
+            header.truncated = truncated;
+
+            uint8_t *dst = m_chunk.data() + m_data_end;
+            std::memcpy(dst, &header, sizeof(header));
+            std::memcpy(dst + sizeof(header), m_frame.data(), m_frame.size());
+            std::memset(dst + sizeof(header) + m_frame.size(), 0, record_size - sizeof(header) - m_frame.size());
+
+            m_index.push_back({m_data_end, state.episode_id, state.step, static_cast<uint32_t>(env)});
+            m_data_end += record_size;
+            chunkHeader()->data_end = m_data_end;
+        }
+
+        bool fits(size_t record_size) const
+        {
+            return m_chunk.isOpen() &&
+                   m_data_end + record_size + (m_index.size() + 1) * sizeof(TrajectoryIndexEntry) <= m_chunk.size();
+        }
+
+        TrajectoryChunkHeader *chunkHeader() { return reinterpret_cast<TrajectoryChunkHeader *>(m_chunk.data()); }
+
+        void openChunk()
+        {
+            const uint32_t index = m_num_chunks++;
+            m_chunk = common::MappedFile::create((std::filesystem::path(m_directory) / trajectoryChunkName(index)).string(),
+                                                 m_config.chunk_size);
+            TrajectoryChunkHeader *header = chunkHeader();
+            std::memset(header, 0, sizeof(*header));
+            std::memcpy(header->magic, kTrajectoryMagic, sizeof(kTrajectoryMagic));
+            header->version = kTrajectoryVersion;
+            header->header_size = sizeof(TrajectoryChunkHeader);
+            header->obs_size = m_obs_size;
+            header->obs_ndim = static_cast<uint32_t>(m_obs_shape.size());
+            for (size_t i = 0; i < m_obs_shape.size(); ++i)
+                header->obs_shape[i] = static_cast<uint32_t>(m_obs_shape[i]);
+            header->chunk_index = index;
+            header->codec = static_cast<uint8_t>(m_config.codec);
+            header->content = static_cast<uint8_t>(m_config.content);
+            header->keyframe_interval = static_cast<uint32_t>(m_config.keyframe_interval);
+            header->data_end = sizeof(TrajectoryChunkHeader);
+
+            m_data_end = sizeof(TrajectoryChunkHeader);
+            m_index.clear();
+            m_encoder.resetAll();
+        }
+
+        void sealChunk()
+        {
+            if (!m_chunk.isOpen())
+                return;
+            const size_t index_bytes = m_index.size() * sizeof(TrajectoryIndexEntry);
+            std::memcpy(m_chunk.data() + m_data_end, m_index.data(), index_bytes);
+            TrajectoryChunkHeader *header = chunkHeader();
+            header->index_offset = m_data_end;
+            header->num_records = m_index.size();
+            header->sealed = 1;
+            m_chunk.close(m_data_end + index_bytes);
+        }
+
+        void rethrowWriterError()
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            if (m_writer_error)
+                std::rethrow_exception(m_writer_error);
+        }
+
+        std::string m_directory;
+        size_t m_num_envs;
+        size_t m_obs_size;
+        std::vector<size_t> m_obs_shape;
+        TrajectoryRecorderConfig m_config;
+
+        // Staging buffers cycle m_free -> record() -> m_full -> I/O thread -> m_free.
+        std::vector<Batch> m_batches;
+        common::ThreadSafeQueue<Batch *> m_free;
+        common::ThreadSafeQueue<Batch *> m_full;
+        std::thread m_thread;
+        std::mutex m_mutex;
+        std::condition_variable m_idle;
+        size_t m_pending = 0;
+        std::exception_ptr m_writer_error;
+
+        // Owned by the I/O thread.
+        common::FrameEncoder m_encoder;
+        std::vector<EnvState> m_env_state;
+        uint64_t m_next_episode_id = 0;
+        common::MappedFile m_chunk;
+        uint32_t m_num_chunks = 0;
+        size_t m_data_end = 0;
+        std::vector<TrajectoryIndexEntry> m_index;
+        std::vector<uint8_t> m_frame;
+    };
+
+    struct TrajectoryStep
+    {
+        uint8_t action;
+        double reward;
+        bool done;
+        bool truncated;
+    };
+
+    // Random access to a trajectory dataset by episode and step. Chunks are memory-mapped
+    // and only their indexes are read up front. getStep() and readEpisode() are not
+    // thread-safe, as the reader keeps one decoding reference frame; TrajectoryCursors over
+    // the same reader may decode in parallel.
+    class TrajectoryReader
+    {
+    public:
+        explicit TrajectoryReader(const std::string &directory) : m_decoder(1, 0)
+        {
+            std::vector<std::filesystem::path> paths;
+            for (const auto &entry : std::filesystem::directory_iterator(directory))
+            {
+                const std::string name = entry.path().filename().string();
+                if (name.rfind("chunk_", 0) == 0 && entry.path().extension() == ".hclt")
+                    paths.push_back(entry.path());
+            }
+            if (paths.empty())
+                throw std::runtime_error("'" + directory + "' contains no trajectory chunks.");
+            std::sort(paths.begin(), paths.end());
+
+            std::map<uint64_t, Episode> episodes;
+            for (const auto &path : paths)
+            {
+                const uint32_t chunk = static_cast<uint32_t>(m_chunks.size());
+                m_chunks.push_back(common::MappedFile::openReadOnly(path.string()));
+                const TrajectoryChunkHeader &header = readHeader(m_chunks.back());
+                for (const TrajectoryIndexEntry &entry : readIndex(m_chunks.back(), header))
+                {
+                    Episode &episode = episodes[entry.episode_id];
+                    if (entry.step != episode.records.size())
+                        throw std::runtime_error("Episode " + std::to_string(entry.episode_id) + " is missing step " +
+                                                 std::to_string(episode.records.size()) + " in " + path.string() + ".");
+                    episode.id = entry.episode_id;
+                    episode.env_id = entry.env_id;
+                    episode.records.push_back({chunk, entry.offset});
+                }
+            }
+            for (auto &[id, episode] : episodes)
+                m_episodes.push_back(std::move(episode));
+            m_decoder = common::FrameDecoder(1, m_obs_size, m_stack_size);
+        }
+
+        size_t getNumEpisodes() const { return m_episodes.size(); }
+        size_t getEpisodeLength(size_t episode) const { return m_episodes.at(episode).records.size(); }
+        uint64_t getEpisodeId(size_t episode) const { return m_episodes.at(episode).id; }
+        uint32_t getEpisodeEnv(size_t episode) const { return m_episodes.at(episode).env_id; }
+        size_t getNumChunks() const { return m_chunks.size(); }
+        size_t getObservationSize() const { return m_obs_size; }
+        const std::vector<size_t> &getObservationShape() const { return m_obs_shape; }
+        TrajectoryContent getContent() const { return m_content; }
+
+        // Decodes one step; obs (getObservationSize() bytes) may be null.
+        TrajectoryStep getStep(size_t episode, size_t step, uint8_t *obs)
+        {
+            const Episode &ep = m_episodes.at(episode);
+            if (step >= ep.records.size())
+                throw std::out_of_range("Step " + std::to_string(step) + " is past the end of episode " +
+                                        std::to_string(episode) + ".");
+            if (!obs)
+                return toStep(recordHeader(ep.records[step]));
+
+            // Walk back to the nearest keyframe, then decode forward.
+            size_t first = step;
+            while (frameCodec(ep.records[first]) != common::FrameCodec::Raw)
+            {
+                if (first == 0)
+                    throw std::runtime_error("Episode " + std::to_string(episode) + " does not start with a keyframe.");
+                first--;
+            }
+            for (size_t k = first; k < step; ++k)
+                decodeFrame(ep.records[k], m_decoder, nullptr);
+            return decodeFrame(ep.records[step], m_decoder, obs);
+        }
+
+        // Decodes a whole episode sequentially. Any output may be null; obs receives
+        // getEpisodeLength() * getObservationSize() bytes.
+        void readEpisode(size_t episode, uint8_t *obs, uint8_t *actions, double *rewards, uint8_t *dones, uint8_t *truncateds)
+        {
+            const Episode &ep = m_episodes.at(episode);
+            for (size_t k = 0; k < ep.records.size(); ++k)
+            {
+                const TrajectoryStep step = obs ? decodeFrame(ep.records[k], m_decoder, obs + k * m_obs_size)
+                                                : toStep(recordHeader(ep.records[k]));
+                if (actions)
+                    actions[k] = step.action;
+                if (rewards)
+                    rewards[k] = step.reward;
+                if (dones)
+                    dones[k] = step.done;
+                if (truncateds)
+                    truncateds[k] = step.truncated;
+            }
+        }
+
+    private:
+        friend class TrajectoryCursor;
+
+        struct RecordRef
+        {
+            uint32_t chunk;
+            uint64_t offset;
+        };
+
+        struct Episode
+        {
+            uint64_t id = 0;
+            uint32_t env_id = 0;
+            std::vector<RecordRef> records;
+        };
+
+        const TrajectoryChunkHeader &readHeader(const common::MappedFile &file)
+        {
+            if (file.size() < sizeof(TrajectoryChunkHeader))
+                throw std::runtime_error(file.path() + " is not a trajectory chunk.");
+            const auto &header = *reinterpret_cast<const TrajectoryChunkHeader *>(file.data());
+            if (std::memcmp(header.magic, kTrajectoryMagic, sizeof(kTrajectoryMagic)) != 0 ||
+                header.header_size != sizeof(TrajectoryChunkHeader) || header.obs_ndim > 4)
+                throw std::runtime_error(file.path() + " is not a trajectory chunk.");
+            if (header.version != 1 && header.version != kTrajectoryVersion)
+                throw std::runtime_error(file.path() + " has unsupported version " + std::to_string(header.version) + ".");
+
+            std::vector<size_t> shape(header.obs_shape, header.obs_shape + header.obs_ndim);
+            const auto content = static_cast<TrajectoryContent>(header.content);
+            if (m_chunks.size() == 1)
+            {
+                m_obs_size = header.obs_size;
+                m_obs_shape = shape;
+                m_content = content;
+                m_version = header.version;
+                m_stack_size = trajectoryStackSize(shape, content, header.version);
+            }
+            else if (header.obs_size != m_obs_size || shape != m_obs_shape || content != m_content ||
+                     header.version != m_version)
+            {
+                throw std::runtime_error(file.path() + " has a different observation format from the rest of the dataset.");
+            }
+            return header;
+        }
+
+        static std::vector<TrajectoryIndexEntry> readIndex(const common::MappedFile &file, const TrajectoryChunkHeader &header)
+        {
+            std::vector<TrajectoryIndexEntry> index;
+            if (header.sealed)
+            {
+                if (header.index_offset > file.size() ||
+                    header.num_records > (file.size() - header.index_offset) / sizeof(TrajectoryIndexEntry))
+                    throw std::runtime_error(file.path() + " has a corrupt index.");
+                index.resize(header.num_records);
+                std::memcpy(index.data(), file.data() + header.index_offset, index.size() * sizeof(TrajectoryIndexEntry));
+                return index;
+            }
+
+            // Unsealed (the recorder did not shut down cleanly): walk the records.
+            const uint64_t end = std::min<uint64_t>(header.data_end, file.size());
+            uint64_t offset = sizeof(TrajectoryChunkHeader);
+            while (offset + sizeof(TrajectoryRecordHeader) <= end)
+            {
+                TrajectoryRecordHeader record;
+                std::memcpy(&record, file.data() + offset, sizeof(record));
+                const size_t size = trajectoryRecordSize(record.frame_size);
+                if (offset + size > end)
+                    break;
+                index.push_back({offset, record.episode_id, record.step, record.env_id});
+                offset += size;
+            }
+            return index;
+        }
+
+        const TrajectoryRecordHeader &recordHeader(const RecordRef &ref) const
+        {
+            const common::MappedFile &file = m_chunks[ref.chunk];
+            if (ref.offset + sizeof(TrajectoryRecordHeader) > file.size())
+                throw std::runtime_error(file.path() + " has a record past the end of the file.");
+            const auto &header = *reinterpret_cast<const TrajectoryRecordHeader *>(file.data() + ref.offset);
+            if (ref.offset + trajectoryRecordSize(header.frame_size) > file.size())
+                throw std::runtime_error(file.path() + " has a record past the end of the file.");
+            return header;
+        }
+
+        common::FrameCodec frameCodec(const RecordRef &ref) const
+        {
+            recordHeader(ref);
+            return static_cast<common::FrameCodec>(m_chunks[ref.chunk].data()[ref.offset + sizeof(TrajectoryRecordHeader)]);
+        }
+
+        TrajectoryStep decodeFrame(const RecordRef &ref, common::FrameDecoder &decoder, uint8_t *obs) const
+        {
+            const TrajectoryRecordHeader &header = recordHeader(ref);
+            const uint8_t *frame = m_chunks[ref.chunk].data() + ref.offset + sizeof(TrajectoryRecordHeader);
+            decoder.decodeFrame(0, frame, header.frame_size, obs);
+            return toStep(header);
+        }
+
+        static TrajectoryStep toStep(const TrajectoryRecordHeader &header)
+        {
+            return {header.action, header.reward, header.done != 0, header.truncated != 0};
+        }
+
+        std::vector<common::MappedFile> m_chunks;
+        std::vector<Episode> m_episodes;
+        size_t m_obs_size = 0;
+        std::vector<size_t> m_obs_shape;
+        TrajectoryContent m_content = TrajectoryContent::Observations;
+        uint32_t m_version = kTrajectoryVersion;
+        size_t m_stack_size = 1;
+        common::FrameDecoder m_decoder;
+    };
+
+    // Decodes one episode of a TrajectoryReader at a time, front to back, with its own
+    // reference frame. The reader must outlive the cursor.
+    class TrajectoryCursor
+    {
+    public:
+        explicit TrajectoryCursor(const TrajectoryReader &reader)
+            : m_reader(&reader), m_decoder(1, reader.getObservationSize(), reader.m_stack_size) {}
+
+        void seek(size_t episode)
+        {
+            m_episode = &m_reader->m_episodes.at(episode);
+            m_step = 0;
+        }
+
+        bool atEnd() const { return !m_episode || m_step >= m_episode->records.size(); }
+        // Index of the step next() will decode.
+        size_t getStep() const { return m_step; }
+
+        // Decodes the next step of the episode into obs (getObservationSize() bytes).
+        TrajectoryStep next(uint8_t *obs)
+        {
+            if (atEnd())
+                throw std::out_of_range("Cursor is past the end of its episode.");
+            return m_reader->decodeFrame(m_episode->records[m_step++], m_decoder, obs);
+        }
+
+    private:
+        const TrajectoryReader *m_reader;
+        const TrajectoryReader::Episode *m_episode = nullptr;
+        size_t m_step = 0;
+        common::FrameDecoder m_decoder;
+    };
+}
@@ -83,6 +83,17 @@ namespace hcle
             }
 
         public:
+            std::vector<std::string> getInfoNames() const override
+            {
+                return {"SCORE", "LIVES"};
+            }
+
+            void getInfo(int32_t *values) override
+            {
+                values[0] = getScore();
+                values[1] = m_current_ram_ptr[CURRENT_LIVES];
+            }
+
             bool isDone() override
             {
                 return (inGame() && m_current_ram_ptr[CURRENT_LIVES] < 0x03);
@@ -77,6 +77,20 @@ namespace hcle
          }
 
       public:
+         std::vector<std::string> getInfoNames() const override
+         {
+            return {"SCORE", "OPPONENT_SCORE", "STRIKES", "BALLS", "OUTS"};
+         }
+
+         void getInfo(int32_t *values) override
+         {
+            values[0] = static_cast<int32_t>(getScore(m_current_ram_ptr));
+            values[1] = static_cast<int32_t>(getOpponentScore(m_current_ram_ptr));
+            values[2] = m_current_ram_ptr[STRIKES];
+            values[3] = m_current_ram_ptr[BALLS];
+            values[4] = m_current_ram_ptr[OUTS];
+         }
+
          bool isDone() override
          {
             return false;
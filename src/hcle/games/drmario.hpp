@@ -109,6 +109,17 @@ namespace hcle
          }
 
       public:
+         std::vector<std::string> getInfoNames() const override
+         {
+            return {"SCORE", "VIRUS_COUNT"};
+         }
+
+         void getInfo(int32_t *values) override
+         {
+            values[0] = get_current_score();
+            values[1] = get_virus_count(m_current_ram_ptr);
+         }
+
          bool isDone() override
          {
             return game_over();
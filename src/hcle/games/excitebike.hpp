@@ -74,6 +74,17 @@ namespace hcle
             // You may want to add the startup frameadvance logic from the Python _did_reset here
          }
 
+         std::vector<std::string> getInfoNames() const override
+         {
+            return {"SPEED", "MOTOR_TEMP"};
+         }
+
+         void getInfo(int32_t *values) override
+         {
+            values[0] = m_current_ram_ptr[PLAYER_SPEED];
+            values[1] = m_current_ram_ptr[MOTOR_TEMP];
+         }
+
          bool isDone() override
          {
             long long current_time = get_time(m_current_ram_ptr);
@@ -7,6 +7,7 @@
 #include <mutex>
 #include <shared_mutex>
 #include <numeric>
+#include <string>
 
 #include "hcle/emucore/nes.hpp"
 #include "hcle/emucore/utils.hpp"
@@ -53,6 +54,12 @@ namespace hcle
             virtual void onStep() {}
             virtual void onReset() {}
             virtual const std::vector<uint8_t> getActionSet() { return action_set; }
+
+            // Small fixed schema of numeric game values (score, lives, position, ...) that the
+            // vectorizer publishes every step. getInfo() writes one value per name returned by
+            // getInfoNames(), in the same order.
+            virtual std::vector<std::string> getInfoNames() const { return {}; }
+            virtual void getInfo([[maybe_unused]] int32_t *values) {}
             void frameadvance(uint8_t controller_value, int n = 1) { nes_->step(controller_value, n); }
 
             void updateRAM()
@@ -63,6 +63,20 @@ namespace hcle
             }
 
         public:
+            std::vector<std::string> getInfoNames() const override
+            {
+                return {"SCORE", "STROKES", "HOLE_NUM", "PAR", "DIST_TO_HOLE"};
+            }
+
+            void getInfo(int32_t *values) override
+            {
+                values[0] = m_current_ram_ptr[SCORE];
+                values[1] = m_current_ram_ptr[STROKES];
+                values[2] = m_current_ram_ptr[HOLE_NUM];
+                values[3] = m_current_ram_ptr[PAR];
+                values[4] = static_cast<int32_t>(dist_to_hole(m_current_ram_ptr));
+            }
+
             bool isDone() override
             {
                 return m_current_ram_ptr[STROKES] > m_current_ram_ptr[PAR] * 2;
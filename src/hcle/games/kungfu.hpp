@@ -80,6 +80,18 @@ namespace hcle
             }
 
         public:
+            std::vector<std::string> getInfoNames() const override
+            {
+                return {"SCORE", "HP", "FLOOR"};
+            }
+
+            void getInfo(int32_t *values) override
+            {
+                values[0] = static_cast<int32_t>(score(m_current_ram_ptr));
+                values[1] = m_current_ram_ptr[HP];
+                values[2] = m_current_ram_ptr[FLOOR];
+            }
+
             bool isDone() override { return is_dead(); }
 
             double getReward() override
@@ -39,6 +39,19 @@ namespace hcle
          }
 
       public:
+         std::vector<std::string> getInfoNames() const override
+         {
+            return {"LIVES", "MAGIC_SHOTS", "HEARTS_COLLECTED", "HEARTS_TOTAL"};
+         }
+
+         void getInfo(int32_t *values) override
+         {
+            values[0] = m_current_ram_ptr[LIVES_REMAINING];
+            values[1] = m_current_ram_ptr[MAGIC_SHOTS];
+            values[2] = m_current_ram_ptr[COLLECTED_HEART_FRAMES];
+            values[3] = m_current_ram_ptr[TOTAL_HEART_FRAMES];
+         }
+
          bool isDone() override
          {
             return m_current_ram_ptr[LIVES_REMAINING] < m_previous_ram[LIVES_REMAINING];
@@ -61,6 +61,17 @@ namespace hcle
             }
 
         public:
+            std::vector<std::string> getInfoNames() const override
+            {
+                return {"SCORE", "LIVES"};
+            }
+
+            void getInfo(int32_t *values) override
+            {
+                values[0] = static_cast<int32_t>(get_score(m_current_ram_ptr));
+                values[1] = get_lives();
+            }
+
             bool isDone() override
             {
                 return get_lives() == 1;
@@ -66,6 +66,17 @@ namespace hcle
             }
 
         public:
+            std::vector<std::string> getInfoNames() const override
+            {
+                return {"MAC_HP", "OPP_HP"};
+            }
+
+            void getInfo(int32_t *values) override
+            {
+                values[0] = m_current_ram_ptr[MAC_HP];
+                values[1] = m_current_ram_ptr[OPP_HP];
+            }
+
             bool isDone() override
             {
                 int mac_hp_change = static_cast<int>(m_current_ram_ptr[MAC_HP]) - static_cast<int>(m_previous_ram[MAC_HP]);
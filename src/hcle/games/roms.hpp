@@ -31,7 +31,7 @@ static const std::map<std::string, std::string> EXPECTED_ROM_HASHES = {
     {"excitebike.bin", "d7fe15cf2bc7b6582c07d12b3cf3bede"},
     {"golf.bin", "a8ef965eabfb57c59a9a6754a5581d77"},
     {"lolo1.bin", "38516649d5d9c0b51a9a578c8178ee5b"},
-    {"mariobro.bin", "d85e4dbfb52687c83915ac3e4cc08bbb"},
+    {"mariobros.bin", "d85e4dbfb52687c83915ac3e4cc08bbb"},
     {"mtpo.bin", "b9a66b2760daa7d5639cbad903de8a18"},
     {"smb2.bin", "71576d8339bd63198fcfc51a92016d58"},
     {"smb3.bin", "bb5c4b6d4d78c101f94bdb360af502f3"},
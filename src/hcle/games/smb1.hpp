@@ -36,6 +36,7 @@ namespace hcle
             static const int LEVEL_NUM = 0x0760;
             static const int WORLD_NUM = 0x075F;
             static const int COINS = 0x075E;
+            static const int LIVES = 0x075A;
             static const int POWERUP_STATE = 0x0756;
             static const int PRE_LEVEL_TIMER = 0x07A0;
             static const int CHANGE_AREA_TIMER = 0x06DE;
@@ -85,6 +86,22 @@ namespace hcle
             }
 
         public:
+            std::vector<std::string> getInfoNames() const override
+            {
+                return {"X_POS", "WORLD_NUM", "LEVEL_NUM", "COINS", "LIVES", "TIME", "POWERUP_STATE"};
+            }
+
+            void getInfo(int32_t *values) override
+            {
+                values[0] = (static_cast<int>(m_current_ram_ptr[CURRENT_PAGE]) << 8) | m_current_ram_ptr[X_POS];
+                values[1] = m_current_ram_ptr[WORLD_NUM];
+                values[2] = m_current_ram_ptr[LEVEL_NUM];
+                values[3] = m_current_ram_ptr[COINS];
+                values[4] = m_current_ram_ptr[LIVES];
+                values[5] = get_time();
+                values[6] = m_current_ram_ptr[POWERUP_STATE];
+            }
+
             bool isDone() override
             {
                 return is_dead();
@@ -65,6 +65,20 @@ namespace hcle
             }
 
         public:
+            std::vector<std::string> getInfoNames() const override
+            {
+                return {"X_POS", "LEVEL", "AREA", "HEALTH", "LIVES"};
+            }
+
+            void getInfo(int32_t *values) override
+            {
+                values[0] = (static_cast<int>(m_current_ram_ptr[PLAYER_X_PAGE]) << 8) | m_current_ram_ptr[PLAYER_X_POS];
+                values[1] = m_current_ram_ptr[CURRENT_LEVEL];
+                values[2] = m_current_ram_ptr[CURRENT_AREA];
+                values[3] = m_current_ram_ptr[PLAYER_HEALTH];
+                values[4] = m_current_ram_ptr[LIVES];
+            }
+
             bool isDone() override
             {
                 return m_current_ram_ptr[LEVEL_TRANSITION] == 0x02 || m_current_ram_ptr[LIVES] < m_previous_ram[LIVES];
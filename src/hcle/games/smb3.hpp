@@ -127,6 +127,19 @@ namespace hcle
             }
 
         public:
+            std::vector<std::string> getInfoNames() const override
+            {
+                return {"X_POS", "WORLD_NUM", "LIVES", "P_METER"};
+            }
+
+            void getInfo(int32_t *values) override
+            {
+                values[0] = static_cast<int32_t>(get_mario_pos(m_current_ram_ptr));
+                values[1] = m_current_ram_ptr[WORLD_NUM];
+                values[2] = m_current_ram_ptr[LIVES];
+                values[3] = m_current_ram_ptr[P_METER];
+            }
+
             bool isDone() override
             {
                 return m_current_ram_ptr[LIVES] < m_previous_ram[LIVES] || m_current_ram_ptr[IS_DYING] != 0;
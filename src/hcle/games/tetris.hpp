@@ -2,7 +2,7 @@
 #pragma once
 #include "game_logic.hpp"
 #include <vector>
-#include <cstdlib>
+#include <random>
 #include <chrono>
 #include <iomanip>
 
@@ -46,7 +46,8 @@ namespace hcle
             {
                 while (!inGame())
                 {
-                    shuffleRNG();
+                    // Seeded from RAM rather than the clock, so replaying a snapshot repeats it.
+                    shuffleRNG(cynes::hash_bytes(cynes::HASH_SEED, m_current_ram_ptr, 0x800));
                     frameadvance(NES_INPUT_START);
                     frameadvance(NES_INPUT_NONE);
                 }
@@ -74,25 +75,39 @@ namespace hcle
                 return tot_score;
             }
 
-            void shuffleRNG()
+            void shuffleRNG(uint64_t seed)
             {
-                auto p1 = std::chrono::system_clock::now();
-                std::srand(std::chrono::duration_cast<std::chrono::nanoseconds>(p1.time_since_epoch()).count());
+                // A local generator: std::rand() is shared by every env thread.
+                std::mt19937 rng(static_cast<uint32_t>(seed ^ (seed >> 32)));
+                std::uniform_int_distribution<int> byte(0, 254);
+                std::uniform_int_distribution<size_t> piece(0, 6);
 
-                m_current_ram_ptr[RNG] = std::rand() % 255;
-                m_current_ram_ptr[RNG + 1] = std::rand() % 255;
+                m_current_ram_ptr[RNG] = byte(rng);
+                m_current_ram_ptr[RNG + 1] = byte(rng);
                 std::vector<uint8_t> pieces = {0x02, 0x07, 0x08, 0x0A, 0x0B, 0x0E, 0x12};
-                m_current_ram_ptr[0x00BF] = pieces[std::rand() % 7];
-                m_current_ram_ptr[0x0019] = std::rand() % 255;
+                m_current_ram_ptr[0x00BF] = pieces[piece(rng)];
+                m_current_ram_ptr[0x0019] = byte(rng);
             }
 
             void onReset() override
             {
                 frameadvance(NES_INPUT_NONE);
-                shuffleRNG();
+                auto p1 = std::chrono::system_clock::now();
+                shuffleRNG(std::chrono::duration_cast<std::chrono::nanoseconds>(p1.time_since_epoch()).count());
             }
 
         public:
+            std::vector<std::string> getInfoNames() const override
+            {
+                return {"SCORE", "LINES"};
+            }
+
+            void getInfo(int32_t *values) override
+            {
+                values[0] = getScore(m_current_ram_ptr);
+                values[1] = getLineCount(m_current_ram_ptr);
+            }
+
             bool isDone() override
             {
                 return m_current_ram_ptr[GAME_OVER] > 0x0;
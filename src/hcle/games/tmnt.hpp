@@ -64,6 +64,19 @@ namespace hcle
                 visited_overworld_coords_.clear();
             }
 
+            std::vector<std::string> getInfoNames() const override
+            {
+                return {"LIVES", "MAP_ID", "LEVEL_X", "BOSS_HEALTH"};
+            }
+
+            void getInfo(int32_t *values) override
+            {
+                values[0] = m_current_ram_ptr[LIVES];
+                values[1] = m_current_ram_ptr[MAP_ID];
+                values[2] = m_current_ram_ptr[LEVEL_X];
+                values[3] = m_current_ram_ptr[BOSS_HEALTH];
+            }
+
             bool isDone() override
             {
                 // Done if lives are not at the starting value (3)
@@ -103,6 +103,21 @@ namespace hcle
          }
 
       public:
+         std::vector<std::string> getInfoNames() const override
+         {
+            return {"HEALTH", "RUPEES", "KEYS", "BOMBS", "MAP_LOCATION", "KILLED_ENEMY_COUNT"};
+         }
+
+         void getInfo(int32_t *values) override
+         {
+            values[0] = m_current_ram_ptr[PARTIAL_HEART];
+            values[1] = m_current_ram_ptr[RUPEES];
+            values[2] = m_current_ram_ptr[KEYS];
+            values[3] = m_current_ram_ptr[BOMBS];
+            values[4] = m_current_ram_ptr[MAP_LOCATION];
+            values[5] = m_current_ram_ptr[KILLED_ENEMY_COUNT];
+         }
+
          bool isDone() override
          {
             return getHealth(m_current_ram_ptr) == 0;
@@ -0,0 +1,53 @@
+#pragma once
+
+// The subset of the DLPack ABI (v0.8, https://github.com/dmlc/dlpack) needed to export
+// CPU buffers. Layouts must match dlpack.h exactly; consumers read these structs directly.
+
+#include <cstdint>
+
+extern "C"
+{
+    typedef enum
+    {
+        kDLCPU = 1,
+    } DLDeviceType;
+
+    typedef struct
+    {
+        DLDeviceType device_type;
+        int32_t device_id;
+    } DLDevice;
+
+    typedef enum
+    {
+        kDLInt = 0U,
+        kDLUInt = 1U,
+        kDLFloat = 2U,
+        kDLBool = 6U,
+    } DLDataTypeCode;
+
+    typedef struct
+    {
+        uint8_t code;
+        uint8_t bits;
+        uint16_t lanes;
+    } DLDataType;
+
+    typedef struct
+    {
+        void *data;
+        DLDevice device;
+        int32_t ndim;
+        DLDataType dtype;
+        int64_t *shape;
+        int64_t *strides;
+        uint64_t byte_offset;
+    } DLTensor;
+
+    typedef struct DLManagedTensor
+    {
+        DLTensor dl_tensor;
+        void *manager_ctx;
+        void (*deleter)(struct DLManagedTensor *self);
+    } DLManagedTensor;
+}
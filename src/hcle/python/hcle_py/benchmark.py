@@ -0,0 +1,281 @@
+"""
+End-to-end throughput benchmark of `NESVectorEnv` from Python.
+
+Sweeps env counts and observation settings across three stepping modes:
+
+- ``sync``: ``step()``, then the simulated agent thinks.
+- ``async``: the pipelined ``step_async``/``step_wait`` loop, so the next
+  batch is emulated while the agent thinks.
+- ``multi``: ``step_many()`` runs ``--multi-steps`` steps per call; the
+  agent thinks once per call.
+
+Every configuration becomes one CSV row with steps/s, emulated frames/s,
+process CPU utilisation and per-call latency percentiles. Sync and async rows
+also fill ``think_time``, ``sync_duration`` and ``async_duration``, the
+columns the plotter notebook reads, so it can load the output in place of
+``performance_results.csv``. For example::
+
+    python -m hcle_py.benchmark --num-envs 8,32,64 --think-times 0,4,16 \\
+        --modes sync,async,multi --output benchmark_results.csv
+"""
+
+from __future__ import annotations
+
+import argparse
+import csv
+import itertools
+import os
+import sys
+import time
+from typing import Callable, Sequence
+
+import numpy as np
+
+COLUMNS = [
+    "game",
+    "mode",
+    "num_envs",
+    "num_threads",
+    "frame_skip",
+    "stack",
+    "grayscale",
+    "maxpool",
+    "think_time",
+    "steps",
+    "duration",
+    "steps_per_sec",
+    "frames_per_sec",
+    "cpu_util",
+    "cpu_util_per_core",
+    "latency_p50_ms",
+    "latency_p90_ms",
+    "latency_p99_ms",
+    "latency_max_ms",
+    "env_step_p50_ms",
+    "env_step_p99_ms",
+    "sync_duration",
+    "async_duration",
+]
+
+
+def _int_list(text: str) -> list[int]:
+    return [int(item) for item in text.split(",") if item]
+
+
+def _think(think_time_ms: int):
+    """Simulates the agent's work between steps, e.g. a policy forward pass."""
+    if think_time_ms > 0:
+        time.sleep(think_time_ms / 1000.0)
+
+
+def _run_mode(env, mode: str, steps: int, think_time_ms: int, multi_steps: int):
+    """Runs one timed loop; returns the per-call latencies in seconds."""
+    rng = np.random.default_rng(0)
+    num_actions = env.single_action_space.n
+
+    def sample(shape):
+        return rng.integers(0, num_actions, size=shape, dtype=np.uint8)
+
+    latencies = []
+    if mode == "sync":
+        for _ in range(steps):
+            start = time.perf_counter()
+            env.step(sample(env.num_envs))
+            latencies.append(time.perf_counter() - start)
+            _think(think_time_ms)
+    elif mode == "async":
+        env.step_async(sample(env.num_envs))
+        for _ in range(steps):
+            _think(think_time_ms)
+            # Only the time the agent is blocked on results counts as latency.
+            start = time.perf_counter()
+            env.step_wait()
+            latencies.append(time.perf_counter() - start)
+            env.step_async(sample(env.num_envs))
+        env.step_wait()
+    elif mode == "multi":
+        calls = max(1, steps // multi_steps)
+        obs = np.empty((multi_steps, *env.observation_space.shape), dtype=np.uint8)
+        rewards = np.empty((multi_steps, env.num_envs), dtype=np.double)
+        dones = np.empty((multi_steps, env.num_envs), dtype=np.uint8)
+        truncateds = np.empty((multi_steps, env.num_envs), dtype=np.uint8)
+        for _ in range(calls):
+            start = time.perf_counter()
+            env.step_many(
+                sample((multi_steps, env.num_envs)), obs, rewards, dones, truncateds
+            )
+            latencies.append(time.perf_counter() - start)
+            _think(think_time_ms)
+    else:
+        raise ValueError(f"Unknown mode '{mode}'. Expected sync, async or multi.")
+    return latencies
+
+
+def run_config(
+    make_env: Callable[..., object],
+    game: str,
+    mode: str,
+    num_envs: int,
+    frame_skip: int,
+    stack: int,
+    grayscale: bool,
+    maxpool: bool,
+    think_time_ms: int,
+    steps: int,
+    multi_steps: int = 8,
+    warmup_steps: int = 10,
+) -> dict:
+    """Benchmarks one configuration and returns its CSV row."""
+    from hcle_py import _hcle_py
+
+    env = make_env(
+        game=game,
+        num_envs=num_envs,
+        frame_skip=frame_skip,
+        stack_num=stack,
+        grayscale=grayscale,
+        maxpool=maxpool,
+        copy=False,
+    )
+    try:
+        env.reset()
+        _run_mode(env, "sync", warmup_steps, 0, multi_steps)
+        if hasattr(env, "reset_latencies"):
+            env.reset_latencies()
+
+        wall_start, cpu_start = time.perf_counter(), time.process_time()
+        latencies = _run_mode(env, mode, steps, think_time_ms, multi_steps)
+        duration = time.perf_counter() - wall_start
+        cpu_time = time.process_time() - cpu_start
+
+        # The pool that ran the steps, after any set_num_threads().
+        num_threads = _hcle_py.get_num_threads()
+        total_steps = len(latencies) * (multi_steps if mode == "multi" else 1)
+        env_step = (
+            env.get_latencies()["step"] if hasattr(env, "get_latencies") else None
+        )
+    finally:
+        env.close()
+
+    latencies_ms = np.asarray(latencies) * 1e3
+    p50, p90, p99 = np.percentile(latencies_ms, [50, 90, 99])
+    num_cores = os.cpu_count() or 1
+    return {
+        "game": game,
+        "mode": mode,
+        "num_envs": num_envs,
+        "num_threads": num_threads,
+        "frame_skip": frame_skip,
+        "stack": stack,
+        "grayscale": int(grayscale),
+        "maxpool": int(maxpool),
+        "think_time": think_time_ms,
+        "steps": total_steps,
+        "duration": duration,
+        "steps_per_sec": total_steps * num_envs / duration,
+        "frames_per_sec": total_steps * num_envs * frame_skip / duration,
+        "cpu_util": cpu_time / duration,
+        "cpu_util_per_core": cpu_time / duration / num_cores,
+        "latency_p50_ms": p50,
+        "latency_p90_ms": p90,
+        "latency_p99_ms": p99,
+        "latency_max_ms": latencies_ms.max(),
+        "env_step_p50_ms": env_step["p50"] / 1e6 if env_step else "",
+        "env_step_p99_ms": env_step["p99"] / 1e6 if env_step else "",
+        "sync_duration": duration if mode == "sync" else "",
+        "async_duration": duration if mode == "async" else "",
+    }
+
+
+def run_sweep(args: argparse.Namespace, make_env: Callable[..., object]) -> list[dict]:
+    """Runs every combination of the swept settings, appending rows to the CSV."""
+    output_exists = args.output != "-" and os.path.isfile(args.output)
+    if output_exists:
+        with open(args.output, newline="") as existing:
+            if next(csv.reader(existing), None) != COLUMNS:
+                raise ValueError(
+                    f"{args.output} has different columns; pick another --output."
+                )
+    out = open(args.output, "a", newline="") if args.output != "-" else None
+    try:
+        writer = csv.DictWriter(out or sys.stdout, fieldnames=COLUMNS)
+        if not output_exists:
+            writer.writeheader()
+
+        rows = []
+        sweep = itertools.product(
+            range(args.repeats),
+            _int_list(args.num_envs),
+            _int_list(args.frame_skip),
+            _int_list(args.stack),
+            _int_list(args.grayscale),
+            _int_list(args.maxpool),
+            _int_list(args.think_times),
+            [mode for mode in args.modes.split(",") if mode],
+        )
+        for _, num_envs, frame_skip, stack, grayscale, maxpool, think, mode in sweep:
+            row = run_config(
+                make_env,
+                args.game,
+                mode,
+                num_envs,
+                frame_skip,
+                stack,
+                bool(grayscale),
+                bool(maxpool),
+                think,
+                args.steps,
+                args.multi_steps,
+                args.warmup_steps,
+            )
+            writer.writerow(row)
+            if out:
+                out.flush()
+                print(
+                    f"{mode:>5} envs={num_envs:<4} skip={frame_skip} stack={stack} "
+                    f"gray={grayscale} maxpool={maxpool} think={think}ms: "
+                    f"{row['steps_per_sec']:.0f} steps/s, "
+                    f"p99 {row['latency_p99_ms']:.2f} ms, "
+                    f"cpu {row['cpu_util']:.2f}"
+                )
+            rows.append(row)
+        return rows
+    finally:
+        if out:
+            out.close()
+
+
+def parse_args(argv: Sequence[str] | None = None) -> argparse.Namespace:
+    """Parses the command line; list options take comma-separated values."""
+    parser = argparse.ArgumentParser(
+        description="Benchmark NESVectorEnv throughput and latency from Python."
+    )
+    parser.add_argument("--game", default="smb1")
+    parser.add_argument("--modes", default="sync,async,multi")
+    parser.add_argument("--num-envs", default="8,32,64")
+    parser.add_argument("--frame-skip", default="4")
+    parser.add_argument("--stack", default="4")
+    parser.add_argument("--grayscale", default="1")
+    parser.add_argument("--maxpool", default="1")
+    parser.add_argument("--think-times", default="0,4,16")
+    parser.add_argument("--steps", type=int, default=200)
+    parser.add_argument("--multi-steps", type=int, default=8)
+    parser.add_argument("--warmup-steps", type=int, default=10)
+    parser.add_argument("--repeats", type=int, default=1)
+    parser.add_argument(
+        "--output",
+        default="benchmark_results.csv",
+        help="CSV file to append to, or - for stdout.",
+    )
+    return parser.parse_args(argv)
+
+
+def main(argv: Sequence[str] | None = None) -> list[dict]:
+    """Entry point of ``python -m hcle_py.benchmark``."""
+    from hcle_py.vector_env import NESVectorEnv
+
+    return run_sweep(parse_args(argv), NESVectorEnv)
+
+
+if __name__ == "__main__":
+    main()
@@ -17,7 +17,7 @@ def register_hcle_envs():
             # The entry point for a single environment instance
             entry_point="hcle_py.env:HCLEnv",
             # The entry point for a vectorized environment instance
-            vector_entry_point="hcle_py.vector_env:HCLEVectorEnv",
+            vector_entry_point="hcle_py.vector_env:NESVectorEnv",
             # Kwargs are passed to BOTH entry points
             kwargs={
                 'game': game_name, 
@@ -0,0 +1,225 @@
+from typing import Any, TypeVar
+import socket
+import struct
+import zlib
+import gymnasium as gym
+from gymnasium.vector import VectorEnv
+from gymnasium.spaces import Box, Discrete
+import numpy as np
+
+ObsType = TypeVar("ObsType")
+
+# Message types; see src/hcle/environment/env_protocol.hpp.
+MSG_INFO = 1
+MSG_RESET = 2
+MSG_STEP = 3
+MSG_CLOSE = 4
+MSG_ERROR = 0x7F
+MSG_INFO_REPLY = 0x81
+MSG_RESULT = 0x82
+
+# Frame codecs; see src/hcle/common/frame_codec.hpp.
+FRAME_CODECS = {"raw": 0, "delta_rle": 1, "delta_zlib": 2}
+
+
+class EnvServerConnection:
+    """
+    Python client for hcle_server. `send_step` only writes the request, so
+    several steps can be pipelined; `recv_result` returns them in order.
+    """
+
+    def __init__(self, address: str, codec: str = "raw"):
+        if codec not in FRAME_CODECS:
+            raise ValueError(f"Unknown frame codec '{codec}'. Expected one of {list(FRAME_CODECS)}.")
+        if address.startswith("unix:"):
+            self.sock = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+            self.sock.connect(address[5:])
+        else:
+            host, port = address.removeprefix("tcp:").rsplit(":", 1)
+            self.sock = socket.create_connection((host, int(port)))
+            self.sock.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+        self.codec = FRAME_CODECS[codec]
+        self.in_flight = 0
+
+        self._send(bytes([MSG_INFO]))
+        payload = self._read_reply(MSG_INFO_REPLY)
+        self.num_envs, self.obs_size, ndim = struct.unpack_from("<IQB", payload, 0)
+        offset = 13
+        self.obs_shape = struct.unpack_from(f"<{ndim}I", payload, offset)
+        offset += 4 * ndim
+        (num_actions,) = struct.unpack_from("<I", payload, offset)
+        offset += 4
+        self.action_set = bytes(payload[offset : offset + num_actions])
+
+        self.last_obs = np.zeros(self.num_envs * self.obs_size, dtype=np.uint8)
+        # Deltas are against the previous observation shifted by one stacked frame.
+        self.stack_shift = self.obs_size // self.obs_shape[0] if ndim else self.obs_size
+
+    def send_reset(self):
+        self._send(bytes([MSG_RESET, self.codec]))
+        self.in_flight += 1
+
+    def send_step(self, actions: np.ndarray):
+        actions = np.ascontiguousarray(actions, dtype=np.uint8)
+        if actions.size != self.num_envs:
+            raise ValueError("Number of actions must equal number of environments.")
+        self._send(bytes([MSG_STEP, self.codec]) + actions.tobytes())
+        self.in_flight += 1
+
+    def recv_result(self) -> tuple[np.ndarray, np.ndarray, np.ndarray, np.ndarray]:
+        """Returns (obs, rewards, dones, truncateds) for the oldest request in flight."""
+        if self.in_flight == 0:
+            raise RuntimeError("recv_result() called with no request in flight.")
+        self.in_flight -= 1
+
+        payload = self._read_reply(MSG_RESULT)
+        (num_envs,) = struct.unpack_from("<I", payload, 0)
+        offset = 4
+        rewards = np.frombuffer(payload, dtype="<f8", count=num_envs, offset=offset).copy()
+        offset += 8 * num_envs
+        dones = np.frombuffer(payload, dtype=np.uint8, count=num_envs, offset=offset).astype(np.bool_)
+        offset += num_envs
+        truncateds = np.frombuffer(payload, dtype=np.uint8, count=num_envs, offset=offset).astype(np.bool_)
+        offset += num_envs
+        (obs_bytes,) = struct.unpack_from("<Q", payload, offset)
+        offset += 8
+
+        end = offset + obs_bytes
+        for env in range(self.num_envs):
+            codec, size = struct.unpack_from("<BI", payload, offset)
+            offset += 5
+            frame = self.last_obs[env * self.obs_size : (env + 1) * self.obs_size]
+            if codec != FRAME_CODECS["raw"] and self.stack_shift < self.obs_size:
+                frame[: -self.stack_shift] = frame[self.stack_shift :]
+            if codec == FRAME_CODECS["raw"]:
+                frame[:] = np.frombuffer(payload, dtype=np.uint8, count=size, offset=offset)
+            elif codec == FRAME_CODECS["delta_rle"]:
+                self._apply_delta_rle(payload, offset, offset + size, frame)
+            elif codec == FRAME_CODECS["delta_zlib"]:
+                frame ^= np.frombuffer(zlib.decompress(payload[offset : offset + size]), dtype=np.uint8)
+            else:
+                raise RuntimeError(f"Unknown frame codec {codec} from hcle_server.")
+            offset += size
+        if offset != end:
+            raise RuntimeError("Result has the wrong observation size.")
+        return self.last_obs, rewards, dones, truncateds
+
+    def close(self):
+        try:
+            self._send(bytes([MSG_CLOSE]))
+        except OSError:
+            pass
+        self.sock.close()
+
+    @staticmethod
+    def _varint(payload: bytes, offset: int) -> tuple[int, int]:
+        value = shift = 0
+        while True:
+            byte = payload[offset]
+            offset += 1
+            value |= (byte & 0x7F) << shift
+            if not byte & 0x80:
+                return value, offset
+            shift += 7
+
+    def _apply_delta_rle(self, payload: bytes, offset: int, end: int, frame: np.ndarray):
+        view = np.frombuffer(payload, dtype=np.uint8)
+        pos = 0
+        while offset < end:
+            zero_run, offset = self._varint(payload, offset)
+            literal, offset = self._varint(payload, offset)
+            pos += zero_run
+            frame[pos : pos + literal] ^= view[offset : offset + literal]
+            offset += literal
+            pos += literal
+
+    def _send(self, payload: bytes):
+        self.sock.sendall(struct.pack("<I", len(payload)) + payload)
+
+    def _recv_exact(self, size: int) -> bytearray:
+        buffer = bytearray(size)
+        view = memoryview(buffer)
+        received = 0
+        while received < size:
+            n = self.sock.recv_into(view[received:], size - received)
+            if n == 0:
+                raise ConnectionError("hcle_server closed the connection.")
+            received += n
+        return buffer
+
+    def _read_reply(self, expected: int) -> bytearray:
+        (length,) = struct.unpack("<I", self._recv_exact(4))
+        message = self._recv_exact(length)
+        if message[0] == MSG_ERROR:
+            raise RuntimeError("hcle_server: " + message[1:].decode("utf-8", "replace"))
+        if message[0] != expected:
+            raise RuntimeError("Unexpected reply from hcle_server.")
+        return message[1:]
+
+
+class RemoteVectorEnv(VectorEnv):
+    """
+    Gymnasium VectorEnv backed by a remote hcle_server.
+
+    The server fixes the game and preprocessing; this wrapper only chooses
+    the address and the frame codec observations travel in. "delta_rle" and
+    "delta_zlib" send each frame relative to the previous one, which cuts
+    bandwidth by an order of magnitude on most games.
+    """
+
+    def __init__(self, address: str, codec: str = "raw"):
+        self.conn = EnvServerConnection(address, codec=codec)
+
+        self.single_observation_space = Box(
+            low=0, high=255, shape=tuple(self.conn.obs_shape), dtype=np.uint8
+        )
+        self.single_action_space = Discrete(len(self.conn.action_set))
+
+        self.num_envs = self.conn.num_envs
+        self.batch_size = self.num_envs
+        self.observation_space = gym.vector.utils.batch_space(
+            self.single_observation_space, self.batch_size
+        )
+        self.action_space = gym.vector.utils.batch_space(
+            self.single_action_space, self.batch_size
+        )
+
+    def reset(
+        self, *, seed: int | None = None, options: dict[str, Any] | None = None
+    ) -> tuple[ObsType, dict[str, Any]]:
+        """Resets all environments and returns the initial observations."""
+        while self.conn.in_flight:
+            self.conn.recv_result()
+        self.conn.send_reset()
+        obs, _, _, _ = self.conn.recv_result()
+        return obs.reshape(self.observation_space.shape).copy(), {}
+
+    def step_async(self, actions: np.ndarray):
+        """Sends actions to the server without waiting for the results."""
+        self.conn.send_step(actions)
+
+    def step_wait(
+        self,
+    ) -> tuple[ObsType, np.ndarray, np.ndarray, np.ndarray, dict[str, Any]]:
+        """Waits for the oldest outstanding step and returns its results."""
+        obs, rewards, dones, truncateds = self.conn.recv_result()
+        return (
+            obs.reshape(self.observation_space.shape).copy(),
+            rewards,
+            dones,
+            truncateds,
+            {},
+        )
+
+    def step(
+        self, actions: np.ndarray
+    ) -> tuple[ObsType, np.ndarray, np.ndarray, np.ndarray, dict[str, Any]]:
+        """Convenience method that performs a full synchronous step."""
+        self.step_async(actions)
+        return self.step_wait()
+
+    def close(self, **kwargs):
+        """Closes the connection; the server goes back to accepting clients."""
+        if hasattr(self, "conn"):
+            self.conn.close()
+            del self.conn
@@ -0,0 +1,173 @@
+from typing import Any, TypeVar
+import os
+import shutil
+import gymnasium as gym
+from gymnasium.vector import VectorEnv
+from gymnasium.spaces import Box, Discrete
+import numpy as np
+from hcle_py import roms
+from . import _hcle_py
+
+ObsType = TypeVar("ObsType")
+
+WORKER_NAME = "hcle_shm_worker"
+
+
+def find_worker() -> str:
+    """
+    Locates the hcle_shm_worker executable: $HCLE_SHM_WORKER, then next to
+    the compiled module, then on PATH.
+    """
+    path = os.environ.get("HCLE_SHM_WORKER")
+    if path:
+        return path
+    local = os.path.join(os.path.dirname(os.path.abspath(__file__)), WORKER_NAME)
+    if os.path.isfile(local):
+        return local
+    found = shutil.which(WORKER_NAME)
+    if found:
+        return found
+    raise FileNotFoundError(
+        f"Could not find {WORKER_NAME}; build it or set HCLE_SHM_WORKER."
+    )
+
+
+class ShmVectorEnv(VectorEnv):
+    """
+    Gymnasium VectorEnv whose environments run in separate worker processes.
+
+    The envs are split across `num_workers` hcle_shm_worker processes, each
+    stepping its slice with its own thread pool and writing results into a
+    POSIX shared memory region. The observation, reward and done arrays
+    below are NumPy views of that region, so no data is copied between
+    processes. With `copy=True` (the default) `reset` and `step` return
+    copies; with `copy=False` they return the views themselves, which are
+    overwritten by the next step. Step infos match NESVectorEnv: episode
+    statistics for envs that finished, plus `final_obs` in same_step
+    autoreset mode. POSIX only.
+    """
+
+    def __init__(
+        self,
+        game: str,
+        num_envs: int = 2,
+        num_workers: int = 2,
+        img_height: int = 84,
+        img_width: int = 84,
+        frame_skip: int = 4,
+        maxpool: bool = True,
+        grayscale: bool = True,
+        stack_num: int = 4,
+        color_index_grayscale: bool = False,
+        max_episode_steps: int = 0,
+        autoreset_mode: str = "next_step",
+        threads_per_worker: int = 0,
+        copy: bool = True,
+        worker_path: str | None = None,
+    ):
+        if not hasattr(_hcle_py, "ShmVectorEnvironment"):
+            raise RuntimeError("ShmVectorEnv requires a POSIX build of hcle_py.")
+
+        roms.get_rom_path(game)
+        self.vec_hcle = _hcle_py.ShmVectorEnvironment(
+            worker_path=worker_path or find_worker(),
+            num_envs=num_envs,
+            num_workers=num_workers,
+            game_name=game,
+            obs_height=img_height,
+            obs_width=img_width,
+            frame_skip=frame_skip,
+            maxpool=maxpool,
+            grayscale=grayscale,
+            stack_num=stack_num,
+            color_index_grayscale=color_index_grayscale,
+            max_episode_steps=max_episode_steps,
+            autoreset_mode=autoreset_mode,
+            threads_per_worker=threads_per_worker,
+        )
+        self.autoreset_mode = autoreset_mode
+        self.copy = copy
+
+        single_obs_shape = (
+            (stack_num, img_height, img_width)
+            if grayscale
+            else (stack_num, img_height, img_width, 3)
+        )
+        self.single_observation_space = Box(
+            low=0, high=255, shape=single_obs_shape, dtype=np.uint8
+        )
+        self.single_action_space = Discrete(len(self.vec_hcle.getActionSet()))
+
+        self.num_envs = num_envs
+        self.batch_size = num_envs
+        self.observation_space = gym.vector.utils.batch_space(
+            self.single_observation_space, self.batch_size
+        )
+        self.action_space = gym.vector.utils.batch_space(
+            self.single_action_space, self.batch_size
+        )
+
+        obs, rewards, dones, truncateds = self.vec_hcle.result_buffers()
+        self.obs_buffer = obs.reshape(self.observation_space.shape)
+        self.rewards_buffer = rewards
+        self.dones_buffer = dones.view(np.bool_)
+        self.truncateds_buffer = truncateds.view(np.bool_)
+        self.final_obs_buffer = self.vec_hcle.final_observations().reshape(
+            self.observation_space.shape
+        )
+        self._last_episode_returns = self.vec_hcle.last_episode_returns()
+        self._last_episode_lengths = self.vec_hcle.last_episode_lengths()
+
+    def reset(
+        self, *, seed: int | None = None, options: dict[str, Any] | None = None
+    ) -> tuple[ObsType, dict[str, Any]]:
+        """Resets all environments and returns the initial observations."""
+        self.vec_hcle.reset()
+        return (np.copy(self.obs_buffer) if self.copy else self.obs_buffer), {}
+
+    def step_async(self, actions: np.ndarray):
+        """Sends actions to the worker processes without waiting for the results."""
+        self.vec_hcle.send(actions)
+
+    def step_wait(
+        self,
+    ) -> tuple[ObsType, np.ndarray, np.ndarray, np.ndarray, dict[str, Any]]:
+        """Waits for the worker processes to finish the step and returns the results."""
+        self.vec_hcle.recv()
+        results = (
+            self.obs_buffer,
+            self.rewards_buffer,
+            self.dones_buffer,
+            self.truncateds_buffer,
+        )
+        if self.copy:
+            results = tuple(np.copy(x) for x in results)
+
+        infos = {}
+        ended = self.dones_buffer | self.truncateds_buffer
+        if ended.any():
+            infos["episode"] = {
+                "r": np.copy(self._last_episode_returns),
+                "l": np.copy(self._last_episode_lengths),
+            }
+            infos["_episode"] = ended
+            if self.autoreset_mode == "same_step":
+                infos["final_obs"] = np.copy(self.final_obs_buffer)
+                infos["_final_obs"] = ended
+        return (*results, infos)
+
+    def step(
+        self, actions: np.ndarray
+    ) -> tuple[ObsType, np.ndarray, np.ndarray, np.ndarray, dict[str, Any]]:
+        """Convenience method that performs a full synchronous step."""
+        self.step_async(actions)
+        return self.step_wait()
+
+    def close(self, **kwargs):
+        """Shuts down the worker processes and releases the shared memory."""
+        if hasattr(self, "vec_hcle"):
+            del self.obs_buffer, self.rewards_buffer
+            del self.dones_buffer, self.truncateds_buffer
+            del self.final_obs_buffer
+            del self._last_episode_returns, self._last_episode_lengths
+            del self.vec_hcle
@@ -14,9 +14,11 @@ class NESVectorEnv(VectorEnv):
     """
     Gymnasium VectorEnv wrapper for the C++ HCLEVectorEnvironment.
 
-    This wrapper manages the lifecycle of the observation, reward, and done
-    buffers, passing them to the C++ backend to be filled in-place,
-    which avoids memory allocation overhead in the main loop.
+    Step results are written by the C++ backend into a ring of
+    `num_result_buffers` buffers that it owns. With `copy=True` (the default)
+    `reset` and `step` return copies of them. With `copy=False` they return
+    NumPy views instead, which stay valid for `num_result_buffers - 1`
+    further resets/steps before being overwritten.
     """
 
     def __init__(
@@ -31,6 +33,10 @@ class NESVectorEnv(VectorEnv):
         grayscale: bool = True,
         stack_num: int = 4,
         color_index_grayscale: bool = False,
+        max_episode_steps: int = 0,
+        autoreset_mode: str = "next_step",
+        copy: bool = True,
+        num_result_buffers: int = 2,
     ):
         # Initialize the C++ vectorized environment
         self.vec_hcle = _hcle_py.HCLEVectorEnvironment(
@@ -45,7 +51,12 @@ class NESVectorEnv(VectorEnv):
             grayscale=grayscale,
             stack_num=stack_num,
             color_index_grayscale=color_index_grayscale,
+            max_episode_steps=max_episode_steps,
+            autoreset_mode=autoreset_mode,
+            num_result_buffers=num_result_buffers,
         )
+        self.autoreset_mode = autoreset_mode
+        self.copy = copy
 
         # --- Define observation and action spaces based on C++ env properties ---
         channels = 1 if grayscale else 3
@@ -74,31 +85,45 @@ class NESVectorEnv(VectorEnv):
             self.single_action_space, self.batch_size
         )
 
-        # --- Pre-allocate shared memory buffers ---
-        # These NumPy arrays will be passed to C++ to be filled directly.
-        self.obs_buffer = np.zeros(
-            self.observation_space.shape, dtype=self.observation_space.dtype
+        # Views of buffers owned by the C++ vectorizer (no copies).
+        # Dones/truncateds are stored as uint8 0/1, so they can be viewed as bool.
+        self._result_views = []
+        for slot in range(self.vec_hcle.num_result_buffers):
+            obs, rewards, dones, truncateds = self.vec_hcle.result_buffers(slot)
+            self._result_views.append(
+                (
+                    obs.reshape(self.observation_space.shape),
+                    rewards,
+                    dones.view(np.bool_),
+                    truncateds.view(np.bool_),
+                )
+            )
+        self.final_obs_buffer = self.vec_hcle.final_observations().reshape(
+            self.observation_space.shape
         )
-        self.rewards_buffer = np.zeros(self.num_envs, dtype=np.double)
-        # Use uint8 for dones to match C++ bool size and avoid vector<bool> issues
-        self.dones_buffer = np.zeros(self.num_envs, dtype=np.uint8)
+        self._elapsed_steps = self.vec_hcle.elapsed_steps()
+        self._episode_counts = self.vec_hcle.episode_counts()
+        self._last_episode_returns = self.vec_hcle.last_episode_returns()
+        self._last_episode_lengths = self.vec_hcle.last_episode_lengths()
+        # Per-env numeric game info (score, lives, ...), columns named by info_names.
+        self.info_names = list(self.vec_hcle.info_names)
+        self.game_info = self.vec_hcle.game_info()
 
     def reset(
         self, *, seed: int | None = None, options: dict[str, Any] | None = None
     ) -> tuple[ObsType, dict[str, Any]]:
         """Resets all environments and returns the initial observations."""
 
-        self.vec_hcle.reset(self.obs_buffer)
-
-        # Return a copy of the observation buffer to prevent users from
-        # accidentally modifying the internal state.
-        return np.copy(self.obs_buffer), {}
+        slot = self.vec_hcle.reset_in_place()
+        obs = self._result_views[slot][0]
+        return (np.copy(obs) if self.copy else obs), {}
 
     def step_async(self, actions: np.ndarray):
         """
         Sends actions to the environments without waiting for the results.
         """
-        actions = np.asarray(actions, dtype=np.uint8)
+        # uint8/int32 arrays are passed to C++ without a copy; other inputs are
+        # converted by the binding.
         self.vec_hcle.send(actions)
 
     def step_wait(
@@ -107,15 +132,27 @@ class NESVectorEnv(VectorEnv):
         """
         Waits for the asynchronous step to complete and returns the results.
         """
-        self.vec_hcle.recv(self.obs_buffer, self.rewards_buffer, self.dones_buffer)
+        slot = self.vec_hcle.recv_in_place()
+        obs, rewards, dones_bool, truncateds = self._result_views[slot]
+        if self.copy:
+            obs, rewards = np.copy(obs), np.copy(rewards)
+            dones_bool, truncateds = np.copy(dones_bool), np.copy(truncateds)
 
-        dones_bool = self.dones_buffer.astype(np.bool_)
-        truncateds = np.zeros(self.num_envs, dtype=np.bool_)
         infos = {}
+        ended = dones_bool | truncateds
+        if ended.any():
+            infos["episode"] = {
+                "r": np.copy(self._last_episode_returns),
+                "l": np.copy(self._last_episode_lengths),
+            }
+            infos["_episode"] = ended
+            if self.autoreset_mode == "same_step":
+                infos["final_obs"] = np.copy(self.final_obs_buffer)
+                infos["_final_obs"] = ended
 
         return (
-            np.copy(self.obs_buffer),
-            self.rewards_buffer,
+            obs,
+            rewards,
             dones_bool,
             truncateds,
             infos,
@@ -130,6 +167,146 @@ class NESVectorEnv(VectorEnv):
         self.step_async(actions)
         return self.step_wait()
 
+    def step_many(
+        self,
+        actions: np.ndarray,
+        obs: np.ndarray | None = None,
+        rewards: np.ndarray | None = None,
+        dones: np.ndarray | None = None,
+        truncateds: np.ndarray | None = None,
+        final_obs: np.ndarray | None = None,
+    ) -> tuple[np.ndarray, np.ndarray, np.ndarray, np.ndarray, dict[str, Any]]:
+        """
+        Runs T consecutive steps for every environment in a single call.
+
+        `actions` has shape [T, num_envs]. Results are written into `obs`,
+        `rewards`, `dones` and `truncateds` (shapes [T, num_envs, ...]), which
+        are allocated if not provided. Environments that finish an episode are
+        reset according to `autoreset_mode`. In "same_step" mode the terminal
+        observation of every step that ended an episode is written into
+        `final_obs` (same shape as `obs`) and returned as `infos["final_obs"]`,
+        with `infos["_final_obs"]` marking the valid entries.
+        """
+        actions = np.asarray(actions)
+        if actions.dtype != np.uint8:
+            # Check the range first: the cast would wrap e.g. -1 to 255.
+            if not np.issubdtype(actions.dtype, np.integer):
+                raise TypeError("actions must be an integer array.")
+            if actions.size and (
+                actions.min() < 0 or actions.max() >= self.single_action_space.n
+            ):
+                raise ValueError(
+                    f"actions must be in [0, {self.single_action_space.n})."
+                )
+        actions = np.ascontiguousarray(actions, dtype=np.uint8)
+        num_steps = actions.shape[0]
+        if obs is None:
+            obs = np.empty(
+                (num_steps, *self.observation_space.shape),
+                dtype=self.observation_space.dtype,
+            )
+        if rewards is None:
+            rewards = np.empty((num_steps, self.num_envs), dtype=np.double)
+        if dones is None:
+            dones = np.empty((num_steps, self.num_envs), dtype=np.uint8)
+        if truncateds is None:
+            truncateds = np.empty((num_steps, self.num_envs), dtype=np.uint8)
+
+        if final_obs is None and self.autoreset_mode == "same_step":
+            final_obs = np.zeros_like(obs)
+
+        self.vec_hcle.step_many(actions, obs, rewards, dones, truncateds, final_obs)
+        infos = {}
+        if self.autoreset_mode == "same_step":
+            infos["final_obs"] = final_obs
+            infos["_final_obs"] = (dones | truncateds).astype(bool)
+        return obs, rewards, dones, truncateds, infos
+
+    @property
+    def elapsed_steps(self) -> np.ndarray:
+        """Steps taken so far in each environment's current episode."""
+        return np.copy(self._elapsed_steps)
+
+    @property
+    def episode_counts(self) -> np.ndarray:
+        """Number of episodes each environment has finished."""
+        return np.copy(self._episode_counts)
+
+    @property
+    def episode_returns(self) -> np.ndarray:
+        """Reward accumulated so far in each environment's current episode."""
+        return np.copy(self.vec_hcle.episode_returns())
+
+    def get_profile(self) -> dict[str, dict[str, float]]:
+        """
+        Seconds and call counts per emulator component (cpu, ppu, apu,
+        mapper) and step phase (emulate, game_logic, reset, preprocess),
+        summed over all envs. Requires a build with HCLE_ENABLE_PROFILING
+        (`_hcle_py.profiling_enabled`); otherwise every counter is zero.
+        """
+        return self.vec_hcle.get_profile()
+
+    def reset_profile(self):
+        """Zeroes the profile counters, e.g. once per training iteration."""
+        self.vec_hcle.reset_profile()
+
+    def get_latencies(self) -> dict[str, dict]:
+        """
+        Latency histograms in nanoseconds for single env steps ("step"),
+        send-to-recv round trips ("batch") and the wait before a worker
+        picks up an env ("queue_wait"). Each entry holds count, mean, p50,
+        p90, p99, p999, max and the raw bucket `counts`, whose bucket limits
+        are `_hcle_py.latency_bucket_upper_bounds()`.
+        """
+        return self.vec_hcle.get_latencies()
+
+    def reset_latencies(self):
+        """Clears the latency histograms, e.g. once per training iteration."""
+        self.vec_hcle.reset_latencies()
+
+    def start_recording(self, directory: str, codec: str = "delta_rle", **kwargs):
+        """
+        Records every following reset and step (obs, action, reward, done)
+        into a chunked, memory-mapped dataset in `directory`. Writing happens
+        on a background thread. Read it back with `_hcle_py.TrajectoryReader`.
+        Call before `reset` so every recorded episode is complete. With
+        `raw_frames=True` the raw emulator frames are stored instead, so
+        `_hcle_py.OfflineVectorEnv` can replay them through other
+        preprocessing settings.
+        """
+        self.vec_hcle.start_recording(directory, codec=codec, **kwargs)
+
+    def stop_recording(self):
+        """Flushes and seals the dataset being recorded."""
+        self.vec_hcle.stop_recording()
+
+    def start_action_logs(self, directory: str, hash_interval: int = 64):
+        """
+        Logs every following episode as a compact, replayable action log in
+        `directory`: the emulator snapshot it starts from, one action byte per
+        step and an emulator state hash every `hash_interval` steps. Check the
+        logs with `_hcle_py.replay_action_log` or the `hcle_replay` tool.
+        """
+        self.vec_hcle.start_action_logs(directory, hash_interval)
+
+    def stop_action_logs(self):
+        """Writes out the episodes still in progress and stops action logging."""
+        self.vec_hcle.stop_action_logs()
+
+    def make_replay_buffer(self, capacity: int, seed: int = 0):
+        """
+        Creates a `_hcle_py.ReplayBuffer` matching this env. It stores only
+        the newest frame of each observation and rebuilds the stacks when
+        sampling. Feed it with `buffer.add_results(env.vec_hcle)` after every
+        `reset`/`step` (not `step_many`).
+        """
+        return _hcle_py.ReplayBuffer(
+            capacity,
+            self.num_envs,
+            list(self.single_observation_space.shape),
+            seed=seed,
+        )
+
     def close(self, **kwargs):
         """Cleans up the C++ environment."""
         if hasattr(self, "vec_hcle"):
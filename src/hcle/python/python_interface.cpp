@@ -55,7 +55,20 @@ PYBIND11_MODULE(_hcle_py, m)
         .def("load_from_state", &hcle::environment::PreprocessedEnv::loadFromState, "Loads a previously saved environment state")
 
         .def("get_action_set", [](hcle::environment::PreprocessedEnv &env)
-             { return env.getActionSet(); });
+             { return env.getActionSet(); })
+        .def("get_profile", [](const hcle::environment::PreprocessedEnv &env)
+             {
+                 py::dict profile;
+                 for (const auto &entry : env.getProfile())
+                 {
+                     py::dict values;
+                     values["calls"] = entry.calls;
+                     values["seconds"] = entry.seconds;
+                     profile[py::str(entry.name)] = values;
+                 }
+                 return profile; },
+             "Returns {name: {calls, seconds}} per emulator component and step phase (needs HCLE_ENABLE_PROFILING)")
+        .def("reset_profile", &hcle::environment::PreprocessedEnv::resetProfile, "Zeroes the profile counters");
 
     init_vector_bindings(m);
     py::register_exception<hcle::common::WindowClosedException>(m, "WindowClosedException");
@@ -1,16 +1,242 @@
 #include <pybind11/pybind11.h>
 #include <pybind11/stl.h>
 #include <pybind11/numpy.h>
+#include "hcle/common/thread_pool.hpp"
 #include "hcle/environment/hcle_vector_environment.hpp"
+#include "hcle/environment/offline_vector_env.hpp"
+#include "hcle/environment/replay_buffer.hpp"
+#include "hcle/python/dlpack.hpp"
+#if !defined(_WIN32)
+#include "hcle/environment/shm_vector_env.hpp"
+#endif
 
+#include <cstring>
 #include <vector>
+#include <optional>
+#include <span>
+#include <string>
+#include <type_traits>
 
 namespace py = pybind11;
 
+// Wraps a buffer owned by the vector environment as a NumPy array without copying.
+// The array holds a reference to the environment so the memory outlives it.
+template <typename T>
+py::array_t<T> buffer_view(py::handle owner, const T *data, std::vector<py::ssize_t> shape)
+{
+     return py::array_t<T>(shape, data, owner);
+}
+
+// Resolves a result slot index; -1 means the most recently collected results.
+int checked_slot(const hcle::environment::HCLEVectorEnvironment &env, int slot)
+{
+     if (slot == -1)
+          return env.getCurrentResultSlot();
+     if (slot < 0 || slot >= env.getNumResultBuffers())
+          throw py::index_error("Result slot out of range.");
+     return slot;
+}
+
+// {name: {"calls": ..., "seconds": ...}} in report order.
+py::dict profile_to_dict(const std::vector<hcle::common::ProfileEntry> &entries)
+{
+     py::dict profile;
+     for (const auto &entry : entries)
+     {
+          py::dict values;
+          values["calls"] = entry.calls;
+          values["seconds"] = entry.seconds;
+          profile[py::str(entry.name)] = values;
+     }
+     return profile;
+}
+
+// Summary statistics in nanoseconds plus the raw bucket counts, which line up with
+// latency_bucket_upper_bounds().
+py::dict latency_to_dict(const hcle::common::LatencyHistogram &histogram)
+{
+     py::dict values;
+     values["count"] = histogram.getCount();
+     values["mean"] = histogram.getMean();
+     values["p50"] = histogram.getPercentile(50.0);
+     values["p90"] = histogram.getPercentile(90.0);
+     values["p99"] = histogram.getPercentile(99.0);
+     values["p999"] = histogram.getPercentile(99.9);
+     values["max"] = histogram.getMax();
+     const std::vector<uint64_t> counts = histogram.getCounts();
+     values["counts"] = py::array_t<uint64_t>(counts.size(), counts.data());
+     return values;
+}
+
+// Checks an output array once, at registration, so per-step calls can skip validation.
+template <typename T>
+T *checked_output(const py::array &arr, py::ssize_t num_envs, py::ssize_t expected_size, const char *name)
+{
+     if (!py::isinstance<py::array_t<T>>(arr))
+          throw py::type_error(std::string(name) + " has the wrong dtype.");
+     if (!(arr.flags() & py::array::c_style) || !arr.writeable())
+          throw py::value_error(std::string(name) + " must be a writeable C-contiguous array.");
+     if (arr.ndim() < 1 || arr.shape(0) != num_envs || arr.size() != expected_size)
+          throw py::value_error(std::string(name) + " must have shape [num_envs, ...] and " +
+                                std::to_string(expected_size) + " elements.");
+     return static_cast<T *>(const_cast<void *>(arr.data()));
+}
+
+// Checks a caller-provided output array on every call, for APIs that don't register buffers.
+template <typename T>
+T *checked_output_data(py::array_t<T> &arr, py::ssize_t expected_size, const char *name)
+{
+     if (!(arr.flags() & py::array::c_style) || !arr.writeable())
+          throw py::value_error(std::string(name) + " must be a writeable C-contiguous array.");
+     if (arr.size() != expected_size)
+          throw py::value_error(std::string(name) + " must have " + std::to_string(expected_size) + " elements.");
+     return arr.mutable_data();
+}
+
+// A C++-owned buffer handed to other array libraries without copying, either through
+// __array_interface__ or the DLPack protocol. Holds a reference to the owning environment.
+struct ExportedBuffer
+{
+     py::object owner;
+     void *data;
+     std::vector<int64_t> shape;
+     size_t itemsize;
+     DLDataType dl_dtype;
+     std::string typestr;
+
+     // C-contiguous strides, in elements.
+     std::vector<int64_t> strides() const
+     {
+          std::vector<int64_t> result(shape.size());
+          int64_t stride = 1;
+          for (size_t i = shape.size(); i-- > 0;)
+          {
+               result[i] = stride;
+               stride *= shape[i];
+          }
+          return result;
+     }
+};
+
+template <typename T>
+ExportedBuffer export_buffer(py::handle owner, const T *data, std::vector<int64_t> shape)
+{
+     const uint8_t code = std::is_floating_point_v<T> ? kDLFloat : (std::is_signed_v<T> ? kDLInt : kDLUInt);
+     return {py::reinterpret_borrow<py::object>(owner), const_cast<T *>(data), std::move(shape), sizeof(T),
+             DLDataType{code, static_cast<uint8_t>(sizeof(T) * 8), 1},
+             py::dtype::of<T>().attr("str").template cast<std::string>()};
+}
+
+// Owns everything a DLManagedTensor points at until the consumer calls its deleter.
+struct DLPackContext
+{
+     py::object owner;
+     std::vector<int64_t> shape;
+     std::vector<int64_t> strides;
+     DLManagedTensor tensor;
+};
+
+void dlpack_deleter(DLManagedTensor *tensor)
+{
+     // Consumers may release the tensor from any thread.
+     py::gil_scoped_acquire gil;
+     delete static_cast<DLPackContext *>(tensor->manager_ctx);
+}
+
+// Frees the tensor if the capsule is destroyed without being consumed (consumers rename
+// it to "used_dltensor").
+void dlpack_capsule_destructor(PyObject *capsule)
+{
+     if (!PyCapsule_IsValid(capsule, "dltensor"))
+          return;
+     PyObject *type, *value, *traceback;
+     PyErr_Fetch(&type, &value, &traceback);
+     auto *tensor = static_cast<DLManagedTensor *>(PyCapsule_GetPointer(capsule, "dltensor"));
+     tensor->deleter(tensor);
+     PyErr_Restore(type, value, traceback);
+}
+
+py::object to_dlpack(const ExportedBuffer &buffer)
+{
+     auto *ctx = new DLPackContext{buffer.owner, buffer.shape, buffer.strides(), {}};
+     DLTensor &dl = ctx->tensor.dl_tensor;
+     dl.data = buffer.data;
+     dl.device = {kDLCPU, 0};
+     dl.ndim = static_cast<int32_t>(ctx->shape.size());
+     dl.dtype = buffer.dl_dtype;
+     dl.shape = ctx->shape.data();
+     dl.strides = ctx->strides.data();
+     dl.byte_offset = 0;
+     ctx->tensor.manager_ctx = ctx;
+     ctx->tensor.deleter = dlpack_deleter;
+
+     PyObject *capsule = PyCapsule_New(&ctx->tensor, "dltensor", dlpack_capsule_destructor);
+     if (!capsule)
+     {
+          delete ctx;
+          throw py::error_already_set();
+     }
+     return py::reinterpret_steal<py::object>(capsule);
+}
+
 void init_vector_bindings(py::module_ &m)
 {
-     py::class_<hcle::environment::HCLEVectorEnvironment>(m, "HCLEVectorEnvironment")
-         .def(py::init<int, std::string, std::string, std::string, int, int, int, bool, bool, int, bool>(),
+     py::class_<ExportedBuffer>(m, "ExportedBuffer")
+         .def_property_readonly("shape", [](const ExportedBuffer &self)
+                                { return py::tuple(py::cast(self.shape)); })
+         .def_property_readonly("__array_interface__", [](const ExportedBuffer &self)
+                                {
+                                     py::list byte_strides;
+                                     for (int64_t stride : self.strides())
+                                          byte_strides.append(stride * static_cast<int64_t>(self.itemsize));
+                                     py::dict interface;
+                                     interface["version"] = 3;
+                                     interface["shape"] = py::tuple(py::cast(self.shape));
+                                     interface["typestr"] = self.typestr;
+                                     interface["strides"] = py::tuple(byte_strides);
+                                     interface["data"] = py::make_tuple(reinterpret_cast<uintptr_t>(self.data), false);
+                                     return interface; })
+         // Extra keywords from newer consumers (max_version, dl_device, copy) are accepted and
+         // an unversioned "dltensor" capsule is returned, which they all still understand.
+         .def("__dlpack__", [](const ExportedBuffer &self, [[maybe_unused]] py::object stream, [[maybe_unused]] py::kwargs kwargs)
+              { return to_dlpack(self); },
+              py::arg("stream") = py::none())
+         .def("__dlpack_device__", [](const ExportedBuffer &)
+              { return py::make_tuple(static_cast<int>(kDLCPU), 0); });
+
+     m.def("set_num_threads", [](int num_threads)
+           { hcle::common::ThreadPool::instance().setNumThreads(num_threads); },
+           py::arg("num_threads"), py::call_guard<py::gil_scoped_release>(),
+           "Sets the size of the worker pool shared by all vector environments in this process.");
+     m.def("get_num_threads", []()
+           { return hcle::common::ThreadPool::instance().getNumThreads(); },
+           "Returns the size of the worker pool shared by all vector environments in this process.");
+     m.attr("profiling_enabled") = hcle::common::kProfilingEnabled;
+
+     m.def("latency_bucket_upper_bounds", []()
+           {
+                const std::vector<uint64_t> bounds = hcle::common::LatencyHistogram::getBucketUpperBounds();
+                return py::array_t<uint64_t>(bounds.size(), bounds.data()); },
+           "Largest latency in nanoseconds of each histogram bucket returned by get_latencies().");
+
+     m.def("start_trace", [](size_t events_per_thread)
+           { hcle::common::Tracer::instance().start(events_per_thread); },
+           py::arg("events_per_thread") = size_t{1} << 16,
+           "Starts recording a timeline of vectorizer dispatches, worker task claims, env steps/resets, result pushes "
+           "and recv waits. Each thread keeps its newest events_per_thread events. Call between batches.");
+     m.def("stop_trace", []()
+           { hcle::common::Tracer::instance().stop(); },
+           "Stops recording the timeline; the events are kept for dump_trace().");
+     m.def("is_tracing", []()
+           { return hcle::common::Tracer::instance().isEnabled(); });
+     m.def("dump_trace", [](const std::string &path)
+           { return hcle::common::Tracer::instance().writeChromeTrace(path); },
+           py::arg("path"), py::call_guard<py::gil_scoped_release>(),
+           "Writes the recorded timeline as Chrome trace JSON (chrome://tracing, ui.perfetto.dev) and returns the "
+           "number of events. Call between batches.");
+
+     py::class_<hcle::environment::HCLEVectorEnvironment>(m, "HCLEVectorEnvironment", py::dynamic_attr())
+         .def(py::init<int, std::string, std::string, std::string, int, int, int, bool, bool, int, bool, int, std::string, int>(),
               py::arg("num_envs"),
               py::arg("rom_path"),
               py::arg("game_name"),
@@ -21,50 +247,516 @@ void init_vector_bindings(py::module_ &m)
               py::arg("maxpool") = true,
               py::arg("grayscale") = true,
               py::arg("stack_num") = 4,
-              py::arg("color_index_grayscale") = false)
+              py::arg("color_index_grayscale") = false,
+              py::arg("max_episode_steps") = 0,
+              py::arg("autoreset_mode") = "next_step",
+              py::arg("num_result_buffers") = 2)
          .def_property_readonly("num_envs", &hcle::environment::HCLEVectorEnvironment::getNumEnvs)
+         .def_property_readonly("num_result_buffers", &hcle::environment::HCLEVectorEnvironment::getNumResultBuffers)
+         .def_property_readonly("max_episode_steps", &hcle::environment::HCLEVectorEnvironment::getMaxEpisodeSteps)
+         .def_property_readonly("autoreset_mode", [](const hcle::environment::HCLEVectorEnvironment &self)
+                                { return self.getAutoResetMode() == hcle::environment::AutoResetMode::SameStep ? "same_step" : "next_step"; })
          // --- Helper functions for Python wrapper ---
          .def("getActionSet", &hcle::environment::HCLEVectorEnvironment::getActionSet,
               "Returns the set of valid actions for the environment.")
          .def("getObservationSize", &hcle::environment::HCLEVectorEnvironment::getObservationSize,
               "Returns the total size in bytes of a single stacked observation.")
+         .def("final_observations", [](py::object self_obj)
+              {
+                   auto &self = self_obj.cast<hcle::environment::HCLEVectorEnvironment &>();
+                   return buffer_view(self_obj, self.getFinalObservations(),
+                                      {self.getNumEnvs(), static_cast<py::ssize_t>(self.getObservationSize())}); },
+              "Returns a [num_envs, obs_size] view of the terminal observations written in same_step autoreset mode.")
+         .def("elapsed_steps", [](py::object self_obj)
+              {
+                   auto &self = self_obj.cast<hcle::environment::HCLEVectorEnvironment &>();
+                   return buffer_view(self_obj, self.getElapsedSteps(), {self.getNumEnvs()}); },
+              "Returns a view of the number of steps taken in each environment's current episode.")
+         .def("episode_counts", [](py::object self_obj)
+              {
+                   auto &self = self_obj.cast<hcle::environment::HCLEVectorEnvironment &>();
+                   return buffer_view(self_obj, self.getEpisodeCounts(), {self.getNumEnvs()}); },
+              "Returns a view of the number of episodes each environment has finished.")
+         .def("episode_returns", [](py::object self_obj)
+              {
+                   auto &self = self_obj.cast<hcle::environment::HCLEVectorEnvironment &>();
+                   return buffer_view(self_obj, self.getEpisodeReturns(), {self.getNumEnvs()}); },
+              "Returns a view of the reward accumulated so far in each environment's current episode.")
+         .def("last_episode_returns", [](py::object self_obj)
+              {
+                   auto &self = self_obj.cast<hcle::environment::HCLEVectorEnvironment &>();
+                   return buffer_view(self_obj, self.getLastEpisodeReturns(), {self.getNumEnvs()}); },
+              "Returns a view of the total reward of each environment's most recently finished episode.")
+         .def("last_episode_lengths", [](py::object self_obj)
+              {
+                   auto &self = self_obj.cast<hcle::environment::HCLEVectorEnvironment &>();
+                   return buffer_view(self_obj, self.getLastEpisodeLengths(), {self.getNumEnvs()}); },
+              "Returns a view of the length of each environment's most recently finished episode.")
+         .def_property_readonly("info_names", &hcle::environment::HCLEVectorEnvironment::getInfoNames,
+                                "Names of the columns of game_info(), as published by the game.")
+         .def("game_info", [](py::object self_obj)
+              {
+                   auto &self = self_obj.cast<hcle::environment::HCLEVectorEnvironment &>();
+                   return buffer_view(self_obj, self.getGameInfo(),
+                                      {self.getNumEnvs(), static_cast<py::ssize_t>(self.getInfoNames().size())}); },
+              "Returns a [num_envs, len(info_names)] view of the game's numeric info values after the last step.")
+         .def("result_buffers", [](py::object self_obj, int slot)
+              {
+                   auto &self = self_obj.cast<hcle::environment::HCLEVectorEnvironment &>();
+                   slot = checked_slot(self, slot);
+                   const py::ssize_t num_envs = self.getNumEnvs();
+                   return py::make_tuple(
+                       buffer_view(self_obj, self.getResultObservations(slot),
+                                   {num_envs, static_cast<py::ssize_t>(self.getObservationSize())}),
+                       buffer_view(self_obj, self.getResultRewards(slot), {num_envs}),
+                       buffer_view(self_obj, self.getResultDones(slot), {num_envs}),
+                       buffer_view(self_obj, self.getResultTruncateds(slot), {num_envs})); },
+              py::arg("slot"),
+              "Returns (obs, rewards, dones, truncateds) views of one of the C++-owned result buffers.")
+         .def("observation_buffer", [](py::object self_obj, int slot)
+              {
+                   auto &self = self_obj.cast<hcle::environment::HCLEVectorEnvironment &>();
+                   slot = checked_slot(self, slot);
+                   std::vector<int64_t> shape = {self.getNumEnvs()};
+                   for (size_t dim : self.getObservationShape())
+                        shape.push_back(static_cast<int64_t>(dim));
+                   return export_buffer(self_obj, self.getResultObservations(slot), std::move(shape)); },
+              py::arg("slot") = -1,
+              "Exports a result buffer's observations ([num_envs, *obs_shape], uint8) via DLPack / __array_interface__. slot=-1 is the latest results.")
+         .def("reward_buffer", [](py::object self_obj, int slot)
+              {
+                   auto &self = self_obj.cast<hcle::environment::HCLEVectorEnvironment &>();
+                   slot = checked_slot(self, slot);
+                   return export_buffer(self_obj, self.getResultRewards(slot), {self.getNumEnvs()}); },
+              py::arg("slot") = -1,
+              "Exports a result buffer's rewards ([num_envs], float64) via DLPack / __array_interface__.")
+         .def("done_buffer", [](py::object self_obj, int slot)
+              {
+                   auto &self = self_obj.cast<hcle::environment::HCLEVectorEnvironment &>();
+                   slot = checked_slot(self, slot);
+                   return export_buffer(self_obj, self.getResultDones(slot), {self.getNumEnvs()}); },
+              py::arg("slot") = -1,
+              "Exports a result buffer's terminated flags ([num_envs], uint8) via DLPack / __array_interface__.")
+         .def("truncated_buffer", [](py::object self_obj, int slot)
+              {
+                   auto &self = self_obj.cast<hcle::environment::HCLEVectorEnvironment &>();
+                   slot = checked_slot(self, slot);
+                   return export_buffer(self_obj, self.getResultTruncateds(slot), {self.getNumEnvs()}); },
+              py::arg("slot") = -1,
+              "Exports a result buffer's truncated flags ([num_envs], uint8) via DLPack / __array_interface__.")
          // --- Core API ---
-         .def("reset", [](hcle::environment::HCLEVectorEnvironment &self, py::array_t<uint8_t> obs_np)
+         .def("register_buffers", [](py::object self_obj, py::array obs_np, py::array rewards_np, py::array dones_np, std::optional<py::array> truncateds_np)
               {
-                 auto *obs_ptr = static_cast<uint8_t *>(obs_np.mutable_data());
+                   auto &self = self_obj.cast<hcle::environment::HCLEVectorEnvironment &>();
+                   const py::ssize_t num_envs = self.getNumEnvs();
+                   hcle::environment::HCLEVectorEnvironment::OutputBuffers buffers;
+                   buffers.obs = checked_output<uint8_t>(obs_np, num_envs, num_envs * static_cast<py::ssize_t>(self.getObservationSize()), "obs");
+                   buffers.rewards = checked_output<double>(rewards_np, num_envs, num_envs, "rewards");
+                   buffers.dones = checked_output<uint8_t>(dones_np, num_envs, num_envs, "dones");
+                   if (truncateds_np)
+                        buffers.truncateds = checked_output<uint8_t>(*truncateds_np, num_envs, num_envs, "truncateds");
 
-                 // Create dummy buffers with the CORRECT size
-                 const int num_envs = self.getNumEnvs();
-                 std::vector<double> reward_buffer(num_envs);
-                 std::vector<uint8_t> done_buffer(num_envs);
+                   // Keep the arrays alive for as long as C++ holds their pointers.
+                   self_obj.attr("_registered_buffers") = py::make_tuple(obs_np, rewards_np, dones_np, truncateds_np);
+                   self.setOutputBuffers(buffers); },
+              py::arg("obs"), py::arg("rewards"), py::arg("dones"), py::arg("truncateds") = py::none(),
+              "Validates and registers the arrays that reset() and recv() fill when called without arguments.")
+         .def("reset", [](hcle::environment::HCLEVectorEnvironment &self, py::array_t<uint8_t> obs_np)
+              {
+                 const py::ssize_t num_envs = self.getNumEnvs();
+                 auto *obs_ptr = checked_output_data(obs_np, num_envs * static_cast<py::ssize_t>(self.getObservationSize()), "obs");
 
                  py::gil_scoped_release release;
-                 self.reset(obs_ptr, reward_buffer.data(), done_buffer.data()); }, py::arg("obs").noconvert())
-         .def("send", [](hcle::environment::HCLEVectorEnvironment &self, py::array_t<uint8_t> actions)
+                 self.reset(obs_ptr, nullptr, nullptr); }, py::arg("obs").noconvert())
+         .def("reset", [](hcle::environment::HCLEVectorEnvironment &self)
+              {
+                   const auto &out = self.getOutputBuffers();
+                   if (!out.obs)
+                        throw std::runtime_error("No output buffers registered; call register_buffers() first.");
+                   self.reset(out.obs, out.rewards, out.dones, out.truncateds); },
+              py::call_guard<py::gil_scoped_release>(),
+              "Resets all environments into the registered output buffers.")
+         .def("reset_in_place", [](hcle::environment::HCLEVectorEnvironment &self)
+              {
+                   self.reset(nullptr, nullptr, nullptr);
+                   return self.getCurrentResultSlot(); },
+              py::call_guard<py::gil_scoped_release>(),
+              "Resets all environments and returns the index of the result buffer holding the initial observations.")
+         // uint8 and int32 actions are borrowed without copying; anything else is converted to int32.
+         .def("send", [](hcle::environment::HCLEVectorEnvironment &self, py::array_t<uint8_t, py::array::c_style> actions)
               {
-                   // Create a no-copy view of the numpy array data
-                   py::buffer_info actions_buf = actions.request();
-                   auto *actions_ptr = static_cast<uint8_t *>(actions_buf.ptr);
-                   std::vector<int> actions_vec(actions_ptr, actions_ptr + actions.size());
+                   std::span<const uint8_t> actions_span(actions.data(), actions.size());
 
                    // Release GIL to allow C++ threads to run in the background
                    py::gil_scoped_release release;
-                   self.send(actions_vec);
-                   // GIL is re-acquired automatically
+                   self.send(actions_span);
               },
               py::arg("actions").noconvert(), "Sends a batch of actions to the environments to be executed.")
+         .def("send", [](hcle::environment::HCLEVectorEnvironment &self, py::array_t<int32_t, py::array::c_style> actions)
+              {
+                   std::span<const int32_t> actions_span(actions.data(), actions.size());
 
-         .def("recv", [](hcle::environment::HCLEVectorEnvironment &self, py::array_t<uint8_t> obs_np, py::array_t<double> rewards_np, py::array_t<uint8_t> dones_np)
+                   py::gil_scoped_release release;
+                   self.send(actions_span);
+              },
+              py::arg("actions"))
+
+         .def("recv", [](hcle::environment::HCLEVectorEnvironment &self, py::array_t<uint8_t> obs_np, py::array_t<double> rewards_np, py::array_t<uint8_t> dones_np, std::optional<py::array_t<uint8_t>> truncateds_np)
               {
-                   // Get pointers to the NumPy array data
-                   auto *obs_ptr = static_cast<uint8_t *>(obs_np.mutable_data());
-                   auto *rewards_ptr = static_cast<double *>(rewards_np.mutable_data());
-                   auto *dones_ptr = static_cast<uint8_t *>(dones_np.mutable_data());
+                   const py::ssize_t num_envs = self.getNumEnvs();
+                   auto *obs_ptr = checked_output_data(obs_np, num_envs * static_cast<py::ssize_t>(self.getObservationSize()), "obs");
+                   auto *rewards_ptr = checked_output_data(rewards_np, num_envs, "rewards");
+                   auto *dones_ptr = checked_output_data(dones_np, num_envs, "dones");
+                   auto *truncateds_ptr = truncateds_np ? checked_output_data(*truncateds_np, num_envs, "truncateds") : nullptr;
 
                    // Release the GIL while waiting for C++ threads to finish
                    py::gil_scoped_release release;
-                   self.recv(obs_ptr, rewards_ptr, dones_ptr);
+                   self.recv(obs_ptr, rewards_ptr, dones_ptr, truncateds_ptr);
                    // GIL is re-acquired automatically
               },
-              py::arg("obs").noconvert(), py::arg("rewards").noconvert(), py::arg("dones").noconvert(), "Waits for the step to complete and writes the results (obs, rewards, dones) into the provided NumPy arrays.");
+              py::arg("obs").noconvert(), py::arg("rewards").noconvert(), py::arg("dones").noconvert(), py::arg("truncateds").noconvert() = py::none(),
+              "Waits for the step to complete and writes the results (obs, rewards, dones and optionally truncateds) into the provided NumPy arrays.")
+         .def("recv", [](hcle::environment::HCLEVectorEnvironment &self)
+              {
+                   const auto &out = self.getOutputBuffers();
+                   if (!out.obs)
+                        throw std::runtime_error("No output buffers registered; call register_buffers() first.");
+                   self.recv(out.obs, out.rewards, out.dones, out.truncateds); },
+              py::call_guard<py::gil_scoped_release>(),
+              "Waits for the step to complete and writes the results into the registered output buffers.")
+         .def("recv_in_place", [](hcle::environment::HCLEVectorEnvironment &self)
+              {
+                   self.recv(nullptr, nullptr, nullptr);
+                   return self.getCurrentResultSlot(); },
+              py::call_guard<py::gil_scoped_release>(),
+              "Waits for the step to complete and returns the index of the result buffer holding its results, without copying.")
+
+         .def("step_many", [](hcle::environment::HCLEVectorEnvironment &self, py::array_t<uint8_t, py::array::c_style> actions_np, py::array_t<uint8_t> obs_np, py::array_t<double> rewards_np, py::array_t<uint8_t> dones_np, std::optional<py::array_t<uint8_t>> truncateds_np, std::optional<py::array_t<uint8_t>> final_obs_np)
+              {
+                   if (actions_np.ndim() != 2 || actions_np.shape(1) != self.getNumEnvs())
+                        throw std::invalid_argument("actions must have shape [num_steps, num_envs].");
+
+                   const int num_steps = static_cast<int>(actions_np.shape(0));
+                   const py::ssize_t num_results = static_cast<py::ssize_t>(num_steps) * self.getNumEnvs();
+                   const auto *actions_ptr = actions_np.data();
+                   auto *obs_ptr = checked_output_data(obs_np, num_results * static_cast<py::ssize_t>(self.getObservationSize()), "obs");
+                   auto *rewards_ptr = checked_output_data(rewards_np, num_results, "rewards");
+                   auto *dones_ptr = checked_output_data(dones_np, num_results, "dones");
+                   auto *truncateds_ptr = truncateds_np ? checked_output_data(*truncateds_np, num_results, "truncateds") : nullptr;
+                   auto *final_obs_ptr = final_obs_np ? checked_output_data(*final_obs_np, num_results * static_cast<py::ssize_t>(self.getObservationSize()), "final_obs") : nullptr;
+
+                   py::gil_scoped_release release;
+                   self.stepMany(actions_ptr, num_steps, obs_ptr, rewards_ptr, dones_ptr, truncateds_ptr, final_obs_ptr);
+              },
+              py::arg("actions"), py::arg("obs").noconvert(), py::arg("rewards").noconvert(), py::arg("dones").noconvert(), py::arg("truncateds").noconvert() = py::none(),
+              py::arg("final_obs").noconvert() = py::none(),
+              "Runs num_steps consecutive steps for all environments and writes [num_steps, num_envs, ...] results into the provided NumPy arrays. "
+              "In same-step autoreset mode final_obs receives the terminal observation of every step that ended an episode.")
+
+         .def("start_recording", [](hcle::environment::HCLEVectorEnvironment &self, const std::string &directory, const std::string &codec, size_t chunk_size, int keyframe_interval, int queue_depth, int zlib_level, bool raw_frames)
+              {
+                   hcle::environment::TrajectoryRecorderConfig config;
+                   config.codec = hcle::common::parseFrameCodec(codec);
+                   config.chunk_size = chunk_size;
+                   config.keyframe_interval = keyframe_interval;
+                   config.queue_depth = queue_depth;
+                   config.zlib_level = zlib_level;
+                   config.content = raw_frames ? hcle::environment::TrajectoryContent::RawFrames
+                                               : hcle::environment::TrajectoryContent::Observations;
+                   self.startRecording(directory, config); },
+              py::arg("directory"), py::arg("codec") = "delta_rle", py::arg("chunk_size") = size_t{64} << 20,
+              py::arg("keyframe_interval") = 64, py::arg("queue_depth") = 8, py::arg("zlib_level") = 1,
+              py::arg("raw_frames") = false,
+              "Records every following reset/step into a chunked trajectory dataset in directory, written by a background thread. "
+              "With raw_frames the raw emulator frames are stored instead of observations, for replay with OfflineVectorEnv.")
+         .def("stop_recording", &hcle::environment::HCLEVectorEnvironment::stopRecording, py::call_guard<py::gil_scoped_release>(),
+              "Flushes and seals the trajectory dataset being recorded.")
+         .def_property_readonly("is_recording", &hcle::environment::HCLEVectorEnvironment::isRecording)
+         .def("get_profile", [](const hcle::environment::HCLEVectorEnvironment &self)
+              { return profile_to_dict(self.getProfile()); },
+              "Time per emulator component (cpu, ppu, apu, mapper) and step phase (emulate, game_logic, reset, preprocess), "
+              "summed over all envs. Empty counters unless the module was built with HCLE_ENABLE_PROFILING.")
+         .def("reset_profile", &hcle::environment::HCLEVectorEnvironment::resetProfile,
+              "Zeroes the profile counters, e.g. at the start of a training iteration.")
+         .def("get_latencies", [](const hcle::environment::HCLEVectorEnvironment &self)
+              {
+                   py::dict latencies;
+                   latencies["step"] = latency_to_dict(self.getStepLatency());
+                   latencies["batch"] = latency_to_dict(self.getBatchLatency());
+                   latencies["queue_wait"] = latency_to_dict(self.getQueueWaitLatency());
+                   return latencies; },
+              "Latency histograms in nanoseconds: step (one env step), batch (send() to the end of recv()) and "
+              "queue_wait (task dispatch to a worker starting it). Each has count, mean, p50, p90, p99, p999, max "
+              "and per-bucket counts matching latency_bucket_upper_bounds().")
+         .def("reset_latencies", &hcle::environment::HCLEVectorEnvironment::resetLatencies,
+              "Clears the latency histograms, e.g. at the start of a training iteration.")
+         .def("start_action_logs", &hcle::environment::HCLEVectorEnvironment::startActionLogs,
+              py::arg("directory"), py::arg("hash_interval") = 64,
+              "Logs every episode that starts from now on as a replayable action log in directory, "
+              "with an emulator state hash every hash_interval steps. Check them with replay_action_log().")
+         .def("stop_action_logs", &hcle::environment::HCLEVectorEnvironment::stopActionLogs,
+              "Writes out the episodes still in progress and stops action logging.")
+         .def_property_readonly("is_logging_actions", &hcle::environment::HCLEVectorEnvironment::isLoggingActions);
+
+     m.def("replay_action_log", [](const std::string &path, bool render_skip)
+           {
+                const hcle::environment::ActionLog log = hcle::environment::ActionLog::read(path);
+                hcle::environment::ActionLogReplayResult result;
+                {
+                     py::gil_scoped_release release;
+                     result = hcle::environment::replayActionLog(log, render_skip);
+                }
+                py::dict out;
+                out["game"] = log.getGameName();
+                out["steps"] = result.steps;
+                out["hashes_checked"] = result.hashes_checked;
+                out["divergence_step"] = result.divergence_step;
+                out["expected_hash"] = result.expected_hash;
+                out["actual_hash"] = result.actual_hash;
+                return out; },
+           py::arg("path"), py::arg("render_skip") = false,
+           "Replays an action log from its snapshot and returns a dict with the steps replayed, the hashes checked "
+           "and the first divergence_step (-1 if every hash matched). render_skip replays in the PPU's render-skip mode.");
+
+     py::class_<hcle::environment::TrajectoryReader>(m, "TrajectoryReader")
+         .def(py::init<std::string>(), py::arg("directory"))
+         .def_property_readonly("num_episodes", &hcle::environment::TrajectoryReader::getNumEpisodes)
+         .def_property_readonly("num_chunks", &hcle::environment::TrajectoryReader::getNumChunks)
+         .def_property_readonly("observation_shape", &hcle::environment::TrajectoryReader::getObservationShape)
+         .def("__len__", &hcle::environment::TrajectoryReader::getNumEpisodes)
+         .def("episode_length", &hcle::environment::TrajectoryReader::getEpisodeLength, py::arg("episode"))
+         .def("episode_env", &hcle::environment::TrajectoryReader::getEpisodeEnv, py::arg("episode"),
+              "Index of the environment that produced the episode.")
+         .def("get_step", [](hcle::environment::TrajectoryReader &self, size_t episode, size_t step)
+              {
+                   const auto &shape = self.getObservationShape();
+                   py::array_t<uint8_t> obs(std::vector<py::ssize_t>(shape.begin(), shape.end()));
+                   hcle::environment::TrajectoryStep result;
+                   {
+                        py::gil_scoped_release release;
+                        result = self.getStep(episode, step, obs.mutable_data());
+                   }
+                   return py::make_tuple(obs, result.action, result.reward, result.done, result.truncated); },
+              py::arg("episode"), py::arg("step"),
+              "Returns (obs, action, reward, done, truncated) for one step. action is 255 for reset observations.")
+         .def("read_episode", [](hcle::environment::TrajectoryReader &self, size_t episode)
+              {
+                   const auto length = static_cast<py::ssize_t>(self.getEpisodeLength(episode));
+                   std::vector<py::ssize_t> obs_shape = {length};
+                   for (size_t dim : self.getObservationShape())
+                        obs_shape.push_back(static_cast<py::ssize_t>(dim));
+                   py::array_t<uint8_t> obs(obs_shape);
+                   py::array_t<uint8_t> actions(length);
+                   py::array_t<double> rewards(length);
+                   py::array_t<bool> dones(length);
+                   py::array_t<bool> truncateds(length);
+                   {
+                        py::gil_scoped_release release;
+                        self.readEpisode(episode, obs.mutable_data(), actions.mutable_data(), rewards.mutable_data(),
+                                         reinterpret_cast<uint8_t *>(dones.mutable_data()),
+                                         reinterpret_cast<uint8_t *>(truncateds.mutable_data()));
+                   }
+                   py::dict result;
+                   result["obs"] = obs;
+                   result["actions"] = actions;
+                   result["rewards"] = rewards;
+                   result["dones"] = dones;
+                   result["truncateds"] = truncateds;
+                   return result; },
+              py::arg("episode"),
+              "Decodes a whole episode into a dict of obs, actions, rewards, dones and truncateds arrays.");
+
+     py::class_<hcle::environment::OfflineVectorEnv>(m, "OfflineVectorEnv")
+         .def(py::init<std::string, int, int, int, int, bool>(),
+              py::arg("directory"), py::arg("num_envs"), py::arg("obs_height") = 84, py::arg("obs_width") = 84,
+              py::arg("stack_num") = 4, py::arg("maxpool") = true, py::call_guard<py::gil_scoped_release>(),
+              "Replays a dataset recorded with raw_frames=True through the observation preprocessing, without emulation.")
+         .def_property_readonly("num_envs", &hcle::environment::OfflineVectorEnv::getNumEnvs)
+         .def_property_readonly("num_episodes", &hcle::environment::OfflineVectorEnv::getNumEpisodes)
+         .def_property_readonly("observation_shape", &hcle::environment::OfflineVectorEnv::getObservationShape)
+         .def("reset", [](hcle::environment::OfflineVectorEnv &self)
+              {
+                   std::vector<py::ssize_t> shape = {self.getNumEnvs()};
+                   for (size_t dim : self.getObservationShape())
+                        shape.push_back(static_cast<py::ssize_t>(dim));
+                   py::array_t<uint8_t> obs(shape);
+                   {
+                        py::gil_scoped_release release;
+                        self.reset(obs.mutable_data(), nullptr, nullptr);
+                   }
+                   return obs; },
+              "Starts every environment on its next recorded episode and returns the [num_envs, ...] observations.")
+         .def("send", [](hcle::environment::OfflineVectorEnv &self, py::array_t<int32_t, py::array::c_style> actions)
+              {
+                   std::span<const int32_t> actions_span(actions.data(), actions.size());
+
+                   py::gil_scoped_release release;
+                   self.send(actions_span);
+              },
+              py::arg("actions"), "Advances every environment by one recorded step; the actions only have to match num_envs.")
+         .def("recv", [](hcle::environment::OfflineVectorEnv &self)
+              {
+                   std::vector<py::ssize_t> shape = {self.getNumEnvs()};
+                   for (size_t dim : self.getObservationShape())
+                        shape.push_back(static_cast<py::ssize_t>(dim));
+                   py::array_t<uint8_t> obs(shape);
+                   py::array_t<double> rewards(self.getNumEnvs());
+                   py::array_t<bool> dones(self.getNumEnvs());
+                   py::array_t<bool> truncateds(self.getNumEnvs());
+                   py::array_t<uint8_t> actions(self.getNumEnvs());
+                   {
+                        py::gil_scoped_release release;
+                        self.recv(obs.mutable_data(), rewards.mutable_data(), reinterpret_cast<uint8_t *>(dones.mutable_data()),
+                                  reinterpret_cast<uint8_t *>(truncateds.mutable_data()));
+                        std::memcpy(actions.mutable_data(), self.getResultActions(), self.getNumEnvs());
+                   }
+                   return py::make_tuple(obs, rewards, dones, truncateds, actions); },
+              "Waits for the step and returns (obs, rewards, dones, truncateds, recorded_actions).");
+
+     py::class_<hcle::environment::ReplayBuffer>(m, "ReplayBuffer")
+         .def(py::init<size_t, int, std::vector<size_t>, uint64_t>(),
+              py::arg("capacity"), py::arg("num_envs"), py::arg("obs_shape"), py::arg("seed") = 0,
+              "Replay buffer for [stack_num, ...] observations that stores each frame once and rebuilds stacks when sampling.")
+         .def_property_readonly("capacity", &hcle::environment::ReplayBuffer::getCapacity)
+         .def_property_readonly("num_envs", &hcle::environment::ReplayBuffer::getNumEnvs)
+         .def_property_readonly("observation_shape", &hcle::environment::ReplayBuffer::getObservationShape)
+         .def_property_readonly("memory_bytes", &hcle::environment::ReplayBuffer::getMemoryUsage)
+         .def("__len__", &hcle::environment::ReplayBuffer::size)
+         .def("clear", &hcle::environment::ReplayBuffer::clear)
+         .def("add", [](hcle::environment::ReplayBuffer &self, py::array_t<uint8_t, py::array::c_style> obs_np, std::optional<py::array_t<uint8_t, py::array::c_style>> actions_np, py::array_t<double, py::array::c_style> rewards_np, py::array_t<uint8_t, py::array::c_style> dones_np, std::optional<py::array_t<uint8_t, py::array::c_style>> truncateds_np, std::optional<py::array_t<uint8_t, py::array::c_style>> final_obs_np)
+              {
+                   const py::ssize_t num_envs = self.getNumEnvs();
+                   const py::ssize_t obs_size = num_envs * static_cast<py::ssize_t>(self.getObservationSize());
+                   if (obs_np.size() != obs_size || (final_obs_np && final_obs_np->size() != obs_size))
+                        throw std::invalid_argument("Observations must have shape [num_envs, *observation_shape].");
+                   if ((actions_np && actions_np->size() != num_envs) || rewards_np.size() != num_envs ||
+                       dones_np.size() != num_envs || (truncateds_np && truncateds_np->size() != num_envs))
+                        throw std::invalid_argument("actions, rewards, dones and truncateds must have shape [num_envs].");
+
+                   py::gil_scoped_release release;
+                   self.add(obs_np.data(), actions_np ? actions_np->data() : nullptr, rewards_np.data(), dones_np.data(),
+                            truncateds_np ? truncateds_np->data() : nullptr, final_obs_np ? final_obs_np->data() : nullptr);
+              },
+              py::arg("obs"), py::arg("actions"), py::arg("rewards"), py::arg("dones"),
+              py::arg("truncateds") = py::none(), py::arg("final_obs") = py::none(),
+              "Adds one batch of results. Pass actions=None for the results of reset(), and final_obs under same_step autoreset.")
+         .def("add_results", [](hcle::environment::ReplayBuffer &self, const hcle::environment::HCLEVectorEnvironment &env)
+              {
+                   if (env.getNumEnvs() != self.getNumEnvs() || env.getObservationSize() != self.getObservationSize())
+                        throw std::invalid_argument("The environment does not match the replay buffer's num_envs and observation_shape.");
+                   const int slot = env.getCurrentResultSlot();
+                   const bool same_step = env.getAutoResetMode() == hcle::environment::AutoResetMode::SameStep;
+                   self.add(env.getResultObservations(slot), env.getResultActions(), env.getResultRewards(slot),
+                            env.getResultDones(slot), env.getResultTruncateds(slot),
+                            same_step ? env.getFinalObservations() : nullptr);
+              },
+              py::arg("env"), py::call_guard<py::gil_scoped_release>(),
+              "Adds the environment's most recent reset()/recv() results straight from its result buffers, without copies through Python.")
+         .def("sample", [](hcle::environment::ReplayBuffer &self, size_t batch_size)
+              {
+                   std::vector<py::ssize_t> obs_shape = {static_cast<py::ssize_t>(batch_size)};
+                   for (size_t dim : self.getObservationShape())
+                        obs_shape.push_back(static_cast<py::ssize_t>(dim));
+                   const auto length = static_cast<py::ssize_t>(batch_size);
+                   py::array_t<uint8_t> obs(obs_shape);
+                   py::array_t<uint8_t> next_obs(obs_shape);
+                   py::array_t<uint8_t> actions(length);
+                   py::array_t<double> rewards(length);
+                   py::array_t<bool> terminateds(length);
+                   py::array_t<bool> truncateds(length);
+                   {
+                        py::gil_scoped_release release;
+                        self.sample(batch_size, obs.mutable_data(), actions.mutable_data(), rewards.mutable_data(),
+                                    next_obs.mutable_data(), reinterpret_cast<uint8_t *>(terminateds.mutable_data()),
+                                    reinterpret_cast<uint8_t *>(truncateds.mutable_data()));
+                   }
+                   py::dict result;
+                   result["obs"] = obs;
+                   result["actions"] = actions;
+                   result["rewards"] = rewards;
+                   result["next_obs"] = next_obs;
+                   result["terminateds"] = terminateds;
+                   result["truncateds"] = truncateds;
+                   return result; },
+              py::arg("batch_size"),
+              "Samples transitions uniformly into a dict of obs, actions, rewards, next_obs, terminateds and truncateds arrays.")
+         .def("sample_into", [](hcle::environment::ReplayBuffer &self, py::array obs_np, py::array actions_np, py::array rewards_np, py::array next_obs_np, py::array terminateds_np, py::array truncateds_np)
+              {
+                   const py::ssize_t batch_size = obs_np.ndim() > 0 ? obs_np.shape(0) : 0;
+                   const py::ssize_t obs_size = batch_size * static_cast<py::ssize_t>(self.getObservationSize());
+                   auto *obs = checked_output<uint8_t>(obs_np, batch_size, obs_size, "obs");
+                   auto *next_obs = checked_output<uint8_t>(next_obs_np, batch_size, obs_size, "next_obs");
+                   auto *actions = checked_output<uint8_t>(actions_np, batch_size, batch_size, "actions");
+                   auto *rewards = checked_output<double>(rewards_np, batch_size, batch_size, "rewards");
+                   auto *terminateds = checked_output<uint8_t>(terminateds_np, batch_size, batch_size, "terminateds");
+                   auto *truncateds = checked_output<uint8_t>(truncateds_np, batch_size, batch_size, "truncateds");
+
+                   py::gil_scoped_release release;
+                   self.sample(static_cast<size_t>(batch_size), obs, actions, rewards, next_obs, terminateds, truncateds);
+              },
+              py::arg("obs"), py::arg("actions"), py::arg("rewards"), py::arg("next_obs"), py::arg("terminateds"), py::arg("truncateds"),
+              "Samples obs.shape[0] transitions into preallocated arrays. terminateds/truncateds are uint8.");
+
+#if !defined(_WIN32)
+     py::class_<hcle::environment::ShmVectorEnvironment>(m, "ShmVectorEnvironment")
+         .def(py::init<std::string, int, int, std::string, int, int, int, bool, bool, int, bool, int, std::string, int>(),
+              py::arg("worker_path"),
+              py::arg("num_envs"),
+              py::arg("num_workers"),
+              py::arg("game_name"),
+              py::arg("obs_height") = 84,
+              py::arg("obs_width") = 84,
+              py::arg("frame_skip") = 4,
+              py::arg("maxpool") = true,
+              py::arg("grayscale") = true,
+              py::arg("stack_num") = 4,
+              py::arg("color_index_grayscale") = false,
+              py::arg("max_episode_steps") = 0,
+              py::arg("autoreset_mode") = "next_step",
+              py::arg("threads_per_worker") = 0,
+              py::call_guard<py::gil_scoped_release>())
+         .def_property_readonly("num_envs", &hcle::environment::ShmVectorEnvironment::getNumEnvs)
+         .def_property_readonly("num_workers", &hcle::environment::ShmVectorEnvironment::getNumWorkers)
+         .def_property_readonly("shm_name", &hcle::environment::ShmVectorEnvironment::getSharedMemoryName)
+         .def("getActionSet", &hcle::environment::ShmVectorEnvironment::getActionSet)
+         .def("getObservationSize", &hcle::environment::ShmVectorEnvironment::getObservationSize)
+         .def("result_buffers", [](py::object self_obj)
+              {
+                   auto &self = self_obj.cast<hcle::environment::ShmVectorEnvironment &>();
+                   const py::ssize_t num_envs = self.getNumEnvs();
+                   return py::make_tuple(
+                       buffer_view(self_obj, self.getObservations(),
+                                   {num_envs, static_cast<py::ssize_t>(self.getObservationSize())}),
+                       buffer_view(self_obj, self.getRewards(), {num_envs}),
+                       buffer_view(self_obj, self.getDones(), {num_envs}),
+                       buffer_view(self_obj, self.getTruncateds(), {num_envs})); },
+              "Returns (obs, rewards, dones, truncateds) views straight into the shared memory region.")
+         .def_property_readonly("autoreset_mode", [](const hcle::environment::ShmVectorEnvironment &self)
+                                { return self.usesSameStepAutoreset() ? "same_step" : "next_step"; })
+         .def("final_observations", [](py::object self_obj)
+              {
+                   auto &self = self_obj.cast<hcle::environment::ShmVectorEnvironment &>();
+                   return buffer_view(self_obj, self.getFinalObservations(),
+                                      {self.getNumEnvs(), static_cast<py::ssize_t>(self.getObservationSize())}); },
+              "Returns a [num_envs, obs_size] view of the terminal observations written in same_step autoreset mode.")
+         .def("last_episode_returns", [](py::object self_obj)
+              {
+                   auto &self = self_obj.cast<hcle::environment::ShmVectorEnvironment &>();
+                   return buffer_view(self_obj, self.getLastEpisodeReturns(), {self.getNumEnvs()}); },
+              "Returns a view of the total reward of each environment's most recently finished episode.")
+         .def("last_episode_lengths", [](py::object self_obj)
+              {
+                   auto &self = self_obj.cast<hcle::environment::ShmVectorEnvironment &>();
+                   return buffer_view(self_obj, self.getLastEpisodeLengths(), {self.getNumEnvs()}); },
+              "Returns a view of the length of each environment's most recently finished episode.")
+         .def("reset", &hcle::environment::ShmVectorEnvironment::reset, py::call_guard<py::gil_scoped_release>())
+         .def("send", [](hcle::environment::ShmVectorEnvironment &self, py::array_t<uint8_t, py::array::c_style> actions)
+              { self.send(std::span<const uint8_t>(actions.data(), actions.size())); },
+              py::arg("actions").noconvert())
+         .def("send", [](hcle::environment::ShmVectorEnvironment &self, py::array_t<int32_t, py::array::c_style> actions)
+              { self.send(std::span<const int32_t>(actions.data(), actions.size())); },
+              py::arg("actions"))
+         .def("recv", &hcle::environment::ShmVectorEnvironment::recv, py::call_guard<py::gil_scoped_release>(),
+              "Waits for the worker processes to finish the step; results are then in result_buffers().");
+#endif
 }
\ No newline at end of file
@@ -2,7 +2,7 @@ import gymnasium as gym
 import time
 import matplotlib.pyplot as plt
 import hcle_py # This import registers the environments
-from hcle_py.vector_env import HCLEVectorEnv
+from hcle_py.vector_env import NESVectorEnv
 
 def run_test():
     print("--- HCLE Test Script ---")
@@ -11,7 +11,7 @@ def run_test():
     num_envs = 64
     try:
         print(f"Creating env: {env_id}")
-        envs = HCLEVectorEnv(game="smb1", num_envs=num_envs, obs_width=256, obs_height=240)
+        envs = NESVectorEnv(game="smb1", num_envs=num_envs, obs_width=256, obs_height=240)
         print("Environment created successfully. ✅")
     except Exception as e:
         print(f"❌ Error creating environment: {e}")